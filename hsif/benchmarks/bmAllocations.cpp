@@ -0,0 +1,136 @@
+#include "Server.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Feeds framed messages through an endpoint's receive buffer, routes them and
+// releases the delivered frames as a socket write would, then counts heap
+// allocations per message once pools are warm. Header routing is expected to
+// allocate nothing in steady state; the process exits non-zero if it does.
+
+#define BENCH_MESSAGES 100000
+#define BENCH_WARMUP 10000
+#define BENCH_SUBSCRIBERS 4
+
+// Allocations made on the routing thread, the logger's writer thread allocates on its own
+static std::atomic<uint64_t> allocations(0);
+static thread_local bool routingThread = false;
+
+void* operator new(size_t size)
+{
+    if (routingThread)
+        allocations++;
+    if (void* memory = std::malloc(size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+// Routes count copies of a message from sender and drains every receiver
+static void routeFrames(Server& server, EndpointHandle sender, const std::vector<std::shared_ptr<Endpoint>>& receivers,
+                        const std::string& frame, size_t count)
+{
+    std::shared_ptr<Endpoint> endpoint = server.getEndpoint(sender);
+    for (size_t index = 0; index < count; index++)
+    {
+        // Emulate a socket read of one frame into the endpoint's receive buffer
+        size_t offset = 0;
+        while (offset < frame.size())
+        {
+            size_t length = std::min<size_t>(PACKET_SIZE, frame.size() - offset);
+            std::memcpy(endpoint->recvBuffer, frame.data() + offset, length);
+            endpoint->bytesRecv = length;
+            endpoint->processRecv();
+            offset += length;
+        }
+        for (const RecvFrame& received : endpoint->outbox)
+            server.routeMessage(received, sender);
+        endpoint->releaseFrames();
+
+        // Discard delivered bytes as if they were sent
+        for (const std::shared_ptr<Endpoint>& receiver : receivers)
+            receiver->processSent(receiver->outbound.bytesQueued(), nullptr);
+    }
+}
+
+static double runAllocations(RoutingMode mode, bool publish, size_t payloadSize)
+{
+    std::string type = publish ? "publish" : "message";
+    std::string msg = "{\"type\":\"" + type + "\",\"from\":\"bench\",\"to\":\"" + (publish ? "bench-readings-topic" : "bench-receiver-0") +
+                      "\",\"data\":\"" + std::string(payloadSize, 'x') + "\"}";
+    std::string frame = std::to_string(msg.length()) + '\r' + msg;
+
+    auto logger = std::make_shared<Logger>();
+    Server server("", 0, logger, false);
+    server.setRoutingMode(mode);
+    EndpointHandle sender;
+    server.createEndpoint(INVALID_SOCKET, sender);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"bench\"}", sender);
+    std::vector<std::shared_ptr<Endpoint>> receivers;
+    for (int index = 0; index < (publish ? BENCH_SUBSCRIBERS : 1); index++)
+    {
+        EndpointHandle receiver;
+        server.createEndpoint(INVALID_SOCKET, receiver);
+        server.routeMessage("{\"type\":\"registration\",\"value\":\"bench-receiver-" + std::to_string(index) + "\"}", receiver);
+        server.routeMessage("{\"type\":\"subscribe\",\"value\":\"bench-readings-topic\"}", receiver);
+        receivers.push_back(server.getEndpoint(receiver));
+    }
+
+    routeFrames(server, sender, receivers, frame, BENCH_WARMUP);
+    uint64_t before = allocations;
+    routeFrames(server, sender, receivers, frame, BENCH_MESSAGES);
+    uint64_t allocated = allocations - before;
+    server.cleanup();
+    return static_cast<double>(allocated) / BENCH_MESSAGES;
+}
+
+int main()
+{
+    // Silence per-message logging
+    std::cout.rdbuf(nullptr);
+    routingThread = true;
+    bool steady = true;
+    printf("payload  route     parse(allocs/msg)  header(allocs/msg)\n");
+    for (size_t payloadSize : { 16, 1024, 16384 })
+    {
+        for (bool publish : { false, true })
+        {
+            double header = runAllocations(RoutingMode::Header, publish, payloadSize);
+            printf("%-8zu %-9s %-18.3f %.4f\n", payloadSize, publish ? "publish" : "message",
+                   runAllocations(RoutingMode::Parse, publish, payloadSize), header);
+            steady = steady && header == 0;
+        }
+    }
+    if (!steady)
+        printf("header routing allocated in steady state\n");
+    return steady ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#include "Server.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Loopback ping-pong comparing poll backends. A single client registers, then
+// repeatedly sends a message addressed to itself and waits for it to come back.
+
+#define BENCH_PORT 7790
+#define BENCH_MESSAGES 20000
+#define BENCH_WARMUP 1000
+
+struct BenchResult
+{
+    // Round trip latency percentiles in microseconds
+    double p50;
+    double p99;
+    // Messages per second
+    double throughput;
+    // Server syscalls per routed message
+    double syscallsPerMessage;
+};
+
+// Reads one length prefixed frame from the socket
+static bool readFrame(SOCKET socket, std::string& pending)
+{
+    char buffer[PACKET_SIZE];
+    while (true)
+    {
+        size_t delimiter = pending.find('\r');
+        if (delimiter != std::string::npos)
+        {
+            size_t length = std::stoul(pending.substr(0, delimiter));
+            if (pending.size() >= delimiter + 1 + length)
+            {
+                pending.erase(0, delimiter + 1 + length);
+                return true;
+            }
+        }
+        int bytes = sock::recv(socket, buffer, sizeof(buffer));
+        if (bytes <= 0)
+            return false;
+        pending.append(buffer, bytes);
+    }
+}
+
+// Sends a whole length prefixed frame
+static bool writeFrame(SOCKET socket, const std::string& payload)
+{
+    std::string frame = std::to_string(payload.length()) + '\r' + payload;
+    size_t sent = 0;
+    while (sent < frame.size())
+    {
+        int bytes = sock::send(socket, frame.c_str() + sent, frame.size() - sent);
+        if (bytes <= 0)
+            return false;
+        sent += bytes;
+    }
+    return true;
+}
+
+static bool runBackend(PollBackend backend, unsigned int port, BenchResult& result)
+{
+    auto logger = std::make_shared<Logger>();
+    Server server("127.0.0.1", port, logger, false, backend);
+    if (!server.connect())
+        return false;
+
+    // Server polls on its own thread until the client hangs up
+    std::atomic<bool> running(true);
+    ServerStats before = {};
+    std::thread poller([&]()
+    {
+        bool success = true;
+        bool sampled = false;
+        while (success && running)
+        {
+            success = server.poll();
+            // Counters are only read on the thread updating them, once the warm-up messages are routed
+            if (!sampled && server.stats().messagesRouted >= BENCH_WARMUP)
+            {
+                before = server.stats();
+                sampled = true;
+            }
+        }
+    });
+
+    SOCKET client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in serverAddr = {};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    bool success = ::connect(client, (sockaddr*)&serverAddr, sizeof(serverAddr)) == 0;
+    success = success && writeFrame(client, "{ \"type\" : \"registration\", \"value\" : \"bench\" }");
+
+    const std::string message = "{ \"type\" : \"message\", \"from\" : \"bench\", \"to\" : \"bench\", \"data\": { \"data\" : \"" + std::string(64, 'x') + "\" } }";
+    std::string pending;
+    std::vector<double> latencies;
+    latencies.reserve(BENCH_MESSAGES);
+    auto start = std::chrono::steady_clock::now();
+    for (int index = 0; success && index < BENCH_WARMUP + BENCH_MESSAGES; index++)
+    {
+        if (index == BENCH_WARMUP)
+            start = std::chrono::steady_clock::now();
+        auto sendTime = std::chrono::steady_clock::now();
+        success = writeFrame(client, message) && readFrame(client, pending);
+        if (index >= BENCH_WARMUP)
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sendTime).count());
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Hang up to wake the poller, then stop it, after which its counters are safe to read here
+    running = false;
+    sock::close(client);
+    poller.join();
+    ServerStats after = server.stats();
+    server.cleanup();
+    if (!success)
+        return false;
+
+    std::sort(latencies.begin(), latencies.end());
+    result.p50 = latencies[latencies.size() / 2];
+    result.p99 = latencies[latencies.size() * 99 / 100];
+    result.throughput = BENCH_MESSAGES / elapsed;
+    result.syscallsPerMessage = static_cast<double>(after.syscalls - before.syscalls) / (after.messagesRouted - before.messagesRouted);
+    return true;
+}
+
+int main()
+{
+    std::vector<std::pair<std::string, PollBackend>> backends = { { "select", PollBackend::Select } };
+#ifdef __linux__
+    backends.push_back({ "epoll", PollBackend::Epoll });
+    backends.push_back({ "io_uring", PollBackend::Uring });
+#endif
+
+    sock::startup();
+    std::cout << "backend    p50(us)  p99(us)  msg/s      syscalls/msg" << std::endl;
+    unsigned int port = BENCH_PORT;
+    for (auto& backend : backends)
+    {
+        BenchResult result;
+        if (!runBackend(backend.second, port++, result))
+        {
+            std::cout << backend.first << " failed" << std::endl;
+            continue;
+        }
+        printf("%-10s %-8.1f %-8.1f %-10.0f %.2f\n", backend.first.c_str(), result.p50, result.p99, result.throughput, result.syscallsPerMessage);
+    }
+    sock::teardown();
+    return 0;
+}
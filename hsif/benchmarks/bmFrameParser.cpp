@@ -0,0 +1,96 @@
+#include "Endpoint.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Feeds a stream of frames through Endpoint::processRecv in packets of varying
+// size and reports parse throughput and heap allocations per frame.
+
+#define BENCH_FRAMES 200000
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if (void* memory = std::malloc(size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+static void runParser(size_t payloadSize, size_t packetSize)
+{
+    std::string payload = "{ \"type\" : \"message\", \"data\" : \"" + std::string(payloadSize, 'x') + "\" }";
+    std::string frame = std::to_string(payload.length()) + '\r' + payload;
+    // Stream long enough that packets fall at every offset within a frame
+    std::string stream;
+    while (stream.size() < packetSize * frame.size())
+        stream += frame;
+
+    Endpoint endpoint(INVALID_SOCKET);
+    size_t frames = 0;
+    size_t offset = 0;
+    uint64_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    while (frames < BENCH_FRAMES)
+    {
+        // Emulate a socket read into the endpoint's receive buffer
+        size_t length = std::min(packetSize, stream.size() - offset);
+        std::memcpy(endpoint.recvBuffer, stream.data() + offset, length);
+        offset = (offset + length) % stream.size();
+        endpoint.bytesRecv = length;
+        if (!endpoint.processRecv())
+        {
+            printf("parse failed\n");
+            return;
+        }
+        frames += endpoint.outbox.size();
+        endpoint.releaseFrames();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t allocated = allocations - before;
+
+    printf("%-8zu %-8zu %-12.0f %-10.1f %.4f\n", payload.size(), packetSize, frames / elapsed,
+           frames * frame.size() / elapsed / (1 << 20), static_cast<double>(allocated) / frames);
+}
+
+int main()
+{
+    printf("payload  packet   frames/s     MiB/s      allocs/frame\n");
+    for (size_t payloadSize : { 16, 256, 4096 })
+    {
+        for (size_t packetSize : { 7, 100, 1024 })
+            runParser(payloadSize, packetSize);
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include "Server.hpp"
+#include "MsgData.hpp"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <random>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// google-benchmark suite for framing, routing and buffer management. Nothing
+// here touches a socket: received bytes are written straight into endpoint
+// receive buffers and sends are completed by releasing queued bytes, exactly
+// what the poll backends do around their syscalls. Run with
+// --benchmark_out=<file> --benchmark_out_format=json to keep results.
+
+// Frames in the stream fed to the receive benchmarks
+#define BENCH_STREAM_FRAMES 256
+
+// Message of roughly the requested size addressed to "bench"
+static std::string benchMessage(size_t payloadSize)
+{
+    return "{ \"type\" : \"message\", \"from\" : \"bench\", \"to\" : \"bench\", \"data\" : { \"value\" : \"" +
+        std::string(payloadSize, 'x') + "\" } }";
+}
+
+// Text frame stream of BENCH_STREAM_FRAMES messages
+static std::string benchStream(size_t payloadSize)
+{
+    std::string payload = benchMessage(payloadSize);
+    std::string frame = std::to_string(payload.length()) + '\r' + payload;
+    std::string stream;
+    for (int index = 0; index < BENCH_STREAM_FRAMES; index++)
+        stream += frame;
+    return stream;
+}
+
+// Server with one registered endpoint and logging limited to warnings
+static Server benchServer(RoutingMode mode, EndpointHandle& handle)
+{
+    auto logger = std::make_shared<Logger>();
+    logger->setLevel(LogLevel::Warning);
+    Server server("", 0, logger, false);
+    server.setRoutingMode(mode);
+    server.createEndpoint(INVALID_SOCKET, handle);
+    server.registerEndpoint("bench", handle);
+    return server;
+}
+
+// Feeds a stream to an endpoint in packets of the given sizes, cycling through them
+static size_t feedStream(Endpoint& endpoint, const std::string& stream, const std::vector<size_t>& packets)
+{
+    size_t frames = 0;
+    size_t next = 0;
+    for (size_t offset = 0; offset < stream.size();)
+    {
+        size_t length = std::min(packets[next++ % packets.size()], stream.size() - offset);
+        std::memcpy(endpoint.recvBuffer, stream.data() + offset, length);
+        endpoint.bytesRecv = length;
+        endpoint.processRecv();
+        frames += endpoint.outbox.size();
+        endpoint.releaseFrames();
+        offset += length;
+    }
+    return frames;
+}
+
+// Endpoint::processRecv with every packet the same size: arguments are payload size and packet size
+static void BM_ProcessRecvFixed(benchmark::State& state)
+{
+    std::string stream = benchStream(state.range(0));
+    std::vector<size_t> packets = { static_cast<size_t>(state.range(1)) };
+    Endpoint endpoint(INVALID_SOCKET);
+    size_t frames = 0;
+    for (auto _ : state)
+        frames += feedStream(endpoint, stream, packets);
+    state.SetItemsProcessed(frames);
+    state.SetBytesProcessed(state.iterations() * stream.size());
+}
+BENCHMARK(BM_ProcessRecvFixed)
+    ->ArgNames({ "payload", "packet" })
+    ->ArgsProduct({ { 16, 256, 4096 }, { 1, 7, 64, 512, PACKET_SIZE } });
+
+// Endpoint::processRecv with packet sizes drawn at random, so frame boundaries land at every offset
+static void BM_ProcessRecvRandom(benchmark::State& state)
+{
+    std::string stream = benchStream(state.range(0));
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<size_t> size(1, PACKET_SIZE);
+    std::vector<size_t> packets(1024);
+    for (size_t& packet : packets)
+        packet = size(generator);
+    Endpoint endpoint(INVALID_SOCKET);
+    size_t frames = 0;
+    for (auto _ : state)
+        frames += feedStream(endpoint, stream, packets);
+    state.SetItemsProcessed(frames);
+    state.SetBytesProcessed(state.iterations() * stream.size());
+}
+BENCHMARK(BM_ProcessRecvRandom)->ArgName("payload")->Arg(16)->Arg(256)->Arg(4096);
+
+// Endpoint::receiveMsg followed by processSent of the whole frame, the queue and send-completion path
+static void BM_ReceiveAndSend(benchmark::State& state)
+{
+    WireFormat format = static_cast<WireFormat>(state.range(1));
+    WireMessage msg(std::make_shared<const std::string>(benchMessage(state.range(0))));
+    Endpoint endpoint(INVALID_SOCKET);
+    endpoint.format = format;
+    endpoint.metrics = std::make_shared<EndpointMetrics>();
+    LatencyHistogram latency;
+    msg.receivedAt = MetricsRegistry::now();
+    for (auto _ : state)
+    {
+        endpoint.receiveMsg(msg);
+        endpoint.processSent(endpoint.outbound.bytesQueued(), &latency);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * msg.payload(format)->size());
+}
+BENCHMARK(BM_ReceiveAndSend)
+    ->ArgNames({ "payload", "format" })
+    ->ArgsProduct({ { 16, 1024, 65536 }, { static_cast<int>(WireFormat::Text), static_cast<int>(WireFormat::MsgPack) } });
+
+// Server::routeMessage of a self-addressed message: arguments are payload size and routing mode
+static void BM_RouteMessage(benchmark::State& state)
+{
+    RoutingMode mode = state.range(1) ? RoutingMode::Header : RoutingMode::Parse;
+    EndpointHandle handle;
+    Server server = benchServer(mode, handle);
+    std::shared_ptr<Endpoint> endpoint = server.getEndpoint(handle);
+    std::string msg = benchMessage(state.range(0));
+    for (auto _ : state)
+    {
+        server.routeMessage(msg, handle);
+        // Discard delivered bytes as if they were sent
+        endpoint->processSent(endpoint->outbound.bytesQueued(), nullptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * msg.size());
+}
+BENCHMARK(BM_RouteMessage)
+    ->ArgNames({ "payload", "header" })
+    ->ArgsProduct({ { 16, 256, 4096, 65536 }, { 0, 1 } });
+
+// MsgData construction from routing fields and data, then serialization
+static void BM_MsgDataFields(benchmark::State& state)
+{
+    json data = { { "value", std::string(state.range(0), 'x') } };
+    for (auto _ : state)
+    {
+        MsgData msg("bench", "source", data);
+        benchmark::DoNotOptimize(msg.getJson());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MsgDataFields)->ArgName("payload")->Arg(16)->Arg(1024)->Arg(65536);
+
+// MsgData construction from a parsed document, including validation, then serialization
+static void BM_MsgDataParsed(benchmark::State& state)
+{
+    std::string text = benchMessage(state.range(0));
+    for (auto _ : state)
+    {
+        MsgData msg(json::parse(text));
+        benchmark::DoNotOptimize(msg.isValid());
+        benchmark::DoNotOptimize(msg.getJson());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_MsgDataParsed)->ArgName("payload")->Arg(16)->Arg(1024)->Arg(65536);
+
+// Server::getEndpoint by identifier with many registered endpoints, visiting them in a scattered order
+static void BM_EndpointLookup(benchmark::State& state)
+{
+    size_t count = state.range(0);
+    auto logger = std::make_shared<Logger>();
+    logger->setLevel(LogLevel::Warning);
+    Server server("", 0, logger, false);
+    std::vector<std::string> ids;
+    for (size_t index = 0; index < count; index++)
+    {
+        EndpointHandle handle;
+        server.createEndpoint(INVALID_SOCKET, handle);
+        ids.push_back("endpoint-" + std::to_string(index));
+        server.registerEndpoint(ids.back(), handle);
+    }
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+
+    size_t next = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(server.getEndpoint(ids[next]));
+        if (++next == count)
+            next = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EndpointLookup)->ArgName("endpoints")->Arg(16)->Arg(1024)->Arg(16384)->Arg(65536);
+
+// Server::getEndpoint of an identifier that is not registered
+static void BM_EndpointLookupMiss(benchmark::State& state)
+{
+    EndpointHandle handle;
+    Server server = benchServer(RoutingMode::Parse, handle);
+    std::string id = "missing-endpoint";
+    for (auto _ : state)
+        benchmark::DoNotOptimize(server.getEndpoint(id));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EndpointLookupMiss);
+
+BENCHMARK_MAIN();
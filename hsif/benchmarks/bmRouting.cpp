@@ -0,0 +1,89 @@
+#include "Server.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Routes self-addressed messages carrying arrays of readings through
+// Server::routeMessage in each routing mode and reports time per message,
+// then repeats header routing with every message journaled and synced to
+// disk in groups as the poll loop would.
+
+#define BENCH_MESSAGES 2000
+
+static double runRouting(RoutingMode mode, size_t readings, bool journaled)
+{
+    std::string data;
+    for (size_t index = 0; index < readings; index++)
+        data += (index ? "," : "") + std::to_string(index * 0.25);
+    std::string msg = "{ \"type\" : \"message\", \"from\" : \"bench\", \"to\" : \"bench\", \"data\" : { \"readings\" : [" + data + "] } }";
+
+    auto logger = std::make_shared<Logger>();
+    Server server("", 0, logger, false);
+    server.setRoutingMode(mode);
+    std::string directory;
+    if (journaled)
+    {
+        char name[] = "/tmp/hsif-bench-journal-XXXXXX";
+        directory = mkdtemp(name);
+        server.openJournal(directory, DEFAULT_JOURNAL_POLICY);
+    }
+    Journal* journal = server.journal();
+    auto syncInterval = DEFAULT_JOURNAL_POLICY.syncInterval;
+    auto nextSync = std::chrono::steady_clock::now() + syncInterval;
+    EndpointHandle handle;
+    server.createEndpoint(INVALID_SOCKET, handle);
+    server.routeMessage("{ \"type\" : \"registration\", \"value\" : \"bench\" }", handle);
+    std::shared_ptr<Endpoint> endpoint = server.getEndpoint("bench");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int index = 0; index < BENCH_MESSAGES; index++)
+    {
+        server.routeMessage(msg, handle);
+        // Discard delivered bytes as if they were sent
+        endpoint->outbound.consume(endpoint->outbound.bytesQueued());
+        // Group commit once per sync interval, as the end of a poll does
+        if (journal && std::chrono::steady_clock::now() >= nextSync)
+        {
+            journal->sync();
+            nextSync = std::chrono::steady_clock::now() + syncInterval;
+        }
+    }
+    if (journal)
+        journal->sync();
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / BENCH_MESSAGES;
+    server.cleanup();
+    if (journaled)
+        std::filesystem::remove_all(directory);
+    return elapsed;
+}
+
+int main()
+{
+    // Silence per-message logging
+    std::cout.rdbuf(nullptr);
+    printf("readings  parse(us)  header(us)  journaled(us)\n");
+    for (size_t readings : { 1, 100, 1000, 10000 })
+    {
+        printf("%-9zu %-10.2f %-11.2f %.2f\n", readings, runRouting(RoutingMode::Parse, readings, false),
+            runRouting(RoutingMode::Header, readings, false), runRouting(RoutingMode::Header, readings, true));
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "MsgData.hpp"
+#include "MsgSchema.hpp"
+#include <chrono>
+#include <cstdio>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Serializes and parses a telemetry message with MsgData and with its typed
+// schema, as JSON text and as MessagePack, and reports time per message.
+
+#define BENCH_MESSAGES 200000
+
+struct BenchReading
+{
+    std::string sensor;
+    double celsius;
+    uint64_t sequence;
+    bool ok;
+    std::vector<double> samples;
+};
+
+template <>
+struct MsgSchema<BenchReading>
+{
+    static constexpr auto fields = std::make_tuple(
+        schema::field("sensor", &BenchReading::sensor),
+        schema::field("celsius", &BenchReading::celsius),
+        schema::field("sequence", &BenchReading::sequence),
+        schema::field("ok", &BenchReading::ok),
+        schema::field("samples", &BenchReading::samples));
+};
+
+// Runs a step BENCH_MESSAGES times and returns nanoseconds per run
+template <typename Step>
+static double timePerMessage(Step step)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int index = 0; index < BENCH_MESSAGES; index++)
+        step(index);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / BENCH_MESSAGES;
+}
+
+int main()
+{
+    TypedMsg<BenchReading> msg = { "message", "unity", "rpi-gateway", { "thermo-1", 21.5, 0, true, {} } };
+    for (int index = 0; index < 8; index++)
+        msg.data.samples.push_back(20.0 + index * 0.125);
+    std::string text;
+    schema::writeJson(msg, text);
+    std::string packed;
+    schema::writeMsgPack(msg, packed);
+    size_t checksum = 0;
+
+    // MsgData builds a document from routing fields and data, then dumps it
+    double dataWrite = timePerMessage([&](int index) {
+        json data = { { "sensor", msg.data.sensor }, { "celsius", msg.data.celsius }, { "sequence", index },
+                      { "ok", msg.data.ok }, { "samples", msg.data.samples } };
+        checksum += MsgData(msg.to, msg.from, data).getJson().size();
+    });
+    // MsgData validates a parsed document, and the fields are read from the document
+    double dataRead = timePerMessage([&](int) {
+        json document = json::parse(text);
+        MsgData parsed(document);
+        checksum += parsed.isValid() + document["data"]["samples"].size() + document["data"]["sequence"].get<uint64_t>();
+    });
+
+    std::string out;
+    TypedMsg<BenchReading> parsed;
+    double schemaWrite = timePerMessage([&](int index) {
+        msg.data.sequence = index;
+        out.clear();
+        schema::writeJson(msg, out);
+        checksum += out.size();
+    });
+    double schemaRead = timePerMessage([&](int) {
+        checksum += schema::readJson(text, parsed) ? parsed.data.samples.size() : 0;
+    });
+    double packWrite = timePerMessage([&](int index) {
+        msg.data.sequence = index;
+        out.clear();
+        schema::writeMsgPack(msg, out);
+        checksum += out.size();
+    });
+    double packRead = timePerMessage([&](int) {
+        checksum += schema::readMsgPack(packed, parsed) ? parsed.data.samples.size() : 0;
+    });
+
+    printf("%zu byte message, %zu bytes packed\n", text.size(), packed.size());
+    printf("codec           write(ns/msg)  read(ns/msg)\n");
+    printf("%-15s %-14.0f %.0f\n", "MsgData", dataWrite, dataRead);
+    printf("%-15s %-14.0f %.0f\n", "schema json", schemaWrite, schemaRead);
+    printf("%-15s %-14.0f %.0f\n", "schema msgpack", packWrite, packRead);
+    printf("json speedup    %-14.1f %.1f\n", dataWrite / schemaWrite, dataRead / schemaRead);
+    return checksum ? 0 : 1;
+}
@@ -1,6 +1,8 @@
 #include "Endpoint.hpp"
 #include <iostream>
 #include <sstream>
+#include <cstring>
+#include <vector>
 
 /*
 Copyright 2020 Itreau Bigsby
@@ -19,119 +21,143 @@ limitations under the License.
  */
 
 Endpoint::Endpoint(SOCKET clientSocket) :
-    socket(clientSocket),
-    id(""),
     bytesRecv(0),
-    bytesSent(0),
-    dataSize_(0),
-    contentSize(0)
-{}
+    id(""),
+    format(WireFormat::Text),
+    socket(clientSocket),
+    slot(INVALID_SLOT_HANDLE),
+    writeInterest(false),
+    ioToken(0),
+    sendInFlight(false),
+    recvArmed(false),
+    recvCancelling(false),
+    backpressure(DEFAULT_BACKPRESSURE_POLICY),
+    pressured(false),
+    blockedOn(0),
+    coalescing(DEFAULT_COALESCING_POLICY),
+    flushDeadline(0),
+    conflate(false),
+    channelLinked(false),
+    channelPeer({}),
+    datagramSeqIn(0),
+    datagramSeqOut(0),
+    replaying(false),
+    replayCursor({}),
+    replayEnd(0),
+    framesSent(0),
+    detachedUntil(0),
+    recvStamp(0),
+    recvFrames_(PACKET_SIZE)
+{
+    recvBuffer = recvFrames_.writePointer();
+}
 
 bool Endpoint::processRecv()
 {
-    // If room in buffer, append string delimiter to char array
-    if (bytesRecv < PACKET_SIZE)
-        recvBuffer[bytesRecv] = '\0';
-    // Convert char array to string for simpler processing
-    std::string stringBuffer(recvBuffer);
-    // If dataSize not set, we are receiving a new message
-    while (stringBuffer != "")
+    // Stamp the receive once for every frame it completes
+    if (metrics)
     {
-        if (dataSize_ == 0)
-        {
-            // First check if string buffer has size delimiter (always has to have if new message)
-            if (stringBuffer.find('\r') == std::string::npos)
-                return false;
-            else
-            {
-                std::vector<std::string> partitions;
-                // Split header from payload
-                partitions.push_back(stringBuffer.substr(0, stringBuffer.find('\r')));
-                partitions.push_back(stringBuffer.substr(stringBuffer.find('\r') + 1));
-
-                // Retrieve payload size
-                dataSize_ = std::stoi(partitions[0]);
-                // If payload exists in current packet, process
-                if (partitions[1] != "")
-                {
-                    stringBuffer = partitions[1];
-                }
-            }
-        }
-        // If size is known, we are still processing previous message
-        else
-        {
-            // Check if message contained in packet
-            if (stringBuffer.length() >= dataSize_)
-            {
-                // Extract message
-                std::string remainingData = stringBuffer.substr(0, dataSize_);
-                std::string message = messageBuffer_ + remainingData;
-                outbox.push(message);
-                // Reset buffers and size variables
-                stringBuffer = stringBuffer.substr(dataSize_);
-                messageBuffer_ = "";
-                dataSize_ = 0;
-            }
-            // If only part, subtract from data size and continue
-            else
-            {
-                // Append to buffer and continue
-                dataSize_ -= stringBuffer.length();
-                messageBuffer_ += stringBuffer;
-                stringBuffer = "";
-            }
-        }
+        recvStamp = MetricsRegistry::now();
+        metrics->bytesIn.add(bytesRecv);
     }
-    // Clear recv buffer and recv byte counter
-    memset(recvBuffer, 0, sizeof recvBuffer);
+
+    // Take ownership of bytes received in place, the buffer keeps PACKET_SIZE bytes free after them
+    recvFrames_.commit(bytesRecv);
+    recvBuffer = recvFrames_.writePointer();
     bytesRecv = 0;
-    return true;
+
+    // Extract every complete frame, partial frames stay buffered for the next receive
+    RecvFrame frame;
+    FrameStatus status;
+    size_t framed = outbox.size();
+    while ((status = recvFrames_.nextFrame(frame)) == FrameStatus::Ready)
+        outbox.push_back(frame);
+    if (metrics)
+        metrics->messagesIn.add(outbox.size() - framed);
+    return status != FrameStatus::Malformed;
 }
 
-void Endpoint::bufferReady()
+void Endpoint::processSent(size_t bytes, LatencyHistogram* latency)
 {
-    // Start by clearing buffer and size counters
-    memset(sendBuffer, 0, PACKET_SIZE);
-    bytesSent = 0;
-    contentSize = 0;
-
-    // If data in inbox, move to buffer
-    if (inbox != "")
+    size_t sent = outbound.consume(bytes, latency);
+    framesSent += sent;
+    if (metrics)
     {
-        // If inbox larger than packet, extract packet from inbox 
-        if (inbox.length() > PACKET_SIZE)
-        {
-            std::string packet = inbox.substr(0, PACKET_SIZE);
-            strcpy(sendBuffer, packet.c_str());
-            contentSize = sizeof sendBuffer;
-            inbox = inbox.substr(contentSize);
-        }
-        // If smaller or equal to buffer, extract and clear inbox
-        else
-        {
-            std::size_t length = inbox.copy(sendBuffer, inbox.length(), 0);
-            sendBuffer[length] = '\0';
-            contentSize = inbox.length();
-            inbox = "";
-        }
+        metrics->bytesOut.add(bytes);
+        metrics->messagesOut.add(sent);
+        metrics->queuedBytes.set(outbound.bytesQueued());
+        metrics->queuedMessages.set(outbound.numFrames());
     }
 }
 
+void Endpoint::releaseFrames()
+{
+    // Buffer may rewind once every frame is consumed
+    outbox.clear();
+    recvFrames_.release();
+    recvBuffer = recvFrames_.writePointer();
+}
+
+std::string Endpoint::unparsedRecv()
+{
+    return recvFrames_.unparsed();
+}
+
+void Endpoint::restoreRecv(std::string_view bytes)
+{
+    recvFrames_.append(bytes);
+    recvBuffer = recvFrames_.writePointer();
+}
+
+void Endpoint::setMaxFrameSize(size_t bytes)
+{
+    recvFrames_.setMaxFrameSize(bytes);
+}
+
 void Endpoint::receiveMsg(std::string msg)
 {
-    // Generate HSIF message from JSON string input
-    inbox += std::to_string(msg.length()) + '\r' + msg;
-    // If no data in outgoing buffer, fill buffer with new message contents
-    if (contentSize == 0)
+    receiveMsg(framing::makePayload(std::move(msg)));
+}
+
+void Endpoint::receiveMsg(Payload msg)
+{
+    // Generate HSIF frame around payload, sent straight from the shared buffer
+    outbound.push(std::move(msg));
+}
+
+void Endpoint::receiveMsg(WireMessage& msg)
+{
+    outbound.push(msg.payload(format), format, msg.receivedAt);
+    if (metrics)
+    {
+        metrics->queuedBytes.set(outbound.bytesQueued());
+        metrics->queuedMessages.set(outbound.numFrames());
+    }
+}
+
+bool Endpoint::receiveLatest(WireMessage& msg, size_t keep)
+{
+    bool replaced = outbound.pushLatest(*msg.conflationKey(), msg.payload(format), format, msg.receivedAt, keep);
+    if (metrics)
     {
-        bufferReady();
+        metrics->queuedBytes.set(outbound.bytesQueued());
+        metrics->queuedMessages.set(outbound.numFrames());
     }
+    return replaced;
 }
 
 void Endpoint::cleanup()
 {
-    // Close socket connection
-    int result = shutdown(socket, SD_SEND);
-    closesocket(socket);
+    // Close socket connection, in-process endpoints have none
+    if (socket != INVALID_SOCKET)
+    {
+        shutdown(socket, SD_SEND);
+        sock::close(socket);
+    }
+    // Unmap shared rings and close doorbells
+    if (shared)
+        shared->close();
+    // Tell an in-process client its endpoint is gone
+    if (local)
+        local->close();
 }
\ No newline at end of file
@@ -1,19 +1,21 @@
 #pragma once
 
-#undef UNICODE
-
-#define WIN32_LEAN_AND_MEAN
-
-#include <windows.h>
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include "Socket.hpp"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string>
 #include <any>
 #include <functional>
 #include "MsgData.hpp"
-#include <queue>
+#include "FrameBuffer.hpp"
+#include "Journal.hpp"
+#include "SendQueue.hpp"
+#include "SharedRing.hpp"
+#include "LocalChannel.hpp"
+#include "SlotMap.hpp"
+#include "Metrics.hpp"
+#include <string_view>
+#include <vector>
 
 /*
 Copyright 2020 Itreau Bigsby
@@ -31,13 +33,62 @@ limitations under the License.
 @author   Itreau Bigsby    mailto:ibigsby@asu.edu
  */
 
-#pragma comment (lib, "Ws2_32.lib")
-
 #define PACKET_SIZE 1024
+// Most buffers handed to a single scatter-gather send
+#define SEND_IOVECS 64
+
+/// <summary>
+/// What the broker does when a receiver's queued outbound bytes pass its high watermark.
+/// </summary>
+enum class OverflowPolicy
+{
+	// Stop reading from the senders feeding the receiver until it drains below its low watermark;
+	// messages from other shards fall back to DropOldest
+	Block,
+	// Discard the receiver's oldest unsent messages
+	DropOldest,
+	// Disconnect the receiver as a slow consumer
+	Disconnect
+};
+
+/// <summary>
+/// Per-endpoint limits on queued outbound bytes.
+/// </summary>
+struct BackpressurePolicy
+{
+	// Queued bytes above which the overflow policy applies
+	size_t highWatermark;
+	// Queued bytes at or below which blocked senders resume
+	size_t lowWatermark;
+	// Action taken above the high watermark
+	OverflowPolicy overflow;
+};
+
+// Backpressure limits used unless a server is configured otherwise
+#define DEFAULT_BACKPRESSURE_POLICY BackpressurePolicy{ 4 * 1024 * 1024, 1024 * 1024, OverflowPolicy::Block }
+
+/// <summary>
+/// Per-endpoint write coalescing. Frames routed to an idle endpoint are held
+/// until the window passes or the byte budget fills, then leave in one write.
+/// </summary>
+struct CoalescingPolicy
+{
+	// Longest time the first held frame waits for others, in microseconds, 0 to write every poll
+	uint64_t windowUs;
+	// Queued bytes that end the window early, 0 for no budget
+	size_t maxBytes;
+	// Disable Nagle's algorithm on the endpoint's socket (TCP_NODELAY)
+	bool noDelay;
+	// Cork the socket while a write needs more than one scatter-gather send (TCP_CORK, Linux only)
+	bool cork;
+};
+
+// Coalescing used unless a server is configured otherwise: writes are not held and socket options are left alone
+#define DEFAULT_COALESCING_POLICY CoalescingPolicy{ 0, 0, false, false }
 
 /// <summary>
 /// Used to encapsulate client socket information. Provides functionality for 
-/// sending, and receiving data using windows sockets.
+/// sending, and receiving data using the platform socket layer.
 /// </summary>
 class Endpoint
 {
@@ -48,6 +99,10 @@ public:
 	Endpoint() = delete;
 	~Endpoint() = default;
 
+	// Receive pointer refers into the endpoint's own buffer
+	Endpoint(const Endpoint&) = delete;
+	Endpoint& operator=(const Endpoint&) = delete;
+
     /// <summary>
     /// Primary constructor. Accepts an existing socket connection as input.
     /// </summary>
@@ -61,44 +116,171 @@ public:
 	void receiveMsg(std::string msg);
 
 	/// <summary>
-	/// Processes received packet.
+	/// Receives a shared JSON message payload without copying it.
+	/// </summary>
+	/// <param name="msg">JSON message payload.</param>
+	void receiveMsg(Payload msg);
+
+	/// <summary>
+	/// Receives a routed message in the wire format this endpoint negotiated.
+	/// </summary>
+	/// <param name="msg">Routed message, encoded on first use of each format. Must encode in the endpoint's format.</param>
+	void receiveMsg(WireMessage& msg);
+
+	/// <summary>
+	/// Receives a routed message that replaces any undelivered message with the same
+	/// conflation key, keeping its place in the queue.
+	/// </summary>
+	/// <param name="msg">Routed message, encoded on first use of each format. Must encode in the endpoint's format and have a conflation key.</param>
+	/// <param name="keep">Number of leading queued frames an in-flight send still reads.</param>
+	/// <returns>True if an older message was replaced.</returns>
+	bool receiveLatest(WireMessage& msg, size_t keep);
+
+	/// <summary>
+	/// Processes bytesRecv bytes written at recvBuffer, appending every complete
+	/// frame to the outbox.
 	/// </summary>
 	/// <returns>Returns whether or not process was successful.</returns>
 	bool processRecv();
 
 	/// <summary>
-	/// Signals to the endpoint that the previous packet has successfully sent
-	/// and its resources can be cleared.
+	/// Releases bytes the socket accepted from the outbound queue, counting sent
+	/// frames and recording the time from receive to send of each.
+	/// </summary>
+	/// <param name="bytes">Number of bytes sent.</param>
+	/// <param name="latency">Histogram receiving latencies, or null.</param>
+	void processSent(size_t bytes, LatencyHistogram* latency);
+
+	/// <summary>
+	/// Signals that the frames in the outbox have been routed, releasing their storage.
 	/// </summary>
-	void bufferReady();
+	void releaseFrames();
+
+	/// <summary>
+	/// Returns received bytes not yet parsed into frames, as they arrived on the socket.
+	/// </summary>
+	/// <returns>Partial frame bytes.</returns>
+	std::string unparsedRecv();
+
+	/// <summary>
+	/// Restores bytes another process received on the same connection but did not
+	/// parse, so the next receive completes their frame.
+	/// </summary>
+	/// <param name="bytes">Bytes returned by unparsedRecv().</param>
+	void restoreRecv(std::string_view bytes);
+
+	/// <summary>
+	/// Sets the largest frame payload the endpoint may send, a longer frame makes its stream invalid.
+	/// </summary>
+	/// <param name="bytes">Largest payload in bytes.</param>
+	void setMaxFrameSize(size_t bytes);
 
 	/// <summary>
 	/// Closes socket connection.
 	/// </summary>
 	void cleanup();
 
-	// Operates as contiguous message inbox string
-	std::string inbox;
-	
-	// Operates as outgoing message queue
-	std::queue<std::string> outbox;
-
-	// Winsock intermediary buffer resources
-	char sendBuffer[PACKET_SIZE];
-	char recvBuffer[PACKET_SIZE];
-	WSABUF buff;
-	size_t bytesSent;
+	// Outgoing frames waiting to be written to the socket
+	SendQueue outbound;
+
+	// Frames parsed from received data, views into the receive buffer valid until releaseFrames()
+	std::vector<RecvFrame> outbox;
+
+	// Socket intermediary buffer resources, PACKET_SIZE bytes are always writable at recvBuffer
+	char* recvBuffer;
 	size_t bytesRecv;
-	size_t contentSize;
+
+	// Scatter list of the current send, stable while an asynchronous send is in flight
+	IoVec sendVecs[SEND_IOVECS];
 	
 	// Endpoint identifier
 	std::string id;
 
+	// Encoding of frames sent to this endpoint, negotiated at registration
+	WireFormat format;
+
+	// Topics this endpoint subscribed to
+	std::vector<std::string> topics;
+
 	// Client socket instance
 	SOCKET socket;
 
+	// Handle of this endpoint in the server's slots, stale once the server removes it
+	SlotHandle slot;
+
+	// Whether the reactor is currently watching this socket for writability
+	bool writeInterest;
+
+	// io_uring connection token and whether a send request is outstanding
+	uint32_t ioToken;
+	bool sendInFlight;
+
+	// io_uring multishot receive armed, and receive cancelled to pause reads but not yet ended
+	bool recvArmed;
+	bool recvCancelling;
+
+	// Queued outbound byte limits
+	BackpressurePolicy backpressure;
+
+	// Whether queued outbound bytes passed the high watermark and have not drained to the low watermark
+	bool pressured;
+
+	// Senders paused while this endpoint is pressured
+	std::vector<SlotHandle> blockedSenders;
+
+	// Number of pressured receivers this endpoint is paused by, reads stop while non-zero
+	size_t blockedOn;
+
+	// Write coalescing limits
+	CoalescingPolicy coalescing;
+
+	// MetricsRegistry::now() stamp at which held frames are written, 0 while no frames are held
+	uint64_t flushDeadline;
+
+	// Whether every message routed here keeps only the newest undelivered message per conflation key
+	bool conflate;
+
+	// Token the client links its datagram channel with, empty until it opens one
+	std::string channelToken;
+
+	// Whether a datagram peer is linked and its address
+	bool channelLinked;
+	DatagramAddress channelPeer;
+
+	// Sequence numbers of the newest datagram received from and sent to the channel peer
+	uint64_t datagramSeqIn;
+	uint64_t datagramSeqOut;
+
+	// Whether a catch-up replay of the journal is in progress, its read position, and the
+	// offset live delivery took over from when it started
+	bool replaying;
+	JournalCursor replayCursor;
+	uint64_t replayEnd;
+
+	// Token a reconnecting client takes its session over with, empty for endpoints registered without one
+	std::string sessionToken;
+
+	// Frames written in full since the session was registered, carried over when it is taken over
+	uint64_t framesSent;
+
+	// MetricsRegistry::now() stamp a disconnected session is dropped at, 0 while connected
+	uint64_t detachedUntil;
+
+	// Shared-memory channel carrying the endpoint's frames in place of its socket, which then
+	// only reports the client closing. Null for socket endpoints
+	std::unique_ptr<SharedChannel> shared;
+
+	// Rings of an in-process client, carrying whole payloads in place of a socket, which is
+	// then INVALID_SOCKET. Null for socket and shared-memory endpoints
+	std::shared_ptr<LocalChannel> local;
+
+	// Traffic counters, null unless owned by a server
+	std::shared_ptr<EndpointMetrics> metrics;
+
+	// MetricsRegistry::now() stamp of the last receive, 0 without metrics
+	uint64_t recvStamp;
+
 private:
-	// Packet processing resources
-	size_t dataSize_;
-	std::string messageBuffer_;
+	// Receive buffer frames are parsed from in place
+	FrameBuffer recvFrames_;
 };
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "EpollReactor.hpp"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+#ifdef __linux__
+
+EpollReactor::EpollReactor() :
+    epollFd_(-1)
+{}
+
+EpollReactor::~EpollReactor()
+{
+    if (epollFd_ != -1)
+        ::close(epollFd_);
+}
+
+bool EpollReactor::init()
+{
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    return epollFd_ != -1;
+}
+
+bool EpollReactor::add(SOCKET socket, bool writeInterest)
+{
+    epoll_event event = {};
+    uint32_t mask = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (writeInterest)
+        mask |= static_cast<uint32_t>(EPOLLOUT);
+    event.events = mask;
+    event.data.fd = socket;
+    return epoll_ctl(epollFd_, EPOLL_CTL_ADD, socket, &event) == 0;
+}
+
+bool EpollReactor::setWriteInterest(SOCKET socket, bool enabled)
+{
+    return setInterest(socket, true, enabled);
+}
+
+bool EpollReactor::setInterest(SOCKET socket, bool readInterest, bool writeInterest)
+{
+    // Modifying the registration re-arms the edge, so a socket that is already
+    // readable or writable reports it on the next wait
+    epoll_event event = {};
+    uint32_t mask = EPOLLET;
+    if (readInterest)
+        mask |= static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP);
+    if (writeInterest)
+        mask |= static_cast<uint32_t>(EPOLLOUT);
+    event.events = mask;
+    event.data.fd = socket;
+    return epoll_ctl(epollFd_, EPOLL_CTL_MOD, socket, &event) == 0;
+}
+
+void EpollReactor::remove(SOCKET socket)
+{
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+}
+
+int EpollReactor::wait(std::vector<ReactorEvent>& ready, int timeoutMs)
+{
+    epoll_event events[MAX_EVENTS];
+    ready.clear();
+
+    int count = epoll_wait(epollFd_, events, MAX_EVENTS, timeoutMs);
+    if (count == -1)
+        return errno == EINTR ? 0 : -1;
+
+    // Translate kernel events into reactor events
+    for (int i = 0; i < count; i++)
+    {
+        ReactorEvent event;
+        event.socket = events[i].data.fd;
+        event.readable = (events[i].events & (EPOLLIN | EPOLLRDHUP)) != 0;
+        event.writable = (events[i].events & EPOLLOUT) != 0;
+        event.hangup = (events[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+        ready.push_back(event);
+    }
+    return count;
+}
+
+#else
+
+EpollReactor::EpollReactor() :
+    epollFd_(-1)
+{}
+
+EpollReactor::~EpollReactor() = default;
+
+bool EpollReactor::init()
+{
+    // Epoll is a Linux facility
+    return false;
+}
+
+bool EpollReactor::add(SOCKET socket, bool writeInterest)
+{
+    return false;
+}
+
+bool EpollReactor::setWriteInterest(SOCKET socket, bool enabled)
+{
+    return false;
+}
+
+bool EpollReactor::setInterest(SOCKET socket, bool readInterest, bool writeInterest)
+{
+    return false;
+}
+
+void EpollReactor::remove(SOCKET socket)
+{}
+
+int EpollReactor::wait(std::vector<ReactorEvent>& ready, int timeoutMs)
+{
+    ready.clear();
+    return -1;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Socket.hpp"
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Readiness notification for a single socket returned from a reactor wait.
+/// </summary>
+struct ReactorEvent
+{
+	SOCKET socket;
+	bool readable;
+	bool writable;
+	bool hangup;
+};
+
+/// <summary>
+/// Edge-triggered epoll wrapper. Sockets are registered once and only sockets
+/// that changed state are reported on each wait, so the cost of a wakeup is
+/// proportional to the number of ready sockets rather than connected ones.
+/// Only functional on Linux; init() fails elsewhere.
+/// </summary>
+class EpollReactor
+{
+public:
+	EpollReactor();
+	~EpollReactor();
+
+	// Reactor owns the epoll descriptor
+	EpollReactor(const EpollReactor&) = delete;
+	EpollReactor& operator=(const EpollReactor&) = delete;
+
+	/// <summary>
+	/// Creates the epoll instance.
+	/// </summary>
+	/// <returns>True if successful.</returns>
+	bool init();
+
+	/// <summary>
+	/// Registers a socket for edge-triggered read notifications.
+	/// </summary>
+	/// <param name="socket">Non-blocking socket to watch.</param>
+	/// <param name="writeInterest">Whether to also watch for writability.</param>
+	/// <returns>True if successful.</returns>
+	bool add(SOCKET socket, bool writeInterest);
+
+	/// <summary>
+	/// Enables or disables write notifications for a registered socket.
+	/// </summary>
+	/// <param name="socket">Registered socket.</param>
+	/// <param name="enabled">True to watch for writability.</param>
+	/// <returns>True if successful.</returns>
+	bool setWriteInterest(SOCKET socket, bool enabled);
+
+	/// <summary>
+	/// Sets read and write notifications for a registered socket. Hangups and
+	/// errors are always reported.
+	/// </summary>
+	/// <param name="socket">Registered socket.</param>
+	/// <param name="readInterest">True to watch for readability.</param>
+	/// <param name="writeInterest">True to watch for writability.</param>
+	/// <returns>True if successful.</returns>
+	bool setInterest(SOCKET socket, bool readInterest, bool writeInterest);
+
+	/// <summary>
+	/// Stops watching a socket. Must be called before the socket is closed.
+	/// </summary>
+	/// <param name="socket">Registered socket.</param>
+	void remove(SOCKET socket);
+
+	/// <summary>
+	/// Blocks until at least one socket is ready or the timeout expires.
+	/// </summary>
+	/// <param name="ready">Cleared and filled with ready sockets.</param>
+	/// <param name="timeoutMs">Milliseconds to wait, -1 to block indefinitely.</param>
+	/// <returns>Number of ready sockets, or -1 on error.</returns>
+	int wait(std::vector<ReactorEvent>& ready, int timeoutMs);
+
+private:
+	// Epoll instance descriptor
+	int epollFd_;
+	// Maximum number of events harvested per wait call
+	static constexpr int MAX_EVENTS = 256;
+};
@@ -0,0 +1,190 @@
+#include "FrameBuffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Longest accepted length prefix, digits only
+#define MAX_HEADER_DIGITS 19
+
+FrameBuffer::FrameBuffer(size_t minimumSpace, size_t maxFrameSize) :
+    data_(minimumSpace * 2),
+    begin_(0),
+    end_(0),
+    frameSize_(0),
+    frameFormat_(WireFormat::Text),
+    haveHeader_(false),
+    held_(false),
+    minimumSpace_(minimumSpace),
+    maxFrameSize_(maxFrameSize)
+{}
+
+void FrameBuffer::setMaxFrameSize(size_t maxFrameSize)
+{
+    maxFrameSize_ = maxFrameSize;
+}
+
+char* FrameBuffer::writePointer()
+{
+    return data_.data() + end_;
+}
+
+void FrameBuffer::commit(size_t bytes)
+{
+    end_ += bytes;
+    if (data_.size() - end_ < minimumSpace_)
+        reserve();
+}
+
+FrameStatus FrameBuffer::nextFrame(std::string_view& frame)
+{
+    RecvFrame recvFrame;
+    FrameStatus status = nextFrame(recvFrame);
+    frame = recvFrame.payload;
+    return status;
+}
+
+FrameStatus FrameBuffer::nextFrame(RecvFrame& frame)
+{
+    // Parse length prefix once per frame, then only wait for the payload
+    if (!haveHeader_)
+    {
+        const char* start = data_.data() + begin_;
+        size_t available = end_ - begin_;
+        if (available == 0)
+            return FrameStatus::Incomplete;
+
+        // Fixed size binary header
+        if (static_cast<unsigned char>(*start) == BINARY_FRAME_MAGIC)
+        {
+            if (available < BINARY_HEADER_SIZE)
+                return FrameStatus::Incomplete;
+            uint32_t length;
+            if (!framing::readBinaryHeader(start, frameFormat_, length) || length == 0 || length > maxFrameSize_)
+                return FrameStatus::Malformed;
+            frameSize_ = length;
+            begin_ += BINARY_HEADER_SIZE;
+        }
+        // Decimal length prefix terminated by '\r'
+        else
+        {
+            const char* delimiter = static_cast<const char*>(std::memchr(start, '\r', available));
+            if (delimiter == nullptr)
+                return available > MAX_HEADER_DIGITS ? FrameStatus::Malformed : FrameStatus::Incomplete;
+
+            size_t digits = delimiter - start;
+            if (digits == 0 || digits > MAX_HEADER_DIGITS)
+                return FrameStatus::Malformed;
+            size_t size = 0;
+            for (const char* digit = start; digit < delimiter; digit++)
+            {
+                if (*digit < '0' || *digit > '9')
+                    return FrameStatus::Malformed;
+                size = size * 10 + (*digit - '0');
+            }
+            if (size == 0 || size > maxFrameSize_)
+                return FrameStatus::Malformed;
+
+            frameSize_ = size;
+            frameFormat_ = WireFormat::Text;
+            begin_ += digits + 1;
+        }
+        haveHeader_ = true;
+    }
+
+    if (end_ - begin_ < frameSize_)
+        return FrameStatus::Incomplete;
+
+    // Hand out payload in place
+    frame.payload = std::string_view(data_.data() + begin_, frameSize_);
+    frame.format = frameFormat_;
+    begin_ += frameSize_;
+    haveHeader_ = false;
+    held_ = true;
+    return FrameStatus::Ready;
+}
+
+void FrameBuffer::release()
+{
+    held_ = false;
+    retired_.clear();
+    // Rewind when everything was consumed, otherwise compact lazily on the next commit
+    if (begin_ == end_)
+        begin_ = end_ = 0;
+}
+
+size_t FrameBuffer::pending()
+{
+    return end_ - begin_;
+}
+
+std::string FrameBuffer::unparsed()
+{
+    std::string bytes;
+    // A parsed header was stepped over, rebuild it in front of the partial payload
+    if (haveHeader_ && frameFormat_ == WireFormat::Text)
+    {
+        bytes = std::to_string(frameSize_);
+        bytes += '\r';
+    }
+    else if (haveHeader_)
+    {
+        char header[BINARY_HEADER_SIZE];
+        framing::writeBinaryHeader(header, frameFormat_, 0, static_cast<uint32_t>(frameSize_));
+        bytes.assign(header, BINARY_HEADER_SIZE);
+    }
+    bytes.append(data_.data() + begin_, end_ - begin_);
+    return bytes;
+}
+
+void FrameBuffer::append(std::string_view bytes)
+{
+    // Free space is only guaranteed minimumSpace bytes at a time
+    while (!bytes.empty())
+    {
+        size_t count = std::min(bytes.size(), minimumSpace_);
+        std::memcpy(writePointer(), bytes.data(), count);
+        commit(count);
+        bytes.remove_prefix(count);
+    }
+}
+
+void FrameBuffer::reserve()
+{
+    size_t unparsed = end_ - begin_;
+    size_t required = unparsed + minimumSpace_;
+
+    // Nothing references the consumed prefix, slide the partial frame down
+    if (!held_ && required <= data_.size())
+    {
+        std::memmove(data_.data(), data_.data() + begin_, unparsed);
+    }
+    // Outstanding frames or a large partial frame need a new block
+    else
+    {
+        size_t capacity = data_.size();
+        while (capacity < required)
+            capacity *= 2;
+        std::vector<char> block(capacity);
+        std::memcpy(block.data(), data_.data() + begin_, unparsed);
+        if (held_)
+            retired_.push_back(std::move(data_));
+        data_ = std::move(block);
+    }
+    begin_ = 0;
+    end_ = unparsed;
+}
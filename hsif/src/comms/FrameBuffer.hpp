@@ -0,0 +1,153 @@
+#pragma once
+
+#include <string_view>
+#include "Framing.hpp"
+#include <vector>
+
+// Default largest frame payload accepted, a longer length prefix makes the stream invalid
+#define FRAME_SIZE_MAX (8 * 1024 * 1024)
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Result of attempting to extract a frame.
+/// </summary>
+enum class FrameStatus
+{
+	// A complete frame was extracted
+	Ready,
+	// More bytes are needed
+	Incomplete,
+	// Header is not a valid length prefix, or names a payload over the size limit
+	Malformed
+};
+
+/// <summary>
+/// Frame payload handed out by a FrameBuffer.
+/// </summary>
+struct RecvFrame
+{
+	// View of the payload inside the receive buffer
+	std::string_view payload;
+	// Encoding named by the frame header
+	WireFormat format;
+};
+
+/// <summary>
+/// Growable receive buffer that splits "<length>\r<payload>" frames in place.
+/// Binary frames, recognised by BINARY_FRAME_MAGIC, may be mixed freely with
+/// text frames on the same stream.
+/// Sockets receive directly into the free space at the end of the buffer and
+/// frames are handed out as views, so no payload bytes are copied on the way
+/// in. Views stay valid until release(); if the buffer must grow while views
+/// are outstanding, the old block is kept alive until then.
+/// </summary>
+class FrameBuffer
+{
+public:
+	/// <summary>
+	/// Creates a buffer that always offers at least the given free space.
+	/// </summary>
+	/// <param name="minimumSpace">Bytes guaranteed writable at writePointer().</param>
+	/// <param name="maxFrameSize">Largest payload a frame header may name.</param>
+	FrameBuffer(size_t minimumSpace, size_t maxFrameSize = FRAME_SIZE_MAX);
+
+	/// <summary>
+	/// Sets the largest payload a frame header may name. The buffer only grows to
+	/// hold frames within this limit, so a peer cannot make it allocate without bound.
+	/// </summary>
+	/// <param name="maxFrameSize">Largest payload in bytes.</param>
+	void setMaxFrameSize(size_t maxFrameSize);
+
+	/// <summary>
+	/// Returns start of free space. At least minimumSpace bytes are writable.
+	/// </summary>
+	/// <returns>Write position.</returns>
+	char* writePointer();
+
+	/// <summary>
+	/// Marks bytes written at writePointer() as received and restores the free
+	/// space guarantee.
+	/// </summary>
+	/// <param name="bytes">Number of bytes written.</param>
+	void commit(size_t bytes);
+
+	/// <summary>
+	/// Extracts the next complete frame. Bytes are only scanned once, however
+	/// the frame is split across receives.
+	/// </summary>
+	/// <param name="frame">Receives view of the frame payload.</param>
+	/// <returns>Whether a frame was extracted, more data is needed, or the stream is invalid.</returns>
+	FrameStatus nextFrame(std::string_view& frame);
+
+	/// <summary>
+	/// Extracts the next complete frame along with the encoding its header names.
+	/// </summary>
+	/// <param name="frame">Receives view of the frame payload and its format.</param>
+	/// <returns>Whether a frame was extracted, more data is needed, or the stream is invalid.</returns>
+	FrameStatus nextFrame(RecvFrame& frame);
+
+	/// <summary>
+	/// Signals that every frame handed out has been consumed, allowing their
+	/// storage to be reused.
+	/// </summary>
+	void release();
+
+	/// <summary>
+	/// Returns number of received bytes not yet handed out as frames.
+	/// </summary>
+	/// <returns>Buffered byte count.</returns>
+	size_t pending();
+
+	/// <summary>
+	/// Returns received bytes not yet handed out as frames as they arrived on the
+	/// stream, including the header of a partial frame already parsed.
+	/// </summary>
+	/// <returns>Copy of the unparsed bytes.</returns>
+	std::string unparsed();
+
+	/// <summary>
+	/// Adds bytes as if received, such as the unparsed() bytes of the same stream
+	/// read by another process.
+	/// </summary>
+	/// <param name="bytes">Bytes to add.</param>
+	void append(std::string_view bytes);
+
+private:
+	/// <summary>
+	/// Moves or reallocates unparsed bytes so minimumSpace bytes are free.
+	/// </summary>
+	void reserve();
+
+	// Current storage block
+	std::vector<char> data_;
+	// Blocks still referenced by outstanding frames
+	std::vector<std::vector<char>> retired_;
+	// Start of unparsed bytes and end of received bytes
+	size_t begin_;
+	size_t end_;
+	// Payload size of the frame at begin_ once its header is parsed
+	size_t frameSize_;
+	WireFormat frameFormat_;
+	bool haveHeader_;
+	// Whether frames have been handed out since the last release
+	bool held_;
+	// Free space guaranteed at the write position
+	size_t minimumSpace_;
+	// Largest payload a frame header may name
+	size_t maxFrameSize_;
+};
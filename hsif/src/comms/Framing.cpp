@@ -0,0 +1,309 @@
+#include "Framing.hpp"
+#include "MsgHeader.hpp"
+#include "SlabPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+void framing::writeBinaryHeader(char* header, WireFormat format, uint8_t flags, uint32_t length)
+{
+    header[0] = static_cast<char>(BINARY_FRAME_MAGIC);
+    header[1] = static_cast<char>(format);
+    header[2] = static_cast<char>(flags);
+    header[3] = 0;
+    // Little-endian regardless of host byte order
+    for (int byte = 0; byte < 4; byte++)
+        header[4 + byte] = static_cast<char>((length >> (8 * byte)) & 0xFF);
+}
+
+bool framing::readBinaryHeader(const char* header, WireFormat& format, uint32_t& length)
+{
+    uint8_t rawFormat = static_cast<uint8_t>(header[1]);
+    if (rawFormat >= WIRE_FORMATS)
+        return false;
+    format = static_cast<WireFormat>(rawFormat);
+    length = 0;
+    for (int byte = 0; byte < 4; byte++)
+        length |= static_cast<uint32_t>(static_cast<uint8_t>(header[4 + byte])) << (8 * byte);
+    return true;
+}
+
+size_t framing::writeDatagramHeader(char* header, uint64_t sequence)
+{
+    char* end = std::to_chars(header, header + DATAGRAM_HEADER_MAX - 1, sequence).ptr;
+    *end++ = '\r';
+    return end - header;
+}
+
+bool framing::readDatagram(std::string_view datagram, uint64_t& sequence, std::string_view& payload)
+{
+    size_t delimiter = datagram.find('\r');
+    if (delimiter == std::string_view::npos || delimiter == 0 || delimiter >= DATAGRAM_HEADER_MAX)
+        return false;
+    auto parsed = std::from_chars(datagram.data(), datagram.data() + delimiter, sequence);
+    if (parsed.ec != std::errc() || parsed.ptr != datagram.data() + delimiter)
+        return false;
+    payload = datagram.substr(delimiter + 1);
+    return true;
+}
+
+bool framing::parseFormat(std::string_view name, WireFormat& format)
+{
+    if (name == "text")
+        format = WireFormat::Text;
+    else if (name == "msgpack")
+        format = WireFormat::MsgPack;
+    else if (name == "cbor")
+        format = WireFormat::Cbor;
+    else
+        return false;
+    return true;
+}
+
+json framing::decode(std::string_view payload, WireFormat format)
+{
+    switch (format)
+    {
+    case WireFormat::MsgPack:
+        return json::from_msgpack(payload.begin(), payload.end());
+    case WireFormat::Cbor:
+        return json::from_cbor(payload.begin(), payload.end());
+    default:
+        return json::parse(payload.begin(), payload.end());
+    }
+}
+
+// Payload buffers allocated because none could be recycled
+static std::atomic<uint64_t> payloadBuffersAllocated(0);
+// Set once the calling thread's idle buffers are freed at thread exit
+static thread_local bool payloadCacheClosed = false;
+
+// Returns the smallest capacity class holding size bytes, PAYLOAD_BUFFER_CLASSES if none does
+static size_t bufferClass(size_t size)
+{
+    size_t sizeClass = 0;
+    while (sizeClass < PAYLOAD_BUFFER_CLASSES && (static_cast<size_t>(PAYLOAD_MIN_BUFFER) << sizeClass) < size)
+        sizeClass++;
+    return sizeClass;
+}
+
+// Returns the class a buffer of some capacity serves, PAYLOAD_BUFFER_CLASSES if it is too small or too large to keep
+static size_t idleClass(size_t capacity)
+{
+    if (capacity < PAYLOAD_MIN_BUFFER)
+        return PAYLOAD_BUFFER_CLASSES;
+    size_t sizeClass = 0;
+    while (sizeClass + 1 < PAYLOAD_BUFFER_CLASSES && (static_cast<size_t>(PAYLOAD_MIN_BUFFER) << (sizeClass + 1)) <= capacity)
+        sizeClass++;
+    return capacity < (static_cast<size_t>(PAYLOAD_MIN_BUFFER) << (sizeClass + 1)) ? sizeClass : PAYLOAD_BUFFER_CLASSES;
+}
+
+// Returns how many idle buffers of a class a thread keeps
+static size_t idleDepth(size_t sizeClass)
+{
+    return std::max<size_t>(1, PAYLOAD_CACHE_BYTES / (static_cast<size_t>(PAYLOAD_MIN_BUFFER) << sizeClass));
+}
+
+// Payload strings live in slab blocks, their character buffers on the heap
+static std::string* createBuffer()
+{
+    return new (SlabPool::shared().allocate(sizeof(std::string))) std::string();
+}
+
+static void destroyBuffer(std::string* buffer)
+{
+    std::destroy_at(buffer);
+    SlabPool::shared().deallocate(buffer, sizeof(std::string));
+}
+
+/// <summary>
+/// Idle payload buffers of one thread by capacity class, freed at thread exit.
+/// </summary>
+struct PayloadCache
+{
+    PayloadCache()
+    {
+        for (size_t sizeClass = 0; sizeClass < PAYLOAD_BUFFER_CLASSES; sizeClass++)
+            idle[sizeClass].reserve(idleDepth(sizeClass));
+    }
+
+    ~PayloadCache()
+    {
+        for (std::vector<std::string*>& buffers : idle)
+        {
+            for (std::string* buffer : buffers)
+                destroyBuffer(buffer);
+        }
+        payloadCacheClosed = true;
+    }
+
+    std::vector<std::string*> idle[PAYLOAD_BUFFER_CLASSES];
+};
+
+// Returns the calling thread's idle buffers, null once they were freed at thread exit
+static PayloadCache* payloadCache()
+{
+    if (payloadCacheClosed)
+        return nullptr;
+    static thread_local PayloadCache cache;
+    return &cache;
+}
+
+/// <summary>
+/// Payload deleter returning its buffer to the freeing thread's idle buffers.
+/// </summary>
+struct PayloadRecycler
+{
+    void operator()(std::string* buffer) const
+    {
+        size_t sizeClass = idleClass(buffer->capacity());
+        PayloadCache* cache = payloadCache();
+        if (cache && sizeClass < PAYLOAD_BUFFER_CLASSES && cache->idle[sizeClass].size() < idleDepth(sizeClass))
+            cache->idle[sizeClass].push_back(buffer);
+        else
+            destroyBuffer(buffer);
+    }
+};
+
+Payload framing::makePayload(std::string_view text)
+{
+    size_t sizeClass = bufferClass(text.size());
+    PayloadCache* cache = payloadCache();
+    std::string* buffer;
+    if (cache && sizeClass < PAYLOAD_BUFFER_CLASSES && !cache->idle[sizeClass].empty())
+    {
+        buffer = cache->idle[sizeClass].back();
+        cache->idle[sizeClass].pop_back();
+    }
+    else
+    {
+        buffer = createBuffer();
+        if (sizeClass < PAYLOAD_BUFFER_CLASSES)
+            buffer->reserve(static_cast<size_t>(PAYLOAD_MIN_BUFFER) << sizeClass);
+        payloadBuffersAllocated.fetch_add(1, std::memory_order_relaxed);
+    }
+    buffer->assign(text.data(), text.size());
+    // The reference count comes from the slab pool as well
+    return Payload(buffer, PayloadRecycler(), PoolAllocator<std::string>());
+}
+
+Payload framing::makePayload(std::string&& text)
+{
+    std::string* buffer = createBuffer();
+    *buffer = std::move(text);
+    return Payload(buffer, PayloadRecycler(), PoolAllocator<std::string>());
+}
+
+uint64_t framing::payloadBuffers()
+{
+    return payloadBuffersAllocated.load(std::memory_order_relaxed);
+}
+
+std::string framing::encode(const json& document, WireFormat format)
+{
+    std::string encoded;
+    switch (format)
+    {
+    case WireFormat::MsgPack:
+        json::to_msgpack(document, encoded);
+        break;
+    case WireFormat::Cbor:
+        json::to_cbor(document, encoded);
+        break;
+    default:
+        // Strings decoded from binary formats are not checked as UTF-8, invalid bytes are replaced rather than thrown on
+        encoded = document.dump(-1, ' ', false, json::error_handler_t::replace);
+        break;
+    }
+    return encoded;
+}
+
+WireMessage::WireMessage(Payload text) :
+    receivedAt(0),
+    conflate(false),
+    lossy(false),
+    forwarded(false),
+    malformed_(false)
+{
+    payloads_[static_cast<size_t>(WireFormat::Text)] = std::move(text);
+}
+
+WireMessage::WireMessage(json document) :
+    receivedAt(0),
+    conflate(false),
+    lossy(false),
+    forwarded(false),
+    document_(std::move(document)),
+    malformed_(false)
+{}
+
+const Payload& WireMessage::payload(WireFormat format)
+{
+    Payload& encoded = payloads_[static_cast<size_t>(format)];
+    if (encoded || !parse())
+        return encoded;
+
+    // Derive the document from text once, then encode the requested format from it
+    encoded = framing::makePayload(framing::encode(*document_, format));
+    return encoded;
+}
+
+bool WireMessage::parse()
+{
+    if (document_)
+        return true;
+    if (malformed_)
+        return false;
+    const Payload& text = payloads_[static_cast<size_t>(WireFormat::Text)];
+    json document = json::parse(text->begin(), text->end(), nullptr, false);
+    if (document.is_discarded())
+    {
+        malformed_ = true;
+        return false;
+    }
+    document_ = std::move(document);
+    return true;
+}
+
+const std::string* WireMessage::conflationKey()
+{
+    if (key_)
+        return &*key_;
+
+    // Sender and key are joined by a character identifiers never contain
+    const Payload& text = payloads_[static_cast<size_t>(WireFormat::Text)];
+    MsgHeader header;
+    if (!document_ && text && header.scanKey(*text))
+    {
+        key_ = std::string(header.from) + '\0' + std::string(header.key);
+        return &*key_;
+    }
+    if (!parse())
+        return nullptr;
+    auto field = [&](const char* name)
+    {
+        auto found = document_->find(name);
+        if (found == document_->end())
+            return std::string();
+        return found->is_string() ? found->get<std::string>() : found->dump();
+    };
+    key_ = field("from") + '\0' + field("key");
+    return &*key_;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "MsgData.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// First byte of a binary frame, never the first byte of a "<length>\r" text frame
+#define BINARY_FRAME_MAGIC 0xB5
+// Binary frame header: magic, format, flags, reserved, then little-endian uint32 payload length
+#define BINARY_HEADER_SIZE 8
+// Longest datagram header, a decimal uint64 sequence number and '\r'
+#define DATAGRAM_HEADER_MAX 21
+
+// Shared immutable message payload, one allocation regardless of recipient count
+using Payload = std::shared_ptr<const std::string>;
+
+// Smallest recycled payload buffer, buffers are recycled in power-of-two capacity classes from here up
+#define PAYLOAD_MIN_BUFFER 64
+// Number of recycled capacity classes, larger payloads get a buffer of their own that is freed after use
+#define PAYLOAD_BUFFER_CLASSES 11
+// Bytes of idle buffers each thread keeps per capacity class, at least one buffer
+#define PAYLOAD_CACHE_BYTES (256 * 1024)
+
+/// <summary>
+/// Encoding of a frame payload on the wire.
+/// </summary>
+enum class WireFormat : uint8_t
+{
+	// JSON text, framed as "<length>\r<payload>" unless sent inside a binary header
+	Text = 0,
+	// MessagePack payload behind a binary header
+	MsgPack = 1,
+	// CBOR payload behind a binary header
+	Cbor = 2
+};
+
+// Number of WireFormat values
+#define WIRE_FORMATS 3
+
+/// <summary>
+/// Helpers for the negotiated binary framing mode.
+/// </summary>
+namespace framing
+{
+	/// <summary>
+	/// Writes a binary frame header.
+	/// </summary>
+	/// <param name="header">Destination, at least BINARY_HEADER_SIZE bytes.</param>
+	/// <param name="format">Payload encoding.</param>
+	/// <param name="flags">Frame flags, currently always zero.</param>
+	/// <param name="length">Payload length.</param>
+	void writeBinaryHeader(char* header, WireFormat format, uint8_t flags, uint32_t length);
+
+	/// <summary>
+	/// Reads a binary frame header.
+	/// </summary>
+	/// <param name="header">Source, at least BINARY_HEADER_SIZE bytes starting with BINARY_FRAME_MAGIC.</param>
+	/// <param name="format">Receives payload encoding.</param>
+	/// <param name="length">Receives payload length.</param>
+	/// <returns>False if the format is unknown.</returns>
+	bool readBinaryHeader(const char* header, WireFormat& format, uint32_t& length);
+
+	/// <summary>
+	/// Writes a datagram header. Datagrams carry one payload each, framed as
+	/// "<sequence>\r<payload>" so receivers can discard datagrams older than one already seen.
+	/// </summary>
+	/// <param name="header">Destination, at least DATAGRAM_HEADER_MAX bytes.</param>
+	/// <param name="sequence">Sequence number of the datagram.</param>
+	/// <returns>Header length.</returns>
+	size_t writeDatagramHeader(char* header, uint64_t sequence);
+
+	/// <summary>
+	/// Splits a datagram into its sequence number and payload.
+	/// </summary>
+	/// <param name="datagram">Received datagram.</param>
+	/// <param name="sequence">Receives sequence number.</param>
+	/// <param name="payload">Receives payload, a view into the datagram.</param>
+	/// <returns>False if the header is malformed.</returns>
+	bool readDatagram(std::string_view datagram, uint64_t& sequence, std::string_view& payload);
+
+	/// <summary>
+	/// Parses the name a client gives in the "framing" field of its registration.
+	/// </summary>
+	/// <param name="name">"text", "msgpack" or "cbor".</param>
+	/// <param name="format">Receives matching format.</param>
+	/// <returns>False if the name is unknown.</returns>
+	bool parseFormat(std::string_view name, WireFormat& format);
+
+	/// <summary>
+	/// Decodes a payload of any format into a JSON document.
+	/// </summary>
+	/// <param name="payload">Encoded payload.</param>
+	/// <param name="format">Payload encoding.</param>
+	/// <returns>Decoded document. Throws json::parse_error if invalid.</returns>
+	json decode(std::string_view payload, WireFormat format);
+
+	/// <summary>
+	/// Copies bytes into a payload. Its buffer and reference count come from
+	/// pools and return to the freeing thread's pools once the last reference
+	/// drops, so a reactor routing a steady stream reuses rather than allocates them.
+	/// </summary>
+	/// <param name="text">Payload bytes.</param>
+	/// <returns>Shared payload.</returns>
+	Payload makePayload(std::string_view text);
+
+	/// <summary>
+	/// Wraps a built string in a payload, adopting its buffer into the recycled buffers.
+	/// </summary>
+	/// <param name="text">Payload bytes, moved from.</param>
+	/// <returns>Shared payload.</returns>
+	Payload makePayload(std::string&& text);
+
+	/// <summary>
+	/// Returns number of payload buffers allocated because none could be recycled.
+	/// </summary>
+	/// <returns>Buffers allocated by every thread since startup.</returns>
+	uint64_t payloadBuffers();
+
+	/// <summary>
+	/// Encodes a JSON document in the given format.
+	/// </summary>
+	/// <param name="document">Document to encode.</param>
+	/// <param name="format">Target encoding.</param>
+	/// <returns>Encoded payload.</returns>
+	std::string encode(const json& document, WireFormat format);
+}
+
+/// <summary>
+/// A routed message and its encodings. Each wire format is produced at most
+/// once, on first request, and shared by every recipient using that format,
+/// so a broker translating between text and binary peers never encodes the
+/// same message twice.
+/// </summary>
+class WireMessage
+{
+public:
+	/// <summary>
+	/// Message already serialized as JSON text.
+	/// </summary>
+	/// <param name="text">JSON text payload.</param>
+	WireMessage(Payload text);
+
+	/// <summary>
+	/// Message held as a parsed document.
+	/// </summary>
+	/// <param name="document">JSON document.</param>
+	WireMessage(json document);
+
+	/// <summary>
+	/// Returns the payload encoded in a format, encoding it if not done yet.
+	/// </summary>
+	/// <param name="format">Target encoding.</param>
+	/// <returns>Shared payload, null if the message is text that is not valid JSON
+	/// and another encoding was requested.</returns>
+	const Payload& payload(WireFormat format);
+
+	/// <summary>
+	/// Returns the key conflation groups this message by: its "from" identifier and
+	/// optional "key" field. Text is scanned rather than parsed where possible, and
+	/// the key is built once however many receivers conflate.
+	/// </summary>
+	/// <returns>Conflation key, null if the message is text that is not valid JSON
+	/// and its key could not be scanned.</returns>
+	const std::string* conflationKey();
+
+	// MetricsRegistry::now() stamp of when the message was received, 0 if unknown
+	uint64_t receivedAt;
+
+	// Whether every receiver keeps only the newest undelivered message per conflation key
+	bool conflate;
+
+	// Whether the message arrived as a datagram and may leave as one
+	bool lossy;
+
+	// Whether another shard handed the message over, so its sender cannot be paused from here
+	bool forwarded;
+
+private:
+	/// <summary>
+	/// Parses the text payload into the document other encodings are derived from.
+	/// Text routed on its header alone is only checked here, so parsing does not throw.
+	/// </summary>
+	/// <returns>False if the text is not valid JSON.</returns>
+	bool parse();
+
+	// Conflation key, built on first use
+	std::optional<std::string> key_;
+	// Parsed form, built lazily when another encoding must be derived from text
+	std::optional<json> document_;
+	// Set once the text failed to parse, so fan-out does not parse it again
+	bool malformed_;
+	// Encodings produced so far, indexed by WireFormat
+	Payload payloads_[WIRE_FORMATS];
+};
@@ -0,0 +1,256 @@
+#include "Handoff.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/time.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Fixed-size lead of a hand-off, sent before the handles so the successor knows how many to expect.
+/// </summary>
+struct HandoffHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t handles;
+    uint64_t snapshotBytes;
+};
+
+// Wraps raw bytes, which need not be valid UTF-8, as a MessagePack bin value
+static json binary(const std::string& bytes)
+{
+    return json::binary(std::vector<uint8_t>(bytes.begin(), bytes.end()));
+}
+
+static std::string bytesOf(const json& value)
+{
+    const json::binary_t& bytes = value.get_binary();
+    return std::string(bytes.begin(), bytes.end());
+}
+
+std::string handoff::encode(const HandoffState& state)
+{
+    json endpoints = json::array();
+    for (const HandoffEndpoint& endpoint : state.endpoints)
+    {
+        json outbound = json::array();
+        for (const std::string& frame : endpoint.outbound)
+            outbound.push_back(binary(frame));
+        endpoints.push_back({
+            { "socket", endpoint.socketIndex },
+            { "id", endpoint.id },
+            { "format", static_cast<int>(endpoint.format) },
+            { "topics", endpoint.topics },
+            { "conflate", endpoint.conflate },
+            { "session", endpoint.sessionToken },
+            { "framesSent", endpoint.framesSent },
+            { "graceLeft", endpoint.graceLeftNs },
+            { "channel", endpoint.channelToken },
+            { "peer", binary(endpoint.channelPeer) },
+            { "seqIn", endpoint.datagramSeqIn },
+            { "seqOut", endpoint.datagramSeqOut },
+            { "unparsed", binary(endpoint.unparsed) },
+            { "outbound", std::move(outbound) } });
+    }
+    json parked = json::array();
+    for (const HandoffParked& destination : state.parked)
+    {
+        json messages = json::array();
+        for (const std::string& msg : destination.messages)
+            messages.push_back(binary(msg));
+        parked.push_back({ { "to", destination.to }, { "messages", std::move(messages) } });
+    }
+    json document = { { "version", HANDOFF_VERSION }, { "datagrams", state.hasDatagrams }, { "endpoints", std::move(endpoints) }, { "parked", std::move(parked) } };
+    std::vector<uint8_t> bytes = json::to_msgpack(document);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+bool handoff::decode(std::string_view bytes, HandoffState& state)
+{
+    json document = json::from_msgpack(bytes.begin(), bytes.end(), true, false);
+    if (document.is_discarded() || !document.is_object() || document.value("version", 0) != HANDOFF_VERSION)
+        return false;
+    // A snapshot of the right version with the wrong shape is rejected as a whole
+    try
+    {
+        state = {};
+        state.hasDatagrams = document.at("datagrams").get<bool>();
+        for (const json& entry : document.at("endpoints"))
+        {
+            HandoffEndpoint endpoint;
+            endpoint.socketIndex = entry.at("socket").get<int64_t>();
+            endpoint.id = entry.at("id").get<std::string>();
+            int format = entry.at("format").get<int>();
+            if (format < 0 || format >= WIRE_FORMATS)
+                return false;
+            endpoint.format = static_cast<WireFormat>(format);
+            endpoint.topics = entry.at("topics").get<std::vector<std::string>>();
+            endpoint.conflate = entry.at("conflate").get<bool>();
+            endpoint.sessionToken = entry.at("session").get<std::string>();
+            endpoint.framesSent = entry.at("framesSent").get<uint64_t>();
+            endpoint.graceLeftNs = entry.at("graceLeft").get<uint64_t>();
+            endpoint.channelToken = entry.at("channel").get<std::string>();
+            endpoint.channelPeer = bytesOf(entry.at("peer"));
+            endpoint.datagramSeqIn = entry.at("seqIn").get<uint64_t>();
+            endpoint.datagramSeqOut = entry.at("seqOut").get<uint64_t>();
+            endpoint.unparsed = bytesOf(entry.at("unparsed"));
+            for (const json& frame : entry.at("outbound"))
+                endpoint.outbound.push_back(bytesOf(frame));
+            state.endpoints.push_back(std::move(endpoint));
+        }
+        for (const json& entry : document.at("parked"))
+        {
+            HandoffParked destination;
+            destination.to = entry.at("to").get<std::string>();
+            for (const json& msg : entry.at("messages"))
+                destination.messages.push_back(bytesOf(msg));
+            state.parked.push_back(std::move(destination));
+        }
+    }
+    catch (const json::exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+#ifdef __linux__
+
+// Bounds every blocking read and write on the control socket
+static bool setTimeouts(SOCKET control)
+{
+    timeval timeout = { HANDOFF_TIMEOUT_MS / 1000, (HANDOFF_TIMEOUT_MS % 1000) * 1000 };
+    return setsockopt(control, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0 &&
+           setsockopt(control, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+}
+
+static bool sendAll(SOCKET control, const char* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t sent = ::send(control, data, length, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            if (sent < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static bool recvAll(SOCKET control, char* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t received = ::recv(control, data, length, 0);
+        if (received <= 0)
+        {
+            if (received < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool handoff::send(SOCKET control, const HandoffState& state, const std::vector<SOCKET>& handles)
+{
+    if (!setTimeouts(control))
+        return false;
+    std::string snapshot = encode(state);
+    HandoffHeader header = { HANDOFF_MAGIC, HANDOFF_VERSION, handles.size(), snapshot.size() };
+    if (!sendAll(control, reinterpret_cast<const char*>(&header), sizeof(header)))
+        return false;
+    // Each batch rides on a single byte, so handles never arrive in the middle of the snapshot
+    for (size_t first = 0; first < handles.size(); first += HANDOFF_HANDLES_PER_MESSAGE)
+    {
+        size_t count = std::min(handles.size() - first, static_cast<size_t>(HANDOFF_HANDLES_PER_MESSAGE));
+        if (!sock::sendHandles(control, handles.data() + first, count))
+            return false;
+    }
+    return sendAll(control, snapshot.data(), snapshot.size());
+}
+
+bool handoff::receive(SOCKET control, HandoffState& state, std::vector<SOCKET>& handles)
+{
+    handles.clear();
+    HandoffHeader header;
+    if (!setTimeouts(control) || !recvAll(control, reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != HANDOFF_MAGIC || header.version != HANDOFF_VERSION)
+        return false;
+    bool received = true;
+    while (received && handles.size() < header.handles)
+    {
+        size_t count = std::min(static_cast<size_t>(header.handles) - handles.size(), static_cast<size_t>(HANDOFF_HANDLES_PER_MESSAGE));
+        handles.resize(handles.size() + count);
+        received = sock::recvHandles(control, handles.data() + handles.size() - count, count);
+        if (!received)
+            handles.resize(handles.size() - count);
+    }
+    std::string snapshot(received ? header.snapshotBytes : 0, '\0');
+    if (received && recvAll(control, snapshot.data(), snapshot.size()) && decode(snapshot, state))
+        return true;
+    // Adopted nothing, so the copies received so far are released
+    for (SOCKET handle : handles)
+        sock::close(handle);
+    handles.clear();
+    return false;
+}
+
+bool handoff::acknowledge(SOCKET control)
+{
+    char byte = 1;
+    return sendAll(control, &byte, 1);
+}
+
+bool handoff::awaitAcknowledgement(SOCKET control)
+{
+    char byte;
+    return recvAll(control, &byte, 1) && byte == 1;
+}
+
+#else
+
+bool handoff::send(SOCKET control, const HandoffState& state, const std::vector<SOCKET>& handles)
+{
+    return false;
+}
+
+bool handoff::receive(SOCKET control, HandoffState& state, std::vector<SOCKET>& handles)
+{
+    return false;
+}
+
+bool handoff::acknowledge(SOCKET control)
+{
+    return false;
+}
+
+bool handoff::awaitAcknowledgement(SOCKET control)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Framing.hpp"
+#include "Socket.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Leads every hand-off so a successor never adopts handles from something else
+#define HANDOFF_MAGIC 0x46444e48u
+// Layout of the hand-off snapshot, bumped when fields change meaning
+#define HANDOFF_VERSION 1
+// Handles passed per SCM_RIGHTS message, below the kernel's limit of 253
+#define HANDOFF_HANDLES_PER_MESSAGE 250
+// Longest either side waits on the other before giving up, the old server then keeps serving
+#define HANDOFF_TIMEOUT_MS 5000
+
+/// <summary>
+/// Connection or disconnected session handed from one broker process to its successor.
+/// </summary>
+struct HandoffEndpoint
+{
+	// Position of the client socket among the handles passed, -1 for a disconnected session
+	int64_t socketIndex;
+	// Registered identifier, empty if not registered yet
+	std::string id;
+	WireFormat format;
+	std::vector<std::string> topics;
+	bool conflate;
+	// Session token and frames sent since the session opened
+	std::string sessionToken;
+	uint64_t framesSent;
+	// Nanoseconds a disconnected session has left before it expires
+	uint64_t graceLeftNs;
+	// Datagram channel token, and the linked peer's raw address if any
+	std::string channelToken;
+	std::string channelPeer;
+	uint64_t datagramSeqIn;
+	uint64_t datagramSeqOut;
+	// Received bytes not yet parsed into frames
+	std::string unparsed;
+	// Unsent bytes of every queued frame, the first trimmed by what was already sent
+	std::vector<std::string> outbound;
+};
+
+/// <summary>
+/// Messages parked for a destination that had not registered at the hand-off.
+/// </summary>
+struct HandoffParked
+{
+	std::string to;
+	std::vector<std::string> messages;
+};
+
+/// <summary>
+/// Everything a successor needs to serve a broker's clients without them reconnecting.
+/// The handles travel beside it: the TCP listener, then the datagram socket if
+/// hasDatagrams, then the client sockets the endpoints point at.
+/// </summary>
+struct HandoffState
+{
+	bool hasDatagrams;
+	std::vector<HandoffEndpoint> endpoints;
+	std::vector<HandoffParked> parked;
+};
+
+/// <summary>
+/// Transfer of a broker's listener and connections to a successor process over a
+/// local socket. The old server sends a fixed header, the handles in SCM_RIGHTS
+/// batches, then the snapshot, and keeps serving unless the successor acknowledges
+/// having adopted them. Only functional on Linux.
+/// </summary>
+namespace handoff
+{
+	/// <summary>
+	/// Encodes a snapshot as MessagePack.
+	/// </summary>
+	/// <param name="state">Snapshot to encode.</param>
+	/// <returns>Encoded bytes.</returns>
+	std::string encode(const HandoffState& state);
+
+	/// <summary>
+	/// Decodes a snapshot written by encode().
+	/// </summary>
+	/// <param name="bytes">Encoded snapshot.</param>
+	/// <param name="state">Receives the snapshot.</param>
+	/// <returns>False if the bytes are not a snapshot of this version.</returns>
+	bool decode(std::string_view bytes, HandoffState& state);
+
+	/// <summary>
+	/// Sends a snapshot and duplicates the handles into the successor. Blocks at most HANDOFF_TIMEOUT_MS per step.
+	/// </summary>
+	/// <param name="control">Local socket connected to the successor.</param>
+	/// <param name="state">Snapshot to send.</param>
+	/// <param name="handles">Handles in the order the snapshot refers to them.</param>
+	/// <returns>True if everything was sent.</returns>
+	bool send(SOCKET control, const HandoffState& state, const std::vector<SOCKET>& handles);
+
+	/// <summary>
+	/// Receives a snapshot and the handles sent with it. Handles received before a failure are closed.
+	/// </summary>
+	/// <param name="control">Local socket connected to the old server.</param>
+	/// <param name="state">Receives the snapshot.</param>
+	/// <param name="handles">Receives the handles in the order sent.</param>
+	/// <returns>True if a complete snapshot and every handle arrived.</returns>
+	bool receive(SOCKET control, HandoffState& state, std::vector<SOCKET>& handles);
+
+	/// <summary>
+	/// Tells the old server the successor serves the connections from now on.
+	/// </summary>
+	/// <param name="control">Local socket connected to the old server.</param>
+	/// <returns>True if sent.</returns>
+	bool acknowledge(SOCKET control);
+
+	/// <summary>
+	/// Waits for the successor to acknowledge the hand-off.
+	/// </summary>
+	/// <param name="control">Local socket connected to the successor.</param>
+	/// <returns>False if the successor failed, closed or timed out.</returns>
+	bool awaitAcknowledgement(SOCKET control);
+}
@@ -0,0 +1,366 @@
+#include "IoUring.hpp"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <cstring>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+IoUring::IoUring() :
+    ringFd_(-1),
+    sqRing_(nullptr),
+    sqRingSize_(0),
+    sqes_(nullptr),
+    sqesSize_(0),
+    sqHead_(nullptr),
+    sqTail_(nullptr),
+    sqMask_(nullptr),
+    sqArray_(nullptr),
+    sqEntries_(0),
+    sqeTail_(0),
+    sqeSubmitted_(0),
+    cqRing_(nullptr),
+    cqRingSize_(0),
+    cqHead_(nullptr),
+    cqTail_(nullptr),
+    cqMask_(nullptr),
+    cqes_(nullptr),
+    bufRing_(nullptr),
+    bufRingSize_(0),
+    bufCount_(0),
+    bufSize_(0),
+    enters_(0)
+{}
+
+uint64_t IoUring::numEnters()
+{
+    return enters_;
+}
+
+#ifdef __linux__
+
+IoUring::~IoUring()
+{
+    // Unmap shared regions before closing the ring
+    if (bufRing_)
+        munmap(bufRing_, bufRingSize_);
+    if (sqes_)
+        munmap(sqes_, sqesSize_);
+    if (cqRing_ && cqRing_ != sqRing_)
+        munmap(cqRing_, cqRingSize_);
+    if (sqRing_)
+        munmap(sqRing_, sqRingSize_);
+    if (ringFd_ != -1)
+        ::close(ringFd_);
+}
+
+bool IoUring::init(unsigned entries)
+{
+    io_uring_params params = {};
+    ringFd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd_ == -1)
+        return false;
+
+    // Map submission and completion rings (a single mapping on modern kernels)
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+    {
+        sqRingSize_ = sqRingSize_ > cqRingSize_ ? sqRingSize_ : cqRingSize_;
+        cqRingSize_ = sqRingSize_;
+    }
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        sqRing_ = nullptr;
+        return false;
+    }
+    if (singleMap)
+        cqRing_ = sqRing_;
+    else
+    {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            cqRing_ = nullptr;
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    // Resolve ring field offsets
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+    messages_.resize(sqEntries_ * sizeof(msghdr));
+    timeouts_.resize(sqEntries_ * sizeof(__kernel_timespec));
+    sqeTail_ = sqeSubmitted_ = *sqTail_;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::setupBufferRing(uint16_t group, unsigned count, unsigned size)
+{
+    // Ring entries must be page aligned, so allocate them with mmap
+    bufRingSize_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, bufRingSize_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED)
+        return false;
+    bufRing_ = static_cast<io_uring_buf_ring*>(ring);
+    bufCount_ = count;
+    bufSize_ = size;
+    bufPool_.resize(static_cast<size_t>(count) * size);
+
+    io_uring_buf_reg reg = {};
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing_);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        return false;
+
+    // Hand every buffer to the kernel
+    for (unsigned bid = 0; bid < count; bid++)
+        recycleBuffer(static_cast<uint16_t>(bid));
+    return true;
+}
+
+io_uring_sqe* IoUring::nextSqe()
+{
+    // Flush prepared entries if the kernel has not consumed enough of the ring
+    if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+        unsigned pending = publish();
+        syscall(__NR_io_uring_enter, ringFd_, pending, 0, 0, nullptr, 0);
+        enters_++;
+    }
+
+    unsigned index = sqeTail_ & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    sqeTail_++;
+    return sqe;
+}
+
+unsigned IoUring::publish()
+{
+    // Make entries visible to the kernel before it reads the tail
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    unsigned pending = sqeTail_ - sqeSubmitted_;
+    sqeSubmitted_ = sqeTail_;
+    return pending;
+}
+
+void IoUring::prepMultishotAccept(SOCKET socket, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepMultishotRecv(SOCKET socket, uint16_t group, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepMultishotPoll(SOCKET socket, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = socket;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepSend(SOCKET socket, const char* buffer, size_t length, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = socket;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepSendv(SOCKET socket, IoVec* vecs, size_t count, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    // Slot is not reused before the kernel has consumed this entry
+    msghdr* message = reinterpret_cast<msghdr*>(messages_.data()) + (sqe - sqes_);
+    *message = {};
+    message->msg_iov = vecs;
+    message->msg_iovlen = count;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = socket;
+    sqe->addr = reinterpret_cast<uint64_t>(message);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepCancel(uint64_t target, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepTimeout(uint64_t nanoseconds, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    // Like message headers, the timespec is read when its slot is submitted
+    __kernel_timespec* timeout = reinterpret_cast<__kernel_timespec*>(timeouts_.data()) + (sqe - sqes_);
+    timeout->tv_sec = nanoseconds / 1000000000;
+    timeout->tv_nsec = nanoseconds % 1000000000;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(timeout);
+    sqe->len = 1;
+    sqe->user_data = userData;
+}
+
+int IoUring::submitAndWait(std::vector<UringCompletion>& completions, unsigned waitNr)
+{
+    completions.clear();
+
+    // Submission and wait share one syscall
+    unsigned pending = publish();
+    long ret = syscall(__NR_io_uring_enter, ringFd_, pending, waitNr, IORING_ENTER_GETEVENTS, nullptr, 0);
+    enters_++;
+    if (ret < 0 && errno != EINTR && errno != EBUSY)
+        return -1;
+
+    // Harvest everything the kernel has completed
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        const io_uring_cqe& cqe = cqes_[head & *cqMask_];
+        completions.push_back({ cqe.user_data, cqe.res, cqe.flags });
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return static_cast<int>(completions.size());
+}
+
+uint16_t IoUring::bufferId(uint32_t flags)
+{
+    return static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+}
+
+const char* IoUring::buffer(uint16_t bid)
+{
+    return bufPool_.data() + static_cast<size_t>(bid) * bufSize_;
+}
+
+void IoUring::recycleBuffer(uint16_t bid)
+{
+    // Append buffer at the ring tail then publish the new tail. Entries are indexed
+    // from the ring start directly since the header's flexible array member is
+    // offset when compiled as C++
+    unsigned short tail = bufRing_->tail;
+    io_uring_buf& entry = reinterpret_cast<io_uring_buf*>(bufRing_)[tail & (bufCount_ - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(buffer(bid));
+    entry.len = bufSize_;
+    entry.bid = bid;
+    __atomic_store_n(&bufRing_->tail, static_cast<unsigned short>(tail + 1), __ATOMIC_RELEASE);
+}
+
+#else
+
+IoUring::~IoUring() = default;
+
+bool IoUring::init(unsigned entries)
+{
+    // io_uring is a Linux facility
+    return false;
+}
+
+bool IoUring::setupBufferRing(uint16_t group, unsigned count, unsigned size)
+{
+    return false;
+}
+
+void IoUring::prepMultishotAccept(SOCKET socket, uint64_t userData)
+{}
+
+void IoUring::prepMultishotRecv(SOCKET socket, uint16_t group, uint64_t userData)
+{}
+
+void IoUring::prepMultishotPoll(SOCKET socket, uint64_t userData)
+{}
+
+void IoUring::prepSend(SOCKET socket, const char* buffer, size_t length, uint64_t userData)
+{}
+
+void IoUring::prepSendv(SOCKET socket, IoVec* vecs, size_t count, uint64_t userData)
+{}
+
+void IoUring::prepCancel(uint64_t target, uint64_t userData)
+{}
+
+void IoUring::prepTimeout(uint64_t nanoseconds, uint64_t userData)
+{}
+
+int IoUring::submitAndWait(std::vector<UringCompletion>& completions, unsigned waitNr)
+{
+    completions.clear();
+    return -1;
+}
+
+uint16_t IoUring::bufferId(uint32_t flags)
+{
+    return 0;
+}
+
+const char* IoUring::buffer(uint16_t bid)
+{
+    return nullptr;
+}
+
+void IoUring::recycleBuffer(uint16_t bid)
+{}
+
+#endif
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "Socket.hpp"
+#include <cstdint>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Completion harvested from the io_uring completion queue.
+/// </summary>
+struct UringCompletion
+{
+	// Value supplied when the request was prepared
+	uint64_t userData;
+	// Syscall style result (bytes, descriptor or negative errno)
+	int32_t result;
+	// IORING_CQE_F_* flags
+	uint32_t flags;
+};
+
+/// <summary>
+/// Minimal io_uring wrapper built directly on the kernel interface (no liburing).
+/// Requests are prepared into the submission ring and handed to the kernel
+/// together with a wait for completions in a single io_uring_enter call.
+/// Receive buffers come from a registered provided-buffer ring so multishot
+/// receives never need a buffer per socket. Only functional on Linux 6.0+.
+/// </summary>
+class IoUring
+{
+public:
+	IoUring();
+	~IoUring();
+
+	// Ring owns kernel mappings
+	IoUring(const IoUring&) = delete;
+	IoUring& operator=(const IoUring&) = delete;
+
+	/// <summary>
+	/// Creates the ring and maps its submission and completion queues.
+	/// </summary>
+	/// <param name="entries">Submission queue size (rounded up to a power of two by the kernel).</param>
+	/// <returns>True if successful.</returns>
+	bool init(unsigned entries);
+
+	/// <summary>
+	/// Registers a ring of provided receive buffers.
+	/// </summary>
+	/// <param name="group">Buffer group identifier referenced by receives.</param>
+	/// <param name="count">Number of buffers (power of two).</param>
+	/// <param name="size">Size of each buffer in bytes.</param>
+	/// <returns>True if successful.</returns>
+	bool setupBufferRing(uint16_t group, unsigned count, unsigned size);
+
+	/// <summary>
+	/// Prepares a multishot accept that completes once per incoming connection.
+	/// </summary>
+	/// <param name="socket">Listening socket.</param>
+	/// <param name="userData">Value returned with each completion.</param>
+	void prepMultishotAccept(SOCKET socket, uint64_t userData);
+
+	/// <summary>
+	/// Prepares a multishot receive that completes once per received chunk, each
+	/// written into a buffer picked from the provided buffer ring.
+	/// </summary>
+	/// <param name="socket">Connected socket.</param>
+	/// <param name="group">Buffer group to receive into.</param>
+	/// <param name="userData">Value returned with each completion.</param>
+	void prepMultishotRecv(SOCKET socket, uint16_t group, uint64_t userData);
+
+	/// <summary>
+	/// Prepares a multishot poll that completes each time a socket becomes readable,
+	/// for sockets drained with ordinary calls rather than ring receives.
+	/// </summary>
+	/// <param name="socket">Socket to watch.</param>
+	/// <param name="userData">Value returned with each completion.</param>
+	void prepMultishotPoll(SOCKET socket, uint64_t userData);
+
+	/// <summary>
+	/// Prepares a send. Buffer must stay valid until the completion is harvested.
+	/// </summary>
+	/// <param name="socket">Connected socket.</param>
+	/// <param name="buffer">Source buffer.</param>
+	/// <param name="length">Number of bytes to send.</param>
+	/// <param name="userData">Value returned with the completion.</param>
+	void prepSend(SOCKET socket, const char* buffer, size_t length, uint64_t userData);
+
+	/// <summary>
+	/// Prepares a scatter-gather send (sendmsg). The buffers and the vecs array
+	/// must stay valid until the completion is harvested.
+	/// </summary>
+	/// <param name="socket">Connected socket.</param>
+	/// <param name="vecs">Buffers to send in order.</param>
+	/// <param name="count">Number of buffers.</param>
+	/// <param name="userData">Value returned with the completion.</param>
+	void prepSendv(SOCKET socket, IoVec* vecs, size_t count, uint64_t userData);
+
+	/// <summary>
+	/// Prepares cancellation of an outstanding request.
+	/// </summary>
+	/// <param name="target">User data of the request to cancel.</param>
+	/// <param name="userData">Value returned with the cancel completion.</param>
+	void prepCancel(uint64_t target, uint64_t userData);
+
+	/// <summary>
+	/// Prepares a timeout that completes with -ETIME once the interval elapses,
+	/// ending a wait for completions that would otherwise block.
+	/// </summary>
+	/// <param name="nanoseconds">Relative interval.</param>
+	/// <param name="userData">Value returned with the completion.</param>
+	void prepTimeout(uint64_t nanoseconds, uint64_t userData);
+
+	/// <summary>
+	/// Submits every prepared request and waits for completions using one io_uring_enter.
+	/// </summary>
+	/// <param name="completions">Cleared and filled with harvested completions.</param>
+	/// <param name="waitNr">Minimum number of completions to wait for.</param>
+	/// <returns>Number of completions harvested, or -1 on error.</returns>
+	int submitAndWait(std::vector<UringCompletion>& completions, unsigned waitNr);
+
+	/// <summary>
+	/// Returns the provided buffer selected by a receive completion.
+	/// </summary>
+	/// <param name="flags">Completion flags.</param>
+	/// <returns>Buffer identifier.</returns>
+	static uint16_t bufferId(uint32_t flags);
+
+	/// <summary>
+	/// Returns pointer to a provided buffer.
+	/// </summary>
+	/// <param name="bid">Buffer identifier.</param>
+	/// <returns>Start of buffer.</returns>
+	const char* buffer(uint16_t bid);
+
+	/// <summary>
+	/// Returns a provided buffer to the kernel once its contents are consumed.
+	/// </summary>
+	/// <param name="bid">Buffer identifier.</param>
+	void recycleBuffer(uint16_t bid);
+
+	/// <summary>
+	/// Returns number of io_uring_enter calls made since initialization.
+	/// </summary>
+	/// <returns>Syscall count.</returns>
+	uint64_t numEnters();
+
+private:
+	/// <summary>
+	/// Claims the next submission entry, flushing the ring to the kernel if full.
+	/// </summary>
+	/// <returns>Zeroed submission entry.</returns>
+	struct io_uring_sqe* nextSqe();
+
+	/// <summary>
+	/// Publishes prepared entries to the kernel-visible submission tail.
+	/// </summary>
+	/// <returns>Number of entries not yet submitted.</returns>
+	unsigned publish();
+
+	// Ring descriptor
+	int ringFd_;
+	// Submission queue mappings
+	void* sqRing_;
+	size_t sqRingSize_;
+	struct io_uring_sqe* sqes_;
+	size_t sqesSize_;
+	unsigned* sqHead_;
+	unsigned* sqTail_;
+	unsigned* sqMask_;
+	unsigned* sqArray_;
+	unsigned sqEntries_;
+	// One msghdr per submission slot, read by the kernel when the slot is submitted
+	std::vector<char> messages_;
+	// One timespec per submission slot, read by the kernel when the slot is submitted
+	std::vector<char> timeouts_;
+	// Next submission entry to fill and last entry handed to the kernel
+	unsigned sqeTail_;
+	unsigned sqeSubmitted_;
+	// Completion queue mappings
+	void* cqRing_;
+	size_t cqRingSize_;
+	unsigned* cqHead_;
+	unsigned* cqTail_;
+	unsigned* cqMask_;
+	struct io_uring_cqe* cqes_;
+	// Provided buffer ring
+	struct io_uring_buf_ring* bufRing_;
+	size_t bufRingSize_;
+	std::vector<char> bufPool_;
+	unsigned bufCount_;
+	unsigned bufSize_;
+	// Syscall accounting
+	uint64_t enters_;
+};
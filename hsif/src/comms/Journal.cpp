@@ -0,0 +1,550 @@
+#include "Journal.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Digits of the zero-padded base offset naming a segment file
+#define SEGMENT_NAME_DIGITS 20
+
+/// <summary>
+/// Fixed part of a record, followed by the destination and the payload and
+/// padded to 8 bytes. A zero length ends the records of a segment.
+/// </summary>
+struct JournalRecordHeader
+{
+    uint64_t offset;
+    uint64_t timestamp;
+    uint32_t length;
+    uint32_t destinationLength;
+    // CRC-32C of the header with this field zeroed, then the destination and payload
+    uint32_t checksum;
+    uint8_t kind;
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(JournalRecordHeader) == 32, "journal records must keep their on-disk layout");
+
+/// <summary>
+/// Sparse index entry locating a record within its segment. A zero position ends the index.
+/// </summary>
+struct JournalIndexEntry
+{
+    uint64_t offset;
+    uint64_t timestamp;
+    uint64_t position;
+};
+
+/// <summary>
+/// One mapped segment file and its index.
+/// </summary>
+struct JournalSegment
+{
+    // Offset of the first record
+    uint64_t base;
+    // Mapped records and their capacity
+    char* data;
+    size_t capacity;
+    int fd;
+    // Mapped index, its capacity and the number of entries written
+    JournalIndexEntry* index;
+    size_t indexCapacity;
+    size_t indexCount;
+    int indexFd;
+    // Bytes of records written, and of those synced; sealed segments count as full
+    size_t size;
+    size_t synced;
+    // Index entries synced
+    size_t indexSynced;
+    // Position of the newest index entry
+    size_t indexedAt;
+};
+
+// CRC-32C (Castagnoli) lookup table
+static const std::array<uint32_t, 256> checksumTable = []()
+{
+    std::array<uint32_t, 256> table{};
+    for (uint32_t index = 0; index < 256; index++)
+    {
+        uint32_t crc = index;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+        table[index] = crc;
+    }
+    return table;
+}();
+
+static uint32_t checksum(uint32_t crc, const char* data, size_t length)
+{
+    crc = ~crc;
+    for (size_t index = 0; index < length; index++)
+        crc = checksumTable[(crc ^ static_cast<uint8_t>(data[index])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Checksum of a record as it is laid out in a segment
+static uint32_t recordChecksum(const JournalRecordHeader& header, const char* body)
+{
+    JournalRecordHeader copy = header;
+    copy.checksum = 0;
+    uint32_t crc = checksum(0, reinterpret_cast<const char*>(&copy), sizeof(copy));
+    return checksum(crc, body, static_cast<size_t>(header.destinationLength) + header.length);
+}
+
+// Bytes a record occupies, padded so every header is aligned
+static size_t recordSize(size_t bodyLength)
+{
+    return (sizeof(JournalRecordHeader) + bodyLength + 7) & ~static_cast<size_t>(7);
+}
+
+Journal::Journal() :
+    policy_(DEFAULT_JOURNAL_POLICY),
+    nextOffset_(0),
+    dirty_(false)
+{}
+
+Journal::~Journal()
+{
+    close();
+}
+
+uint64_t Journal::now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(JournalClock::now().time_since_epoch()).count());
+}
+
+bool Journal::dirty() const
+{
+    return dirty_;
+}
+
+uint64_t Journal::startOffset() const
+{
+    return segments_.empty() ? nextOffset_ : segments_.front()->base;
+}
+
+uint64_t Journal::endOffset() const
+{
+    return nextOffset_;
+}
+
+const JournalPolicy& Journal::policy() const
+{
+    return policy_;
+}
+
+std::string Journal::segmentPath(uint64_t base, const char* extension) const
+{
+    char name[SEGMENT_NAME_DIGITS + 8];
+    snprintf(name, sizeof(name), "%020llu%s", static_cast<unsigned long long>(base), extension);
+    return directory_ + "/" + name;
+}
+
+size_t Journal::findSegment(uint64_t offset) const
+{
+    auto found = std::upper_bound(segments_.begin(), segments_.end(), offset,
+        [](uint64_t value, const std::unique_ptr<JournalSegment>& segment) { return value < segment->base; });
+    return found == segments_.begin() ? 0 : static_cast<size_t>(found - segments_.begin()) - 1;
+}
+
+bool Journal::readRecord(const JournalSegment& segment, size_t position, JournalRecord& record, size_t& size) const
+{
+    if (position + sizeof(JournalRecordHeader) > segment.capacity)
+        return false;
+    const JournalRecordHeader* header = reinterpret_cast<const JournalRecordHeader*>(segment.data + position);
+    size_t body = static_cast<size_t>(header->destinationLength) + header->length;
+    if (header->length == 0 || body > segment.capacity - position - sizeof(JournalRecordHeader))
+        return false;
+    const char* data = segment.data + position + sizeof(JournalRecordHeader);
+    if (recordChecksum(*header, data) != header->checksum)
+        return false;
+    record.offset = header->offset;
+    record.timestamp = header->timestamp;
+    record.kind = static_cast<JournalKind>(header->kind);
+    record.destination = std::string_view(data, header->destinationLength);
+    record.payload = std::string_view(data + header->destinationLength, header->length);
+    size = recordSize(body);
+    return true;
+}
+
+bool Journal::append(JournalKind kind, std::string_view destination, std::string_view payload, uint64_t timestamp)
+{
+    if (segments_.empty() || payload.empty())
+        return false;
+    size_t size = recordSize(destination.size() + payload.size());
+    if (segments_.back()->size + size > segments_.back()->capacity && !roll(size))
+        return false;
+    JournalSegment& segment = *segments_.back();
+
+    // Bytes go straight into the mapping, the kernel writes them back on sync or under memory pressure
+    char* body = segment.data + segment.size + sizeof(JournalRecordHeader);
+    std::memcpy(body, destination.data(), destination.size());
+    std::memcpy(body + destination.size(), payload.data(), payload.size());
+    JournalRecordHeader header = {};
+    header.offset = nextOffset_;
+    header.timestamp = timestamp;
+    header.length = static_cast<uint32_t>(payload.size());
+    header.destinationLength = static_cast<uint32_t>(destination.size());
+    header.kind = static_cast<uint8_t>(kind);
+    header.checksum = recordChecksum(header, body);
+    std::memcpy(segment.data + segment.size, &header, sizeof(header));
+
+    if (segment.size >= segment.indexedAt + policy_.indexInterval && segment.indexCount < segment.indexCapacity)
+    {
+        segment.index[segment.indexCount++] = { nextOffset_, timestamp, segment.size };
+        segment.indexedAt = segment.size;
+    }
+    segment.size += size;
+    nextOffset_++;
+    dirty_ = true;
+    return true;
+}
+
+JournalCursor Journal::seek(uint64_t offset)
+{
+    if (segments_.empty())
+        return { nextOffset_, 0, 0 };
+    const JournalSegment& segment = *segments_[findSegment(offset)];
+    offset = std::min(std::max(offset, segment.base), nextOffset_);
+
+    // Start from the last index entry at or before the offset, then step record by record
+    JournalCursor cursor = { segment.base, segment.base, 0 };
+    const JournalIndexEntry* entries = segment.index;
+    const JournalIndexEntry* found = std::upper_bound(entries, entries + segment.indexCount, offset,
+        [](uint64_t value, const JournalIndexEntry& entry) { return value < entry.offset; });
+    if (found != entries)
+    {
+        cursor.offset = (found - 1)->offset;
+        cursor.position = static_cast<size_t>((found - 1)->position);
+    }
+    JournalRecord record;
+    size_t size;
+    while (cursor.offset < offset && readRecord(segment, cursor.position, record, size) && record.offset == cursor.offset)
+    {
+        cursor.offset++;
+        cursor.position += size;
+    }
+    return cursor;
+}
+
+JournalCursor Journal::seekTime(uint64_t timestamp)
+{
+    if (segments_.empty())
+        return { nextOffset_, 0, 0 };
+
+    // Timestamps grow with offsets unless the wall clock stepped back, so search the
+    // segments by their first record and their index by entry
+    size_t index = 0;
+    JournalRecord record;
+    size_t size;
+    for (size_t candidate = segments_.size(); candidate-- > 0;)
+    {
+        if (readRecord(*segments_[candidate], 0, record, size) && record.timestamp < timestamp)
+        {
+            index = candidate;
+            break;
+        }
+    }
+    const JournalSegment& segment = *segments_[index];
+    uint64_t start = segment.base;
+    for (size_t entry = 0; entry < segment.indexCount && segment.index[entry].timestamp < timestamp; entry++)
+        start = segment.index[entry].offset;
+
+    JournalCursor cursor = seek(start);
+    JournalCursor previous = cursor;
+    while (next(cursor, record))
+    {
+        if (record.timestamp >= timestamp)
+            return previous;
+        previous = cursor;
+    }
+    return cursor;
+}
+
+bool Journal::next(JournalCursor& cursor, JournalRecord& record)
+{
+    while (!segments_.empty() && cursor.offset < nextOffset_)
+    {
+        size_t index = findSegment(cursor.offset);
+        // Moved past the end of its segment, or its segment was deleted
+        if (cursor.segment != segments_[index]->base || cursor.offset < segments_[index]->base)
+        {
+            cursor = seek(cursor.offset);
+            index = findSegment(cursor.offset);
+        }
+        size_t size;
+        if (readRecord(*segments_[index], cursor.position, record, size) && record.offset == cursor.offset)
+        {
+            cursor.offset++;
+            cursor.position += size;
+            return true;
+        }
+        // A damaged record loses the rest of its segment
+        if (index + 1 == segments_.size())
+            return false;
+        uint64_t following = segments_[index + 1]->base;
+        cursor = { following, following, 0 };
+    }
+    return false;
+}
+
+#ifdef __linux__
+
+// Opens or creates a file of at least size bytes and maps it, size receives the mapped size
+static char* mapFile(const std::string& path, size_t& size, int& fd)
+{
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return nullptr;
+    struct stat status;
+    if (fstat(fd, &status) == -1)
+        return nullptr;
+    // Blocks are reserved up front so a full disk fails here rather than as a fault on a mapped write
+    if (static_cast<size_t>(status.st_size) < size)
+    {
+        if (posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0 || fdatasync(fd) == -1)
+            return nullptr;
+    }
+    else
+        size = static_cast<size_t>(status.st_size);
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return data == MAP_FAILED ? nullptr : static_cast<char*>(data);
+}
+
+// Unmaps and closes a segment's files
+static void unmapSegment(JournalSegment& segment)
+{
+    if (segment.data)
+        munmap(segment.data, segment.capacity);
+    if (segment.index)
+        munmap(segment.index, segment.indexCapacity * sizeof(JournalIndexEntry));
+    if (segment.fd != -1)
+        ::close(segment.fd);
+    if (segment.indexFd != -1)
+        ::close(segment.indexFd);
+}
+
+bool Journal::open(const std::string& directory, JournalPolicy policy)
+{
+    close();
+    directory_ = directory;
+    policy_ = policy;
+    policy_.indexInterval = std::max<size_t>(policy_.indexInterval, 1);
+    nextOffset_ = 0;
+
+    DIR* listing = opendir(directory.c_str());
+    if (!listing)
+        return false;
+    std::vector<uint64_t> bases;
+    while (dirent* entry = readdir(listing))
+    {
+        std::string name = entry->d_name;
+        if (name.size() == SEGMENT_NAME_DIGITS + 4 && name.compare(SEGMENT_NAME_DIGITS, 4, ".log") == 0 &&
+            name.find_first_not_of("0123456789") == SEGMENT_NAME_DIGITS)
+            bases.push_back(std::stoull(name.substr(0, SEGMENT_NAME_DIGITS)));
+    }
+    closedir(listing);
+    std::sort(bases.begin(), bases.end());
+
+    for (uint64_t base : bases)
+    {
+        if (!addSegment(base, 0))
+        {
+            close();
+            return false;
+        }
+    }
+    if (segments_.empty())
+        return addSegment(0, policy_.segmentSize);
+    recover();
+    return true;
+}
+
+bool Journal::addSegment(uint64_t base, size_t capacity)
+{
+    auto segment = std::make_unique<JournalSegment>();
+    *segment = { base, nullptr, capacity, -1, nullptr, 0, 0, -1, 0, 0, 0, 0 };
+    bool created = capacity > 0;
+    if (segment->capacity < sizeof(JournalRecordHeader))
+        segment->capacity = policy_.segmentSize;
+    segment->data = mapFile(segmentPath(base, ".log"), segment->capacity, segment->fd);
+    size_t indexBytes = (segment->capacity / policy_.indexInterval + 1) * sizeof(JournalIndexEntry);
+    if (segment->data)
+        segment->index = reinterpret_cast<JournalIndexEntry*>(mapFile(segmentPath(base, ".idx"), indexBytes, segment->indexFd));
+    if (!segment->index)
+    {
+        unmapSegment(*segment);
+        return false;
+    }
+    segment->indexCapacity = indexBytes / sizeof(JournalIndexEntry);
+    while (segment->indexCount < segment->indexCapacity && segment->index[segment->indexCount].position != 0)
+        segment->indexCount++;
+    segment->indexSynced = segment->indexCount;
+
+    if (created)
+    {
+        // The new files' directory entries must be durable before records in them are
+        int handle = ::open(directory_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (handle != -1)
+        {
+            fsync(handle);
+            ::close(handle);
+        }
+    }
+    else
+    {
+        // Segments found on disk are sealed until recovery finds the end of the newest
+        segment->size = segment->capacity;
+        segment->synced = segment->capacity;
+    }
+    segments_.push_back(std::move(segment));
+    return true;
+}
+
+void Journal::recover()
+{
+    JournalSegment& segment = *segments_.back();
+    size_t position = 0;
+    uint64_t offset = segment.base;
+    JournalRecord record;
+    size_t size;
+    // Every record is checked, a crash may have written back pages of a later record but not an earlier one
+    while (readRecord(segment, position, record, size) && record.offset == offset)
+    {
+        position += size;
+        offset++;
+    }
+    segment.size = position;
+    segment.synced = position;
+    nextOffset_ = offset;
+
+    while (segment.indexCount > 0 && segment.index[segment.indexCount - 1].position >= position)
+        segment.index[--segment.indexCount] = {};
+    segment.indexSynced = segment.indexCount;
+    segment.indexedAt = segment.indexCount > 0 ? static_cast<size_t>(segment.index[segment.indexCount - 1].position) : 0;
+}
+
+bool Journal::roll(size_t size)
+{
+    // An empty segment too small for the record is replaced, its successor would start at the same offset
+    if (segments_.back()->size == 0)
+    {
+        JournalSegment& empty = *segments_.back();
+        unmapSegment(empty);
+        unlink(segmentPath(empty.base, ".log").c_str());
+        unlink(segmentPath(empty.base, ".idx").c_str());
+        segments_.pop_back();
+    }
+    if (!addSegment(nextOffset_, std::max(policy_.segmentSize, size)))
+        return false;
+    retire();
+    return true;
+}
+
+void Journal::retire()
+{
+    // The newest segment is never deleted, whatever the limit
+    while (policy_.maxSegments > 0 && segments_.size() > std::max<size_t>(policy_.maxSegments, 1))
+    {
+        JournalSegment& segment = *segments_.front();
+        unmapSegment(segment);
+        unlink(segmentPath(segment.base, ".log").c_str());
+        unlink(segmentPath(segment.base, ".idx").c_str());
+        segments_.pop_front();
+    }
+}
+
+bool Journal::sync()
+{
+    if (!dirty_)
+        return true;
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    bool success = true;
+    // Only the newest segments can hold unsynced records, a roll leaves the sealed one's tail behind
+    for (auto found = segments_.rbegin(); found != segments_.rend(); found++)
+    {
+        JournalSegment& segment = **found;
+        if (segment.synced >= segment.size && segment.indexSynced >= segment.indexCount)
+            break;
+        // msync needs a page-aligned start
+        size_t start = segment.synced & ~(page - 1);
+        if (segment.size > start && msync(segment.data + start, segment.size - start, MS_SYNC) == -1)
+            success = false;
+        size_t indexStart = (segment.indexSynced * sizeof(JournalIndexEntry)) & ~(page - 1);
+        size_t indexEnd = segment.indexCount * sizeof(JournalIndexEntry);
+        if (indexEnd > indexStart && msync(reinterpret_cast<char*>(segment.index) + indexStart, indexEnd - indexStart, MS_SYNC) == -1)
+            success = false;
+        segment.synced = segment.size;
+        segment.indexSynced = segment.indexCount;
+    }
+    dirty_ = false;
+    return success;
+}
+
+void Journal::close()
+{
+    sync();
+    for (std::unique_ptr<JournalSegment>& segment : segments_)
+        unmapSegment(*segment);
+    segments_.clear();
+}
+
+#else
+
+bool Journal::open(const std::string& directory, JournalPolicy policy)
+{
+    return false;
+}
+
+bool Journal::addSegment(uint64_t base, size_t capacity)
+{
+    return false;
+}
+
+void Journal::recover()
+{}
+
+bool Journal::roll(size_t size)
+{
+    return false;
+}
+
+void Journal::retire()
+{}
+
+bool Journal::sync()
+{
+    return true;
+}
+
+void Journal::close()
+{
+    segments_.clear();
+}
+
+#endif
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+using JournalClock = std::chrono::system_clock;
+
+/// <summary>
+/// How a journaled message was routed.
+/// </summary>
+enum class JournalKind : uint8_t
+{
+	// Message sent to the endpoint named by its destination
+	Message = 1,
+	// Message published to the topic named by its destination
+	Publish = 2
+};
+
+/// <summary>
+/// Segment size, index density, sync interval and retention of a journal.
+/// </summary>
+struct JournalPolicy
+{
+	// Bytes preallocated for each segment file, larger records get a segment of their own size
+	size_t segmentSize;
+	// Record bytes between sparse index entries
+	size_t indexInterval;
+	// Longest time an appended record waits to be synced to disk, zero to sync once per poll
+	std::chrono::milliseconds syncInterval;
+	// Segments kept before the oldest is deleted, 0 to keep every segment
+	size_t maxSegments;
+};
+
+// Journal layout used unless a server is configured otherwise
+#define DEFAULT_JOURNAL_POLICY JournalPolicy{ 64 * 1024 * 1024, 4096, std::chrono::milliseconds(10), 0 }
+
+/// <summary>
+/// One journaled message. Views point into the journal mapping and stay valid
+/// until its segment is deleted by retention.
+/// </summary>
+struct JournalRecord
+{
+	// Position of the record in the journal, one per record
+	uint64_t offset;
+	// Wall clock time the record was appended, in milliseconds since the epoch
+	uint64_t timestamp;
+	// How the message was routed
+	JournalKind kind;
+	// Destination endpoint or topic
+	std::string_view destination;
+	// Message as JSON text
+	std::string_view payload;
+};
+
+/// <summary>
+/// Read position in a journal. Stays usable across appends and survives its
+/// segment being deleted, in which case reading resumes at the oldest record.
+/// </summary>
+struct JournalCursor
+{
+	// Offset of the next record to read
+	uint64_t offset;
+	// Base offset of the segment holding it
+	uint64_t segment;
+	// Byte position of the record within that segment
+	size_t position;
+};
+
+struct JournalSegment;
+
+/// <summary>
+/// Append-only journal of routed messages, kept as a directory of segment files
+/// named by the offset of their first record. Segments are preallocated and
+/// memory-mapped, so an append is a copy into the mapping; sync() makes every
+/// record appended since the last sync durable at once. Each segment has a
+/// sparse index mapping offsets and timestamps to byte positions, and records
+/// carry a checksum so a tail torn by a crash is cut off when the journal is
+/// reopened. Single-threaded. Only functional on Linux.
+/// </summary>
+class Journal
+{
+public:
+	Journal();
+	~Journal();
+
+	// Journal owns its mappings and files
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+
+	/// <summary>
+	/// Opens the journal in a directory, recovering the segments already there.
+	/// </summary>
+	/// <param name="directory">Existing directory holding the segments.</param>
+	/// <param name="policy">Segment size, index density, sync interval and retention.</param>
+	/// <returns>True if successful.</returns>
+	bool open(const std::string& directory, JournalPolicy policy);
+
+	/// <summary>
+	/// Appends a record, rolling over to a new segment when the current one is full.
+	/// </summary>
+	/// <param name="kind">How the message was routed.</param>
+	/// <param name="destination">Destination endpoint or topic.</param>
+	/// <param name="payload">Message as JSON text.</param>
+	/// <param name="timestamp">Wall clock time in milliseconds since the epoch.</param>
+	/// <returns>False if a new segment could not be created.</returns>
+	bool append(JournalKind kind, std::string_view destination, std::string_view payload, uint64_t timestamp);
+
+	/// <summary>
+	/// Writes records appended since the last sync to disk and waits for them to be durable.
+	/// </summary>
+	/// <returns>False if the disk reported an error.</returns>
+	bool sync();
+
+	/// <summary>
+	/// Returns whether records were appended since the last sync.
+	/// </summary>
+	/// <returns>True if a sync would write anything.</returns>
+	bool dirty() const;
+
+	/// <summary>
+	/// Returns a cursor at the first record at or after an offset. Offsets older
+	/// than the oldest retained record start at the oldest record.
+	/// </summary>
+	/// <param name="offset">Journal offset.</param>
+	/// <returns>Read position.</returns>
+	JournalCursor seek(uint64_t offset);
+
+	/// <summary>
+	/// Returns a cursor at the first record appended at or after a time.
+	/// </summary>
+	/// <param name="timestamp">Wall clock time in milliseconds since the epoch.</param>
+	/// <returns>Read position.</returns>
+	JournalCursor seekTime(uint64_t timestamp);
+
+	/// <summary>
+	/// Reads the record at a cursor and advances it.
+	/// </summary>
+	/// <param name="cursor">Read position.</param>
+	/// <param name="record">Receives the record.</param>
+	/// <returns>False once the cursor reaches the end of the journal.</returns>
+	bool next(JournalCursor& cursor, JournalRecord& record);
+
+	/// <summary>
+	/// Returns the offset of the oldest retained record.
+	/// </summary>
+	/// <returns>Journal offset.</returns>
+	uint64_t startOffset() const;
+
+	/// <summary>
+	/// Returns the offset the next appended record receives.
+	/// </summary>
+	/// <returns>Journal offset.</returns>
+	uint64_t endOffset() const;
+
+	/// <summary>
+	/// Returns the policy the journal was opened with.
+	/// </summary>
+	/// <returns>Journal policy.</returns>
+	const JournalPolicy& policy() const;
+
+	/// <summary>
+	/// Syncs and unmaps every segment.
+	/// </summary>
+	void close();
+
+	/// <summary>
+	/// Returns the current wall clock time as journal timestamps measure it.
+	/// </summary>
+	/// <returns>Milliseconds since the epoch.</returns>
+	static uint64_t now();
+
+private:
+	/// <summary>
+	/// Opens or creates a segment and its index after the existing segments,
+	/// preallocating files shorter than needed.
+	/// </summary>
+	/// <param name="base">Offset of the segment's first record.</param>
+	/// <param name="capacity">Record bytes the segment holds at least.</param>
+	/// <returns>True if successful.</returns>
+	bool addSegment(uint64_t base, size_t capacity);
+
+	/// <summary>
+	/// Finds the end of the newest segment by validating its records and drops
+	/// index entries past the last valid record.
+	/// </summary>
+	void recover();
+
+	/// <summary>
+	/// Seals the newest segment and starts another after it.
+	/// </summary>
+	/// <param name="size">Bytes of the record that did not fit.</param>
+	/// <returns>False if the new segment could not be created.</returns>
+	bool roll(size_t size);
+
+	/// <summary>
+	/// Deletes the oldest segments beyond the retention limit.
+	/// </summary>
+	void retire();
+
+	/// <summary>
+	/// Returns the path of a segment file.
+	/// </summary>
+	/// <param name="base">Offset of the segment's first record.</param>
+	/// <param name="extension">".log" for records, ".idx" for the index.</param>
+	/// <returns>Path within the journal directory.</returns>
+	std::string segmentPath(uint64_t base, const char* extension) const;
+
+	/// <summary>
+	/// Returns the segment holding an offset, the oldest if the offset is older.
+	/// </summary>
+	/// <param name="offset">Journal offset.</param>
+	/// <returns>Index into segments_.</returns>
+	size_t findSegment(uint64_t offset) const;
+
+	/// <summary>
+	/// Reads and validates the record at a position of a segment.
+	/// </summary>
+	/// <param name="segment">Segment to read.</param>
+	/// <param name="position">Byte position of the record.</param>
+	/// <param name="record">Receives the record.</param>
+	/// <param name="size">Receives the record's size including padding.</param>
+	/// <returns>False at the end of the segment's records or at a damaged record.</returns>
+	bool readRecord(const JournalSegment& segment, size_t position, JournalRecord& record, size_t& size) const;
+
+	// Directory holding the segments
+	std::string directory_;
+	// Segments from oldest to newest, the newest receives appends
+	std::deque<std::unique_ptr<JournalSegment>> segments_;
+	// Layout and retention
+	JournalPolicy policy_;
+	// Offset the next record receives
+	uint64_t nextOffset_;
+	// Whether records were appended since the last sync
+	bool dirty_;
+};
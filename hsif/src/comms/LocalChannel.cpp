@@ -0,0 +1,221 @@
+#include "LocalChannel.hpp"
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+LocalHub::LocalHub() :
+    rung_(false),
+    bell_(-1)
+{}
+
+SOCKET LocalHub::handle()
+{
+    return bell_ == -1 ? INVALID_SOCKET : static_cast<SOCKET>(bell_);
+}
+
+void LocalHub::notify(std::weak_ptr<LocalChannel> channel)
+{
+    ready_.push(std::move(channel));
+    ring();
+}
+
+bool LocalHub::next(std::weak_ptr<LocalChannel>& channel)
+{
+    return ready_.pop(channel);
+}
+
+#ifdef __linux__
+
+LocalHub::~LocalHub()
+{
+    if (bell_ != -1)
+        ::close(bell_);
+}
+
+bool LocalHub::open()
+{
+    bell_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return bell_ != -1;
+}
+
+void LocalHub::ring()
+{
+    // Pairs with the fence in clear(): either the server sees what was queued before this ring, or this ring writes
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (rung_.exchange(true, std::memory_order_relaxed))
+        return;
+    uint64_t one = 1;
+    (void)::write(bell_, &one, sizeof(one));
+}
+
+void LocalHub::clear()
+{
+    uint64_t count;
+    (void)::read(bell_, &count, sizeof(count));
+    rung_.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+#else
+
+LocalHub::~LocalHub()
+{}
+
+bool LocalHub::open()
+{
+    return false;
+}
+
+void LocalHub::ring()
+{}
+
+void LocalHub::clear()
+{}
+
+#endif
+
+LocalChannel::LocalChannel(size_t capacity) :
+    handle(INVALID_SLOT_HANDLE),
+    inbound_(capacity),
+    outbound_(capacity),
+    pending_(false),
+    serverWaiting_(false),
+    clientWaiting_(false),
+    closed_(false)
+{}
+
+void LocalChannel::open(std::shared_ptr<LocalHub> hub)
+{
+    hub_ = std::move(hub);
+    // The server attaches the channel the first time it is serviced
+    wakeServer();
+}
+
+bool LocalChannel::trySend(const LocalFrame& frame)
+{
+    if (closed_.load(std::memory_order_acquire) || !inbound_.tryPush(frame))
+        return false;
+    wakeServer();
+    return true;
+}
+
+bool LocalChannel::send(const LocalFrame& frame)
+{
+    if (trySend(frame))
+        return true;
+    // Ring full, wait for the server to take messages
+    bool sent = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    clientWaiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wakeup_.wait(lock, [&]() { return (sent = trySend(frame)) || closed_.load(std::memory_order_acquire); });
+    clientWaiting_.store(false, std::memory_order_relaxed);
+    return sent;
+}
+
+bool LocalChannel::tryReceive(Payload& payload)
+{
+    if (!outbound_.pop(payload))
+        return false;
+    // A server that found the ring full delivers the rest once notified
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (serverWaiting_.load(std::memory_order_relaxed) && serverWaiting_.exchange(false, std::memory_order_relaxed))
+        wakeServer();
+    return true;
+}
+
+bool LocalChannel::receive(Payload& payload, int timeoutMs)
+{
+    if (tryReceive(payload))
+        return true;
+    // Announce the wait, then check again so a delivery in between is not missed
+    bool received = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    clientWaiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ready = [&]() { return (received = tryReceive(payload)) || closed_.load(std::memory_order_acquire); };
+    if (timeoutMs < 0)
+        wakeup_.wait(lock, ready);
+    else
+        wakeup_.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+    clientWaiting_.store(false, std::memory_order_relaxed);
+    return received;
+}
+
+bool LocalChannel::take(LocalFrame& frame)
+{
+    return inbound_.pop(frame);
+}
+
+bool LocalChannel::deliver(const Payload& payload)
+{
+    if (outbound_.tryPush(payload))
+        return true;
+    // Announce the wait, then retry in case the client took messages before it could see the flag
+    serverWaiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return outbound_.tryPush(payload);
+}
+
+void LocalChannel::wakeClient()
+{
+    // Pairs with the client's fence between announcing its wait and checking the rings
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!clientWaiting_.load(std::memory_order_relaxed))
+        return;
+    // Taking the lock places the notification after the client's check or inside its wait
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeup_.notify_all();
+}
+
+void LocalChannel::clearPending()
+{
+    pending_.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void LocalChannel::wakeServer()
+{
+    // Pairs with the fence in clearPending(): either the server sees this activity, or the channel is queued again
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (hub_ && !pending_.exchange(true, std::memory_order_relaxed))
+        hub_->notify(weak_from_this());
+}
+
+void LocalChannel::close()
+{
+    if (closed_.exchange(true, std::memory_order_acq_rel))
+        return;
+    wakeServer();
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeup_.notify_all();
+}
+
+bool LocalChannel::closed()
+{
+    return closed_.load(std::memory_order_acquire);
+}
+
+size_t LocalChannel::capacity()
+{
+    return outbound_.capacity();
+}
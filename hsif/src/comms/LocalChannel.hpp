@@ -0,0 +1,226 @@
+#pragma once
+
+#include "Framing.hpp"
+#include "Socket.hpp"
+#include "MpscQueue.hpp"
+#include "MpscRing.hpp"
+#include "SlotMap.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Messages buffered in each direction of a local channel
+#define LOCAL_RING_CAPACITY 1024
+
+class LocalChannel;
+
+/// <summary>
+/// Message an in-process client hands to the broker, with the encoding it was written in.
+/// </summary>
+struct LocalFrame
+{
+	Payload payload;
+	WireFormat format;
+};
+
+/// <summary>
+/// Wakeup shared by a server thread and the in-process clients attached to it. A
+/// channel with new activity queues itself here and rings one eventfd, which the
+/// server's reactor watches like any socket; the eventfd is only written when the
+/// server has not been rung since it last drained the queue. Only functional on Linux.
+/// </summary>
+class LocalHub
+{
+public:
+	LocalHub();
+	~LocalHub();
+
+	// Hub owns its eventfd
+	LocalHub(const LocalHub&) = delete;
+	LocalHub& operator=(const LocalHub&) = delete;
+
+	/// <summary>
+	/// Creates the eventfd.
+	/// </summary>
+	/// <returns>True if successful.</returns>
+	bool open();
+
+	/// <summary>
+	/// Returns the eventfd the server watches, readable once rung.
+	/// </summary>
+	/// <returns>Eventfd handle, INVALID_SOCKET unless open.</returns>
+	SOCKET handle();
+
+	/// <summary>
+	/// Queues a channel for service and rings the server. Safe to call from any thread.
+	/// </summary>
+	/// <param name="channel">Channel with new activity.</param>
+	void notify(std::weak_ptr<LocalChannel> channel);
+
+	/// <summary>
+	/// Rings the server so its current or next wait returns. Safe to call from any thread.
+	/// </summary>
+	void ring();
+
+	/// <summary>
+	/// Consumes pending rings before the queue is drained. Server only.
+	/// </summary>
+	void clear();
+
+	/// <summary>
+	/// Dequeues the next channel to service. Server only.
+	/// </summary>
+	/// <param name="channel">Receives the channel, empty if it has since been released.</param>
+	/// <returns>False if no channels are queued.</returns>
+	bool next(std::weak_ptr<LocalChannel>& channel);
+
+private:
+	// Channels with activity the server has not seen, held weakly so a released client is not kept alive
+	MpscQueue<std::weak_ptr<LocalChannel>> ready_;
+	// Set once rung and cleared by the server before draining, so rings between drains share one write
+	std::atomic<bool> rung_;
+	// Eventfd watched by the server
+	int bell_;
+};
+
+/// <summary>
+/// Pair of lock-free rings connecting an in-process client with the server thread
+/// owning its endpoint. Messages cross as refcounted payloads, so nothing is copied,
+/// framed or written to a socket: the server routes the payloads the client sends and
+/// hands over the payloads routed to it. The client notifies the server's hub only
+/// when the channel goes from idle to pending, and the server only signals the client
+/// while it waits, so a busy stream costs no syscalls or locks on either side.
+/// </summary>
+class LocalChannel : public std::enable_shared_from_this<LocalChannel>
+{
+public:
+	/// <summary>
+	/// Initializes both rings.
+	/// </summary>
+	/// <param name="capacity">Minimum messages buffered in each direction.</param>
+	LocalChannel(size_t capacity);
+
+	// Rings are owned by the channel
+	LocalChannel(const LocalChannel&) = delete;
+	LocalChannel& operator=(const LocalChannel&) = delete;
+
+	/// <summary>
+	/// Connects the channel to the hub of the server serving it and notifies the server. Client side, once.
+	/// </summary>
+	/// <param name="hub">Hub of the server thread.</param>
+	void open(std::shared_ptr<LocalHub> hub);
+
+	/// <summary>
+	/// Hands a message to the server if there is room. Client side.
+	/// </summary>
+	/// <param name="frame">Message and its encoding.</param>
+	/// <returns>False if the ring is full or the channel closed.</returns>
+	bool trySend(const LocalFrame& frame);
+
+	/// <summary>
+	/// Hands a message to the server, waiting while the ring is full. Client side.
+	/// </summary>
+	/// <param name="frame">Message and its encoding.</param>
+	/// <returns>False if the channel closed.</returns>
+	bool send(const LocalFrame& frame);
+
+	/// <summary>
+	/// Takes the next message routed to the client if one is waiting. Client side.
+	/// </summary>
+	/// <param name="payload">Receives the message, encoded as the client registered.</param>
+	/// <returns>False if no message is waiting.</returns>
+	bool tryReceive(Payload& payload);
+
+	/// <summary>
+	/// Takes the next message routed to the client, waiting for one. Client side.
+	/// </summary>
+	/// <param name="payload">Receives the message, encoded as the client registered.</param>
+	/// <param name="timeoutMs">Milliseconds to wait, -1 to wait indefinitely.</param>
+	/// <returns>False on timeout, or once the channel closed and every message was taken.</returns>
+	bool receive(Payload& payload, int timeoutMs);
+
+	/// <summary>
+	/// Takes the next message the client sent. Server side.
+	/// </summary>
+	/// <param name="frame">Receives the message.</param>
+	/// <returns>False if the ring is empty.</returns>
+	bool take(LocalFrame& frame);
+
+	/// <summary>
+	/// Hands a message to the client if there is room. A full ring makes the client
+	/// notify the server once it has taken a message. Server side.
+	/// </summary>
+	/// <param name="payload">Message encoded as the client registered.</param>
+	/// <returns>False if the ring is full.</returns>
+	bool deliver(const Payload& payload);
+
+	/// <summary>
+	/// Wakes the client if it waits for messages or room. Server side, after a batch of take() or deliver().
+	/// </summary>
+	void wakeClient();
+
+	/// <summary>
+	/// Clears the pending flag before the server services the channel, so activity from then on notifies it again. Server side.
+	/// </summary>
+	void clearPending();
+
+	/// <summary>
+	/// Queues the channel for service by the server unless it already is. Either side.
+	/// </summary>
+	void wakeServer();
+
+	/// <summary>
+	/// Closes the channel. The server removes the endpoint and a waiting client returns. Either side.
+	/// </summary>
+	void close();
+
+	/// <summary>
+	/// Returns whether either side closed the channel.
+	/// </summary>
+	/// <returns>True once closed.</returns>
+	bool closed();
+
+	/// <summary>
+	/// Returns number of messages each ring holds when full.
+	/// </summary>
+	/// <returns>Capacity.</returns>
+	size_t capacity();
+
+	// Endpoint serving the channel, INVALID_SLOT_HANDLE until attached. Server thread only
+	SlotHandle handle;
+
+private:
+	// Client to server, and server to client
+	MpscRing<LocalFrame> inbound_;
+	MpscRing<Payload> outbound_;
+	// Hub of the serving server, set once by open()
+	std::shared_ptr<LocalHub> hub_;
+	// Set while the channel is queued on the hub and not yet serviced
+	std::atomic<bool> pending_;
+	// Set by a server that found the client's ring full
+	std::atomic<bool> serverWaiting_;
+	// Set by a client about to wait for messages or room
+	std::atomic<bool> clientWaiting_;
+	// Set once either side closed the channel
+	std::atomic<bool> closed_;
+	// Guards the client's wait so a wakeup is not lost between its check and its sleep
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+};
@@ -0,0 +1,152 @@
+#include "MetricsExporter.hpp"
+#include <chrono>
+#include <cstring>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Waits for a socket to become readable, returns false on timeout or error.
+// Polled rather than selected, so descriptors past FD_SETSIZE are safe
+static bool waitReadable(SOCKET socket, int milliseconds)
+{
+#ifdef _WIN32
+    WSAPOLLFD entry = { socket, POLLRDNORM, 0 };
+    return WSAPoll(&entry, 1, milliseconds) > 0;
+#else
+    pollfd entry = { socket, POLLIN, 0 };
+    return ::poll(&entry, 1, milliseconds) > 0;
+#endif
+}
+
+MetricsExporter::MetricsExporter(std::vector<std::shared_ptr<MetricsRegistry>> sources, std::shared_ptr<Logger> logger, bool logToFile) :
+    sources_(std::move(sources)),
+    logger_(logger),
+    logToFile_(logToFile),
+    listenSocket_(INVALID_SOCKET),
+    port_(0),
+    running_(false)
+{}
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+bool MetricsExporter::start(unsigned int port)
+{
+    if ((listenSocket_ = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
+    {
+        LOG_ERROR(logger_, logToFile_, "Metrics socket() failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    sock::setReuseAddress(listenSocket_);
+
+    // Metrics are only reachable from this host
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(listenSocket_, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR || listen(listenSocket_, SOMAXCONN))
+    {
+        LOG_ERROR(logger_, logToFile_, "Metrics listener on port " + std::to_string(port) + " failed with error: " + std::to_string(sock::lastError()));
+        sock::close(listenSocket_);
+        listenSocket_ = INVALID_SOCKET;
+        return false;
+    }
+    port_ = sock::localPort(listenSocket_);
+    LOG_INFO(logger_, logToFile_, "Serving metrics on 127.0.0.1:" + std::to_string(port_));
+
+    running_ = true;
+    thread_ = std::thread(&MetricsExporter::serveLoop, this);
+    return true;
+}
+
+void MetricsExporter::stop()
+{
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+    if (listenSocket_ != INVALID_SOCKET)
+    {
+        sock::close(listenSocket_);
+        listenSocket_ = INVALID_SOCKET;
+    }
+}
+
+unsigned int MetricsExporter::port()
+{
+    return port_;
+}
+
+std::string MetricsExporter::render()
+{
+    std::vector<MetricsSnapshot> snapshots;
+    for (const std::shared_ptr<MetricsRegistry>& source : sources_)
+        snapshots.push_back(source->snapshot());
+    return MetricsRegistry::toPrometheus(snapshots);
+}
+
+void MetricsExporter::serveLoop()
+{
+    // Listener is polled with a timeout so stop() never has to interrupt a blocking accept
+    while (running_)
+    {
+        if (!waitReadable(listenSocket_, METRICS_POLL_INTERVAL))
+            continue;
+        SOCKET client = accept(listenSocket_, NULL, NULL);
+        if (client == INVALID_SOCKET)
+            continue;
+        serveClient(client);
+        sock::close(client);
+    }
+}
+
+void MetricsExporter::serveClient(SOCKET client)
+{
+    // Read the request headers so closing does not reset the connection, clients that send nothing still get the text
+    std::string request;
+    char buffer[1024];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(METRICS_REQUEST_TIMEOUT);
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < sizeof(buffer) * 8)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0 || !waitReadable(client, static_cast<int>(remaining)))
+            break;
+        int received = sock::recv(client, buffer, sizeof(buffer));
+        if (received <= 0)
+            break;
+        request.append(buffer, received);
+    }
+
+    std::string body = render();
+    std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+        std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+        int written = sock::send(client, response.data() + sent, response.size() - sent);
+        if (written == SOCKET_ERROR)
+        {
+            LOG_WARNING(logger_, logToFile_, "Metrics send() failed with error: " + std::to_string(sock::lastError()));
+            return;
+        }
+        sent += written;
+    }
+}
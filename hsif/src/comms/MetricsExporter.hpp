@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Socket.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Default loopback port serving Prometheus text
+#define METRICS_PORT 8889
+// How often the exporter thread checks whether it should stop, in milliseconds
+#define METRICS_POLL_INTERVAL 100
+// Longest wait for a scrape request before answering anyway, in milliseconds
+#define METRICS_REQUEST_TIMEOUT 1000
+
+/// <summary>
+/// Serves metrics in the Prometheus text format over HTTP on a loopback port.
+/// Runs on its own thread and only reads registry snapshots, so the reactor
+/// threads it reports on never wait for a scrape. Every connection receives
+/// one response and is closed.
+/// </summary>
+class MetricsExporter
+{
+public:
+	MetricsExporter() = delete;
+
+	/// <summary>
+	/// Exporter initialization with the registries to report and logging parameters.
+	/// </summary>
+	/// <param name="sources">Registries exported together, one per shard.</param>
+	/// <param name="logger">Pointer reference to Logger utility object.</param>
+	/// <param name="logToFile">Determines whether or not to log to file.</param>
+	MetricsExporter(std::vector<std::shared_ptr<MetricsRegistry>> sources, std::shared_ptr<Logger> logger, bool logToFile);
+
+	/// <summary>
+	/// Stops the exporter thread.
+	/// </summary>
+	~MetricsExporter();
+
+	// Exporter thread refers to this instance
+	MetricsExporter(const MetricsExporter&) = delete;
+	MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+	/// <summary>
+	/// Listens on 127.0.0.1 and starts serving scrapes.
+	/// </summary>
+	/// <param name="port">TCP port, 0 to let the system choose.</param>
+	/// <returns>Returns whether or not the listener started.</returns>
+	bool start(unsigned int port);
+
+	/// <summary>
+	/// Stops serving and closes the listener.
+	/// </summary>
+	void stop();
+
+	/// <summary>
+	/// Returns the port the exporter listens on.
+	/// </summary>
+	/// <returns>Bound port, 0 before start().</returns>
+	unsigned int port();
+
+	/// <summary>
+	/// Formats the current value of every source.
+	/// </summary>
+	/// <returns>Prometheus exposition text.</returns>
+	std::string render();
+
+private:
+	/// <summary>
+	/// Exporter thread body. Accepts and answers scrapes until stopped.
+	/// </summary>
+	void serveLoop();
+
+	/// <summary>
+	/// Reads a scrape request and writes the exposition text back.
+	/// </summary>
+	/// <param name="client">Accepted connection.</param>
+	void serveClient(SOCKET client);
+
+	// Registries reported on every scrape
+	std::vector<std::shared_ptr<MetricsRegistry>> sources_;
+	// Current logger object
+	std::shared_ptr<Logger> logger_;
+	// Determines whether or not to log to a file
+	bool logToFile_;
+	// Loopback listener
+	SOCKET listenSocket_;
+	// Bound port
+	unsigned int port_;
+	// Cleared to stop the exporter thread
+	std::atomic<bool> running_;
+	// Exporter thread
+	std::thread thread_;
+};
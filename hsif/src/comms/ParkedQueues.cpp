@@ -0,0 +1,164 @@
+#include "ParkedQueues.hpp"
+#include <algorithm>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+ParkedQueues::ParkedQueues() :
+    ParkedQueues(DEFAULT_PARKING_POLICY)
+{}
+
+ParkedQueues::ParkedQueues(ParkingPolicy policy) :
+    policy_(policy),
+    total_(0),
+    nextExpiry_(ParkClock::time_point::max()),
+    stats_({ 0, 0, 0 })
+{}
+
+void ParkedQueues::setPolicy(ParkingPolicy policy)
+{
+    policy_ = policy;
+    // Force a sweep so a shorter TTL takes effect on messages already parked
+    nextExpiry_ = total_ > 0 ? ParkClock::time_point::min() : ParkClock::time_point::max();
+}
+
+bool ParkedQueues::park(const std::string& to, Payload msg, ParkClock::time_point now)
+{
+    // Global limit protects the broker itself, so it always refuses the newcomer
+    if (total_ >= policy_.maxTotal || policy_.maxPerDestination == 0)
+    {
+        stats_.dropped++;
+        return false;
+    }
+
+    std::deque<Parked>& queue = queues_[to];
+    if (queue.size() >= policy_.maxPerDestination)
+    {
+        stats_.dropped++;
+        if (policy_.drop == DropPolicy::DropNewest)
+            return false;
+        queue.pop_front();
+        total_--;
+    }
+
+    queue.push_back({ std::move(msg), now });
+    total_++;
+    stats_.parked++;
+    if (policy_.ttl.count() > 0)
+        nextExpiry_ = std::min(nextExpiry_, now + policy_.ttl);
+    return true;
+}
+
+std::vector<Payload> ParkedQueues::release(const std::string& to, ParkClock::time_point now)
+{
+    std::vector<Payload> released;
+    auto found = queues_.find(to);
+    if (found == queues_.end())
+        return released;
+
+    released.reserve(found->second.size());
+    for (Parked& parked : found->second)
+    {
+        if (expired(parked.parkedAt, now))
+            stats_.expired++;
+        else
+            released.push_back(std::move(parked.msg));
+    }
+    total_ -= found->second.size();
+    queues_.erase(found);
+    return released;
+}
+
+std::vector<Payload> ParkedQueues::peek(const std::string& to, ParkClock::time_point now)
+{
+    std::vector<Payload> parked;
+    auto found = queues_.find(to);
+    if (found == queues_.end())
+        return parked;
+
+    parked.reserve(found->second.size());
+    for (const Parked& entry : found->second)
+    {
+        if (!expired(entry.parkedAt, now))
+            parked.push_back(entry.msg);
+    }
+    return parked;
+}
+
+size_t ParkedQueues::expire(ParkClock::time_point now)
+{
+    if (now < nextExpiry_)
+        return 0;
+
+    // Queues are in arrival order, so expired messages are always at the front
+    size_t count = 0;
+    nextExpiry_ = ParkClock::time_point::max();
+    for (auto queue = queues_.begin(); queue != queues_.end();)
+    {
+        std::deque<Parked>& parked = queue->second;
+        while (!parked.empty() && expired(parked.front().parkedAt, now))
+        {
+            parked.pop_front();
+            count++;
+        }
+        if (parked.empty())
+        {
+            queue = queues_.erase(queue);
+            continue;
+        }
+        if (policy_.ttl.count() > 0)
+            nextExpiry_ = std::min(nextExpiry_, parked.front().parkedAt + policy_.ttl);
+        queue++;
+    }
+    total_ -= count;
+    stats_.expired += count;
+    return count;
+}
+
+std::vector<std::string> ParkedQueues::destinations()
+{
+    std::vector<std::string> ids;
+    ids.reserve(queues_.size());
+    for (const auto& queue : queues_)
+        ids.push_back(queue.first);
+    return ids;
+}
+
+bool ParkedQueues::empty()
+{
+    return total_ == 0;
+}
+
+size_t ParkedQueues::size()
+{
+    return total_;
+}
+
+size_t ParkedQueues::size(const std::string& to)
+{
+    auto found = queues_.find(to);
+    return found == queues_.end() ? 0 : found->second.size();
+}
+
+ParkingStats ParkedQueues::stats()
+{
+    return stats_;
+}
+
+bool ParkedQueues::expired(ParkClock::time_point parkedAt, ParkClock::time_point now)
+{
+    return policy_.ttl.count() > 0 && now - parkedAt >= policy_.ttl;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Framing.hpp"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+using ParkClock = std::chrono::steady_clock;
+
+/// <summary>
+/// Message given up when a destination's parked queue is full.
+/// </summary>
+enum class DropPolicy
+{
+	// Discard the message waiting longest to make room for the new one
+	DropOldest,
+	// Refuse the new message
+	DropNewest
+};
+
+/// <summary>
+/// Limits on messages held for destinations that have not registered yet.
+/// </summary>
+struct ParkingPolicy
+{
+	// Time a message may wait for its destination, zero to never expire
+	std::chrono::milliseconds ttl;
+	// Messages held for a single destination
+	size_t maxPerDestination;
+	// Messages held across every destination, new messages are refused beyond it
+	size_t maxTotal;
+	// Message dropped when a destination's queue is full
+	DropPolicy drop;
+};
+
+// Parking limits used unless a server is configured otherwise
+#define DEFAULT_PARKING_POLICY ParkingPolicy{ std::chrono::seconds(30), 1024, 65536, DropPolicy::DropOldest }
+
+/// <summary>
+/// Counters describing parked message outcomes.
+/// </summary>
+struct ParkingStats
+{
+	// Messages accepted into a parked queue
+	uint64_t parked;
+	// Parked messages discarded after waiting longer than the TTL
+	uint64_t expired;
+	// Messages discarded because a queue limit was reached
+	uint64_t dropped;
+};
+
+/// <summary>
+/// Messages waiting for their destination to register, queued per destination
+/// in arrival order. Parked messages are never looked at again until their
+/// destination is released, so an unregistered destination costs nothing per
+/// poll beyond an occasional expiry sweep.
+/// </summary>
+class ParkedQueues
+{
+public:
+	ParkedQueues();
+
+	/// <summary>
+	/// Parked queues with the given limits.
+	/// </summary>
+	/// <param name="policy">Parking limits.</param>
+	ParkedQueues(ParkingPolicy policy);
+
+	/// <summary>
+	/// Replaces the parking limits. Messages already parked are kept.
+	/// </summary>
+	/// <param name="policy">Parking limits.</param>
+	void setPolicy(ParkingPolicy policy);
+
+	/// <summary>
+	/// Parks a message until its destination registers.
+	/// </summary>
+	/// <param name="to">Destination identifier.</param>
+	/// <param name="msg">JSON text payload.</param>
+	/// <param name="now">Current time.</param>
+	/// <returns>False if the message was refused.</returns>
+	bool park(const std::string& to, Payload msg, ParkClock::time_point now);
+
+	/// <summary>
+	/// Removes every message parked for a destination, expired messages excluded.
+	/// </summary>
+	/// <param name="to">Destination identifier.</param>
+	/// <param name="now">Current time.</param>
+	/// <returns>Messages in arrival order.</returns>
+	std::vector<Payload> release(const std::string& to, ParkClock::time_point now);
+
+	/// <summary>
+	/// Returns every message parked for a destination without removing them, expired messages excluded.
+	/// </summary>
+	/// <param name="to">Destination identifier.</param>
+	/// <param name="now">Current time.</param>
+	/// <returns>Messages in arrival order.</returns>
+	std::vector<Payload> peek(const std::string& to, ParkClock::time_point now);
+
+	/// <summary>
+	/// Discards messages older than the TTL. Returns immediately until the
+	/// oldest parked message can have expired.
+	/// </summary>
+	/// <param name="now">Current time.</param>
+	/// <returns>Number of messages discarded.</returns>
+	size_t expire(ParkClock::time_point now);
+
+	/// <summary>
+	/// Returns every destination with parked messages.
+	/// </summary>
+	/// <returns>Destination identifiers.</returns>
+	std::vector<std::string> destinations();
+
+	/// <summary>
+	/// Returns whether no message is parked.
+	/// </summary>
+	/// <returns>True if every queue is empty.</returns>
+	bool empty();
+
+	/// <summary>
+	/// Returns number of messages parked across every destination.
+	/// </summary>
+	/// <returns>Message count.</returns>
+	size_t size();
+
+	/// <summary>
+	/// Returns number of messages parked for a destination.
+	/// </summary>
+	/// <param name="to">Destination identifier.</param>
+	/// <returns>Message count.</returns>
+	size_t size(const std::string& to);
+
+	/// <summary>
+	/// Returns counters accumulated since construction.
+	/// </summary>
+	/// <returns>Parking statistics.</returns>
+	ParkingStats stats();
+
+private:
+	/// <summary>
+	/// Parked message and its arrival time.
+	/// </summary>
+	struct Parked
+	{
+		Payload msg;
+		ParkClock::time_point parkedAt;
+	};
+
+	/// <summary>
+	/// Returns whether a message parked at the given time has outlived the TTL.
+	/// </summary>
+	/// <param name="parkedAt">Time the message was parked.</param>
+	/// <param name="now">Current time.</param>
+	/// <returns>True if expired.</returns>
+	bool expired(ParkClock::time_point parkedAt, ParkClock::time_point now);
+
+	// Parked messages of each destination in arrival order
+	std::unordered_map<std::string, std::deque<Parked>> queues_;
+	// Current limits
+	ParkingPolicy policy_;
+	// Messages parked across every destination
+	size_t total_;
+	// Earliest time a parked message can expire
+	ParkClock::time_point nextExpiry_;
+	// Outcome counters
+	ParkingStats stats_;
+};
@@ -0,0 +1,290 @@
+#include "SendQueue.hpp"
+#include <algorithm>
+#include <charconv>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+SendQueue::SendQueue() :
+    droppedFrames_(0),
+    offset_(0),
+    bytesQueued_(0),
+    popped_(0)
+{}
+
+void SendQueue::push(Payload payload)
+{
+    push(std::move(payload), WireFormat::Text);
+}
+
+void SendQueue::push(Payload payload, WireFormat format)
+{
+    push(std::move(payload), format, 0);
+}
+
+void SendQueue::push(Payload payload, WireFormat format, uint64_t receivedAt)
+{
+    Frame frame;
+    frame.receivedAt = receivedAt;
+    frameHeader(frame, payload, format);
+    bytesQueued_ += frame.headerSize + payload->length();
+    frame.payload = std::move(payload);
+    frames_.push_back(std::move(frame));
+}
+
+void SendQueue::pushFramed(Payload bytes)
+{
+    // Header travels inside the bytes
+    Frame frame;
+    frame.receivedAt = 0;
+    frame.headerSize = 0;
+    bytesQueued_ += bytes->length();
+    frame.payload = std::move(bytes);
+    frames_.push_back(std::move(frame));
+}
+
+bool SendQueue::pushLatest(const std::string& key, Payload payload, WireFormat format, uint64_t receivedAt, size_t keep)
+{
+    // Replace the older frame in place when nothing has read it yet
+    auto found = latest_.find(key);
+    if (found != latest_.end())
+    {
+        size_t position = static_cast<size_t>(found->second - popped_);
+        size_t locked = std::max(keep, offset_ > 0 ? size_t(1) : size_t(0));
+        if (position >= locked)
+        {
+            Frame& frame = frames_[position];
+            bytesQueued_ -= frame.headerSize + frame.payload->length();
+            frameHeader(frame, payload, format);
+            bytesQueued_ += frame.headerSize + payload->length();
+            frame.payload = std::move(payload);
+            frame.receivedAt = receivedAt;
+            return true;
+        }
+    }
+
+    push(std::move(payload), format, receivedAt);
+    frames_.back().key = key;
+    latest_[key] = popped_ + frames_.size() - 1;
+    return false;
+}
+
+size_t SendQueue::gather(IoVec* vecs, size_t max)
+{
+    size_t count = 0;
+    size_t skip = offset_;
+    for (auto frame = frames_.begin(); frame != frames_.end() && count < max; ++frame)
+    {
+        if (!frame->payload)
+            continue;
+        // Header, then payload, each trimmed by what was already sent
+        if (skip < frame->headerSize)
+            sock::setIoVec(vecs[count++], frame->header + skip, frame->headerSize - skip);
+        size_t payloadSkip = skip > frame->headerSize ? skip - frame->headerSize : 0;
+        if (count < max && payloadSkip < frame->payload->length())
+            sock::setIoVec(vecs[count++], frame->payload->data() + payloadSkip, frame->payload->length() - payloadSkip);
+        skip = 0;
+    }
+    return count;
+}
+
+void SendQueue::consume(size_t bytes)
+{
+    consume(bytes, nullptr);
+}
+
+size_t SendQueue::consume(size_t bytes, LatencyHistogram* latency)
+{
+    bytesQueued_ -= bytes;
+    size_t sent = 0;
+    uint64_t now = 0;
+    while (bytes > 0)
+    {
+        Frame& frame = frames_.front();
+        size_t remaining = frame.headerSize + frame.payload->length() - offset_;
+        if (bytes < remaining)
+        {
+            offset_ += bytes;
+            return sent;
+        }
+        // Clock is read at most once per send
+        if (latency && frame.receivedAt != 0)
+        {
+            if (now == 0)
+                now = MetricsRegistry::now();
+            latency->record(now > frame.receivedAt ? now - frame.receivedAt : 0);
+        }
+        bytes -= remaining;
+        offset_ = 0;
+        sent++;
+        popFront();
+        popDropped();
+    }
+    return sent;
+}
+
+const Payload& SendQueue::front()
+{
+    return frames_.front().payload;
+}
+
+size_t SendQueue::frontBytes()
+{
+    if (frames_.empty())
+        return 0;
+    Frame& frame = frames_.front();
+    return frame.headerSize + frame.payload->length() - offset_;
+}
+
+void SendQueue::copyUnsent(std::vector<std::string>& frames)
+{
+    size_t skip = offset_;
+    for (const Frame& frame : frames_)
+    {
+        if (!frame.payload)
+            continue;
+        std::string bytes;
+        bytes.reserve(frame.headerSize + frame.payload->length() - skip);
+        if (skip < frame.headerSize)
+            bytes.append(frame.header + skip, frame.headerSize - skip);
+        size_t payloadSkip = skip > frame.headerSize ? skip - frame.headerSize : 0;
+        bytes.append(*frame.payload, payloadSkip, std::string::npos);
+        frames.push_back(std::move(bytes));
+        skip = 0;
+    }
+}
+
+size_t SendQueue::dropOldest(size_t limit, size_t keep)
+{
+    // Partially sent front frame must finish or the stream loses its framing
+    size_t position = std::max(keep, offset_ > 0 ? size_t(1) : size_t(0));
+    size_t dropped = 0;
+    for (; position < frames_.size() && bytesQueued_ > limit; position++)
+    {
+        Frame& frame = frames_[position];
+        if (!frame.payload)
+            continue;
+        bytesQueued_ -= frame.headerSize + frame.payload->length();
+        frame.payload.reset();
+        if (!frame.key.empty())
+        {
+            auto found = latest_.find(frame.key);
+            if (found != latest_.end() && found->second == popped_ + position)
+                latest_.erase(found);
+        }
+        droppedFrames_++;
+        dropped++;
+    }
+    popDropped();
+    return dropped;
+}
+
+void SendQueue::moveTo(SendQueue& other, size_t keep)
+{
+    size_t kept = std::min(keep, frames_.size());
+    for (size_t position = 0; position < frames_.size(); position++)
+    {
+        Frame& frame = frames_[position];
+        if (!frame.payload)
+            continue;
+        bool newest = false;
+        if (!frame.key.empty())
+        {
+            // A message the other queue already holds under the key supersedes this one
+            if (other.latest_.count(frame.key) > 0)
+                continue;
+            auto found = latest_.find(frame.key);
+            newest = found != latest_.end() && found->second == popped_ + position;
+            if (newest)
+                other.latest_[frame.key] = other.popped_ + other.frames_.size();
+        }
+        // The other queue's stream has not seen any byte of the frame yet
+        other.bytesQueued_ += frame.headerSize + frame.payload->length();
+        other.frames_.push_back(position < kept ? frame : std::move(frame));
+        // Superseded keys would point the other queue at the wrong frame
+        if (!newest)
+            other.frames_.back().key.clear();
+    }
+
+    // Erasing at the back leaves the kept frames where a send may still read them
+    frames_.erase(frames_.begin() + kept, frames_.end());
+    latest_.clear();
+    droppedFrames_ = 0;
+    bytesQueued_ = 0;
+    for (const Frame& frame : frames_)
+    {
+        if (frame.payload)
+            bytesQueued_ += frame.headerSize + frame.payload->length();
+        else
+            droppedFrames_++;
+    }
+    bytesQueued_ -= frames_.empty() ? 0 : offset_;
+    if (frames_.empty())
+        offset_ = 0;
+}
+
+void SendQueue::popDropped()
+{
+    while (!frames_.empty() && !frames_.front().payload)
+    {
+        popFront();
+        droppedFrames_--;
+    }
+}
+
+void SendQueue::popFront()
+{
+    // A newer frame may already have taken over the key
+    Frame& frame = frames_.front();
+    if (!frame.key.empty())
+    {
+        auto found = latest_.find(frame.key);
+        if (found != latest_.end() && found->second == popped_)
+            latest_.erase(found);
+    }
+    frames_.pop_front();
+    popped_++;
+}
+
+void SendQueue::frameHeader(Frame& frame, const Payload& payload, WireFormat format)
+{
+    if (format == WireFormat::Text)
+    {
+        char* end = std::to_chars(frame.header, frame.header + sizeof(frame.header) - 1, payload->length()).ptr;
+        *end++ = '\r';
+        frame.headerSize = end - frame.header;
+    }
+    else
+    {
+        framing::writeBinaryHeader(frame.header, format, 0, static_cast<uint32_t>(payload->length()));
+        frame.headerSize = BINARY_HEADER_SIZE;
+    }
+}
+
+bool SendQueue::empty()
+{
+    return frames_.empty();
+}
+
+size_t SendQueue::bytesQueued()
+{
+    return bytesQueued_;
+}
+
+size_t SendQueue::numFrames()
+{
+    return frames_.size() - droppedFrames_;
+}
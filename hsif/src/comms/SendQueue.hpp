@@ -0,0 +1,215 @@
+#pragma once
+
+#include "Socket.hpp"
+#include "Framing.hpp"
+#include "Metrics.hpp"
+#include "SlabPool.hpp"
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Outgoing frames of an endpoint. Each frame pairs a small length header
+/// with a refcounted payload, so queueing never copies message bytes and the
+/// same payload can be queued on many endpoints. Frames are flushed straight
+/// from their payloads with scatter-gather sends; partially sent frames are
+/// tracked by offset.
+/// </summary>
+class SendQueue
+{
+public:
+	SendQueue();
+
+	/// <summary>
+	/// Queues a message framed as "<length>\r<payload>".
+	/// </summary>
+	/// <param name="payload">Message payload.</param>
+	void push(Payload payload);
+
+	/// <summary>
+	/// Queues a message framed for a wire format. Text payloads are framed as
+	/// "<length>\r<payload>", binary payloads behind a fixed BINARY_HEADER_SIZE header.
+	/// </summary>
+	/// <param name="payload">Message payload encoded in the given format.</param>
+	/// <param name="format">Payload encoding.</param>
+	void push(Payload payload, WireFormat format);
+
+	/// <summary>
+	/// Queues a message framed for a wire format, remembering when it was received
+	/// so the time until it is fully sent can be measured.
+	/// </summary>
+	/// <param name="payload">Message payload encoded in the given format.</param>
+	/// <param name="format">Payload encoding.</param>
+	/// <param name="receivedAt">MetricsRegistry::now() stamp of the original receive, 0 if unknown.</param>
+	void push(Payload payload, WireFormat format, uint64_t receivedAt);
+
+	/// <summary>
+	/// Queues bytes that already carry their frame header, as copied by copyUnsent().
+	/// </summary>
+	/// <param name="bytes">Framed message, or the rest of a partially sent one.</param>
+	void pushFramed(Payload bytes);
+
+	/// <summary>
+	/// Queues a message that supersedes any unsent message queued under the same key.
+	/// The newer payload takes the older frame's place, so at most one message per key
+	/// waits and queue depth is bounded by the number of keys rather than by message rate.
+	/// A partially sent frame or one of the first keep frames is never replaced; the
+	/// message is queued behind it instead.
+	/// </summary>
+	/// <param name="key">Conflation key.</param>
+	/// <param name="payload">Message payload encoded in the given format.</param>
+	/// <param name="format">Payload encoding.</param>
+	/// <param name="receivedAt">MetricsRegistry::now() stamp of the original receive, 0 if unknown.</param>
+	/// <param name="keep">Number of leading frames that must not be replaced.</param>
+	/// <returns>True if an older message was replaced.</returns>
+	bool pushLatest(const std::string& key, Payload payload, WireFormat format, uint64_t receivedAt, size_t keep);
+
+	/// <summary>
+	/// Fills scatter-gather elements with unsent bytes, starting at the first unsent byte.
+	/// </summary>
+	/// <param name="vecs">Elements to fill.</param>
+	/// <param name="max">Capacity of vecs.</param>
+	/// <returns>Number of elements filled.</returns>
+	size_t gather(IoVec* vecs, size_t max);
+
+	/// <summary>
+	/// Marks bytes as sent, releasing frames sent in full.
+	/// </summary>
+	/// <param name="bytes">Number of bytes the socket accepted.</param>
+	void consume(size_t bytes);
+
+	/// <summary>
+	/// Marks bytes as sent, releasing frames sent in full and recording the time
+	/// from receive to send of each stamped frame.
+	/// </summary>
+	/// <param name="bytes">Number of bytes the socket accepted.</param>
+	/// <param name="latency">Histogram receiving latencies, or null.</param>
+	/// <returns>Number of frames sent in full.</returns>
+	size_t consume(size_t bytes, LatencyHistogram* latency);
+
+	/// <summary>
+	/// Returns the payload of the front frame, for a receiver that takes whole
+	/// messages rather than bytes. Must only be called while frames are queued.
+	/// </summary>
+	/// <returns>Payload of the first frame with bytes to send.</returns>
+	const Payload& front();
+
+	/// <summary>
+	/// Returns number of unsent bytes of the front frame, headers included, so
+	/// consuming them releases exactly that frame.
+	/// </summary>
+	/// <returns>Unsent byte count of the first frame, 0 if nothing is queued.</returns>
+	size_t frontBytes();
+
+	/// <summary>
+	/// Copies the unsent bytes of every frame, headers included, the front frame
+	/// trimmed by what was already sent. Queueing them with pushFramed() continues
+	/// the byte stream exactly where this queue left it.
+	/// </summary>
+	/// <param name="frames">Receives one string per frame in send order.</param>
+	void copyUnsent(std::vector<std::string>& frames);
+
+	/// <summary>
+	/// Discards the oldest unsent frames until no more than a byte limit is queued.
+	/// Frames are released in place rather than erased, so frames already handed to
+	/// the kernel keep their addresses; a partially sent frame is never discarded.
+	/// </summary>
+	/// <param name="limit">Queued bytes to stay within.</param>
+	/// <param name="keep">Number of leading frames that must not be discarded.</param>
+	/// <returns>Number of frames discarded.</returns>
+	size_t dropOldest(size_t limit, size_t keep);
+
+	/// <summary>
+	/// Moves every unsent frame to the back of another queue, as when a connection
+	/// hands its stream over to another. Payloads move, they are not copied. A partially
+	/// sent front frame is sent again in full, since the other queue starts a new
+	/// byte stream, and a frame whose conflation key the other queue already holds is
+	/// superseded and left out. The first keep frames stay here as well, sharing their
+	/// payloads, so a send still reading them keeps valid addresses.
+	/// </summary>
+	/// <param name="other">Queue receiving the frames.</param>
+	/// <param name="keep">Number of leading frames that must stay in place.</param>
+	void moveTo(SendQueue& other, size_t keep);
+
+	/// <summary>
+	/// Returns whether every queued byte has been sent.
+	/// </summary>
+	/// <returns>True if nothing is waiting.</returns>
+	bool empty();
+
+	/// <summary>
+	/// Returns number of unsent bytes, headers included.
+	/// </summary>
+	/// <returns>Unsent byte count.</returns>
+	size_t bytesQueued();
+
+	/// <summary>
+	/// Returns number of frames not yet sent in full.
+	/// </summary>
+	/// <returns>Frame count.</returns>
+	size_t numFrames();
+
+private:
+	/// <summary>
+	/// Length header and payload of a queued message.
+	/// </summary>
+	struct Frame
+	{
+		char header[24];
+		size_t headerSize;
+		// Null once the frame has been discarded
+		Payload payload;
+		// Receive stamp, 0 if unknown
+		uint64_t receivedAt;
+		// Conflation key, empty unless queued by pushLatest()
+		std::string key;
+	};
+
+	/// <summary>
+	/// Writes a frame's length header for a payload.
+	/// </summary>
+	/// <param name="frame">Frame to fill.</param>
+	/// <param name="payload">Message payload.</param>
+	/// <param name="format">Payload encoding.</param>
+	static void frameHeader(Frame& frame, const Payload& payload, WireFormat format);
+
+	/// <summary>
+	/// Pops the front frame, forgetting its conflation key.
+	/// </summary>
+	void popFront();
+
+	/// <summary>
+	/// Pops discarded frames from the front so the front frame always has bytes to send.
+	/// </summary>
+	void popDropped();
+
+	// Frames in send order
+	std::deque<Frame, PoolAllocator<Frame>> frames_;
+	// Discarded frames still holding their position in frames_
+	size_t droppedFrames_;
+	// Bytes of the front frame already sent
+	size_t offset_;
+	// Unsent bytes across all frames
+	size_t bytesQueued_;
+	// Frames popped from the front since construction, so popped_ + position numbers a frame for good
+	uint64_t popped_;
+	// Number of the newest unsent frame queued under each conflation key
+	std::unordered_map<std::string, uint64_t> latest_;
+};
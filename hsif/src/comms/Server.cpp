@@ -1,6 +1,10 @@
 #include "Server.hpp"
+#include "ShardGroup.hpp"
 #include <iostream>
 #include <thread>
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
 
 /*
 Copyright 2020 Itreau Bigsby
@@ -21,93 +25,463 @@ limitations under the License.
 #define DEFAULT_PORT 8888
 #define DATA_BUFSIZE 1024
 
+// Largest datagram received, and largest payload sent as one datagram; bigger loss-tolerant messages go over TCP rather than fragment
+#define DATAGRAM_BUFSIZE 65536
+#define DATAGRAM_PAYLOAD_MAX 1200
+// Journal records a catch-up replay reads per poll, so one long replay cannot stall the loop
+#define JOURNAL_REPLAY_RECORDS 1024
+
+// io_uring sizing: submission entries and provided receive buffers
+#define URING_ENTRIES 1024
+#define URING_BUFFERS 1024
+#define URING_BUFFER_GROUP 0
+// Wait before re-arming an accept that failed for lack of descriptors or memory
+#define URING_ACCEPT_BACKOFF_NS 100000000
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#else
+#define IORING_CQE_F_BUFFER 0
+#define IORING_CQE_F_MORE 0
+#endif
+
+// io_uring user data layout: operation (4 bits) | connection token (28 bits) | socket (32 bits)
+enum UringOp : uint64_t
+{
+    URING_ACCEPT = 1,
+    URING_RECV = 2,
+    URING_SEND = 3,
+    URING_CANCEL = 4,
+    URING_TIMEOUT = 5,
+    URING_POLL = 6,
+    URING_SHARED_ACCEPT = 7,
+    URING_SHARED = 8,
+    URING_LOCAL = 9,
+    URING_ACCEPT_RETRY = 10
+};
+
+static uint64_t uringData(UringOp op, uint32_t token, SOCKET socket)
+{
+    return (static_cast<uint64_t>(op) << 60) | (static_cast<uint64_t>(token & 0x0FFFFFFF) << 32) | static_cast<uint32_t>(socket);
+}
+
+// Map key of a datagram peer address
+static std::string channelKey(const DatagramAddress& address)
+{
+    return std::string(reinterpret_cast<const char*>(&address.storage), address.length);
+}
+
+// True if message carries key as a string
+static bool hasString(const json& message, const char* key)
+{
+    auto field = message.find(key);
+    return field != message.end() && field->is_string();
+}
+
+// Creates the metrics a server updates
+static ServerMetrics createMetrics(MetricsRegistry& registry)
+{
+    ServerMetrics metrics;
+    metrics.polls = registry.counter("hsif_polls_total", "Poll cycles completed.");
+    metrics.syscalls = registry.counter("hsif_syscalls_total", "Socket and readiness syscalls issued.");
+    metrics.messagesRouted = registry.counter("hsif_messages_routed_total", "Messages queued on a destination endpoint.");
+    metrics.messagesPublished = registry.counter("hsif_messages_published_total", "Publish messages fanned out to subscribers.");
+    metrics.messagesForwarded = registry.counter("hsif_messages_forwarded_total", "Messages handed to the shard owning their destination.");
+    metrics.messagesParked = registry.counter("hsif_messages_parked_total", "Messages parked for an unregistered destination.");
+    metrics.messagesExpired = registry.counter("hsif_messages_expired_total", "Parked messages discarded after their TTL.");
+    metrics.messagesDropped = registry.counter("hsif_messages_dropped_total", "Messages discarded because a parked queue was full.");
+    metrics.messagesMalformed = registry.counter("hsif_messages_malformed_total", "Frames dropped, with their sender, because they could not be decoded or lacked a required field.");
+    metrics.senderPauses = registry.counter("hsif_sender_pauses_total", "Times a sender was paused by a pressured receiver.");
+    metrics.overflowDrops = registry.counter("hsif_overflow_drops_total", "Queued frames discarded under the drop-oldest policy.");
+    metrics.overflowDisconnects = registry.counter("hsif_overflow_disconnects_total", "Receivers disconnected under the disconnect policy.");
+    metrics.statsRequests = registry.counter("hsif_stats_requests_total", "Stats request messages answered.");
+    metrics.batchesRouted = registry.counter("hsif_batches_routed_total", "Batch messages split and routed.");
+    metrics.coalescedWrites = registry.counter("hsif_coalesced_writes_total", "Held writes released by their coalescing window or byte budget.");
+    metrics.messagesConflated = registry.counter("hsif_conflated_messages_total", "Undelivered messages replaced by a newer message with the same conflation key.");
+    metrics.datagramsIn = registry.counter("hsif_datagrams_in_total", "Datagrams routed from linked channels.");
+    metrics.datagramsOut = registry.counter("hsif_datagrams_out_total", "Datagrams sent to linked channels.");
+    metrics.datagramsDropped = registry.counter("hsif_datagrams_dropped_total", "Datagrams discarded as malformed, stale, unlinked or not accepted by the socket.");
+    metrics.messagesJournaled = registry.counter("hsif_messages_journaled_total", "Routed messages appended to the journal.");
+    metrics.journalSyncs = registry.counter("hsif_journal_syncs_total", "Group commits syncing journaled messages to disk.");
+    metrics.messagesReplayed = registry.counter("hsif_messages_replayed_total", "Journaled messages delivered by catch-up replays.");
+    metrics.sessionsResumed = registry.counter("hsif_sessions_resumed_total", "Sessions taken over by a reconnecting client.");
+    metrics.sessionsExpired = registry.counter("hsif_sessions_expired_total", "Disconnected sessions dropped after their grace period.");
+    metrics.endpoints = registry.gauge("hsif_endpoints", "Connected endpoints.");
+    metrics.registeredEndpoints = registry.gauge("hsif_registered_endpoints", "Endpoints with a registered identifier.");
+    metrics.parkedMessages = registry.gauge("hsif_parked_messages", "Messages waiting for their destination to register.");
+    metrics.detachedSessions = registry.gauge("hsif_detached_sessions", "Disconnected sessions waiting to be resumed.");
+    metrics.poolSlabBytes = registry.gauge("hsif_pool_slab_bytes", "Bytes of slabs the allocator pool obtained from the system.");
+    metrics.poolHugeSlabs = registry.gauge("hsif_pool_huge_slabs", "Allocator pool slabs backed by huge pages.");
+    metrics.poolOversized = registry.counter("hsif_pool_oversized_total", "Allocations too large for the pool, passed to the heap.");
+    metrics.payloadBuffers = registry.counter("hsif_payload_buffers_total", "Payload buffers allocated because none could be recycled.");
+    metrics.pressuredEndpoints = registry.gauge("hsif_pressured_endpoints", "Endpoints above their high watermark.");
+    metrics.pausedSenders = registry.gauge("hsif_paused_senders", "Senders paused by a pressured receiver.");
+    metrics.deliveryLatency = registry.histogram("hsif_delivery_latency_seconds", "Time from receiving a message to writing it in full to its receiver.");
+    return metrics;
+}
+
+// Builds the reply to a stats request, durations in nanoseconds
+static json statsDocument(const MetricsSnapshot& snapshot, const std::string& to)
+{
+    json counters = json::object();
+    for (const MetricSample& counter : snapshot.counters)
+        counters[counter.name] = counter.value;
+    json gauges = json::object();
+    for (const MetricSample& gauge : snapshot.gauges)
+        gauges[gauge.name] = gauge.value;
+    json latency = json::object();
+    for (const HistogramSnapshot& histogram : snapshot.histograms)
+    {
+        latency[histogram.name] = {
+            { "count", histogram.count },
+            { "sumNs", histogram.sum },
+            { "maxNs", histogram.max },
+            { "p50Ns", histogram.percentile(0.5) },
+            { "p90Ns", histogram.percentile(0.9) },
+            { "p99Ns", histogram.percentile(0.99) },
+            { "p999Ns", histogram.percentile(0.999) }
+        };
+    }
+    json endpoints = json::array();
+    for (const EndpointSample& endpoint : snapshot.endpoints)
+    {
+        endpoints.push_back({
+            { "id", endpoint.id },
+            { "bytesIn", endpoint.bytesIn },
+            { "bytesOut", endpoint.bytesOut },
+            { "messagesIn", endpoint.messagesIn },
+            { "messagesOut", endpoint.messagesOut },
+            { "queuedBytes", endpoint.queuedBytes },
+            { "queuedMessages", endpoint.queuedMessages }
+        });
+    }
+    return {
+        { "type", "stats" },
+        { "from", "hsif" },
+        { "to", to },
+        { "value", { { "counters", counters }, { "gauges", gauges }, { "latency", latency }, { "endpoints", endpoints } } }
+    };
+}
+
+// Builds the message leading a session's stream, resume counts the frames the session was sent before it.
+// Session messages conflate, so one the old connection never sent is superseded rather than moved.
+static WireMessage sessionMessage(const std::string& to, uint64_t resume, bool resumed)
+{
+    WireMessage wire(json{ { "type", "session" }, { "from", "hsif" }, { "to", to }, { "key", "session" }, { "resume", resume }, { "resumed", resumed } });
+    wire.conflate = true;
+    return wire;
+}
+
 Server::Server() :
-    ip_(""),
-    port_(DEFAULT_PORT),
-    logger_(std::make_shared<Logger>()),
-    logToFile_(false),
-    listenSocket_(INVALID_SOCKET)
+    Server("", DEFAULT_PORT, std::make_shared<Logger>(), false)
 {}
 
 Server::Server(std::string ip, unsigned int port, std::shared_ptr<Logger> logger, bool logToFile) :
-    ip_(ip),
+    Server(std::move(ip), port, std::move(logger), logToFile, PollBackend::Select)
+{}
+
+Server::Server(std::string ip, unsigned int port, std::shared_ptr<Logger> logger, bool logToFile, PollBackend backend) :
     port_(port),
-    logger_(logger),
+    ip_(std::move(ip)),
+    logger_(std::move(logger)),
     logToFile_(logToFile),
-    listenSocket_(INVALID_SOCKET)
+    backend_(backend),
+    metrics_(std::make_shared<MetricsRegistry>()),
+    instruments_(createMetrics(*metrics_))
 {}
 
 bool Server::connect()
 {
-    // Initialize WSA library
-    WSADATA wsaData;
+    // Initialize socket library
     int wsaRet;
-    if ((wsaRet = (WSAStartup(0x0202, &wsaData))) != 0)
+    if ((wsaRet = sock::startup()) != 0)
     {
-        logger_->logMsg("WSAStartup() failed with error: " + wsaRet, logToFile_);
-        WSACleanup();
+        LOG_ERROR(logger_, logToFile_, "WSAStartup() failed with error: " + std::to_string(wsaRet));
+        sock::teardown();
         return false;
     }
     else
-        logger_->logMsg("WSAStartup() successful", logToFile_);
+        LOG_INFO(logger_, logToFile_, "WSAStartup() successful");
 
     // Initialize server socket
-    if ((listenSocket_ = WSASocket(AF_INET, SOCK_STREAM, 0, NULL, 0, WSA_FLAG_OVERLAPPED)) == INVALID_SOCKET)
+    if ((listenSocket_ = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
     {
-        logger_->logMsg("WSASocket() failed with error: " + WSAGetLastError(), logToFile_);
-        WSACleanup();
+        LOG_ERROR(logger_, logToFile_, "socket() failed with error: " + std::to_string(sock::lastError()));
+        sock::teardown();
         return false;
     }
     else
-        logger_->logMsg("Listener socket initialization successful", logToFile_);
+        LOG_INFO(logger_, logToFile_, "Listener socket initialization successful");
+
+    // Allow quick restarts while old connections linger in TIME_WAIT
+    sock::setReuseAddress(listenSocket_);
+
+    // Shards share the port and let the kernel balance connections between them
+    if (shardGroup_ && !sock::setReusePort(listenSocket_))
+    {
+        LOG_ERROR(logger_, logToFile_, "setsockopt(SO_REUSEPORT) failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
 
     // Create socket information object
-    SOCKADDR_IN InternetAddr;
+    sockaddr_in InternetAddr = {};
     InternetAddr.sin_family = AF_INET;
     InternetAddr.sin_addr.s_addr = htonl(INADDR_ANY);
     InternetAddr.sin_port = htons(port_);
 
     // Bind socket to given address/port
-    if (bind(listenSocket_, (PSOCKADDR)&InternetAddr, sizeof(InternetAddr)) == SOCKET_ERROR)
+    if (bind(listenSocket_, (sockaddr*)&InternetAddr, sizeof(InternetAddr)) == SOCKET_ERROR)
     {
-        logger_->logMsg("bind() failed with error: " + WSAGetLastError(), logToFile_);
+        LOG_ERROR(logger_, logToFile_, "bind() failed with error: " + std::to_string(sock::lastError()));
         return false;
     }
     else
-        logger_->logMsg("Socket bind successful", logToFile_);
+        LOG_INFO(logger_, logToFile_, "Socket bind successful");
 
     // Initialize listener on socket
-    if (listen(listenSocket_, 5))
+    if (listen(listenSocket_, SOMAXCONN))
     {
-        logger_->logMsg("listen() failed with error: " + WSAGetLastError(), logToFile_);
+        LOG_ERROR(logger_, logToFile_, "listen() failed with error: " + std::to_string(sock::lastError()));
         return false;
     }
     else
-        logger_->logMsg("listen() on port " + std::to_string(port_) + " successful", logToFile_);
+        LOG_INFO(logger_, logToFile_, "listen() on port " + std::to_string(port_) + " successful");
 
     // Set non-blocking
-    ULONG nonBlock = 1;
-    if (ioctlsocket(listenSocket_, FIONBIO, &nonBlock) == SOCKET_ERROR)
+    if (!sock::setNonBlocking(listenSocket_))
     {
-        logger_->logMsg("Ioctlsocket() failed with error: " + WSAGetLastError(), logToFile_);
+        LOG_ERROR(logger_, logToFile_, "Ioctlsocket() failed with error: " + std::to_string(sock::lastError()));
         return false;
     }
     else
-        logger_->logMsg("Non-Blocking listener setup successful", logToFile_);
+        LOG_INFO(logger_, logToFile_, "Non-Blocking listener setup successful");
+
+    return connectServices();
+}
+
+bool Server::connectServices()
+{
+    // Register listener with reactor if using epoll
+    if (backend_ == PollBackend::Epoll)
+    {
+        reactor_ = std::make_unique<EpollReactor>();
+        if (!reactor_->init() || !reactor_->add(listenSocket_, false))
+        {
+            LOG_ERROR(logger_, logToFile_, "Epoll reactor initialization failed with error: " + std::to_string(sock::lastError()));
+            return false;
+        }
+        else
+            LOG_INFO(logger_, logToFile_, "Epoll reactor initialization successful");
+
+        // Watch for messages routed here by other shards
+        if (shardGroup_ && !reactor_->add(shardGroup_->wakeHandle(shardIndex_), false))
+        {
+            LOG_ERROR(logger_, logToFile_, "Shard wakeup registration failed with error: " + std::to_string(sock::lastError()));
+            return false;
+        }
+    }
+
+    // Create ring, register receive buffers and begin accepting if using io_uring
+    if (backend_ == PollBackend::Uring)
+    {
+        ring_ = std::make_unique<IoUring>();
+        if (!ring_->init(URING_ENTRIES) || !ring_->setupBufferRing(URING_BUFFER_GROUP, URING_BUFFERS, PACKET_SIZE))
+        {
+            LOG_ERROR(logger_, logToFile_, "io_uring initialization failed with error: " + std::to_string(sock::lastError()));
+            return false;
+        }
+        else
+            LOG_INFO(logger_, logToFile_, "io_uring initialization successful");
+        ring_->prepMultishotAccept(listenSocket_, uringData(URING_ACCEPT, 0, listenSocket_));
+    }
+
+    // Open datagram listener if requested
+    if (datagramPort_ != 0 && !connectDatagrams())
+        return false;
+
+    // Open shared-memory listener if requested
+    if (!sharedPath_.empty() && !connectShared())
+        return false;
+
+    // Watch for in-process clients and for wakeups from other threads
+    if (!connectLocalHub() && localEnabled_)
+        return false;
+
+    // Accept a successor process if requested
+    if (!upgradePath_.empty() && !connectUpgrade())
+        return false;
 
     // Return successful initialization
     return true;
 }
 
+bool Server::connectDatagrams()
+{
+    // A socket handed over by the previous server is already bound
+    if (datagramSocket_ == INVALID_SOCKET)
+    {
+        if ((datagramSocket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == INVALID_SOCKET)
+        {
+            LOG_ERROR(logger_, logToFile_, "Datagram socket() failed with error: " + std::to_string(sock::lastError()));
+            return false;
+        }
+
+        sockaddr_in datagramAddr = {};
+        datagramAddr.sin_family = AF_INET;
+        datagramAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+        datagramAddr.sin_port = htons(datagramPort_);
+        if (bind(datagramSocket_, (sockaddr*)&datagramAddr, sizeof(datagramAddr)) == SOCKET_ERROR || !sock::setNonBlocking(datagramSocket_))
+        {
+            LOG_ERROR(logger_, logToFile_, "Datagram bind() failed with error: " + std::to_string(sock::lastError()));
+            return false;
+        }
+    }
+    datagramBuffer_.resize(DATAGRAM_BUFSIZE);
+
+    // Readiness backends watch the socket, io_uring reports readability and the socket is drained directly
+    if (reactor_ && !reactor_->add(datagramSocket_, false))
+    {
+        LOG_ERROR(logger_, logToFile_, "Datagram reactor registration failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    if (ring_)
+        ring_->prepMultishotPoll(datagramSocket_, uringData(URING_POLL, 0, datagramSocket_));
+    LOG_INFO(logger_, logToFile_, "Datagram listener on port " + std::to_string(datagramPort_) + " successful");
+    return true;
+}
+
+bool Server::connectShared()
+{
+    if ((sharedListenSocket_ = sock::listenLocal(sharedPath_)) == INVALID_SOCKET)
+    {
+        LOG_ERROR(logger_, logToFile_, "Shared-memory listener on " + sharedPath_ + " failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    if (reactor_ && !reactor_->add(sharedListenSocket_, false))
+    {
+        LOG_ERROR(logger_, logToFile_, "Shared-memory listener registration failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    if (ring_)
+        ring_->prepMultishotAccept(sharedListenSocket_, uringData(URING_SHARED_ACCEPT, 0, sharedListenSocket_));
+    LOG_INFO(logger_, logToFile_, "Shared-memory listener on " + sharedPath_ + " successful");
+    return true;
+}
+
+bool Server::connectLocalHub()
+{
+    localHub_ = std::make_shared<LocalHub>();
+    if (!localHub_->open())
+    {
+        // Without an eventfd the server still runs, only wake() is unavailable
+        if (localEnabled_)
+            LOG_ERROR(logger_, logToFile_, "In-process wakeup creation failed with error: " + std::to_string(sock::lastError()));
+        localHub_.reset();
+        return false;
+    }
+    SOCKET bell = localHub_->handle();
+    if (reactor_ && !reactor_->add(bell, false))
+    {
+        LOG_ERROR(logger_, logToFile_, "In-process wakeup registration failed with error: " + std::to_string(sock::lastError()));
+        localHub_.reset();
+        return false;
+    }
+    if (ring_)
+        ring_->prepMultishotPoll(bell, uringData(URING_LOCAL, 0, bell));
+    if (localEnabled_)
+        LOG_INFO(logger_, logToFile_, "In-process endpoints enabled");
+    return true;
+}
+
+bool Server::connectUpgrade()
+{
+    // Completions in flight cannot follow their sockets, and shards share their listener with each other
+    if (ring_ || shardGroup_)
+    {
+        LOG_ERROR(logger_, logToFile_, "Hand-off to a successor requires an unsharded select or epoll server");
+        return false;
+    }
+    if ((upgradeListenSocket_ = sock::listenLocal(upgradePath_)) == INVALID_SOCKET)
+    {
+        LOG_ERROR(logger_, logToFile_, "Upgrade listener on " + upgradePath_ + " failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    if (reactor_ && !reactor_->add(upgradeListenSocket_, false))
+    {
+        LOG_ERROR(logger_, logToFile_, "Upgrade listener registration failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    LOG_INFO(logger_, logToFile_, "Upgrade listener on " + upgradePath_ + " successful");
+    return true;
+}
+
 bool Server::poll()
+{
+    // Connections handed to a successor are no longer served here
+    if (handedOff_)
+        return false;
+    bool success;
+    if (backend_ == PollBackend::Epoll)
+        success = pollEpoll();
+    else if (backend_ == PollBackend::Uring)
+        success = pollUring();
+    else
+        success = pollSelect();
+    instruments_.polls->inc();
+    updateMetrics();
+    return success && !handedOff_;
+}
+
+void Server::updateMetrics()
+{
+    // Counters owned by this thread are mirrored rather than updated twice on hot paths
+    ServerStats current = stats();
+    instruments_.syscalls->set(current.syscalls);
+    instruments_.messagesRouted->set(current.messagesRouted);
+    instruments_.messagesPublished->set(current.messagesPublished);
+    instruments_.messagesParked->set(current.messagesParked);
+    instruments_.messagesExpired->set(current.messagesExpired);
+    instruments_.messagesDropped->set(current.messagesDropped);
+    instruments_.messagesMalformed->set(current.messagesMalformed);
+    instruments_.senderPauses->set(current.senderPauses);
+    instruments_.overflowDrops->set(current.overflowDrops);
+    instruments_.overflowDisconnects->set(current.overflowDisconnects);
+    instruments_.batchesRouted->set(current.batchesRouted);
+    instruments_.coalescedWrites->set(current.coalescedWrites);
+    instruments_.messagesConflated->set(current.messagesConflated);
+    instruments_.datagramsIn->set(current.datagramsIn);
+    instruments_.datagramsOut->set(current.datagramsOut);
+    instruments_.datagramsDropped->set(current.datagramsDropped);
+    instruments_.messagesJournaled->set(current.messagesJournaled);
+    instruments_.journalSyncs->set(current.journalSyncs);
+    instruments_.messagesReplayed->set(current.messagesReplayed);
+    instruments_.sessionsResumed->set(current.sessionsResumed);
+    instruments_.sessionsExpired->set(current.sessionsExpired);
+    instruments_.pressuredEndpoints->set(current.pressuredEndpoints);
+    instruments_.pausedSenders->set(current.pausedSenders);
+    instruments_.endpoints->set(endpoints_.size());
+    instruments_.registeredEndpoints->set(endpointMap_.size());
+    instruments_.parkedMessages->set(parked_.size());
+    instruments_.detachedSessions->set(sessions_.size());
+
+    // Shards share the pools, so one reports them rather than every shard adding the same amounts
+    if (!shardGroup_ || shardIndex_ == 0)
+    {
+        SlabStats pool = SlabPool::shared().stats();
+        instruments_.poolSlabBytes->set(pool.slabBytes);
+        instruments_.poolHugeSlabs->set(pool.hugeSlabs);
+        instruments_.poolOversized->set(pool.oversized);
+        instruments_.payloadBuffers->set(framing::payloadBuffers());
+    }
+}
+
+bool Server::pollSelect()
 {
     // Initialize local variables
     int total;
     SOCKET acceptSocket = INVALID_SOCKET;
-    DWORD sendBytes;
-    DWORD recvBytes;
-    FD_SET readSet;
-    FD_SET writeSet;
+    fd_set readSet;
+    fd_set writeSet;
 
     // Prepare the Read and Write socket sets for network I/O notification
     FD_ZERO(&readSet);
@@ -115,249 +489,2721 @@ bool Server::poll()
 
     // Always allow reading from sockets
     FD_SET(listenSocket_, &readSet);
+    SOCKET maxSocket = listenSocket_;
+    if (datagramSocket_ != INVALID_SOCKET)
+    {
+        FD_SET(datagramSocket_, &readSet);
+        if (datagramSocket_ > maxSocket)
+            maxSocket = datagramSocket_;
+    }
+    if (sharedListenSocket_ != INVALID_SOCKET)
+    {
+        FD_SET(sharedListenSocket_, &readSet);
+        if (sharedListenSocket_ > maxSocket)
+            maxSocket = sharedListenSocket_;
+    }
+    if (localHub_)
+    {
+        FD_SET(localHub_->handle(), &readSet);
+        if (localHub_->handle() > maxSocket)
+            maxSocket = localHub_->handle();
+    }
+    if (upgradeListenSocket_ != INVALID_SOCKET)
+    {
+        FD_SET(upgradeListenSocket_, &readSet);
+        if (upgradeListenSocket_ > maxSocket)
+            maxSocket = upgradeListenSocket_;
+    }
 
     // If data available in endpoint outboxes, add to write set
     for (const std::shared_ptr<Endpoint>& endpoint : endpoints_)
     {
-        if (endpoint->contentSize > 0)
+        // In-process endpoints have no socket, their clients ring the hub instead
+        if (endpoint->local)
+            continue;
+        // Shared-memory endpoints are written directly and read when their doorbell rings
+        if (endpoint->shared)
+        {
+            FD_SET(endpoint->socket, &readSet);
+            FD_SET(endpoint->shared->bell(), &readSet);
+            maxSocket = std::max({ maxSocket, endpoint->socket, endpoint->shared->bell() });
+            continue;
+        }
+        if (!endpoint->outbound.empty() && endpoint->flushDeadline == 0)
             FD_SET(endpoint->socket, &writeSet);
-        else
+        // Senders blocked by a pressured receiver are not read from
+        else if (endpoint->blockedOn == 0)
             FD_SET(endpoint->socket, &readSet);
+        if (endpoint->socket > maxSocket)
+            maxSocket = endpoint->socket;
     }
 
-    // Block unless change on sockets
-    if ((total = select(0, &readSet, &writeSet, NULL, NULL)) == SOCKET_ERROR)
+    // Block unless change on sockets or a held write comes due (first argument ignored by winsock)
+    int64_t holdNs = holdTimeout();
+    timeval timeout = { static_cast<long>(holdNs / 1000000000), static_cast<long>((holdNs % 1000000000 + 999) / 1000) };
+    stats_.syscalls++;
+    if ((total = select(static_cast<int>(maxSocket) + 1, &readSet, &writeSet, NULL, holdNs < 0 ? NULL : &timeout)) == SOCKET_ERROR)
     {
-        logger_->logMsg("Select() returned with error: " + WSAGetLastError(), logToFile_);
+        LOG_ERROR(logger_, logToFile_, "Select() returned with error: " + std::to_string(sock::lastError()));
         return false;
     }
     else
-        logger_->logMsg("Poll on endpoint successful", logToFile_);
+        LOG_DEBUG(logger_, logToFile_, "Poll on endpoint successful");
 
     // Check for new connections on listening socket
     if (FD_ISSET(listenSocket_, &readSet))
     {
         // Attempt to create endpoint from new socket
         total--;
+        stats_.syscalls++;
         if ((acceptSocket = accept(listenSocket_, NULL, NULL)) != INVALID_SOCKET)
         {
-            ULONG nonBlock = 1;
-            if (ioctlsocket(acceptSocket, FIONBIO, &nonBlock) == SOCKET_ERROR)
+            if (!sock::setNonBlocking(acceptSocket))
             {
-                logger_->logMsg("Ioctlsocket(FIONBIO) failed with error: " + WSAGetLastError(), logToFile_);
-                return false;
+                LOG_ERROR(logger_, logToFile_, "Ioctlsocket(FIONBIO) failed with error: " + std::to_string(sock::lastError()));
+                sock::close(acceptSocket);
             }
-            else
-                logger_->logMsg("Non-blocking client socket initialized", logToFile_);
-
-            // Create endpoint
-            if (createEndpoint(acceptSocket) == false)
+            // Create endpoint, a socket select() cannot watch is refused without stopping the server
+            else if (createEndpoint(acceptSocket) == false)
             {
-                logger_->logMsg("CreateSocketInformation(AcceptSocket) failed", logToFile_);
-                return false;
+                LOG_ERROR(logger_, logToFile_, "CreateSocketInformation(AcceptSocket) failed");
+                sock::close(acceptSocket);
             }
             else
-                logger_->logMsg("Endpoint created successfully!", logToFile_);
+                LOG_INFO(logger_, logToFile_, "Endpoint created successfully!");
         }
         // If blocking exception, catch
         else
         {
-            // Log error
-            if (WSAGetLastError() != WSAEWOULDBLOCK)
-            {
-                logger_->logMsg("accept() failed with error: " + WSAGetLastError(), logToFile_);
-                return false;
-            }
+            // Log error, aborted handshakes and exhausted descriptors only cost this round's connection
+            if (!sock::wouldBlock(sock::lastError()))
+                LOG_WARNING(logger_, logToFile_, "accept() failed with error: " + std::to_string(sock::lastError()));
             // Continue if accept
             else
-                logger_->logMsg("Accept successful", logToFile_);
+                LOG_DEBUG(logger_, logToFile_, "Accept successful");
         }
     }
 
-    // Loop through each endpoint in the vector (using for loop so we can use index)
-    for (size_t index = 0; index < endpoints_.size(); index++)
+    // Route datagrams before endpoint I/O so their deliveries go out this poll
+    if (datagramSocket_ != INVALID_SOCKET && FD_ISSET(datagramSocket_, &readSet))
+        readDatagrams();
+
+    // Check for shared-memory clients
+    if (sharedListenSocket_ != INVALID_SOCKET && FD_ISSET(sharedListenSocket_, &readSet))
+        acceptShared();
+
+    // Check for in-process clients
+    if (localHub_ && FD_ISSET(localHub_->handle(), &readSet))
+        serviceLocal();
+
+    // Visit endpoints in dense order. Removing an endpoint moves the last one into
+    // its position, which is then visited in turn instead of being skipped.
+    for (size_t position = 0; position < endpoints_.size();)
     {
-        // If flagged for reading incoming data, process incoming packet
-        if (FD_ISSET(endpoints_[index]->socket, &readSet))
-        {
-            total--;
+        if (serviceEndpoint(endpoints_.handleAt(position), readSet, writeSet))
+            position++;
+    }
+    serviceReplay();
+    serviceHeld();
+    serviceOverflow();
+    serviceParked();
+    serviceSessions();
+    serviceJournal();
 
-            // Set WSA buffer values
-            endpoints_[index]->buff.buf = endpoints_[index]->recvBuffer;
-            endpoints_[index]->buff.len = 1024;
+    // Hand off last, once this poll's deliveries are queued
+    if (upgradeListenSocket_ != INVALID_SOCKET && FD_ISSET(upgradeListenSocket_, &readSet))
+        acceptSuccessor();
+    return true;
+}
 
-            // Write data to buffer
-            DWORD flags = 0;
-            if (WSARecv(endpoints_[index]->socket, &(endpoints_[index]->buff), 1, &recvBytes, &flags, NULL, NULL) == SOCKET_ERROR)
-            {
-                // If blocking exception, delete endpoint
-                if (WSAGetLastError() != WSAEWOULDBLOCK)
-                {
-                    logger_->logMsg("WSARecv() failed with error: " + WSAGetLastError(), logToFile_);
-                    deleteEndpoint(index);
-                }
-                // Otherwise continue...
-                else
-                    logger_->logMsg("Packet received from endpoint successfully", logToFile_);
-                continue;
-            }
-            else
-            {
-                // Log bytes recieved
-                endpoints_[index]->bytesRecv = recvBytes;
+bool Server::serviceEndpoint(EndpointHandle handle, fd_set& readSet, fd_set& writeSet)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    int sendBytes;
+    int recvBytes;
 
-                // Process packet recieved
-                bool success = endpoints_[index]->processRecv();
+    // In-process endpoints are serviced when their client rings the hub
+    if (endpoint->local)
+        return true;
 
-                // If zero bytes are received, or unsuccessful parsing, close the connection
-                if (recvBytes == 0 || !success)
-                {
-                    deleteEndpoint(index);
-                    continue;
-                }
-            }
-        }
+    // Shared-memory endpoints only need service once their socket or doorbell is ready
+    if (endpoint->shared)
+    {
+        if (FD_ISSET(endpoint->socket, &readSet))
+            return serviceShared(handle, endpoint->socket);
+        if (FD_ISSET(endpoint->shared->bell(), &readSet))
+            return serviceShared(handle, endpoint->shared->bell());
+        return true;
+    }
 
-        // Check for outgoing messages
-        int size = endpoints_[index]->outbox.size();
-        // While messages available for routing, route and continue.
-        while (size > 0)
+    // If flagged for reading incoming data, process incoming packet
+    if (FD_ISSET(endpoint->socket, &readSet))
+    {
+        // Write data to buffer
+        stats_.syscalls++;
+        if ((recvBytes = sock::recv(endpoint->socket, endpoint->recvBuffer, PACKET_SIZE)) == SOCKET_ERROR)
         {
-            std::string currentMsg = endpoints_[index]->outbox.front();
-            endpoints_[index]->outbox.pop();
-            routeMessage(currentMsg, index);
-            size--;
+            // If blocking exception, delete endpoint
+            if (!sock::wouldBlock(sock::lastError()))
+            {
+                LOG_ERROR(logger_, logToFile_, "WSARecv() failed with error: " + std::to_string(sock::lastError()));
+                deleteEndpoint(handle);
+                return false;
+            }
+            // Otherwise continue...
+            LOG_DEBUG(logger_, logToFile_, "Packet received from endpoint successfully");
+            return true;
         }
-
-        // If messages available to write, send packet
-        if (FD_ISSET(endpoints_[index]->socket, &writeSet))
+        else
         {
-            total--;
+            // Log bytes recieved
+            endpoint->bytesRecv = recvBytes;
 
-            // Set WSA buffer values
-            endpoints_[index]->buff.buf = endpoints_[index]->sendBuffer + endpoints_[index]->bytesSent;
-            endpoints_[index]->buff.len = endpoints_[index]->contentSize - endpoints_[index]->bytesSent;
+            // Process packet recieved
+            bool success = endpoint->processRecv();
 
-            // Write data to outgoing socket
-            if (WSASend(endpoints_[index]->socket, &(endpoints_[index]->buff), 1, &sendBytes, 0, NULL, NULL) == SOCKET_ERROR)
+            // If zero bytes are received, or unsuccessful parsing, close the connection
+            if (recvBytes == 0 || !success)
             {
-                // If blocking exception, log and remove endpoint
-                if (WSAGetLastError() != WSAEWOULDBLOCK)
-                {
-                    logger_->logMsg("WSASend() failed with error: " + WSAGetLastError(), logToFile_);
-                    deleteEndpoint(index);
-                }
-                // Otherwise, continue
-                else
-                    logger_->logMsg("Packet sent from endpoint successfully", logToFile_);
-                continue;
+                deleteEndpoint(handle);
+                return false;
             }
-            else
+        }
+    }
+
+    // Route frames parsed from this cycle's packet
+    if (!routeOutbox(handle))
+        return false;
+
+    // If messages available to write, send packet
+    if (FD_ISSET(endpoint->socket, &writeSet))
+    {
+        // Write queued frames to outgoing socket
+        if ((sendBytes = sendOutbound(endpoint)) == SOCKET_ERROR)
+        {
+            // If blocking exception, log and remove endpoint
+            if (!sock::wouldBlock(sock::lastError()))
             {
-                // Log sent bytes
-                endpoints_[index]->bytesSent += sendBytes;
-                    
-                // If all bytes sent, clear buffer
-                if (endpoints_[index]->bytesSent == endpoints_[index]->contentSize)
-                    endpoints_[index]->bufferReady();
+                LOG_ERROR(logger_, logToFile_, "WSASend() failed with error: " + std::to_string(sock::lastError()));
+                deleteEndpoint(handle);
+                return false;
             }
+            // Otherwise, continue
+            LOG_DEBUG(logger_, logToFile_, "Packet sent from endpoint successfully");
         }
+        relievePressure(endpoint);
     }
-}
-
-bool Server::createEndpoint(SOCKET clientSocket)
-{
-    // Create shared pointer to endpoint and add to endpoint buffer
-    auto socketInfo = std::make_shared<Endpoint>(clientSocket);
-    endpoints_.push_back(socketInfo);
     return true;
 }
 
-bool Server::registerEndpoint(std::string id, size_t index)
+bool Server::pollEpoll()
 {
-    // Attempt to register endpoint with identifier
-    auto ret = endpointMap_.insert({ id, index });
-    // If failure, return
-    if (ret.second == false)
+    // Block until at least one registered socket changes state or a held write comes due
+    int64_t holdNs = holdTimeout();
+    stats_.syscalls++;
+    if (reactor_->wait(readyEvents_, holdNs < 0 ? -1 : static_cast<int>((holdNs + 999999) / 1000000)) == -1)
     {
+        LOG_ERROR(logger_, logToFile_, "epoll_wait() returned with error: " + std::to_string(sock::lastError()));
         return false;
     }
-    // If successful, set endpoint id value and log success message
-    else
+    bool successor = false;
+
+    // Only sockets reported ready are visited
+    for (const ReactorEvent& event : readyEvents_)
     {
-        endpoints_[index]->id = id;
-        logger_->logMsg("Endpoint registered successfully: " + id, logToFile_);
-        return true;
+        // Check for new connections on listening socket
+        if (event.socket == listenSocket_)
+        {
+            if (!acceptConnections())
+                return false;
+            continue;
+        }
+
+        // Check for datagrams
+        if (event.socket == datagramSocket_)
+        {
+            readDatagrams();
+            continue;
+        }
+
+        // Check for shared-memory clients
+        if (event.socket == sharedListenSocket_)
+        {
+            acceptShared();
+            continue;
+        }
+
+        // Check for in-process clients
+        if (localHub_ && event.socket == localHub_->handle())
+        {
+            serviceLocal();
+            continue;
+        }
+
+        // Check for a successor, served once the other events are
+        if (event.socket == upgradeListenSocket_)
+        {
+            successor = true;
+            continue;
+        }
+
+        // Check for messages from other shards
+        if (shardGroup_ && event.socket == shardGroup_->wakeHandle(shardIndex_))
+        {
+            drainShardInbox();
+            continue;
+        }
+
+        // Endpoint may have been removed earlier in this cycle
+        auto found = socketMap_.find(event.socket);
+        if (found == socketMap_.end())
+            continue;
+        EndpointHandle handle = found->second;
+
+        // Shared-memory endpoints read their ring instead of the socket
+        if (getEndpoint(handle)->shared)
+        {
+            serviceShared(handle, event.socket);
+            continue;
+        }
+
+        // Drain readable socket, routing frames as they are parsed
+        if ((event.readable || event.hangup) && !readEndpoint(handle))
+            continue;
+
+        // Flush outgoing buffer while socket accepts data
+        if (event.writable)
+            writeEndpoint(handle);
     }
+
+    serviceReplay();
+    serviceHeld();
+    serviceOverflow();
+    serviceParked();
+    serviceSessions();
+    serviceJournal();
+
+    // Hand off last, once this poll's deliveries are queued
+    if (successor)
+        acceptSuccessor();
+    return true;
 }
 
-void Server::routeMessage(std::string msg, size_t index)
+bool Server::acceptConnections()
 {
-    // Parse message
-    json message = json::parse(msg);
-    // If registration message, attempt to register
-    if (message.contains(std::string("type")) && message["type"] == "registration")
-    {
-        registerEndpoint(message["value"], index);
-    }
-    // If basic message, attempt to send to designated endpoint
-    else if (message.contains(std::string("type")) && message["type"] == "message")
+    // Edge-triggered listener must be accepted until it would block
+    while (true)
     {
-        auto recvEndpoint = getEndpoint(message["to"]);
-        // If endpoint found, log success and add to message inbox
-        if (recvEndpoint)
+        stats_.syscalls++;
+        SOCKET acceptSocket = accept(listenSocket_, NULL, NULL);
+        if (acceptSocket == INVALID_SOCKET)
         {
-            logger_->logMsg("Sending message: " + message.dump(), logToFile_);
-            recvEndpoint->receiveMsg(message.dump());
+            int error = sock::lastError();
+            if (sock::wouldBlock(error))
+                return true;
+            // A client giving up during its handshake only costs its own connection
+            if (sock::acceptAborted(error))
+                continue;
+            // Out of descriptors or buffers, the backlog waits for a later round instead of stopping the server
+            LOG_WARNING(logger_, logToFile_, "accept() failed with error: " + std::to_string(error));
+            return true;
         }
-        // If endpoint not found (possibly due to endpoint not registered yet), push message back into outbox
-        else
+
+        if (!sock::setNonBlocking(acceptSocket))
         {
-            endpoints_[index]->outbox.push(msg);
+            LOG_ERROR(logger_, logToFile_, "Ioctlsocket(FIONBIO) failed with error: " + std::to_string(sock::lastError()));
+            sock::close(acceptSocket);
+            continue;
         }
-    }
-    else
-    {
-        // Future message types will be handled here
+
+        // Create endpoint and begin watching its socket
+        if (createEndpoint(acceptSocket) == false)
+        {
+            LOG_ERROR(logger_, logToFile_, "CreateSocketInformation(AcceptSocket) failed");
+            sock::close(acceptSocket);
+            continue;
+        }
+        else
+            LOG_INFO(logger_, logToFile_, "Endpoint created successfully!");
     }
 }
 
-bool Server::deleteEndpoint(size_t index)
+bool Server::readEndpoint(EndpointHandle handle)
 {
-    // Dispose of socket connection
-    auto endPoint = endpoints_[index];
-    endPoint->cleanup();
-    // Remove endpoint reference from map and list
-    endpoints_.erase(endpoints_.begin() + index);
-    endpointMap_.erase(endPoint->id);
-    return true;
-}
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    // Stop once a receiver fed by this endpoint blocks it, unread data waits in the socket
+    while (endpoint->blockedOn == 0)
+    {
+        stats_.syscalls++;
+        int recvBytes = sock::recv(endpoint->socket, endpoint->recvBuffer, PACKET_SIZE);
+        if (recvBytes == SOCKET_ERROR)
+        {
+            // Socket drained, wait for next edge
+            if (sock::wouldBlock(sock::lastError()))
+                return true;
+            LOG_ERROR(logger_, logToFile_, "recv() failed with error: " + std::to_string(sock::lastError()));
+            deleteEndpoint(handle);
+            return false;
+        }
 
-std::shared_ptr<Endpoint> Server::getEndpoint(std::string id)
-{
-    // If endpoint exists in map, return
-	if (endpointMap_.find(id) != endpointMap_.end())
-	{
-		return endpoints_[endpointMap_[id]];
-	}
+        // Orderly shutdown from peer
+        if (recvBytes == 0)
+        {
+            deleteEndpoint(handle);
+            return false;
+        }
 
-    // Return null if not found
-	return nullptr;
+        // Process packet recieved and route its frames before the buffer is reused
+        endpoint->bytesRecv = recvBytes;
+        if (!endpoint->processRecv())
+        {
+            deleteEndpoint(handle);
+            return false;
+        }
+        if (!routeOutbox(handle))
+            return false;
+    }
+    return true;
 }
 
-size_t Server::numEndpoints()
+int Server::sendOutbound(const std::shared_ptr<Endpoint>& endpoint)
 {
-    return endpoints_.size();
+    // Hand as many queued frames as fit in one scatter list to the socket
+    size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+    stats_.syscalls++;
+    int sendBytes = sock::sendv(endpoint->socket, endpoint->sendVecs, count);
+    if (sendBytes != SOCKET_ERROR)
+        endpoint->processSent(sendBytes, instruments_.deliveryLatency);
+    return sendBytes;
 }
 
-size_t Server::numRegisteredEndpoints()
+bool Server::writeEndpoint(EndpointHandle handle)
 {
-    return endpointMap_.size();
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    // Writes needing several sends are corked so the boundaries between them do not produce short segments
+    bool corked = endpoint->coalescing.cork && endpoint->outbound.numFrames() > SEND_IOVECS;
+    if (corked)
+    {
+        stats_.syscalls++;
+        sock::setCork(endpoint->socket, true);
+    }
+    while (!endpoint->outbound.empty())
+    {
+        if (sendOutbound(endpoint) == SOCKET_ERROR)
+        {
+            // Socket buffer full, wait for next writable edge
+            if (sock::wouldBlock(sock::lastError()))
+                break;
+            LOG_ERROR(logger_, logToFile_, "send() failed with error: " + std::to_string(sock::lastError()));
+            deleteEndpoint(handle);
+            return false;
+        }
+    }
+    if (corked)
+    {
+        stats_.syscalls++;
+        sock::setCork(endpoint->socket, false);
+    }
+
+    // Watch for writability only while frames remain
+    relievePressure(endpoint);
+    updateWriteInterest(endpoint);
+    return true;
+}
+
+void Server::acceptShared()
+{
+    while (true)
+    {
+        stats_.syscalls++;
+        SOCKET control = accept(sharedListenSocket_, NULL, NULL);
+        if (control == INVALID_SOCKET)
+        {
+            if (!sock::wouldBlock(sock::lastError()))
+                LOG_ERROR(logger_, logToFile_, "Shared-memory accept() failed with error: " + std::to_string(sock::lastError()));
+            return;
+        }
+        createSharedEndpoint(control);
+    }
+}
+
+void Server::createSharedEndpoint(SOCKET control)
+{
+    // A client that cannot be given a channel is turned away, the listener keeps accepting
+    auto channel = std::make_unique<SharedChannel>();
+    stats_.syscalls++;
+    if (!channel->create(SHARED_RING_CAPACITY))
+    {
+        LOG_ERROR(logger_, logToFile_, "Shared channel creation failed with error: " + std::to_string(sock::lastError()));
+        sock::close(control);
+        return;
+    }
+    // The server starts out asleep before the client can write, so the client rings for its first frame
+    channel->receiving().prepareSleep();
+    if (!channel->sendHandles(control))
+    {
+        LOG_ERROR(logger_, logToFile_, "Shared channel handoff failed with error: " + std::to_string(sock::lastError()));
+        sock::close(control);
+        return;
+    }
+
+    auto endpoint = std::allocate_shared<Endpoint>(PoolAllocator<Endpoint>(), control);
+    endpoint->shared = std::move(channel);
+    EndpointHandle handle;
+    if (addEndpoint(endpoint, handle))
+        LOG_INFO(logger_, logToFile_, "Shared-memory endpoint created successfully!");
+    else
+    {
+        LOG_ERROR(logger_, logToFile_, "Shared-memory endpoint creation failed");
+        endpoint->cleanup();
+    }
+}
+
+bool Server::serviceShared(EndpointHandle handle, SOCKET ready)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    // Clients never write to the control socket once the channel is set up, so readability means it closed
+    if (ready == endpoint->socket)
+    {
+        deleteEndpoint(handle);
+        return false;
+    }
+
+    stats_.syscalls++;
+    endpoint->shared->clearBell();
+    if (!readShared(handle))
+        return false;
+    // The doorbell also rings when the client frees space for frames still queued
+    writeShared(endpoint);
+    return true;
+}
+
+bool Server::readShared(EndpointHandle handle)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    SharedRing& ring = endpoint->shared->receiving();
+    // Stop once a receiver fed by this endpoint blocks it, unread bytes wait in the ring
+    while (endpoint->blockedOn == 0)
+    {
+        size_t bytes = ring.read(endpoint->recvBuffer, PACKET_SIZE);
+        if (bytes == SHARED_RING_ERROR)
+        {
+            LOG_ERROR(logger_, logToFile_, "Dropping shared-memory endpoint with corrupt ring positions");
+            deleteEndpoint(handle);
+            return false;
+        }
+        if (bytes == 0)
+        {
+            // Ring drained, the client rings the doorbell with its next write
+            if (ring.prepareSleep())
+                return true;
+            continue;
+        }
+        // A client waiting for space may write again
+        if (ring.wakeProducer())
+        {
+            stats_.syscalls++;
+            endpoint->shared->ringPeer();
+        }
+
+        // Process bytes read and route their frames before the buffer is reused
+        endpoint->bytesRecv = bytes;
+        if (!endpoint->processRecv())
+        {
+            deleteEndpoint(handle);
+            return false;
+        }
+        if (!routeOutbox(handle))
+            return false;
+    }
+    return true;
+}
+
+void Server::writeShared(const std::shared_ptr<Endpoint>& endpoint)
+{
+    SharedRing& ring = endpoint->shared->sending();
+    bool written = false;
+    while (!endpoint->outbound.empty())
+    {
+        size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+        size_t bytes = ring.write(endpoint->sendVecs, count);
+        // Writes may happen while routing, so the channel is only shut here. Its control socket
+        // then reads as closed, which removes the endpoint on the next poll
+        if (bytes == SHARED_RING_ERROR)
+        {
+            LOG_ERROR(logger_, logToFile_, "Dropping shared-memory endpoint with corrupt ring positions");
+            shutdown(endpoint->socket, SD_BOTH);
+            return;
+        }
+        if (bytes == 0)
+        {
+            // Ring full, the client rings the doorbell once it has read
+            if (ring.prepareWait())
+                break;
+            continue;
+        }
+        endpoint->processSent(bytes, instruments_.deliveryLatency);
+        written = true;
+    }
+    // One ring per sleep of the client, however many frames were written
+    if (written && ring.wakeConsumer())
+    {
+        stats_.syscalls++;
+        endpoint->shared->ringPeer();
+    }
+    relievePressure(endpoint);
+}
+
+void Server::serviceLocal()
+{
+    stats_.syscalls++;
+    localHub_->clear();
+    // Channels queued again while being serviced wait for the next poll, so one busy client cannot hold this one
+    std::weak_ptr<LocalChannel> queued;
+    while (localHub_->next(queued))
+    {
+        if (auto channel = queued.lock())
+            localReady_.push_back(std::move(channel));
+    }
+
+    for (const std::shared_ptr<LocalChannel>& channel : localReady_)
+    {
+        channel->clearPending();
+        // The first notification of a channel attaches it
+        if (channel->handle == INVALID_SLOT_HANDLE)
+        {
+            if (channel->closed())
+                continue;
+            createLocalEndpoint(channel);
+        }
+        // Endpoint may have been removed since the client notified
+        EndpointHandle handle = channel->handle;
+        std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+        if (!endpoint || endpoint->local != channel)
+            continue;
+        if (channel->closed())
+        {
+            deleteEndpoint(handle);
+            continue;
+        }
+        if (!readLocal(handle))
+            continue;
+        // The client also notifies after taking from a full ring, frames may be waiting for room
+        writeLocal(endpoint);
+    }
+    localReady_.clear();
+}
+
+void Server::createLocalEndpoint(const std::shared_ptr<LocalChannel>& channel)
+{
+    auto endpoint = std::allocate_shared<Endpoint>(PoolAllocator<Endpoint>(), INVALID_SOCKET);
+    endpoint->local = channel;
+    EndpointHandle handle;
+    if (addEndpoint(endpoint, handle))
+    {
+        channel->handle = handle;
+        LOG_INFO(logger_, logToFile_, "In-process endpoint created successfully!");
+    }
+    else
+    {
+        LOG_ERROR(logger_, logToFile_, "In-process endpoint creation failed");
+        channel->close();
+    }
+}
+
+bool Server::readLocal(EndpointHandle handle)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    LocalChannel& channel = *endpoint->local;
+    LocalFrame frame;
+    size_t taken = 0;
+    // Stop once a receiver fed by this endpoint blocks it, untaken messages wait in the ring
+    while (endpoint->blockedOn == 0 && channel.take(frame))
+    {
+        if (endpoint->metrics)
+        {
+            endpoint->recvStamp = MetricsRegistry::now();
+            endpoint->metrics->bytesIn.add(frame.payload->length());
+            endpoint->metrics->messagesIn.add(1);
+        }
+        // The sender's payload is routed, and forwarded when routing on headers, without a copy
+        routeStamp_ = endpoint->recvStamp;
+        routePayload_ = std::move(frame.payload);
+        bool routed = routeMessage(RecvFrame{ *routePayload_, frame.format }, handle);
+        routePayload_.reset();
+        routeStamp_ = 0;
+        if (!routed)
+        {
+            deleteEndpoint(handle);
+            return false;
+        }
+        // One ring of messages per poll, the rest are taken on the next
+        if (++taken == channel.capacity())
+        {
+            channel.wakeServer();
+            break;
+        }
+    }
+    // A client waiting for room may send again
+    if (taken > 0)
+        channel.wakeClient();
+    return true;
+}
+
+void Server::writeLocal(const std::shared_ptr<Endpoint>& endpoint)
+{
+    LocalChannel& channel = *endpoint->local;
+    bool written = false;
+    // Payloads are handed over whole, their frame headers are only released.
+    // A full ring stops the loop, the client notifies the hub once it has taken a message
+    while (!endpoint->outbound.empty() && channel.deliver(endpoint->outbound.front()))
+    {
+        endpoint->processSent(endpoint->outbound.frontBytes(), instruments_.deliveryLatency);
+        written = true;
+    }
+    if (written)
+        channel.wakeClient();
+    relievePressure(endpoint);
+}
+
+bool Server::routeOutbox(EndpointHandle handle)
+{
+    // Frames are views into the receive buffer, released once routed
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    bool routed = true;
+    routeStamp_ = endpoint->recvStamp;
+    for (const RecvFrame& frame : endpoint->outbox)
+    {
+        // A sender of malformed frames is out of step with the protocol, its later frames are not trusted either
+        if (!(routed = routeMessage(frame, handle)))
+            break;
+    }
+    routeStamp_ = 0;
+    endpoint->releaseFrames();
+    if (!routed)
+        deleteEndpoint(handle);
+    return routed;
+}
+
+void Server::parkMessage(const std::string& to, Payload msg)
+{
+    parked_.park(to, std::move(msg), ParkClock::now());
+}
+
+void Server::journalMessage(JournalKind kind, std::string_view to, std::string_view msg)
+{
+    if (!journal_->append(kind, to, msg, Journal::now()))
+    {
+        // Routing goes on without durability rather than stopping the broker
+        LOG_ERROR(logger_, logToFile_, "Journal append failed with error: " + std::to_string(sock::lastError()) + ", journal closed");
+        journal_.reset();
+        journalDeadline_ = 0;
+        return;
+    }
+    stats_.messagesJournaled++;
+    // The first unsynced message starts the group commit window, later ones join it
+    if (journalDeadline_ == 0)
+        journalDeadline_ = MetricsRegistry::now() + static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(journal_->policy().syncInterval).count());
+}
+
+void Server::serviceJournal()
+{
+    if (journalDeadline_ == 0 || journalDeadline_ > MetricsRegistry::now())
+        return;
+    journalDeadline_ = 0;
+    stats_.syscalls++;
+    stats_.journalSyncs++;
+    if (!journal_->sync())
+        LOG_ERROR(logger_, logToFile_, "Journal sync failed with error: " + std::to_string(sock::lastError()));
+}
+
+bool Server::replayJournal(EndpointHandle handle, JournalCursor from)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    if (!journal_ || !endpoint || endpoint->id == "")
+        return false;
+    // Messages routed from now on are delivered live, the replay stops short of them
+    endpoint->replayCursor = from;
+    endpoint->replayEnd = journal_->endOffset();
+    // Delivery starts right away, a replay longer than one share continues over the next polls
+    if (!endpoint->replaying && !continueReplay(endpoint))
+    {
+        endpoint->replaying = true;
+        replaying_.push_back(endpoint);
+    }
+    return true;
+}
+
+void Server::serviceReplay()
+{
+    replayPending_ = false;
+    if (replaying_.empty())
+        return;
+    size_t kept = 0;
+    for (size_t position = 0; position < replaying_.size(); position++)
+    {
+        std::shared_ptr<Endpoint> endpoint = replaying_[position];
+        // Removed endpoints stop replaying, a closed journal ends every replay
+        if (!endpoint->replaying || !journal_ || continueReplay(endpoint))
+        {
+            endpoint->replaying = false;
+            continue;
+        }
+        replaying_[kept++] = std::move(endpoint);
+    }
+    replaying_.resize(kept);
+}
+
+bool Server::continueReplay(const std::shared_ptr<Endpoint>& endpoint)
+{
+    JournalRecord record;
+    for (size_t count = 0; count < JOURNAL_REPLAY_RECORDS; count++)
+    {
+        // The rest follows as the endpoint drains, so a replay never trips its overflow policy
+        if (endpoint->outbound.bytesQueued() > endpoint->backpressure.lowWatermark)
+            return false;
+        if (endpoint->replayCursor.offset >= endpoint->replayEnd || !journal_->next(endpoint->replayCursor, record) || record.offset >= endpoint->replayEnd)
+        {
+            json done = { { "type", "replay" }, { "to", endpoint->id }, { "offset", endpoint->replayEnd } };
+            WireMessage wire(std::move(done));
+            deliverMessage(endpoint, wire, INVALID_SLOT_HANDLE);
+            return true;
+        }
+        bool addressed = record.kind == JournalKind::Publish
+            ? std::find(endpoint->topics.begin(), endpoint->topics.end(), record.destination) != endpoint->topics.end()
+            : record.destination == endpoint->id;
+        if (!addressed)
+            continue;
+        WireMessage wire(framing::makePayload(record.payload));
+        if (!deliverMessage(endpoint, wire, INVALID_SLOT_HANDLE))
+        {
+            dropMalformed("journaled message for " + endpoint->id);
+            continue;
+        }
+        stats_.messagesReplayed++;
+    }
+    replayPending_ = true;
+    return false;
+}
+
+void Server::resumeSession(const std::shared_ptr<Endpoint>& previous, const std::shared_ptr<Endpoint>& endpoint, EndpointHandle handle)
+{
+    std::string id = previous->id;
+    endpoint->id = id;
+    endpoint->format = previous->format;
+    endpoint->sessionToken = previous->sessionToken;
+    endpoint->framesSent = previous->framesSent;
+    endpoint->conflate = endpoint->conflate || previous->conflate;
+    endpoint->backpressure = previous->backpressure;
+    endpoint->coalescing = previous->coalescing;
+    metrics_->nameEndpoint(endpoint->metrics, id);
+
+    // The session message leads the new stream, ahead of the frames the old connection left unsent
+    WireMessage resumed = sessionMessage(id, previous->framesSent, true);
+    deliverMessage(endpoint, resumed, INVALID_SLOT_HANDLE);
+    // Frames an in-flight io_uring send still reads stay with the old connection as well
+    previous->outbound.moveTo(endpoint->outbound, previous->sendInFlight ? SEND_IOVECS : 0);
+
+    // Subscriptions keep their place among each topic's subscribers
+    for (const std::string& topic : previous->topics)
+    {
+        std::vector<std::shared_ptr<Endpoint>>& subscribers = topics_[topic];
+        if (std::find(endpoint->topics.begin(), endpoint->topics.end(), topic) != endpoint->topics.end())
+            subscribers.erase(std::find(subscribers.begin(), subscribers.end(), previous));
+        else
+        {
+            std::replace(subscribers.begin(), subscribers.end(), previous, endpoint);
+            endpoint->topics.push_back(topic);
+        }
+    }
+    previous->topics.clear();
+
+    // Senders the session blocked stay blocked until the new connection drains
+    if (previous->pressured)
+    {
+        if (!endpoint->pressured)
+        {
+            endpoint->pressured = true;
+            stats_.pressuredEndpoints++;
+        }
+        for (SlotHandle sender : previous->blockedSenders)
+            blockSender(endpoint, sender);
+        previous->pressured = false;
+        stats_.pressuredEndpoints--;
+        releaseSenders(previous);
+    }
+    relievePressure(endpoint);
+    holdWrites(endpoint);
+    updateWriteInterest(endpoint);
+
+    // The old connection is removed without keeping its session again
+    auto registered = endpointMap_.find(id);
+    EndpointHandle previousHandle = registered != endpointMap_.end() ? registered->second : INVALID_SLOT_HANDLE;
+    endpointMap_[id] = handle;
+    previous->sessionToken.clear();
+    if (previous->detachedUntil != 0)
+        sessions_.erase(id);
+    else
+        deleteEndpoint(previousHandle);
+    stats_.sessionsResumed++;
+    LOG_INFO(logger_, logToFile_, "Session resumed: " + id);
+}
+
+bool Server::detachSession(const std::shared_ptr<Endpoint>& endpoint)
+{
+    if (endpoint->sessionToken.empty() || sessionPolicy_.grace.count() <= 0 || shardGroup_)
+        return false;
+    if (sessions_.size() >= sessionPolicy_.maxDetached)
+    {
+        LOG_WARNING(logger_, logToFile_, "Dropping session, too many sessions are disconnected: " + endpoint->id);
+        return false;
+    }
+    endpoint->detachedUntil = MetricsRegistry::now() + std::chrono::duration_cast<std::chrono::nanoseconds>(sessionPolicy_.grace).count();
+    if (sessions_.empty() || endpoint->detachedUntil < sessionExpiry_)
+        sessionExpiry_ = endpoint->detachedUntil;
+    sessions_[endpoint->id] = endpoint;
+    LOG_INFO(logger_, logToFile_, "Session disconnected, kept for its client to resume: " + endpoint->id);
+    return true;
+}
+
+void Server::dropSession(const std::shared_ptr<Endpoint>& endpoint)
+{
+    auto found = sessions_.find(endpoint->id);
+    if (found == sessions_.end() || found->second != endpoint)
+        return;
+    sessions_.erase(found);
+    while (!endpoint->topics.empty())
+        unsubscribeEndpoint(endpoint->topics.back(), endpoint);
+    if (endpoint->pressured)
+    {
+        endpoint->pressured = false;
+        stats_.pressuredEndpoints--;
+        releaseSenders(endpoint);
+    }
+}
+
+void Server::serviceSessions()
+{
+    if (sessions_.empty())
+        return;
+    uint64_t now = MetricsRegistry::now();
+    if (now < sessionExpiry_)
+        return;
+    std::vector<std::shared_ptr<Endpoint>> expired;
+    sessionExpiry_ = UINT64_MAX;
+    for (const auto& session : sessions_)
+    {
+        if (session.second->detachedUntil <= now)
+            expired.push_back(session.second);
+        else if (session.second->detachedUntil < sessionExpiry_)
+            sessionExpiry_ = session.second->detachedUntil;
+    }
+    for (const std::shared_ptr<Endpoint>& endpoint : expired)
+    {
+        LOG_INFO(logger_, logToFile_, "Session expired with " + std::to_string(endpoint->outbound.numFrames()) + " undelivered frames: " + endpoint->id);
+        dropSession(endpoint);
+        stats_.sessionsExpired++;
+    }
+}
+
+void Server::serviceParked()
+{
+    if (parked_.empty())
+        return;
+    parked_.expire(ParkClock::now());
+
+    // Local registrations release their messages directly, only other shards need a lookup
+    if (!registrationPending_ || !shardGroup_)
+        return;
+    registrationPending_ = false;
+    EndpointLocation location;
+    for (const std::string& to : parked_.destinations())
+    {
+        if (!shardGroup_->locate(to, location) || location.shard == shardIndex_)
+            continue;
+        for (Payload& msg : parked_.release(to, ParkClock::now()))
+            shardGroup_->forward(location.shard, { to, std::move(msg), false, 0 });
+    }
+}
+
+void Server::rearmAccept(int result, bool shared)
+{
+    SOCKET listener = shared ? sharedListenSocket_ : listenSocket_;
+    // A client giving up during its handshake only costs its own connection
+    if (result >= 0 || sock::acceptAborted(-result))
+    {
+        ring_->prepMultishotAccept(listener, uringData(shared ? URING_SHARED_ACCEPT : URING_ACCEPT, 0, listener));
+        return;
+    }
+    // Out of descriptors or memory, accepting again at once would fail the same way, so the backlog waits
+    LOG_WARNING(logger_, logToFile_, std::string(shared ? "Shared-memory accept()" : "accept()") + " failed with error: " + std::to_string(-result));
+    ring_->prepTimeout(URING_ACCEPT_BACKOFF_NS, uringData(URING_ACCEPT_RETRY, shared ? 1 : 0, listener));
+}
+
+bool Server::pollUring()
+{
+    // A held write coming due must end the wait, one timeout is outstanding at a time
+    int64_t holdNs = holdTimeout();
+    if (holdNs >= 0 && !uringTimeoutArmed_)
+    {
+        ring_->prepTimeout(holdNs, uringData(URING_TIMEOUT, 0, 0));
+        uringTimeoutArmed_ = true;
+    }
+
+    // Submit everything queued since the last poll and wait for at least one completion
+    uint64_t enters = ring_->numEnters();
+    int count = ring_->submitAndWait(completions_, 1);
+    stats_.syscalls += ring_->numEnters() - enters;
+    if (count == -1)
+    {
+        LOG_ERROR(logger_, logToFile_, "io_uring_enter() returned with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+
+    // Kernel holds its own references now, so sockets of removed endpoints can close
+    for (auto& endpoint : retiredEndpoints_)
+        endpoint->cleanup();
+    retiredEndpoints_.clear();
+
+    for (const UringCompletion& completion : completions_)
+    {
+        switch (completion.userData >> 60)
+        {
+        case URING_ACCEPT:
+            if (completion.result >= 0)
+            {
+                if (createEndpoint(completion.result) == false)
+                {
+                    LOG_ERROR(logger_, logToFile_, "CreateSocketInformation(AcceptSocket) failed");
+                    sock::close(completion.result);
+                }
+                else
+                    LOG_INFO(logger_, logToFile_, "Endpoint created successfully!");
+            }
+            // Re-arm if the kernel ended the multishot request
+            if (!(completion.flags & IORING_CQE_F_MORE))
+                rearmAccept(completion.result, false);
+            break;
+        case URING_RECV:
+            completeRecv(completion);
+            break;
+        case URING_SEND:
+            completeSend(completion);
+            break;
+        case URING_TIMEOUT:
+            uringTimeoutArmed_ = false;
+            break;
+        case URING_POLL:
+            readDatagrams();
+            if (!(completion.flags & IORING_CQE_F_MORE))
+                ring_->prepMultishotPoll(datagramSocket_, uringData(URING_POLL, 0, datagramSocket_));
+            break;
+        case URING_SHARED_ACCEPT:
+            if (completion.result >= 0)
+                createSharedEndpoint(completion.result);
+            if (!(completion.flags & IORING_CQE_F_MORE))
+                rearmAccept(completion.result, true);
+            break;
+        case URING_ACCEPT_RETRY:
+            // Back-off elapsed, the token names which listener to accept on again
+            rearmAccept(0, (completion.userData >> 32) & 0x0FFFFFFF);
+            break;
+        case URING_SHARED:
+            completeShared(completion);
+            break;
+        case URING_LOCAL:
+            serviceLocal();
+            if (!(completion.flags & IORING_CQE_F_MORE))
+                ring_->prepMultishotPoll(localHub_->handle(), uringData(URING_LOCAL, 0, localHub_->handle()));
+            break;
+        default:
+            break;
+        }
+    }
+
+    serviceReplay();
+    serviceHeld();
+    serviceOverflow();
+    serviceParked();
+    serviceSessions();
+    serviceJournal();
+    return true;
+}
+
+void Server::completeRecv(const UringCompletion& completion)
+{
+    bool hasBuffer = (completion.flags & IORING_CQE_F_BUFFER) != 0;
+    uint16_t bid = IoUring::bufferId(completion.flags);
+    EndpointHandle handle;
+
+    // Completion may belong to an endpoint removed earlier
+    if (!findIoEndpoint(completion.userData, handle))
+    {
+        if (hasBuffer)
+            ring_->recycleBuffer(bid);
+        return;
+    }
+
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    if (!(completion.flags & IORING_CQE_F_MORE))
+    {
+        endpoint->recvArmed = false;
+        endpoint->recvCancelling = false;
+    }
+    if (completion.result > 0 && hasBuffer)
+    {
+        // Process packet recieved, then hand the buffer back to the kernel
+        std::memcpy(endpoint->recvBuffer, ring_->buffer(bid), completion.result);
+        ring_->recycleBuffer(bid);
+        endpoint->bytesRecv = completion.result;
+        if (!endpoint->processRecv())
+        {
+            deleteEndpoint(handle);
+            return;
+        }
+        if (!routeOutbox(handle))
+            return;
+    }
+    // Orderly shutdown or error, buffer exhaustion and paused reads only end the multishot request
+    else if (completion.result != -ENOBUFS && completion.result != -ECANCELED)
+    {
+        if (hasBuffer)
+            ring_->recycleBuffer(bid);
+        deleteEndpoint(handle);
+        return;
+    }
+
+    // Re-arm if the kernel ended the multishot request and reads are not paused
+    if (!endpoint->recvArmed && !endpoint->recvCancelling && endpoint->blockedOn == 0)
+        armRecv(endpoint);
+}
+
+void Server::completeSend(const UringCompletion& completion)
+{
+    // Release the reference that kept the send buffer alive
+    auto found = inflightSends_.find(completion.userData);
+    if (found == inflightSends_.end())
+        return;
+    std::shared_ptr<Endpoint> endpoint = found->second;
+    inflightSends_.erase(found);
+    endpoint->sendInFlight = false;
+
+    EndpointHandle handle;
+    if (!findIoEndpoint(completion.userData, handle))
+        return;
+    if (completion.result < 0)
+    {
+        LOG_ERROR(logger_, logToFile_, "send() failed with error: " + std::to_string(-completion.result));
+        deleteEndpoint(handle);
+        return;
+    }
+
+    // Release sent frames and keep sending
+    endpoint->processSent(completion.result, instruments_.deliveryLatency);
+    relievePressure(endpoint);
+    queueSend(endpoint);
+}
+
+void Server::completeShared(const UringCompletion& completion)
+{
+    // Completion may belong to an endpoint removed earlier
+    EndpointHandle handle;
+    if (!findIoEndpoint(completion.userData, handle))
+        return;
+    SOCKET ready = static_cast<SOCKET>(static_cast<uint32_t>(completion.userData));
+    if (!serviceShared(handle, ready))
+        return;
+
+    // Re-arm if the kernel ended the multishot request
+    if (!(completion.flags & IORING_CQE_F_MORE))
+        ring_->prepMultishotPoll(ready, completion.userData);
+}
+
+void Server::queueSend(const std::shared_ptr<Endpoint>& endpoint)
+{
+    if (endpoint->sendInFlight || endpoint->outbound.empty() || endpoint->flushDeadline != 0)
+        return;
+
+    // Sends prepared during this poll are submitted together with the next wait
+    uint64_t userData = uringData(URING_SEND, endpoint->ioToken, endpoint->socket);
+    size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+    ring_->prepSendv(endpoint->socket, endpoint->sendVecs, count, userData);
+    inflightSends_[userData] = endpoint;
+    endpoint->sendInFlight = true;
+}
+
+bool Server::findIoEndpoint(uint64_t userData, EndpointHandle& handle)
+{
+    auto found = socketMap_.find(static_cast<SOCKET>(static_cast<uint32_t>(userData)));
+    if (found == socketMap_.end())
+        return false;
+    // Socket numbers are reused, tokens are not
+    handle = found->second;
+    std::shared_ptr<Endpoint>* endpoint = endpoints_.get(handle);
+    return endpoint && (*endpoint)->ioToken == ((userData >> 32) & 0x0FFFFFFF);
+}
+
+void Server::updateWriteInterest(const std::shared_ptr<Endpoint>& endpoint)
+{
+    // Shared-memory endpoints are written right away, copying into their ring costs no syscall
+    if (endpoint->shared)
+    {
+        if (endpoint->flushDeadline == 0)
+            writeShared(endpoint);
+        return;
+    }
+    // In-process endpoints are handed their payloads right away as well
+    if (endpoint->local)
+    {
+        if (endpoint->flushDeadline == 0)
+            writeLocal(endpoint);
+        return;
+    }
+
+    // Completion backend sends directly instead of waiting for writability
+    if (ring_)
+    {
+        queueSend(endpoint);
+        return;
+    }
+
+    if (!reactor_)
+        return;
+
+    // Only touch the reactor on empty/non-empty transitions, held frames wait for their deadline
+    bool pending = !endpoint->outbound.empty() && endpoint->flushDeadline == 0;
+    if (pending != endpoint->writeInterest)
+    {
+        stats_.syscalls++;
+        reactor_->setInterest(endpoint->socket, endpoint->blockedOn == 0, pending);
+        endpoint->writeInterest = pending;
+    }
+}
+
+void Server::updateReadInterest(const std::shared_ptr<Endpoint>& endpoint)
+{
+    bool paused = endpoint->blockedOn > 0;
+    // Shared-memory endpoints stop reading their ring while paused and ring their own doorbell to resume
+    if (endpoint->shared)
+    {
+        if (!paused)
+        {
+            stats_.syscalls++;
+            endpoint->shared->ringSelf();
+        }
+        return;
+    }
+    // In-process endpoints stop taking from their ring while paused and queue themselves on the hub to resume
+    if (endpoint->local)
+    {
+        if (!paused)
+            endpoint->local->wakeServer();
+        return;
+    }
+
+    // Completion backend cancels the multishot receive and arms a new one on resume
+    if (ring_)
+    {
+        if (paused && endpoint->recvArmed)
+        {
+            ring_->prepCancel(uringData(URING_RECV, endpoint->ioToken, endpoint->socket), uringData(URING_CANCEL, 0, endpoint->socket));
+            endpoint->recvArmed = false;
+            endpoint->recvCancelling = true;
+        }
+        // A cancelled receive re-arms from its final completion instead
+        else if (!paused && !endpoint->recvArmed && !endpoint->recvCancelling)
+            armRecv(endpoint);
+        return;
+    }
+
+    // Select rebuilds its descriptor sets from the paused state every poll
+    if (!reactor_)
+        return;
+    stats_.syscalls++;
+    reactor_->setInterest(endpoint->socket, !paused, endpoint->writeInterest);
+}
+
+void Server::armRecv(const std::shared_ptr<Endpoint>& endpoint)
+{
+    ring_->prepMultishotRecv(endpoint->socket, URING_BUFFER_GROUP, uringData(URING_RECV, endpoint->ioToken, endpoint->socket));
+    endpoint->recvArmed = true;
+}
+
+void Server::armShared(const std::shared_ptr<Endpoint>& endpoint)
+{
+    SOCKET bell = endpoint->shared->bell();
+    ring_->prepMultishotPoll(bell, uringData(URING_SHARED, endpoint->ioToken, bell));
+    ring_->prepMultishotPoll(endpoint->socket, uringData(URING_SHARED, endpoint->ioToken, endpoint->socket));
+}
+
+bool Server::deliverMessage(const std::shared_ptr<Endpoint>& receiver, WireMessage& msg, EndpointHandle sender)
+{
+    // Text routed on its header alone is first parsed here, when a receiver needs another encoding or a conflation key
+    bool conflating = msg.conflate || receiver->conflate;
+    if (!msg.payload(receiver->format) || (conflating && !msg.conflationKey()))
+        return false;
+
+    // Loss-tolerant messages bypass the outbound queue when the receiver has a datagram channel
+    if (msg.lossy && receiver->channelLinked && sendDatagram(receiver, msg.payload(receiver->format)))
+    {
+        stats_.messagesRouted++;
+        return true;
+    }
+
+    // Frames of an in-flight io_uring send are still read by the kernel and cannot be replaced
+    if (conflating)
+    {
+        if (receiver->receiveLatest(msg, receiver->sendInFlight ? SEND_IOVECS : 0))
+            stats_.messagesConflated++;
+    }
+    else
+        receiver->receiveMsg(msg);
+    stats_.messagesRouted++;
+
+    const BackpressurePolicy& policy = receiver->backpressure;
+    if (receiver->outbound.bytesQueued() > policy.highWatermark)
+    {
+        switch (policy.overflow)
+        {
+        case OverflowPolicy::Block:
+            // Pausing a sender on another shard would take a round trip through its inbox, so the oldest frames give way
+            if (msg.forwarded)
+            {
+                stats_.overflowDrops += receiver->outbound.dropOldest(policy.highWatermark, receiver->sendInFlight ? SEND_IOVECS : 0);
+                break;
+            }
+            if (!receiver->pressured)
+            {
+                receiver->pressured = true;
+                stats_.pressuredEndpoints++;
+                LOG_WARNING(logger_, logToFile_, "Endpoint passed its high watermark, blocking senders: " + receiver->id);
+            }
+            blockSender(receiver, sender);
+            break;
+        case OverflowPolicy::DropOldest:
+            // Frames of an in-flight io_uring send are still read by the kernel
+            stats_.overflowDrops += receiver->outbound.dropOldest(policy.highWatermark, receiver->sendInFlight ? SEND_IOVECS : 0);
+            break;
+        case OverflowPolicy::Disconnect:
+            if (std::find(overflowed_.begin(), overflowed_.end(), receiver) == overflowed_.end())
+                overflowed_.push_back(receiver);
+            break;
+        }
+    }
+    // A disconnected session only queues until its client resumes it
+    if (receiver->detachedUntil != 0)
+        return true;
+    holdWrites(receiver);
+    updateWriteInterest(receiver);
+    return true;
+}
+
+void Server::blockSender(const std::shared_ptr<Endpoint>& receiver, EndpointHandle sender)
+{
+    // Parked, replayed and server-generated messages have no sender to pause
+    std::shared_ptr<Endpoint> source = getEndpoint(sender);
+    if (!source || source == receiver)
+        return;
+    std::vector<SlotHandle>& blocked = receiver->blockedSenders;
+    if (std::find(blocked.begin(), blocked.end(), sender) != blocked.end())
+        return;
+
+    blocked.push_back(sender);
+    if (source->blockedOn++ == 0)
+    {
+        stats_.pausedSenders++;
+        stats_.senderPauses++;
+        updateReadInterest(source);
+    }
+}
+
+void Server::releaseSenders(const std::shared_ptr<Endpoint>& receiver)
+{
+    // Senders removed while blocked have stale handles and are skipped
+    for (SlotHandle sender : receiver->blockedSenders)
+    {
+        std::shared_ptr<Endpoint> source = getEndpoint(sender);
+        if (source && --source->blockedOn == 0)
+        {
+            stats_.pausedSenders--;
+            updateReadInterest(source);
+        }
+    }
+    receiver->blockedSenders.clear();
+}
+
+void Server::relievePressure(const std::shared_ptr<Endpoint>& endpoint)
+{
+    if (!endpoint->pressured || endpoint->outbound.bytesQueued() > endpoint->backpressure.lowWatermark)
+        return;
+    endpoint->pressured = false;
+    stats_.pressuredEndpoints--;
+    releaseSenders(endpoint);
+}
+
+void Server::serviceOverflow()
+{
+    for (const std::shared_ptr<Endpoint>& receiver : overflowed_)
+    {
+        // Receiver may have drained or disconnected since it overflowed
+        if (receiver->outbound.bytesQueued() <= receiver->backpressure.highWatermark)
+            continue;
+        // A disconnected session has no connection to close, it is dropped instead
+        if (receiver->detachedUntil != 0)
+        {
+            LOG_WARNING(logger_, logToFile_, "Dropping disconnected session over its high watermark: " + receiver->id);
+            dropSession(receiver);
+            stats_.overflowDisconnects++;
+            continue;
+        }
+        if (getEndpoint(receiver->slot) != receiver)
+            continue;
+        LOG_WARNING(logger_, logToFile_, "Disconnecting slow endpoint over its high watermark: " + receiver->id);
+        deleteEndpoint(receiver->slot);
+        stats_.overflowDisconnects++;
+    }
+    overflowed_.clear();
+}
+
+void Server::holdWrites(const std::shared_ptr<Endpoint>& receiver)
+{
+    const CoalescingPolicy& policy = receiver->coalescing;
+    if (policy.windowUs == 0)
+        return;
+
+    // A full budget goes out now, held or not
+    if (policy.maxBytes > 0 && receiver->outbound.bytesQueued() >= policy.maxBytes)
+    {
+        if (receiver->flushDeadline != 0)
+        {
+            receiver->flushDeadline = 0;
+            stats_.coalescedWrites++;
+        }
+        return;
+    }
+
+    // Only an idle receiver starts a window, one already waiting on the socket coalesces by itself
+    if (receiver->flushDeadline != 0 || receiver->writeInterest || receiver->sendInFlight)
+        return;
+    receiver->flushDeadline = MetricsRegistry::now() + policy.windowUs * 1000;
+    held_.push_back(receiver);
+}
+
+int64_t Server::holdTimeout()
+{
+    if (replayPending_)
+        return 0;
+    if (held_.empty() && journalDeadline_ == 0 && sessions_.empty())
+        return -1;
+    uint64_t now = MetricsRegistry::now();
+    uint64_t earliest = journalDeadline_ != 0 ? journalDeadline_ : UINT64_MAX;
+    if (!sessions_.empty() && sessionExpiry_ < earliest)
+        earliest = sessionExpiry_;
+    for (const std::shared_ptr<Endpoint>& endpoint : held_)
+    {
+        if (endpoint->flushDeadline != 0 && endpoint->flushDeadline < earliest)
+            earliest = endpoint->flushDeadline;
+    }
+    if (earliest == UINT64_MAX)
+        return 0;
+    return earliest > now ? static_cast<int64_t>(earliest - now) : 0;
+}
+
+void Server::serviceHeld()
+{
+    if (held_.empty())
+        return;
+    uint64_t now = MetricsRegistry::now();
+    size_t kept = 0;
+    for (size_t position = 0; position < held_.size(); position++)
+    {
+        std::shared_ptr<Endpoint> endpoint = held_[position];
+        // Released early by its budget, or removed
+        if (endpoint->flushDeadline == 0)
+            continue;
+        if (endpoint->flushDeadline > now)
+        {
+            held_[kept++] = std::move(endpoint);
+            continue;
+        }
+        endpoint->flushDeadline = 0;
+        stats_.coalescedWrites++;
+
+        if (endpoint->shared)
+        {
+            writeShared(endpoint);
+            continue;
+        }
+        if (endpoint->local)
+        {
+            writeLocal(endpoint);
+            continue;
+        }
+
+        // Completion backend submits the send with its next wait, readiness backends write right away
+        if (ring_)
+        {
+            queueSend(endpoint);
+            continue;
+        }
+        auto found = socketMap_.find(endpoint->socket);
+        if (found != socketMap_.end() && getEndpoint(found->second) == endpoint)
+            writeEndpoint(found->second);
+    }
+    held_.resize(kept);
+}
+
+void Server::drainShardInbox()
+{
+    // Consume the wakeup before draining so a concurrent forward re-arms it
+    shardGroup_->clearWake(shardIndex_);
+
+    ShardMessage msg;
+    while (shardGroup_->nextMessage(shardIndex_, msg))
+    {
+        // Published messages reach every local subscriber and are never forwarded again
+        WireMessage wire(std::move(msg.payload));
+        wire.receivedAt = msg.receivedAt;
+        wire.forwarded = true;
+        // Header-routed text is only checked where it must be re-encoded, which may be on this shard
+        if (msg.publish)
+        {
+            if (!deliverTopic(msg.to, wire, INVALID_SLOT_HANDLE))
+                dropMalformed("cross-shard publish to " + msg.to);
+            continue;
+        }
+
+        auto recvEndpoint = getEndpoint(msg.to);
+        // Destination may have disconnected after the sender's shard located it
+        if (recvEndpoint)
+        {
+            if (!deliverMessage(recvEndpoint, wire, INVALID_SLOT_HANDLE))
+                dropMalformed("cross-shard message for " + msg.to);
+        }
+        else
+            LOG_WARNING(logger_, logToFile_, "Dropping cross-shard message for unknown endpoint: " + msg.to);
+    }
+
+    // Registrations on other shards may make parked messages routable
+    uint64_t generation = shardGroup_->registrationGeneration();
+    if (generation != registrationGeneration_)
+    {
+        registrationGeneration_ = generation;
+        registrationPending_ = true;
+    }
+}
+
+bool Server::createEndpoint(SOCKET clientSocket)
+{
+    EndpointHandle handle;
+    return createEndpoint(clientSocket, handle);
+}
+
+bool Server::createEndpoint(SOCKET clientSocket, EndpointHandle& handle)
+{
+    // Create shared pointer to endpoint and add to endpoint slots
+    return addEndpoint(std::allocate_shared<Endpoint>(PoolAllocator<Endpoint>(), clientSocket), handle);
+}
+
+bool Server::addEndpoint(std::shared_ptr<Endpoint> socketInfo, EndpointHandle& handle)
+{
+    SOCKET clientSocket = socketInfo->socket;
+    // Select cannot watch descriptors past FD_SETSIZE, a busy server needs the epoll or io_uring backend
+    if (backend_ == PollBackend::Select && !socketInfo->local && clientSocket != INVALID_SOCKET &&
+        (!sock::fitsSelect(clientSocket) || (socketInfo->shared && !sock::fitsSelect(socketInfo->shared->bell()))))
+    {
+        LOG_ERROR(logger_, logToFile_, "Socket " + std::to_string(clientSocket) + " exceeds FD_SETSIZE of the select backend");
+        return false;
+    }
+    socketInfo->backpressure = backpressure_;
+    socketInfo->coalescing = coalescing_;
+    socketInfo->setMaxFrameSize(maxFrameSize_);
+    socketInfo->metrics = metrics_->addEndpoint();
+    handle = endpoints_.insert(socketInfo);
+    socketInfo->slot = handle;
+    // In-process endpoints have no socket to watch, their client rings the hub
+    if (socketInfo->local)
+        return true;
+    socketMap_[clientSocket] = handle;
+    // Shared-memory endpoints are also found by their doorbell
+    SOCKET bell = socketInfo->shared ? socketInfo->shared->bell() : INVALID_SOCKET;
+    if (bell != INVALID_SOCKET)
+        socketMap_[bell] = handle;
+
+    // Begin watching socket, and doorbell, if using reactor
+    if (reactor_ && (!reactor_->add(clientSocket, false) || (bell != INVALID_SOCKET && !reactor_->add(bell, false))))
+    {
+        LOG_ERROR(logger_, logToFile_, "epoll_ctl(ADD) failed with error: " + std::to_string(sock::lastError()));
+        reactor_->remove(clientSocket);
+        endpoints_.erase(handle);
+        socketMap_.erase(clientSocket);
+        socketMap_.erase(bell);
+        metrics_->removeEndpoint(socketInfo->metrics);
+        return false;
+    }
+
+    // Begin receiving into provided buffers, or polling the doorbell, if using io_uring
+    if (ring_)
+    {
+        socketInfo->ioToken = ++nextIoToken_ & 0x0FFFFFFF;
+        if (socketInfo->shared)
+            armShared(socketInfo);
+        else
+            armRecv(socketInfo);
+    }
+
+    // Accepted sockets start with Nagle's algorithm on, only a policy asking otherwise costs a syscall
+    if (coalescing_.noDelay && clientSocket != INVALID_SOCKET && !socketInfo->shared)
+        sock::setNoDelay(clientSocket, true);
+    return true;
+}
+
+bool Server::registerEndpoint(std::string id, EndpointHandle handle)
+{
+    return registerEndpoint(id, handle, WireFormat::Text);
+}
+
+bool Server::registerEndpoint(std::string id, EndpointHandle handle, WireFormat format)
+{
+    return registerEndpoint(id, handle, format, "");
+}
+
+bool Server::registerEndpoint(std::string id, EndpointHandle handle, WireFormat format, const std::string& session)
+{
+    // Endpoint may have been removed since the handle was taken
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    if (!endpoint)
+    {
+        return false;
+    }
+    // Sessions live on one server, shards of a group register without them
+    bool resumable = !session.empty() && !shardGroup_;
+    if (!session.empty() && shardGroup_)
+        LOG_WARNING(logger_, logToFile_, "Registering without a session, shards do not keep sessions: " + id);
+    // The client of a session may take it over from a connection that is closed or not yet reaped
+    std::shared_ptr<Endpoint> previous = resumable ? getEndpoint(id) : nullptr;
+    if (previous && previous != endpoint)
+    {
+        if (previous->sessionToken != session || previous->format != format)
+        {
+            LOG_WARNING(logger_, logToFile_, "Rejecting registration with a mismatched session token or framing: " + id);
+            return false;
+        }
+        resumeSession(previous, endpoint, handle);
+        return true;
+    }
+    // A disconnected session holds its identifier until it is resumed or expires
+    if (sessions_.count(id) > 0)
+    {
+        return false;
+    }
+    // Identifiers are unique across every shard in a group
+    if (shardGroup_ && !shardGroup_->registerEndpoint(id, { shardIndex_, handle }))
+    {
+        return false;
+    }
+    // Attempt to register endpoint with identifier
+    auto ret = endpointMap_.insert({ id, handle });
+    // If failure, return
+    if (ret.second == false)
+    {
+        return false;
+    }
+    // If successful, set endpoint id value and log success message
+    else
+    {
+        endpoint->id = id;
+        endpoint->format = format;
+        metrics_->nameEndpoint(endpoint->metrics, id);
+        LOG_INFO(logger_, logToFile_, "Endpoint registered successfully: " + id);
+        // A new session counts the frames it is sent from its opening message on
+        if (resumable)
+        {
+            endpoint->sessionToken = session;
+            endpoint->framesSent = 0;
+            WireMessage opened = sessionMessage(id, 0, false);
+            deliverMessage(endpoint, opened, INVALID_SLOT_HANDLE);
+        }
+        // Deliver what was sent before the endpoint existed, in arrival order
+        for (Payload& msg : parked_.release(id, ParkClock::now()))
+        {
+            WireMessage wire(std::move(msg));
+            if (!deliverMessage(endpoint, wire, INVALID_SLOT_HANDLE))
+                dropMalformed("parked message for " + id);
+        }
+        return true;
+    }
+}
+
+bool Server::routeMessage(std::string_view msg, EndpointHandle handle)
+{
+    return routeMessage(RecvFrame{ msg, WireFormat::Text }, handle);
+}
+
+bool Server::routeMessage(const RecvFrame& frame, EndpointHandle handle)
+{
+    // Route text on header fields alone when they can be read without parsing
+    if (routingMode_ == RoutingMode::Header && frame.format == WireFormat::Text)
+    {
+        MsgHeader header;
+        // Registrations may negotiate framing, batches carry whole messages and replays carry numbers, so all are parsed in full
+        if (header.scan(frame.payload) && header.type != "registration" && header.type != "batch" && header.type != "replay")
+        {
+            if (routeHeader(header, frame.payload, handle))
+                return true;
+            LOG_WARNING(logger_, logToFile_, "Dropping message whose body is not valid JSON");
+            stats_.messagesMalformed++;
+            return false;
+        }
+    }
+
+    // Parse message in whichever format it arrived, a frame that does not decode or lacks a required field is dropped
+    try
+    {
+        json message = framing::decode(frame.payload, frame.format);
+        if (routeParsed(message, handle))
+            return true;
+        LOG_WARNING(logger_, logToFile_, "Dropping message that is not an object or lacks a field its type requires");
+    }
+    catch (const json::exception& e)
+    {
+        LOG_WARNING(logger_, logToFile_, std::string("Dropping message that could not be decoded: ") + e.what());
+    }
+    stats_.messagesMalformed++;
+    return false;
+}
+
+bool Server::routeParsed(json& message, EndpointHandle handle)
+{
+    if (!message.is_object())
+        return false;
+    // If registration message, attempt to register with the requested framing
+    if (message.contains(std::string("type")) && message["type"] == "registration")
+    {
+        if (!hasString(message, "value") || (message.contains(std::string("framing")) && !hasString(message, "framing")))
+            return false;
+        WireFormat format = WireFormat::Text;
+        if (message.contains(std::string("framing")) && !framing::parseFormat(message["framing"].get<std::string>(), format))
+        {
+            LOG_WARNING(logger_, logToFile_, "Rejecting registration with unknown framing: " + message["framing"].dump());
+            return true;
+        }
+        // Conflation applies before registration so parked messages conflate too
+        if (message.contains(std::string("conflate")) && message["conflate"].is_boolean())
+            setConflation(handle, message["conflate"].get<bool>());
+        std::string session;
+        if (message.contains(std::string("session")) && message["session"].is_string())
+            session = message["session"].get<std::string>();
+        registerEndpoint(message["value"], handle, format, session);
+    }
+    // If basic message, attempt to send to designated endpoint
+    else if (message.contains(std::string("type")) && message["type"] == "message")
+    {
+        if (!hasString(message, "to"))
+            return false;
+        std::string to = message["to"];
+        auto recvEndpoint = getEndpoint(to);
+        EndpointLocation location;
+        // If endpoint found, log success and add to message inbox, encoded as the receiver negotiated
+        if (recvEndpoint)
+        {
+            WireMessage wire(std::move(message));
+            wire.receivedAt = routeStamp_;
+            wire.lossy = routeLossy_;
+            LOG_DEBUG(logger_, logToFile_, "Sending message: " + *wire.payload(WireFormat::Text));
+            if (journal_)
+                journalMessage(JournalKind::Message, to, *wire.payload(WireFormat::Text));
+            deliverMessage(recvEndpoint, wire, handle);
+        }
+        // If endpoint owned by another shard, hand message over to that shard as text
+        else if (shardGroup_ && shardGroup_->locate(to, location) && location.shard != shardIndex_)
+        {
+            shardGroup_->forward(location.shard, { to, framing::makePayload(message.dump()), false, routeStamp_ });
+            instruments_.messagesForwarded->inc();
+        }
+        // If endpoint not found (possibly due to endpoint not registered yet), park message until a registration
+        else
+        {
+            Payload text = framing::makePayload(message.dump());
+            if (journal_)
+                journalMessage(JournalKind::Message, to, *text);
+            parkMessage(to, std::move(text));
+        }
+    }
+    // If subscription message, attempt to subscribe or unsubscribe sender
+    else if (message.contains(std::string("type")) && message["type"] == "subscribe")
+    {
+        if (!hasString(message, "value"))
+            return false;
+        subscribeEndpoint(message["value"], handle);
+    }
+    else if (message.contains(std::string("type")) && message["type"] == "unsubscribe")
+    {
+        if (!hasString(message, "value"))
+            return false;
+        unsubscribeEndpoint(message["value"], handle);
+    }
+    // If publish message, encode once per format and share with every subscriber of topic "to"
+    else if (message.contains(std::string("type")) && message["type"] == "publish")
+    {
+        if (!hasString(message, "to"))
+            return false;
+        std::string topic = message["to"];
+        WireMessage wire(std::move(message));
+        wire.receivedAt = routeStamp_;
+        wire.lossy = routeLossy_;
+        LOG_DEBUG(logger_, logToFile_, "Publishing message: " + *wire.payload(WireFormat::Text));
+        if (journal_)
+            journalMessage(JournalKind::Publish, topic, *wire.payload(WireFormat::Text));
+        publishMessage(topic, wire, handle);
+    }
+    // If stats request, reply to sender with the broker's metrics
+    else if (message.contains(std::string("type")) && message["type"] == "stats")
+    {
+        sendStats(handle);
+    }
+    // If batch, route every message it carries in order as if each had arrived on its own
+    else if (message.contains(std::string("type")) && message["type"] == "batch")
+    {
+        return routeBatch(message, handle);
+    }
+    // If channel message, open a datagram channel token for the sender
+    else if (message.contains(std::string("type")) && message["type"] == "channel")
+    {
+        if (!hasString(message, "value"))
+            return false;
+        openChannel(message["value"], handle);
+    }
+    // If replay request, catch the sender up on journaled messages from an offset or a time
+    else if (message.contains(std::string("type")) && message["type"] == "replay")
+    {
+        if (!journal_)
+            LOG_WARNING(logger_, logToFile_, "Ignoring replay request, no journal is open");
+        else if (message.contains(std::string("offset")) && message["offset"].is_number_unsigned())
+            replayJournal(handle, journal_->seek(message["offset"].get<uint64_t>()));
+        else if (message.contains(std::string("since")) && message["since"].is_number_unsigned())
+            replayJournal(handle, journal_->seekTime(message["since"].get<uint64_t>()));
+        else
+            replayJournal(handle, journal_->seek(journal_->startOffset()));
+    }
+    else
+    {
+        // Future message types will be handled here
+    }
+    return true;
+}
+
+bool Server::routeHeader(const MsgHeader& header, std::string_view msg, EndpointHandle handle)
+{
+    // If basic message, forward sender's bytes to designated endpoint
+    if (header.type == "message")
+    {
+        const std::string& to = routeTo_.assign(header.to);
+        auto recvEndpoint = getEndpoint(to);
+        if (recvEndpoint)
+        {
+            LOG_DEBUG(logger_, logToFile_, "Sending message from " + std::string(header.from) + " to " + to);
+            WireMessage wire(routedPayload(msg));
+            wire.receivedAt = routeStamp_;
+            wire.lossy = routeLossy_;
+            if (!deliverMessage(recvEndpoint, wire, handle))
+                return false;
+            if (journal_)
+                journalMessage(JournalKind::Message, to, msg);
+        }
+        // If endpoint owned by another shard, hand message over to that shard
+        else if (EndpointLocation location; shardGroup_ && shardGroup_->locate(to, location) && location.shard != shardIndex_)
+        {
+            shardGroup_->forward(location.shard, { to, routedPayload(msg), false, routeStamp_ });
+            instruments_.messagesForwarded->inc();
+        }
+        // If endpoint not found (possibly due to endpoint not registered yet), park message until a registration
+        else
+        {
+            if (journal_)
+                journalMessage(JournalKind::Message, to, msg);
+            parkMessage(to, routedPayload(msg));
+        }
+    }
+    // If subscription message, attempt to subscribe or unsubscribe sender
+    else if (header.type == "subscribe")
+    {
+        subscribeEndpoint(std::string(header.value), handle);
+    }
+    else if (header.type == "unsubscribe")
+    {
+        unsubscribeEndpoint(std::string(header.value), handle);
+    }
+    // If publish message, share sender's bytes with every subscriber of topic "to"
+    else if (header.type == "publish")
+    {
+        LOG_DEBUG(logger_, logToFile_, "Publishing message from " + std::string(header.from) + " to topic " + std::string(header.to));
+        WireMessage wire(routedPayload(msg));
+        wire.receivedAt = routeStamp_;
+        wire.lossy = routeLossy_;
+        if (!publishMessage(routeTo_.assign(header.to), wire, handle))
+            return false;
+        if (journal_)
+            journalMessage(JournalKind::Publish, header.to, msg);
+    }
+    // If stats request, reply to sender with the broker's metrics
+    else if (header.type == "stats")
+    {
+        sendStats(handle);
+    }
+    // If channel message, open a datagram channel token for the sender
+    else if (header.type == "channel")
+    {
+        openChannel(std::string(header.value), handle);
+    }
+    return true;
+}
+
+Payload Server::routedPayload(std::string_view msg)
+{
+    // In-process senders hand over a payload holding exactly these bytes
+    return routePayload_ ? routePayload_ : framing::makePayload(msg);
+}
+
+bool Server::routeBatch(json& batch, EndpointHandle handle)
+{
+    if (!batch.contains(std::string("messages")) || !batch["messages"].is_array())
+    {
+        LOG_WARNING(logger_, logToFile_, "Rejecting batch without a messages array");
+        return true;
+    }
+    stats_.batchesRouted++;
+    for (json& message : batch["messages"])
+    {
+        // Batches do not nest, so a batch costs one pass however it was built
+        if (!message.is_object() || (message.contains(std::string("type")) && message["type"] == "batch"))
+        {
+            LOG_WARNING(logger_, logToFile_, "Skipping batch element that is not a message: " + message.dump());
+            continue;
+        }
+        if (!routeParsed(message, handle))
+            return false;
+    }
+    return true;
+}
+
+bool Server::subscribeEndpoint(std::string topic, EndpointHandle handle)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    std::vector<std::string>& subscribed = endpoint->topics;
+    if (std::find(subscribed.begin(), subscribed.end(), topic) != subscribed.end())
+        return false;
+
+    // First local subscriber makes this shard a publish destination
+    std::vector<std::shared_ptr<Endpoint>>& subscribers = topics_[topic];
+    if (subscribers.empty() && shardGroup_)
+        shardGroup_->subscribeTopic(topic, shardIndex_);
+    subscribers.push_back(endpoint);
+    subscribed.push_back(topic);
+    LOG_INFO(logger_, logToFile_, "Endpoint subscribed to topic: " + topic);
+    return true;
+}
+
+bool Server::unsubscribeEndpoint(const std::string& topic, EndpointHandle handle)
+{
+    return unsubscribeEndpoint(topic, getEndpoint(handle));
+}
+
+bool Server::unsubscribeEndpoint(const std::string& topic, const std::shared_ptr<Endpoint>& endpoint)
+{
+    std::vector<std::string>& subscribed = endpoint->topics;
+    auto topicPos = std::find(subscribed.begin(), subscribed.end(), topic);
+    if (topicPos == subscribed.end())
+        return false;
+    subscribed.erase(topicPos);
+
+    // Last local subscriber leaving removes the topic from this shard
+    auto found = topics_.find(topic);
+    std::vector<std::shared_ptr<Endpoint>>& subscribers = found->second;
+    subscribers.erase(std::find(subscribers.begin(), subscribers.end(), endpoint));
+    if (subscribers.empty())
+    {
+        topics_.erase(found);
+        if (shardGroup_)
+            shardGroup_->unsubscribeTopic(topic, shardIndex_);
+    }
+    return true;
+}
+
+bool Server::openChannel(const std::string& token, EndpointHandle handle)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    if (!endpoint || token.empty())
+        return false;
+    auto ret = channelTokens_.insert({ token, handle });
+    if (!ret.second && ret.first->second != handle)
+    {
+        LOG_WARNING(logger_, logToFile_, "Rejecting datagram channel token already in use");
+        return false;
+    }
+    // A new token replaces the endpoint's previous one, a linked peer stays linked
+    if (!endpoint->channelToken.empty() && endpoint->channelToken != token)
+        channelTokens_.erase(endpoint->channelToken);
+    endpoint->channelToken = token;
+    return true;
+}
+
+void Server::readDatagrams()
+{
+    DatagramAddress from;
+    while (true)
+    {
+        stats_.syscalls++;
+        int received = sock::recvFrom(datagramSocket_, datagramBuffer_.data(), datagramBuffer_.size(), from);
+        if (received == SOCKET_ERROR)
+        {
+            // Socket drained, wait for next edge
+            if (sock::wouldBlock(sock::lastError()))
+                return;
+            // Errors such as an unreachable peer report on one earlier send, later datagrams are still readable
+            LOG_DEBUG(logger_, logToFile_, "recvfrom() failed with error: " + std::to_string(sock::lastError()));
+            continue;
+        }
+        receiveDatagram(std::string_view(datagramBuffer_.data(), received), from);
+    }
+}
+
+void Server::receiveDatagram(std::string_view datagram, const DatagramAddress& from)
+{
+    uint64_t sequence;
+    std::string_view payload;
+    if (!framing::readDatagram(datagram, sequence, payload))
+    {
+        stats_.datagramsDropped++;
+        return;
+    }
+
+    // Datagrams from a linked peer route as sent by its endpoint, unless overtaken by a newer one
+    auto linked = channels_.find(channelKey(from));
+    std::shared_ptr<Endpoint> endpoint = linked != channels_.end() ? getEndpoint(linked->second) : nullptr;
+    if (endpoint && sequence > endpoint->datagramSeqIn)
+    {
+        endpoint->datagramSeqIn = sequence;
+        stats_.datagramsIn++;
+        if (endpoint->metrics)
+        {
+            endpoint->metrics->bytesIn.add(datagram.size());
+            endpoint->metrics->messagesIn.add(1);
+        }
+        routeStamp_ = endpoint->metrics ? MetricsRegistry::now() : 0;
+        routeLossy_ = true;
+        // A malformed datagram is dropped alone, its channel's stream connection stays up
+        if (!routeMessage(RecvFrame{ payload, endpoint->format }, linked->second))
+            stats_.datagramsDropped++;
+        routeLossy_ = false;
+        routeStamp_ = 0;
+        return;
+    }
+
+    // Anything else only gets through as a hello. Hellos carry sequence 0, so a repeated
+    // hello from a linked peer lands here too and is acknowledged again
+    MsgHeader header;
+    if (header.scan(payload) && header.type == "channel" && linkChannel(std::string(header.value), from, sequence))
+        return;
+    stats_.datagramsDropped++;
+}
+
+bool Server::linkChannel(const std::string& token, const DatagramAddress& from, uint64_t sequence)
+{
+    auto holder = channelTokens_.find(token);
+    if (holder == channelTokens_.end())
+        return false;
+    EndpointHandle handle = holder->second;
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+
+    // A peer that moved, for example after a NAT rebinding, leaves its old address behind
+    if (endpoint->channelLinked)
+        channels_.erase(channelKey(endpoint->channelPeer));
+    auto linked = channels_.insert({ channelKey(from), handle });
+    if (!linked.second)
+    {
+        // Address reused by another client unlinks the endpoint that held it
+        std::shared_ptr<Endpoint> previous = getEndpoint(linked.first->second);
+        if (previous && previous != endpoint)
+            previous->channelLinked = false;
+        linked.first->second = handle;
+    }
+    endpoint->channelLinked = true;
+    endpoint->channelPeer = from;
+    endpoint->datagramSeqIn = sequence;
+    LOG_INFO(logger_, logToFile_, "Datagram channel linked: " + endpoint->id);
+
+    // Acknowledge so the client knows its datagrams are accepted
+    json ack = { { "type", "channel" }, { "from", "hsif" }, { "value", token } };
+    sendDatagram(endpoint, framing::makePayload(framing::encode(ack, endpoint->format)));
+    return true;
+}
+
+bool Server::sendDatagram(const std::shared_ptr<Endpoint>& receiver, const Payload& payload)
+{
+    if (payload->length() > DATAGRAM_PAYLOAD_MAX)
+        return false;
+
+    char header[DATAGRAM_HEADER_MAX];
+    IoVec vecs[2];
+    sock::setIoVec(vecs[0], header, framing::writeDatagramHeader(header, ++receiver->datagramSeqOut));
+    sock::setIoVec(vecs[1], payload->data(), payload->length());
+    stats_.syscalls++;
+    int sent = sock::sendTo(datagramSocket_, vecs, 2, receiver->channelPeer);
+    if (sent == SOCKET_ERROR)
+    {
+        stats_.datagramsDropped++;
+        return true;
+    }
+    stats_.datagramsOut++;
+    if (receiver->metrics)
+    {
+        receiver->metrics->bytesOut.add(sent);
+        receiver->metrics->messagesOut.add(1);
+    }
+    return true;
+}
+
+bool Server::publishMessage(const std::string& topic, WireMessage& msg, EndpointHandle sender)
+{
+    stats_.messagesPublished++;
+    if (!deliverTopic(topic, msg, sender))
+        return false;
+
+    // Other shards receive the same shared payload once each, however many subscribers they own
+    if (shardGroup_)
+    {
+        shardGroup_->topicShards(topic, topicShards_);
+        for (size_t shard : topicShards_)
+        {
+            if (shard != shardIndex_)
+                shardGroup_->forward(shard, { topic, msg.payload(WireFormat::Text), true, msg.receivedAt });
+        }
+    }
+    return true;
+}
+
+bool Server::deliverTopic(const std::string& topic, WireMessage& msg, EndpointHandle sender)
+{
+    auto found = topics_.find(topic);
+    if (found == topics_.end())
+        return true;
+    msg.conflate = !conflatedTopics_.empty() && conflatedTopics_.count(topic) > 0;
+    // Subscribers taking the sender's text still receive it when others cannot
+    bool delivered = true;
+    for (const std::shared_ptr<Endpoint>& subscriber : found->second)
+        delivered = deliverMessage(subscriber, msg, sender) && delivered;
+    return delivered;
+}
+
+void Server::dropMalformed(const std::string& what)
+{
+    LOG_WARNING(logger_, logToFile_, "Dropping " + what + " whose body is not valid JSON");
+    stats_.messagesMalformed++;
+}
+
+bool Server::deleteEndpoint(EndpointHandle handle)
+{
+    // Stale handles refer to nothing and are ignored
+    auto endPoint = getEndpoint(handle);
+    if (!endPoint)
+        return false;
+    // Dispose of socket connection
+    SOCKET bell = endPoint->shared ? endPoint->shared->bell() : INVALID_SOCKET;
+    if (reactor_ && !endPoint->local)
+    {
+        reactor_->remove(endPoint->socket);
+        if (bell != INVALID_SOCKET)
+            reactor_->remove(bell);
+    }
+    // Pending io_uring requests may still name the socket, close it after the next submission.
+    // In-process endpoints have no requests, their channel closes right away
+    if (ring_ && !endPoint->local)
+    {
+        if (bell != INVALID_SOCKET)
+        {
+            ring_->prepCancel(uringData(URING_SHARED, endPoint->ioToken, bell), uringData(URING_CANCEL, 0, bell));
+            ring_->prepCancel(uringData(URING_SHARED, endPoint->ioToken, endPoint->socket), uringData(URING_CANCEL, 0, endPoint->socket));
+        }
+        else
+            ring_->prepCancel(uringData(URING_RECV, endPoint->ioToken, endPoint->socket), uringData(URING_CANCEL, 0, endPoint->socket));
+        retiredEndpoints_.push_back(endPoint);
+    }
+    else
+        endPoint->cleanup();
+    // A registered session outlives its connection for the grace period, keeping its queue and subscriptions
+    auto registered = endpointMap_.find(endPoint->id);
+    bool owner = registered != endpointMap_.end() && registered->second == handle;
+    bool detached = owner && detachSession(endPoint);
+    // Otherwise drop subscriptions so publishes no longer reach the removed endpoint
+    while (!detached && !endPoint->topics.empty())
+        unsubscribeEndpoint(endPoint->topics.back(), handle);
+    // Senders blocked by the removed endpoint resume unless its session is kept, a removed sender is no longer paused
+    if (endPoint->pressured && !detached)
+    {
+        endPoint->pressured = false;
+        stats_.pressuredEndpoints--;
+        releaseSenders(endPoint);
+    }
+    if (endPoint->blockedOn > 0)
+        stats_.pausedSenders--;
+    endPoint->blockedOn = 0;
+    // Held frames and the rest of a replay are discarded with the endpoint
+    endPoint->flushDeadline = 0;
+    endPoint->replaying = false;
+    // Datagram channel closes with the endpoint
+    auto token = channelTokens_.find(endPoint->channelToken);
+    if (token != channelTokens_.end() && token->second == handle)
+        channelTokens_.erase(token);
+    if (endPoint->channelLinked)
+    {
+        auto channel = channels_.find(channelKey(endPoint->channelPeer));
+        if (channel != channels_.end() && channel->second == handle)
+            channels_.erase(channel);
+        endPoint->channelLinked = false;
+    }
+    // Traffic of the removed endpoint stays in the totals
+    metrics_->removeEndpoint(endPoint->metrics);
+    // Remove endpoint reference from maps and slots, every other handle stays valid
+    endpoints_.erase(handle);
+    if (owner)
+        endpointMap_.erase(registered);
+    if (shardGroup_ && endPoint->id != "")
+        shardGroup_->unregisterEndpoint(endPoint->id, shardIndex_);
+    auto mapped = socketMap_.find(endPoint->socket);
+    if (mapped != socketMap_.end() && mapped->second == handle)
+        socketMap_.erase(mapped);
+    mapped = socketMap_.find(bell);
+    if (bell != INVALID_SOCKET && mapped != socketMap_.end() && mapped->second == handle)
+        socketMap_.erase(mapped);
+    return true;
+}
+
+std::shared_ptr<Endpoint> Server::getEndpoint(const std::string& id)
+{
+    // If endpoint exists in map, return
+    auto found = endpointMap_.find(id);
+    if (found != endpointMap_.end())
+        return getEndpoint(found->second);
+
+    // A disconnected session keeps receiving into its queue until it is resumed or expires
+    auto session = sessions_.find(id);
+    if (session != sessions_.end())
+        return session->second;
+
+    // Return null if not found
+    return nullptr;
+}
+
+std::shared_ptr<Endpoint> Server::getEndpoint(EndpointHandle handle)
+{
+    std::shared_ptr<Endpoint>* endpoint = endpoints_.get(handle);
+    return endpoint ? *endpoint : nullptr;
+}
+
+size_t Server::numEndpoints()
+{
+    return endpoints_.size();
+}
+
+size_t Server::numRegisteredEndpoints()
+{
+    return endpointMap_.size();
+}
+
+size_t Server::numSubscribers(const std::string& topic)
+{
+    auto found = topics_.find(topic);
+    return found == topics_.end() ? 0 : found->second.size();
+}
+
+size_t Server::numDetachedSessions()
+{
+    return sessions_.size();
+}
+
+PollBackend Server::backend()
+{
+    return backend_;
+}
+
+void Server::setDatagramPort(unsigned int port)
+{
+    datagramPort_ = port;
+}
+
+void Server::setSharedPath(const std::string& path)
+{
+    sharedPath_ = path;
+}
+
+void Server::setLocalEndpoints(bool enabled)
+{
+    localEnabled_ = enabled;
+}
+
+void Server::setUpgradePath(const std::string& path)
+{
+    upgradePath_ = path;
+}
+
+bool Server::attachLocal(std::shared_ptr<LocalChannel> channel)
+{
+    if (!localEnabled_ || !localHub_)
+        return false;
+    channel->open(localHub_);
+    return true;
+}
+
+bool Server::wake()
+{
+    // Rings the eventfd in-process clients share, so the wait returns without touching the listener
+    if (!localHub_)
+        return false;
+    localHub_->ring();
+    return true;
+}
+
+bool Server::takeOver(const std::string& path)
+{
+    // Initialize socket library
+    int wsaRet;
+    if ((wsaRet = sock::startup()) != 0)
+    {
+        LOG_ERROR(logger_, logToFile_, "WSAStartup() failed with error: " + std::to_string(wsaRet));
+        sock::teardown();
+        return false;
+    }
+
+    SOCKET control = sock::connectLocal(path);
+    if (control == INVALID_SOCKET)
+    {
+        LOG_ERROR(logger_, logToFile_, "Connecting to the upgrade listener on " + path + " failed with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    HandoffState state;
+    std::vector<SOCKET> handles;
+    if (!handoff::receive(control, state, handles))
+    {
+        LOG_ERROR(logger_, logToFile_, "Receiving the hand-off from " + path + " failed with error: " + std::to_string(sock::lastError()));
+        sock::close(control);
+        return false;
+    }
+
+    // Client sockets follow the listener and datagram socket, every index must name one of them
+    size_t firstClient = state.hasDatagrams ? 2 : 1;
+    bool valid = handles.size() >= firstClient && backend_ != PollBackend::Uring && !shardGroup_;
+    for (const HandoffEndpoint& entry : state.endpoints)
+        valid = valid && (entry.socketIndex < 0 || (static_cast<size_t>(entry.socketIndex) >= firstClient && static_cast<size_t>(entry.socketIndex) < handles.size()));
+    if (!valid)
+    {
+        LOG_ERROR(logger_, logToFile_, "Rejecting hand-off from " + path + ", it does not fit this server");
+        for (SOCKET handle : handles)
+            sock::close(handle);
+        sock::close(control);
+        return false;
+    }
+
+    listenSocket_ = handles[0];
+    port_ = sock::localPort(listenSocket_);
+    if (state.hasDatagrams)
+    {
+        datagramSocket_ = handles[1];
+        datagramPort_ = sock::localPort(datagramSocket_);
+    }
+    // The next successor connects where this one did unless configured otherwise
+    if (upgradePath_.empty())
+        upgradePath_ = path;
+    if (!connectServices())
+    {
+        // Without an acknowledgement the previous server keeps serving, its connections are left open
+        for (size_t index = firstClient; index < handles.size(); index++)
+            sock::close(handles[index]);
+        sock::close(control);
+        return false;
+    }
+    adoptState(state, handles);
+
+    if (!handoff::acknowledge(control))
+    {
+        LOG_ERROR(logger_, logToFile_, "Acknowledging the hand-off from " + path + " failed with error: " + std::to_string(sock::lastError()));
+        for (const std::shared_ptr<Endpoint>& endpoint : endpoints_)
+        {
+            if (reactor_ && endpoint->socket != INVALID_SOCKET)
+                reactor_->remove(endpoint->socket);
+            sock::close(endpoint->socket);
+            endpoint->socket = INVALID_SOCKET;
+        }
+        sock::close(control);
+        return false;
+    }
+    sock::close(control);
+    LOG_INFO(logger_, logToFile_, "Took over " + std::to_string(endpoints_.size()) + " connections and " + std::to_string(sessions_.size()) + " disconnected sessions from " + path);
+    return true;
+}
+
+void Server::adoptState(const HandoffState& state, const std::vector<SOCKET>& handles)
+{
+    uint64_t now = MetricsRegistry::now();
+    for (const HandoffEndpoint& entry : state.endpoints)
+    {
+        bool connected = entry.socketIndex >= 0;
+        auto endpoint = std::allocate_shared<Endpoint>(PoolAllocator<Endpoint>(), connected ? handles[entry.socketIndex] : INVALID_SOCKET);
+        EndpointHandle handle = INVALID_SLOT_HANDLE;
+        if (connected && !addEndpoint(endpoint, handle))
+        {
+            LOG_ERROR(logger_, logToFile_, "Dropping handed over connection: " + entry.id);
+            sock::close(endpoint->socket);
+            continue;
+        }
+        endpoint->format = entry.format;
+        endpoint->conflate = entry.conflate;
+        endpoint->sessionToken = entry.sessionToken;
+        endpoint->framesSent = entry.framesSent;
+        endpoint->datagramSeqIn = entry.datagramSeqIn;
+        endpoint->datagramSeqOut = entry.datagramSeqOut;
+        // The next receive completes the frame the previous server read part of
+        endpoint->restoreRecv(entry.unparsed);
+        // Frames already carry their headers, the first continues where the previous server stopped writing
+        for (const std::string& frame : entry.outbound)
+            endpoint->outbound.pushFramed(framing::makePayload(frame));
+
+        if (!connected)
+        {
+            // Disconnected sessions keep what is left of their grace period
+            endpoint->id = entry.id;
+            endpoint->detachedUntil = now + std::max<uint64_t>(entry.graceLeftNs, 1);
+            if (sessions_.empty() || endpoint->detachedUntil < sessionExpiry_)
+                sessionExpiry_ = endpoint->detachedUntil;
+            sessions_[entry.id] = endpoint;
+        }
+        else if (!entry.id.empty() && endpointMap_.insert({ entry.id, handle }).second)
+        {
+            endpoint->id = entry.id;
+            metrics_->nameEndpoint(endpoint->metrics, entry.id);
+        }
+
+        // Subscribers keep the order they had on the previous server
+        for (const std::string& topic : entry.topics)
+        {
+            topics_[topic].push_back(endpoint);
+            endpoint->topics.push_back(topic);
+        }
+
+        if (!connected)
+            continue;
+        if (!entry.channelToken.empty() && channelTokens_.insert({ entry.channelToken, handle }).second)
+            endpoint->channelToken = entry.channelToken;
+        // Peer bytes are the channel key, as copied from the address the previous server linked
+        if (!entry.channelPeer.empty() && entry.channelPeer.size() <= sizeof(endpoint->channelPeer.storage))
+        {
+            std::memcpy(&endpoint->channelPeer.storage, entry.channelPeer.data(), entry.channelPeer.size());
+            endpoint->channelPeer.length = static_cast<socklen_t>(entry.channelPeer.size());
+            endpoint->channelLinked = true;
+            channels_[entry.channelPeer] = handle;
+        }
+        updateWriteInterest(endpoint);
+    }
+
+    // Parked messages wait out a full TTL again
+    for (const HandoffParked& destination : state.parked)
+    {
+        for (const std::string& msg : destination.messages)
+            parkMessage(destination.to, framing::makePayload(msg));
+    }
+}
+
+void Server::acceptSuccessor()
+{
+    // Edge-triggered listener is drained, a successor that fails leaves the next its turn
+    SOCKET control;
+    while (!handedOff_ && (control = accept(upgradeListenSocket_, NULL, NULL)) != INVALID_SOCKET)
+    {
+        stats_.syscalls++;
+        handOff(control);
+        sock::close(control);
+    }
+}
+
+bool Server::handOff(SOCKET control)
+{
+    HandoffState state;
+    state.hasDatagrams = datagramSocket_ != INVALID_SOCKET;
+    std::vector<SOCKET> handles = { listenSocket_ };
+    if (state.hasDatagrams)
+        handles.push_back(datagramSocket_);
+
+    auto snapshot = [](Endpoint& endpoint, int64_t socketIndex) {
+        HandoffEndpoint entry;
+        entry.socketIndex = socketIndex;
+        entry.id = endpoint.id;
+        entry.format = endpoint.format;
+        entry.topics = endpoint.topics;
+        entry.conflate = endpoint.conflate;
+        entry.sessionToken = endpoint.sessionToken;
+        entry.framesSent = endpoint.framesSent;
+        entry.graceLeftNs = 0;
+        entry.channelToken = endpoint.channelToken;
+        if (endpoint.channelLinked)
+            entry.channelPeer = channelKey(endpoint.channelPeer);
+        entry.datagramSeqIn = endpoint.datagramSeqIn;
+        entry.datagramSeqOut = endpoint.datagramSeqOut;
+        endpoint.outbound.copyUnsent(entry.outbound);
+        return entry;
+    };
+    // Shared-memory and in-process clients are tied to this process, only socket clients are handed over
+    for (const std::shared_ptr<Endpoint>& endpoint : endpoints_)
+    {
+        if (endpoint->shared || endpoint->local)
+            continue;
+        state.endpoints.push_back(snapshot(*endpoint, static_cast<int64_t>(handles.size())));
+        state.endpoints.back().unparsed = endpoint->unparsedRecv();
+        handles.push_back(endpoint->socket);
+    }
+    uint64_t now = MetricsRegistry::now();
+    for (const auto& session : sessions_)
+    {
+        state.endpoints.push_back(snapshot(*session.second, -1));
+        state.endpoints.back().graceLeftNs = session.second->detachedUntil > now ? session.second->detachedUntil - now : 0;
+    }
+    for (const std::string& to : parked_.destinations())
+    {
+        HandoffParked destination = { to, {} };
+        for (const Payload& msg : parked_.peek(to, ParkClock::now()))
+            destination.messages.push_back(*msg);
+        state.parked.push_back(std::move(destination));
+    }
+
+    stats_.syscalls++;
+    if (!handoff::send(control, state, handles) || !handoff::awaitAcknowledgement(control))
+    {
+        LOG_ERROR(logger_, logToFile_, "Hand-off to successor failed, still serving: " + std::to_string(sock::lastError()));
+        return false;
+    }
+
+    // The successor holds its own copies, closing these without a shutdown leaves the connections open
+    for (const std::shared_ptr<Endpoint>& endpoint : endpoints_)
+    {
+        if (endpoint->local)
+            continue;
+        if (reactor_)
+        {
+            reactor_->remove(endpoint->socket);
+            if (endpoint->shared)
+                reactor_->remove(endpoint->shared->bell());
+        }
+        // Shared-memory clients see their connection close and reconnect to the successor
+        if (endpoint->shared)
+            endpoint->cleanup();
+        else
+            sock::close(endpoint->socket);
+        endpoint->socket = INVALID_SOCKET;
+    }
+    for (SOCKET* listener : { &listenSocket_, &datagramSocket_, &upgradeListenSocket_, &sharedListenSocket_ })
+    {
+        if (*listener == INVALID_SOCKET)
+            continue;
+        if (reactor_)
+            reactor_->remove(*listener);
+        // Socket files stay, the successor may have bound the same paths
+        sock::close(*listener);
+        *listener = INVALID_SOCKET;
+    }
+    // Closing syncs the journal before the successor opens it
+    journal_.reset();
+    handedOff_ = true;
+    LOG_INFO(logger_, logToFile_, "Handed " + std::to_string(handles.size()) + " sockets and " + std::to_string(sessions_.size()) + " disconnected sessions to successor");
+    return true;
+}
+
+bool Server::handedOff()
+{
+    return handedOff_;
+}
+
+bool Server::openJournal(const std::string& directory, JournalPolicy policy)
+{
+    if (shardGroup_)
+    {
+        LOG_WARNING(logger_, logToFile_, "Shards do not journal, ignoring journal directory: " + directory);
+        return false;
+    }
+    auto journal = std::make_unique<Journal>();
+    if (!journal->open(directory, policy))
+    {
+        LOG_ERROR(logger_, logToFile_, "Journal open failed in " + directory + " with error: " + std::to_string(sock::lastError()));
+        return false;
+    }
+    LOG_INFO(logger_, logToFile_, "Journal opened in " + directory + " at offset " + std::to_string(journal->endOffset()));
+    journal_ = std::move(journal);
+    return true;
+}
+
+Journal* Server::journal()
+{
+    return journal_.get();
+}
+
+void Server::setRoutingMode(RoutingMode mode)
+{
+    routingMode_ = mode;
+}
+
+void Server::setBackpressurePolicy(BackpressurePolicy policy)
+{
+    backpressure_ = policy;
+    for (const std::shared_ptr<Endpoint>& endpoint : endpoints_)
+        endpoint->backpressure = policy;
+}
+
+bool Server::setBackpressurePolicy(EndpointHandle handle, BackpressurePolicy policy)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    if (!endpoint)
+        return false;
+    endpoint->backpressure = policy;
+    return true;
+}
+
+void Server::setCoalescingPolicy(CoalescingPolicy policy)
+{
+    coalescing_ = policy;
+    for (size_t position = 0; position < endpoints_.size(); position++)
+        setCoalescingPolicy(endpoints_.handleAt(position), policy);
+}
+
+bool Server::setCoalescingPolicy(EndpointHandle handle, CoalescingPolicy policy)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    if (!endpoint)
+        return false;
+    if (endpoint->socket != INVALID_SOCKET && policy.noDelay != endpoint->coalescing.noDelay)
+        sock::setNoDelay(endpoint->socket, policy.noDelay);
+    endpoint->coalescing = policy;
+    // Frames held under the old window are released on the next poll
+    if (endpoint->flushDeadline != 0)
+        endpoint->flushDeadline = 1;
+    return true;
+}
+
+void Server::setMaxFrameSize(size_t bytes)
+{
+    maxFrameSize_ = bytes;
+    for (const std::shared_ptr<Endpoint>& endpoint : endpoints_)
+        endpoint->setMaxFrameSize(bytes);
+}
+
+bool Server::setConflation(EndpointHandle handle, bool conflate)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    if (!endpoint)
+        return false;
+    endpoint->conflate = conflate;
+    return true;
+}
+
+void Server::setTopicConflation(const std::string& topic, bool conflate)
+{
+    if (conflate)
+        conflatedTopics_.insert(topic);
+    else
+        conflatedTopics_.erase(topic);
+}
+
+void Server::setSessionPolicy(SessionPolicy policy)
+{
+    sessionPolicy_ = policy;
+}
+
+void Server::setParkingPolicy(ParkingPolicy policy)
+{
+    parked_.setPolicy(policy);
+}
+
+size_t Server::numParked(const std::string& to)
+{
+    return parked_.size(to);
+}
+
+ServerStats Server::stats()
+{
+    ParkingStats parking = parked_.stats();
+    stats_.messagesParked = parking.parked;
+    stats_.messagesExpired = parking.expired;
+    stats_.messagesDropped = parking.dropped;
+    return stats_;
+}
+
+std::shared_ptr<MetricsRegistry> Server::metrics()
+{
+    return metrics_;
+}
+
+void Server::sendStats(EndpointHandle handle)
+{
+    std::shared_ptr<Endpoint> endpoint = getEndpoint(handle);
+    instruments_.statsRequests->inc();
+    updateMetrics();
+
+    // Every shard's registry is safe to read from here, so the reply covers the whole group
+    std::vector<MetricsSnapshot> snapshots;
+    if (shardGroup_)
+    {
+        for (size_t shard = 0; shard < shardGroup_->numShards(); shard++)
+            snapshots.push_back(shardGroup_->metrics(shard)->snapshot());
+    }
+    else
+        snapshots.push_back(metrics_->snapshot());
+
+    WireMessage wire(statsDocument(MetricsRegistry::merge(snapshots), endpoint->id));
+    deliverMessage(endpoint, wire, INVALID_SLOT_HANDLE);
+}
+
+void Server::joinShardGroup(ShardGroup* group, size_t shard)
+{
+    shardGroup_ = group;
+    shardIndex_ = shard;
+    metrics_->setShard(std::to_string(shard));
 }
 
 void Server::cleanup()
 {
+    // In-process clients see their channels close, including those not attached yet
+    for (const std::shared_ptr<Endpoint>& endpoint : endpoints_)
+    {
+        if (endpoint->local)
+            endpoint->local->close();
+    }
+    std::weak_ptr<LocalChannel> pending;
+    while (localHub_ && localHub_->next(pending))
+    {
+        if (auto channel = pending.lock())
+            channel->close();
+    }
+    localHub_.reset();
     // Dispose of socket resources
-    closesocket(listenSocket_);
-    WSACleanup();
-}
\ No newline at end of file
+    reactor_.reset();
+    for (auto& endpoint : retiredEndpoints_)
+        endpoint->cleanup();
+    retiredEndpoints_.clear();
+    inflightSends_.clear();
+    ring_.reset();
+    // Closing syncs whatever the last group commit has not
+    journal_.reset();
+    sessions_.clear();
+    sock::close(listenSocket_);
+    if (datagramSocket_ != INVALID_SOCKET)
+        sock::close(datagramSocket_);
+    // The socket file would otherwise outlive the listener
+    if (sharedListenSocket_ != INVALID_SOCKET)
+    {
+        sock::close(sharedListenSocket_);
+        std::remove(sharedPath_.c_str());
+    }
+    if (upgradeListenSocket_ != INVALID_SOCKET)
+    {
+        sock::close(upgradeListenSocket_);
+        std::remove(upgradePath_.c_str());
+    }
+    sock::teardown();
+}
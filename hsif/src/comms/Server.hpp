@@ -1,13 +1,22 @@
 #pragma once
 
 #include "Endpoint.hpp"
+#include "EpollReactor.hpp"
+#include "Handoff.hpp"
+#include "IoUring.hpp"
+#include "Journal.hpp"
+#include "MsgHeader.hpp"
+#include "ParkedQueues.hpp"
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <string>
 #include <any>
 #include <mutex>
 #include "Logger.hpp"
+#include "SlotMap.hpp"
+#include "Metrics.hpp"
 
 /*
 Copyright 2020 Itreau Bigsby
@@ -25,7 +34,149 @@ limitations under the License.
 @author   Itreau Bigsby    mailto:ibigsby@asu.edu
  */
 
-using EndpointMap = std::unordered_map<std::string, size_t>;
+class ShardGroup;
+
+using EndpointHandle = SlotHandle;
+using EndpointMap = std::unordered_map<std::string, EndpointHandle>;
+using SocketMap = std::unordered_map<SOCKET, EndpointHandle>;
+using TopicMap = std::unordered_map<std::string, std::vector<std::shared_ptr<Endpoint>>>;
+
+/// <summary>
+/// Socket readiness mechanism used by Server::poll.
+/// </summary>
+enum class PollBackend
+{
+	// Portable select() loop that rebuilds descriptor sets every poll
+	Select,
+	// Edge-triggered epoll reactor (Linux only)
+	Epoll,
+	// Completion based io_uring transport with multishot accept/recv (Linux 6.0+ only)
+	Uring
+};
+
+/// <summary>
+/// How Server::routeMessage reads incoming messages.
+/// </summary>
+enum class RoutingMode
+{
+	// Parse every message into a JSON document and forward it re-serialized
+	Parse,
+	// Scan only the top-level routing fields and forward the sender's bytes unchanged
+	Header
+};
+
+/// <summary>
+/// How long the broker keeps the state of a disconnected session for its client to resume.
+/// </summary>
+struct SessionPolicy
+{
+	// Time a disconnected session keeps its queue and subscriptions, zero to drop it on disconnect
+	std::chrono::milliseconds grace;
+	// Disconnected sessions kept at once, sessions disconnecting beyond it are dropped
+	size_t maxDetached;
+};
+
+// Session limits used unless a server is configured otherwise
+#define DEFAULT_SESSION_POLICY SessionPolicy{ std::chrono::seconds(30), 1024 }
+
+/// <summary>
+/// Counters describing server I/O efficiency.
+/// </summary>
+struct ServerStats
+{
+	// Socket and readiness syscalls issued by poll()
+	uint64_t syscalls;
+	// Messages delivered to a destination endpoint
+	uint64_t messagesRouted;
+	// Publish messages fanned out to topic subscribers
+	uint64_t messagesPublished;
+	// Messages parked for a destination that had not registered yet
+	uint64_t messagesParked;
+	// Parked messages discarded after outliving the parking TTL
+	uint64_t messagesExpired;
+	// Messages discarded because a parked queue was full
+	uint64_t messagesDropped;
+	// Frames that could not be decoded or lacked a field their type requires, dropped with their sender
+	uint64_t messagesMalformed;
+	// Endpoints currently above their high watermark under OverflowPolicy::Block
+	uint64_t pressuredEndpoints;
+	// Senders currently paused by a pressured receiver
+	uint64_t pausedSenders;
+	// Times a sender was paused
+	uint64_t senderPauses;
+	// Queued frames discarded under OverflowPolicy::DropOldest
+	uint64_t overflowDrops;
+	// Receivers disconnected under OverflowPolicy::Disconnect
+	uint64_t overflowDisconnects;
+	// Batch messages split and routed
+	uint64_t batchesRouted;
+	// Held writes released by their coalescing window or byte budget
+	uint64_t coalescedWrites;
+	// Undelivered messages replaced by a newer message with the same conflation key
+	uint64_t messagesConflated;
+	// Datagrams routed from linked channels, and sent to them
+	uint64_t datagramsIn;
+	uint64_t datagramsOut;
+	// Datagrams discarded: malformed, stale, from an unlinked peer, or not accepted by the socket
+	uint64_t datagramsDropped;
+	// Messages appended to the journal, and group commits syncing them to disk
+	uint64_t messagesJournaled;
+	uint64_t journalSyncs;
+	// Journaled messages delivered by catch-up replays
+	uint64_t messagesReplayed;
+	// Sessions taken over by a reconnecting client, and disconnected sessions dropped after their grace period
+	uint64_t sessionsResumed;
+	uint64_t sessionsExpired;
+};
+
+/// <summary>
+/// Metrics a server updates while polling, owned by its MetricsRegistry.
+/// </summary>
+struct ServerMetrics
+{
+	// Completed polls
+	Counter* polls;
+	// Mirrors of ServerStats, refreshed after every poll
+	Counter* syscalls;
+	Counter* messagesRouted;
+	Counter* messagesPublished;
+	Counter* messagesParked;
+	Counter* messagesExpired;
+	Counter* messagesDropped;
+	Counter* messagesMalformed;
+	Counter* senderPauses;
+	Counter* overflowDrops;
+	Counter* overflowDisconnects;
+	Counter* batchesRouted;
+	Counter* coalescedWrites;
+	Counter* messagesConflated;
+	Counter* datagramsIn;
+	Counter* datagramsOut;
+	Counter* datagramsDropped;
+	Counter* messagesJournaled;
+	Counter* journalSyncs;
+	Counter* messagesReplayed;
+	Counter* sessionsResumed;
+	Counter* sessionsExpired;
+	Gauge* pressuredEndpoints;
+	Gauge* pausedSenders;
+	// Messages handed to the shard owning their destination
+	Counter* messagesForwarded;
+	// Stats requests answered
+	Counter* statsRequests;
+	// Connected, registered, parked and disconnected session counts
+	Gauge* endpoints;
+	Gauge* registeredEndpoints;
+	Gauge* parkedMessages;
+	Gauge* detachedSessions;
+	// Process-wide allocator state, reported by unsharded servers and the first shard only
+	Gauge* poolSlabBytes;
+	Gauge* poolHugeSlabs;
+	Counter* poolOversized;
+	Counter* payloadBuffers;
+	// Time from receiving a message to writing it in full to its receiver
+	LatencyHistogram* deliveryLatency;
+};
 
 /// <summary>
 /// HSIF server class. Orchestrates endpoint registration and communication.
@@ -47,8 +198,22 @@ public:
 	/// <param name="logToFile">Determines whether or not to log to file.</param>
 	Server(std::string ip, unsigned int port, std::shared_ptr<Logger> logger, bool logToFile);
 
+	/// <summary>
+	/// Server initialization with socket, logging and poll backend parameters.
+	/// </summary>
+	/// <param name="ip">Ip address to accept connections. Provide "" to accept connections on any ip.</param>
+	/// <param name="port">TCP port to listen for new connections and data.</param>
+	/// <param name="logger">Pointer reference to Logger utility object.</param>
+	/// <param name="logToFile">Determines whether or not to log to file.</param>
+	/// <param name="backend">Socket readiness mechanism used by poll().</param>
+	Server(std::string ip, unsigned int port, std::shared_ptr<Logger> logger, bool logToFile, PollBackend backend);
+
 	~Server() = default;
 
+	// Servers own their reactor and may only be moved
+	Server(Server&&) = default;
+	Server& operator=(Server&&) = default;
+
 	/// <summary>
 	/// Initializes server socket connection.
 	/// </summary>
@@ -56,7 +221,7 @@ public:
 	bool connect();
 
 	/// <summary>
-	/// Poll function. Executes single select() call and performs socket IO on endpoints.
+	/// Poll function. Executes single readiness wait using the configured backend and performs socket IO on endpoints.
 	/// </summary>
 	/// <returns>Returns false if exception occurred during poll.</returns>
 	bool poll();
@@ -68,34 +233,122 @@ public:
 	/// <returns>Returns true if creation successful.</returns>
 	bool createEndpoint(SOCKET clientSocket);
 
+	/// <summary>
+	/// Creates an endpoint given a new socket connection, returning its handle.
+	/// </summary>
+	/// <param name="clientSocket">Socket client created from incoming connection to server.</param>
+	/// <param name="handle">Receives handle of the new endpoint.</param>
+	/// <returns>Returns true if creation successful.</returns>
+	bool createEndpoint(SOCKET clientSocket, EndpointHandle& handle);
+
 	/// <summary>
 	/// Registers endpoint with provided identification string.
 	/// </summary>
 	/// <param name="id">Identifying string for sending and receiving messages.</param>
-	/// <param name="index">Index of endpoint in endpoints vector.</param>
+	/// <param name="handle">Handle of endpoint.</param>
 	/// <returns>True if registration successful.</returns>
-	bool registerEndpoint(std::string id, size_t index);
+	bool registerEndpoint(std::string id, EndpointHandle handle);
+
+	/// <summary>
+	/// Registers endpoint with provided identification string and the wire format it receives,
+	/// then delivers every message parked for that identifier.
+	/// </summary>
+	/// <param name="id">Identifying string for sending and receiving messages.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="format">Encoding of messages sent to the endpoint.</param>
+	/// <returns>True if registration successful.</returns>
+	bool registerEndpoint(std::string id, EndpointHandle handle, WireFormat format);
+
+	/// <summary>
+	/// Registers endpoint as a session its client can resume after reconnecting. A
+	/// registration carrying the token of the session holding the identifier takes
+	/// it over, whether the old connection has closed or not: the queued frames the
+	/// old connection had not sent move to the new one, followed by its subscriptions
+	/// and blocked senders. Either way the endpoint is first sent a "session" message
+	/// whose "resume" field counts the frames the session was sent before it, so the
+	/// client can tell how many frames were lost in flight or will arrive twice.
+	/// Shards of a ShardGroup register the endpoint without a session.
+	/// </summary>
+	/// <param name="id">Identifying string for sending and receiving messages.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="format">Encoding of messages sent to the endpoint, fixed for the life of the session.</param>
+	/// <param name="session">Token chosen by the client, empty to register without a session.</param>
+	/// <returns>False if the identifier is held by another client or the token does not match.</returns>
+	bool registerEndpoint(std::string id, EndpointHandle handle, WireFormat format, const std::string& session);
 
 	/// <summary>
 	/// Routes message provided based on identifying "to" information.
 	/// </summary>
 	/// <param name="msg">JSON formatted string message.</param>
-	/// <param name="index">Index of endpoint in vector.</param>
-	void routeMessage(std::string msg, size_t index);
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>False if the message was malformed and dropped.</returns>
+	bool routeMessage(std::string_view msg, EndpointHandle handle);
+
+	/// <summary>
+	/// Routes a received frame of any wire format based on identifying "to" information.
+	/// </summary>
+	/// <param name="frame">Frame payload and its encoding.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>False if the frame was malformed and dropped.</returns>
+	bool routeMessage(const RecvFrame& frame, EndpointHandle handle);
+
+	/// <summary>
+	/// Subscribes an endpoint to a topic. Subscribing twice has no effect.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>True if the endpoint was not already subscribed.</returns>
+	bool subscribeEndpoint(std::string topic, EndpointHandle handle);
+
+	/// <summary>
+	/// Removes an endpoint's subscription to a topic.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>True if the endpoint was subscribed.</returns>
+	bool unsubscribeEndpoint(const std::string& topic, EndpointHandle handle);
 
 	/// <summary>
-	/// Removes an endpoint given its index in the endpoints vector. 
+	/// Queues one message on every subscriber of a topic, including subscribers
+	/// owned by other shards. Each encoding is produced once and shared, never copied.
 	/// </summary>
-	/// <param name="index">Index of endpoint in vector.</param>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="msg">Published message.</param>
+	/// <param name="sender">Handle of publishing endpoint.</param>
+	/// <returns>False if the message is not valid JSON and a subscriber needed it re-encoded or conflated.</returns>
+	bool publishMessage(const std::string& topic, WireMessage& msg, EndpointHandle sender);
+
+	/// <summary>
+	/// Opens a datagram channel token for an endpoint. A datagram from the client
+	/// carrying the same token then links the client's datagram address to this
+	/// endpoint, and datagrams from that address are routed as sent by it.
+	/// </summary>
+	/// <param name="token">Token chosen by the client, unique among open channels.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>False if the token is empty or held by another endpoint.</returns>
+	bool openChannel(const std::string& token, EndpointHandle handle);
+
+	/// <summary>
+	/// Removes an endpoint given its handle. Handles of other endpoints stay valid.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
 	/// <returns>Returns true if successful.</returns>
-	bool deleteEndpoint(size_t index);
+	bool deleteEndpoint(EndpointHandle handle);
 
 	/// <summary>
-	/// Returns an endpoint based on the string identifier.
+	/// Returns an endpoint based on the string identifier, or the disconnected session
+	/// holding it during its grace period.
 	/// </summary>
 	/// <param name="id">String identifier for the endpoint.</param>
 	/// <returns>Pointer to endpoint instance.</returns>
-	std::shared_ptr<Endpoint> getEndpoint(std::string id);
+	std::shared_ptr<Endpoint> getEndpoint(const std::string& id);
+
+	/// <summary>
+	/// Returns an endpoint based on its handle.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>Pointer to endpoint instance, null if the endpoint has been removed.</returns>
+	std::shared_ptr<Endpoint> getEndpoint(EndpointHandle handle);
 
 	/// <summary>
 	/// Closes server and client socket connections.
@@ -114,20 +367,816 @@ public:
 	/// <returns>Integer value representing number of registered endpoints.</returns>
 	size_t numRegisteredEndpoints();
 
+	/// <summary>
+	/// Helper function used to determine number of local subscribers of a topic.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <returns>Number of endpoints subscribed on this server.</returns>
+	size_t numSubscribers(const std::string& topic);
+
+	/// <summary>
+	/// Helper function used to determine number of disconnected sessions waiting to be resumed.
+	/// </summary>
+	/// <returns>Number of sessions within their grace period.</returns>
+	size_t numDetachedSessions();
+
+	/// <summary>
+	/// Returns the poll backend in use.
+	/// </summary>
+	/// <returns>Backend selected at construction.</returns>
+	PollBackend backend();
+
+	/// <summary>
+	/// Receives datagrams on a UDP port, which may equal the TCP port. Messages that
+	/// arrive as datagrams are loss-tolerant and leave as datagrams to receivers with
+	/// a linked channel, over TCP otherwise. Must be called before connect(); shards of
+	/// a ShardGroup do not receive datagrams.
+	/// </summary>
+	/// <param name="port">UDP port, 0 to disable.</param>
+	void setDatagramPort(unsigned int port);
+
+	/// <summary>
+	/// Accepts clients on the same host over shared memory. A SharedClient connecting
+	/// to the local socket at path is handed a pair of rings and doorbells and is
+	/// routed like any other endpoint. Must be called before connect(); Linux only,
+	/// and shards of a ShardGroup do not accept shared-memory clients.
+	/// </summary>
+	/// <param name="path">Filesystem path of the local socket, empty to disable.</param>
+	void setSharedPath(const std::string& path);
+
+	/// <summary>
+	/// Serves in-process clients handed over with attachLocal(). Their messages travel
+	/// through lock-free rings as refcounted payloads and are routed like any other
+	/// endpoint's. Must be called before connect(); Linux only.
+	/// </summary>
+	/// <param name="enabled">Whether in-process clients are served.</param>
+	void setLocalEndpoints(bool enabled);
+
+	/// <summary>
+	/// Hands an in-process client's channel to this server, which adds its endpoint on
+	/// the next poll. Messages the client sends before then wait in its ring. Safe to
+	/// call from any thread once connected.
+	/// </summary>
+	/// <param name="channel">Unopened channel of the client.</param>
+	/// <returns>False unless in-process clients are served.</returns>
+	bool attachLocal(std::shared_ptr<LocalChannel> channel);
+
+	/// <summary>
+	/// Makes a poll blocked on another thread return by ringing the eventfd the server
+	/// watches for in-process clients. Safe to call from any thread once connected; Linux only.
+	/// </summary>
+	/// <returns>False if the server has no wakeup to ring.</returns>
+	bool wake();
+
+	/// <summary>
+	/// Lets a successor process take the server over without its clients reconnecting. A
+	/// server calling takeOver() on the local socket at path is handed the listener, the
+	/// datagram socket and every socket client's connection with its identifier, session,
+	/// subscriptions, partial input and unsent frames, along with disconnected sessions
+	/// and parked messages. poll() returns false once the successor acknowledges. Must be
+	/// called before connect(); Linux only, on the select and epoll backends, and shards of
+	/// a ShardGroup are not handed off.
+	/// </summary>
+	/// <param name="path">Filesystem path of the local socket, empty to disable.</param>
+	void setUpgradePath(const std::string& path);
+
+	/// <summary>
+	/// Starts the server on the listener and connections of the server accepting successors
+	/// at path, in place of connect(). The server then accepts its own successor on the path
+	/// set by setUpgradePath(), or on the same path if none was set.
+	/// </summary>
+	/// <param name="path">Filesystem path of the running server's upgrade socket.</param>
+	/// <returns>False if nothing was handed over, the running server then keeps serving.</returns>
+	bool takeOver(const std::string& path);
+
+	/// <summary>
+	/// Returns whether a successor took the server over.
+	/// </summary>
+	/// <returns>True once handed off.</returns>
+	bool handedOff();
+
+	/// <summary>
+	/// Journals every routed message and publish to segment files in a directory, so
+	/// endpoints can replay what was routed to them from an offset or a time. Records
+	/// are synced to disk in groups, at most policy.syncInterval after being routed.
+	/// Linux only; shards of a ShardGroup do not journal.
+	/// </summary>
+	/// <param name="directory">Existing directory holding the journal.</param>
+	/// <param name="policy">Segment size, index density, sync interval and retention.</param>
+	/// <returns>False if the journal could not be opened.</returns>
+	bool openJournal(const std::string& directory, JournalPolicy policy);
+
+	/// <summary>
+	/// Returns the journal messages are appended to.
+	/// </summary>
+	/// <returns>Journal, null unless openJournal succeeded.</returns>
+	Journal* journal();
+
+	/// <summary>
+	/// Starts delivering journaled messages sent to a registered endpoint or published to
+	/// its topics, from a read position up to the messages routed before the call. The
+	/// replay is paced by the endpoint's queue and ends with a "replay" message carrying
+	/// the offset live delivery took over from. Clients ask for this with a "replay"
+	/// message holding an "offset" or a "since" time in milliseconds since the epoch.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="from">Journal read position.</param>
+	/// <returns>False if there is no journal or the endpoint is not registered.</returns>
+	bool replayJournal(EndpointHandle handle, JournalCursor from);
+
+	/// <summary>
+	/// Selects how messages are read when routing. Defaults to RoutingMode::Parse.
+	/// </summary>
+	/// <param name="mode">Routing mode.</param>
+	void setRoutingMode(RoutingMode mode);
+
+	/// <summary>
+	/// Sets TTL, size limits and drop policy for messages waiting on unregistered destinations.
+	/// </summary>
+	/// <param name="policy">Parking limits.</param>
+	void setParkingPolicy(ParkingPolicy policy);
+
+	/// <summary>
+	/// Sets how long disconnected sessions are kept and how many. While a session is
+	/// disconnected, messages routed to it queue under its backpressure policy.
+	/// </summary>
+	/// <param name="policy">Session limits.</param>
+	void setSessionPolicy(SessionPolicy policy);
+
+	/// <summary>
+	/// Sets outbound watermarks and overflow policy of every current and future endpoint.
+	/// </summary>
+	/// <param name="policy">Backpressure limits.</param>
+	void setBackpressurePolicy(BackpressurePolicy policy);
+
+	/// <summary>
+	/// Sets outbound watermarks and overflow policy of one endpoint.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="policy">Backpressure limits.</param>
+	/// <returns>False if the endpoint has been removed.</returns>
+	bool setBackpressurePolicy(EndpointHandle handle, BackpressurePolicy policy);
+
+	/// <summary>
+	/// Sets write coalescing and socket options of every current and future endpoint.
+	/// </summary>
+	/// <param name="policy">Coalescing window, byte budget and socket options.</param>
+	void setCoalescingPolicy(CoalescingPolicy policy);
+
+	/// <summary>
+	/// Sets write coalescing and socket options of one endpoint.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="policy">Coalescing window, byte budget and socket options.</param>
+	/// <returns>False if the endpoint has been removed.</returns>
+	bool setCoalescingPolicy(EndpointHandle handle, CoalescingPolicy policy);
+
+	/// <summary>
+	/// Sets the largest frame payload every current and future endpoint may send.
+	/// An endpoint sending a longer frame is disconnected. Defaults to FRAME_SIZE_MAX.
+	/// </summary>
+	/// <param name="bytes">Largest payload in bytes.</param>
+	void setMaxFrameSize(size_t bytes);
+
+	/// <summary>
+	/// Makes an endpoint keep only the newest undelivered message per sender and "key"
+	/// field. Clients may also ask for this by registering with "conflate": true.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="conflate">Whether messages routed to the endpoint conflate.</param>
+	/// <returns>False if the endpoint has been removed.</returns>
+	bool setConflation(EndpointHandle handle, bool conflate);
+
+	/// <summary>
+	/// Makes every subscriber of a topic keep only the newest undelivered publish per
+	/// sender and "key" field, whatever the subscriber's own setting.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="conflate">Whether publishes to the topic conflate.</param>
+	void setTopicConflation(const std::string& topic, bool conflate);
+
+	/// <summary>
+	/// Returns number of messages parked for a destination.
+	/// </summary>
+	/// <param name="to">Destination identifier.</param>
+	/// <returns>Parked message count.</returns>
+	size_t numParked(const std::string& to);
+
+	/// <summary>
+	/// Returns I/O counters accumulated since construction.
+	/// </summary>
+	/// <returns>Server statistics.</returns>
+	ServerStats stats();
+
+	/// <summary>
+	/// Returns the registry holding this server's metrics. Its values may be read from any thread.
+	/// </summary>
+	/// <returns>Metrics registry.</returns>
+	std::shared_ptr<MetricsRegistry> metrics();
+
+	/// <summary>
+	/// Makes this server one shard of a multi-reactor group. Must be called before connect().
+	/// </summary>
+	/// <param name="group">Owning shard group.</param>
+	/// <param name="shard">Index of this server within the group.</param>
+	void joinShardGroup(ShardGroup* group, size_t shard);
+
+	/// <summary>
+	/// Resumes the senders a pressured endpoint blocked once it drains to its low watermark.
+	/// </summary>
+	/// <param name="endpoint">Endpoint whose outgoing buffer shrank.</param>
+	void relievePressure(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Disconnects receivers that overflowed under OverflowPolicy::Disconnect.
+	/// Deferred to the end of a poll so routing never removes endpoints mid-delivery.
+	/// </summary>
+	void serviceOverflow();
+
+	/// <summary>
+	/// Delivers messages other shards routed to endpoints owned by this shard.
+	/// </summary>
+	void drainShardInbox();
+
 private:
+	/// <summary>
+	/// Copies I/O counters and endpoint counts into the metrics registry.
+	/// </summary>
+	void updateMetrics();
+
+	/// <summary>
+	/// Answers a stats request with a snapshot of every shard's metrics, encoded as the requester negotiated.
+	/// </summary>
+	/// <param name="handle">Handle of requesting endpoint.</param>
+	void sendStats(EndpointHandle handle);
+
+	/// <summary>
+	/// Creates, binds and registers the datagram socket.
+	/// </summary>
+	/// <returns>Returns whether or not setup was successful.</returns>
+	bool connectDatagrams();
+
+	/// <summary>
+	/// Starts everything besides the TCP listener: the readiness backend, datagram, shared-memory,
+	/// in-process and upgrade listeners. Shared by connect() and takeOver().
+	/// </summary>
+	/// <returns>Returns whether or not setup was successful.</returns>
+	bool connectServices();
+
+	/// <summary>
+	/// Creates the local socket a successor process connects to.
+	/// </summary>
+	/// <returns>Returns whether or not setup was successful.</returns>
+	bool connectUpgrade();
+
+	/// <summary>
+	/// Accepts pending successors on the upgrade socket until one takes the server over.
+	/// </summary>
+	void acceptSuccessor();
+
+	/// <summary>
+	/// Hands the listener, connections, sessions and parked messages to a successor, then
+	/// closes this server's copies of the sockets without shutting the connections down.
+	/// </summary>
+	/// <param name="control">Local socket connected to the successor.</param>
+	/// <returns>False if the successor did not acknowledge, this server then keeps serving.</returns>
+	bool handOff(SOCKET control);
+
+	/// <summary>
+	/// Recreates handed over connections, sessions, subscriptions, channels and parked messages.
+	/// </summary>
+	/// <param name="state">Snapshot received from the previous server.</param>
+	/// <param name="handles">Handles received with it, client sockets at the indices the snapshot names.</param>
+	void adoptState(const HandoffState& state, const std::vector<SOCKET>& handles);
+
+	/// <summary>
+	/// Receives datagrams until the socket would block.
+	/// </summary>
+	void readDatagrams();
+
+	/// <summary>
+	/// Routes a datagram from a linked peer, or links the peer if the datagram is a
+	/// channel hello. Stale datagrams and datagrams from unknown peers are dropped.
+	/// </summary>
+	/// <param name="datagram">Received datagram.</param>
+	/// <param name="from">Sender address.</param>
+	void receiveDatagram(std::string_view datagram, const DatagramAddress& from);
+
+	/// <summary>
+	/// Links a peer address to the endpoint holding a channel token, restarting the
+	/// channel's sequence, and acknowledges with a datagram echoing the token.
+	/// </summary>
+	/// <param name="token">Channel token from the hello.</param>
+	/// <param name="from">Peer address.</param>
+	/// <param name="sequence">Sequence number of the hello.</param>
+	/// <returns>False if no endpoint holds the token.</returns>
+	bool linkChannel(const std::string& token, const DatagramAddress& from, uint64_t sequence);
+
+	/// <summary>
+	/// Sends a payload to an endpoint's linked peer as one datagram. A datagram the
+	/// socket does not accept is dropped, as loss-tolerant traffic may be.
+	/// </summary>
+	/// <param name="receiver">Endpoint with a linked channel.</param>
+	/// <param name="payload">Payload encoded in the receiver's format.</param>
+	/// <returns>False if the payload is too large for a datagram and must go over TCP.</returns>
+	bool sendDatagram(const std::shared_ptr<Endpoint>& receiver, const Payload& payload);
+
+	/// <summary>
+	/// Creates the local socket shared-memory clients connect to.
+	/// </summary>
+	/// <returns>Returns whether or not setup was successful.</returns>
+	bool connectShared();
+
+	/// <summary>
+	/// Accepts every pending shared-memory client on the local socket.
+	/// </summary>
+	void acceptShared();
+
+	/// <summary>
+	/// Creates a shared channel for a connected client, passes it over the control
+	/// socket and adds the endpoint. A client that cannot be set up is closed.
+	/// </summary>
+	/// <param name="control">Accepted local socket.</param>
+	void createSharedEndpoint(SOCKET control);
+
+	/// <summary>
+	/// Re-arms a multishot accept the kernel ended. Exhausted descriptors or memory
+	/// wait out a back-off timeout first instead of failing every poll.
+	/// </summary>
+	/// <param name="result">Result of the final accept completion.</param>
+	/// <param name="shared">True for the shared-memory listener.</param>
+	void rearmAccept(int result, bool shared);
+
+	/// <summary>
+	/// Handles a shared-memory endpoint whose doorbell rang or whose control socket changed state.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="ready">Doorbell or control socket reported ready.</param>
+	/// <returns>Returns false if the endpoint was closed and removed.</returns>
+	bool serviceShared(EndpointHandle handle, SOCKET ready);
+
+	/// <summary>
+	/// Reads a shared-memory endpoint's ring until it is empty, routing the frames
+	/// parsed from each read.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>Returns false if the endpoint was closed and removed.</returns>
+	bool readShared(EndpointHandle handle);
+
+	/// <summary>
+	/// Copies queued frames into a shared-memory endpoint's ring until it is drained
+	/// or the ring is full, ringing the client if it sleeps.
+	/// </summary>
+	/// <param name="endpoint">Shared-memory endpoint.</param>
+	void writeShared(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Prepares multishot polls on a shared-memory endpoint's doorbell and control socket.
+	/// </summary>
+	/// <param name="endpoint">Shared-memory endpoint.</param>
+	void armShared(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Handles a poll completion for a shared-memory endpoint.
+	/// </summary>
+	/// <param name="completion">Harvested completion.</param>
+	void completeShared(const UringCompletion& completion);
+
+	/// <summary>
+	/// Creates the wakeup in-process clients and wake() ring and begins watching it.
+	/// Only fatal to connect() when in-process clients are served.
+	/// </summary>
+	/// <returns>Returns whether or not setup was successful.</returns>
+	bool connectLocalHub();
+
+	/// <summary>
+	/// Services every in-process channel queued on the hub since the last wakeup:
+	/// attaches new channels, removes closed ones, routes what the others sent and
+	/// hands over frames waiting for room in their rings.
+	/// </summary>
+	void serviceLocal();
+
+	/// <summary>
+	/// Adds the endpoint of a newly attached in-process client. A client that cannot be added is closed.
+	/// </summary>
+	/// <param name="channel">Channel of the client.</param>
+	void createLocalEndpoint(const std::shared_ptr<LocalChannel>& channel);
+
+	/// <summary>
+	/// Routes the messages an in-process endpoint sent, up to one ring of them per poll.
+	/// A malformed message closes and removes the endpoint.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>Returns false if the endpoint was closed and removed.</returns>
+	bool readLocal(EndpointHandle handle);
+
+	/// <summary>
+	/// Hands queued frames to an in-process endpoint's ring until it is drained or the
+	/// ring is full, waking the client if it waits.
+	/// </summary>
+	/// <param name="endpoint">In-process endpoint.</param>
+	void writeLocal(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Adds a constructed endpoint and begins watching it with the configured backend.
+	/// </summary>
+	/// <param name="endpoint">New endpoint.</param>
+	/// <param name="handle">Receives handle of the endpoint.</param>
+	/// <returns>Returns true if successful.</returns>
+	bool addEndpoint(std::shared_ptr<Endpoint> endpoint, EndpointHandle& handle);
+
+	/// <summary>
+	/// Select based poll. Rebuilds descriptor sets and visits every endpoint.
+	/// </summary>
+	/// <returns>Returns false if exception occurred during poll.</returns>
+	bool pollSelect();
+
+	/// <summary>
+	/// Performs the reads, routing and writes select() reported for one endpoint.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <param name="readSet">Sockets reported readable.</param>
+	/// <param name="writeSet">Sockets reported writable.</param>
+	/// <returns>Returns false if the endpoint was closed and removed.</returns>
+	bool serviceEndpoint(EndpointHandle handle, fd_set& readSet, fd_set& writeSet);
+
+	/// <summary>
+	/// Epoll based poll. Only visits endpoints whose sockets changed state.
+	/// </summary>
+	/// <returns>Returns false if exception occurred during poll.</returns>
+	bool pollEpoll();
+
+	/// <summary>
+	/// io_uring based poll. Submits queued requests and harvests completions in one io_uring_enter.
+	/// </summary>
+	/// <returns>Returns false if exception occurred during poll.</returns>
+	bool pollUring();
+
+	/// <summary>
+	/// Handles a multishot receive completion for an endpoint.
+	/// </summary>
+	/// <param name="completion">Harvested completion.</param>
+	void completeRecv(const UringCompletion& completion);
+
+	/// <summary>
+	/// Handles a send completion for an endpoint.
+	/// </summary>
+	/// <param name="completion">Harvested completion.</param>
+	void completeSend(const UringCompletion& completion);
+
+	/// <summary>
+	/// Prepares a scatter-gather send of the endpoint's queued frames if none is in flight.
+	/// </summary>
+	/// <param name="endpoint">Endpoint with outgoing data.</param>
+	void queueSend(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Pauses reads from a sender until a pressured receiver drains.
+	/// </summary>
+	/// <param name="receiver">Pressured endpoint.</param>
+	/// <param name="sender">Handle of endpoint feeding the receiver.</param>
+	void blockSender(const std::shared_ptr<Endpoint>& receiver, EndpointHandle sender);
+
+	/// <summary>
+	/// Resumes every sender a receiver blocked.
+	/// </summary>
+	/// <param name="receiver">Endpoint that is no longer pressured.</param>
+	void releaseSenders(const std::shared_ptr<Endpoint>& receiver);
+
+	/// <summary>
+	/// Starts or stops reading from an endpoint's socket to match its paused state.
+	/// </summary>
+	/// <param name="endpoint">Endpoint blocked or unblocked.</param>
+	void updateReadInterest(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Prepares a multishot receive into the provided buffer ring.
+	/// </summary>
+	/// <param name="endpoint">Endpoint to receive from.</param>
+	void armRecv(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Resolves io_uring user data to a live endpoint handle.
+	/// </summary>
+	/// <param name="userData">User data of a completion.</param>
+	/// <param name="handle">Receives handle of endpoint.</param>
+	/// <returns>False if the endpoint has since been removed.</returns>
+	bool findIoEndpoint(uint64_t userData, EndpointHandle& handle);
+
+	/// <summary>
+	/// Accepts every pending connection on the listening socket.
+	/// </summary>
+	/// <returns>Returns false if accept failed with a non-recoverable error.</returns>
+	bool acceptConnections();
+
+	/// <summary>
+	/// Reads from an endpoint socket until it would block (edge-triggered),
+	/// routing the frames parsed from each read.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>Returns false if the endpoint was closed and removed.</returns>
+	bool readEndpoint(EndpointHandle handle);
+
+	/// <summary>
+	/// Sends as many queued frames as one scatter-gather call accepts.
+	/// </summary>
+	/// <param name="endpoint">Endpoint with queued frames.</param>
+	/// <returns>Bytes sent or SOCKET_ERROR.</returns>
+	int sendOutbound(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Writes buffered data to an endpoint socket until it would block or is drained.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>Returns false if the endpoint was closed and removed.</returns>
+	bool writeEndpoint(EndpointHandle handle);
+
+	/// <summary>
+	/// Routes a message using only its scanned header, forwarding the original bytes.
+	/// </summary>
+	/// <param name="header">Routing fields of the message.</param>
+	/// <param name="msg">Original serialized message.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>False if the body is not valid JSON and a receiver needed it re-encoded or conflated.</returns>
+	bool routeHeader(const MsgHeader& header, std::string_view msg, EndpointHandle handle);
+
+	/// <summary>
+	/// Returns the payload forwarding a header-routed message: the payload an in-process
+	/// sender handed over, or a copy of the received bytes.
+	/// </summary>
+	/// <param name="msg">Original serialized message.</param>
+	/// <returns>Payload holding msg.</returns>
+	Payload routedPayload(std::string_view msg);
+
+	/// <summary>
+	/// Routes a parsed message by its type.
+	/// </summary>
+	/// <param name="message">Parsed message, its contents may be moved out.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>False if a field the message type requires is missing or not a string.</returns>
+	bool routeParsed(json& message, EndpointHandle handle);
+
+	/// <summary>
+	/// Routes each message of a batch in order. Nested batches are skipped.
+	/// </summary>
+	/// <param name="batch">Parsed batch message.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>False if a message of the batch is malformed, later messages are not routed.</returns>
+	bool routeBatch(json& batch, EndpointHandle handle);
+
+	/// <summary>
+	/// Routes every frame parsed into an endpoint's outbox, then releases them.
+	/// A malformed frame closes and removes the endpoint.
+	/// </summary>
+	/// <param name="handle">Handle of endpoint.</param>
+	/// <returns>Returns false if the endpoint was closed and removed.</returns>
+	bool routeOutbox(EndpointHandle handle);
+
+	/// <summary>
+	/// Parks a message for a destination that has not registered on any shard yet.
+	/// </summary>
+	/// <param name="to">Destination identifier.</param>
+	/// <param name="msg">JSON text payload.</param>
+	void parkMessage(const std::string& to, Payload msg);
+
+	/// <summary>
+	/// Appends a routed message to the journal. A journal that fails to grow is closed.
+	/// </summary>
+	/// <param name="kind">Message or publish.</param>
+	/// <param name="to">Destination identifier or topic.</param>
+	/// <param name="msg">JSON text payload.</param>
+	void journalMessage(JournalKind kind, std::string_view to, std::string_view msg);
+
+	/// <summary>
+	/// Syncs journaled messages once the oldest unsynced one has waited the sync interval.
+	/// </summary>
+	void serviceJournal();
+
+	/// <summary>
+	/// Continues every catch-up replay whose endpoint has room in its queue.
+	/// </summary>
+	void serviceReplay();
+
+	/// <summary>
+	/// Delivers the next journaled messages of an endpoint's replay until its queue
+	/// passes the low watermark, a poll's share of records is read, or the replay ends.
+	/// </summary>
+	/// <param name="endpoint">Replaying endpoint.</param>
+	/// <returns>True once the replay has ended.</returns>
+	bool continueReplay(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Hands a session over to an endpoint registering with its token: moves the old
+	/// connection's unsent frames, subscriptions and blocked senders to the endpoint
+	/// and removes the old connection or disconnected session.
+	/// </summary>
+	/// <param name="previous">Connected or disconnected endpoint holding the session.</param>
+	/// <param name="endpoint">Endpoint taking the session over.</param>
+	/// <param name="handle">Handle of endpoint.</param>
+	void resumeSession(const std::shared_ptr<Endpoint>& previous, const std::shared_ptr<Endpoint>& endpoint, EndpointHandle handle);
+
+	/// <summary>
+	/// Keeps a removed endpoint's session for its grace period, if it has one and
+	/// the policy has room for it.
+	/// </summary>
+	/// <param name="endpoint">Registered endpoint being removed.</param>
+	/// <returns>True if the session was kept.</returns>
+	bool detachSession(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Discards a disconnected session, its queue and subscriptions, resuming the senders it blocked.
+	/// </summary>
+	/// <param name="endpoint">Endpoint of the disconnected session.</param>
+	void dropSession(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Drops disconnected sessions whose grace period has passed.
+	/// </summary>
+	void serviceSessions();
+
+	/// <summary>
+	/// Removes a subscription of an endpoint that may no longer have a handle.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="endpoint">Subscribed endpoint.</param>
+	/// <returns>True if the endpoint was subscribed.</returns>
+	bool unsubscribeEndpoint(const std::string& topic, const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Expires parked messages past their TTL and, after a registration on another
+	/// shard, hands messages parked for that destination over to its shard.
+	/// </summary>
+	void serviceParked();
+
+	/// <summary>
+	/// Turns reactor write interest on or off when the endpoint's outgoing
+	/// buffer changes between empty and non-empty.
+	/// </summary>
+	/// <param name="endpoint">Endpoint whose outgoing buffer may have changed.</param>
+	void updateWriteInterest(const std::shared_ptr<Endpoint>& endpoint);
+
+	/// <summary>
+	/// Queues a published message on every subscriber of a topic owned by this server.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="msg">Published message.</param>
+	/// <param name="sender">Handle of publishing endpoint, INVALID_SLOT_HANDLE if published on another shard.</param>
+	/// <returns>False if the message could not be queued on every subscriber.</returns>
+	bool deliverTopic(const std::string& topic, WireMessage& msg, EndpointHandle sender);
+
+	/// <summary>
+	/// Queues a message on a receiver and applies its overflow policy if the
+	/// receiver passes its high watermark.
+	/// </summary>
+	/// <param name="receiver">Destination endpoint.</param>
+	/// <param name="msg">Routed message.</param>
+	/// <param name="sender">Handle of sending endpoint, INVALID_SLOT_HANDLE if it has none on this server.</param>
+	/// <returns>False, with nothing queued, if the message is text that is not valid JSON and the
+	/// receiver needs it re-encoded or conflated.</returns>
+	bool deliverMessage(const std::shared_ptr<Endpoint>& receiver, WireMessage& msg, EndpointHandle sender);
+
+	/// <summary>
+	/// Counts and logs a message dropped because it is not valid JSON, when it has no
+	/// sender on this server to disconnect: forwarded, parked or journaled messages.
+	/// </summary>
+	/// <param name="what">Description of the message for the log.</param>
+	void dropMalformed(const std::string& what);
+
+
+	/// <summary>
+	/// Starts a coalescing window when frames are queued on an idle receiver,
+	/// or ends it once the receiver's byte budget fills.
+	/// </summary>
+	/// <param name="receiver">Endpoint a frame was just queued on.</param>
+	void holdWrites(const std::shared_ptr<Endpoint>& receiver);
+
+	/// <summary>
+	/// Returns how long the next poll may block before a held write, a journal sync or
+	/// a session expiry comes due, or at all while a replay has records left to read.
+	/// </summary>
+	/// <returns>Nanoseconds, or -1 if no writes are held.</returns>
+	int64_t holdTimeout();
+
+	/// <summary>
+	/// Writes the frames of every endpoint whose coalescing window has passed.
+	/// </summary>
+	void serviceHeld();
+
 	// Socket for listening for incoming connections
-	SOCKET listenSocket_;
+	SOCKET listenSocket_ = INVALID_SOCKET;
 	// Port for listening to incoming connections
 	unsigned int port_;
 	// Ip to listen for incoming connections ("" if accept from anywhere)
 	std::string ip_;
-	// List of endpoint instances currently connected to server
-	std::vector<std::shared_ptr<Endpoint>> endpoints_;
+	// Endpoint instances currently connected to server
+	SlotMap<std::shared_ptr<Endpoint>> endpoints_;
 	// Mapping between endpoint instances and their string identifiers
 	EndpointMap endpointMap_;
+	// Subscribers of each topic with at least one local subscriber
+	TopicMap topics_;
+	// Topics whose publishes conflate at every subscriber
+	std::unordered_set<std::string> conflatedTopics_;
 	// Current logger object
 	std::shared_ptr<Logger> logger_;
 	// Determines whether or not to log to a file
-	bool logToFile_;
+	bool logToFile_ = false;
+	// Socket readiness mechanism
+	PollBackend backend_ = PollBackend::Select;
+	// Message routing mode
+	RoutingMode routingMode_ = RoutingMode::Parse;
+	// Epoll reactor instance (only used by PollBackend::Epoll)
+	std::unique_ptr<EpollReactor> reactor_;
+	// Mapping between endpoint sockets, and doorbells of shared-memory endpoints, and their handles
+	SocketMap socketMap_;
+	// Ready events harvested by the last reactor wait
+	std::vector<ReactorEvent> readyEvents_;
+	// Messages waiting for their destination to register
+	ParkedQueues parked_;
+	// Backpressure limits given to new endpoints
+	BackpressurePolicy backpressure_ = DEFAULT_BACKPRESSURE_POLICY;
+	// Write coalescing given to new endpoints
+	CoalescingPolicy coalescing_ = DEFAULT_COALESCING_POLICY;
+	// Largest frame payload new endpoints may send
+	size_t maxFrameSize_ = FRAME_SIZE_MAX;
+	// Receivers waiting to be disconnected under OverflowPolicy::Disconnect
+	std::vector<std::shared_ptr<Endpoint>> overflowed_;
+	// Receivers holding frames until their coalescing window passes
+	std::vector<std::shared_ptr<Endpoint>> held_;
+	// Set when a registration on another shard may make parked messages routable
+	bool registrationPending_ = false;
+	// io_uring instance (only used by PollBackend::Uring)
+	std::unique_ptr<IoUring> ring_;
+	// Completions harvested by the last io_uring_enter
+	std::vector<UringCompletion> completions_;
+	// Endpoints kept alive while the kernel still references their send buffer
+	std::unordered_map<uint64_t, std::shared_ptr<Endpoint>> inflightSends_;
+	// Removed endpoints whose sockets close once pending requests are submitted
+	std::vector<std::shared_ptr<Endpoint>> retiredEndpoints_;
+	// Token distinguishing connections that reuse a socket number
+	uint32_t nextIoToken_ = 0;
+	// Whether an io_uring timeout bounding the wait for a held write is outstanding
+	bool uringTimeoutArmed_ = false;
+	// I/O counters
+	ServerStats stats_{};
+	// Owning shard group (null when running a single reactor)
+	ShardGroup* shardGroup_ = nullptr;
+	// Index of this server within its shard group
+	size_t shardIndex_ = 0;
+	// Last group registration generation observed by this shard
+	uint64_t registrationGeneration_ = 0;
+	// Shards subscribed to the topic of the publish being routed
+	std::vector<size_t> topicShards_;
+	// Metrics shared with exporters on other threads
+	std::shared_ptr<MetricsRegistry> metrics_;
+	// Metrics updated by this server
+	ServerMetrics instruments_;
+	// Receive stamp of the endpoint whose frames are being routed, 0 outside routeOutbox
+	uint64_t routeStamp_ = 0;
+	// Destination of the message being header-routed, reused so identifiers past the small-string size are not allocated per message
+	std::string routeTo_;
+	// UDP port datagrams are received on, 0 when disabled
+	unsigned int datagramPort_ = 0;
+	// Datagram socket (INVALID_SOCKET when disabled)
+	SOCKET datagramSocket_ = INVALID_SOCKET;
+	// Buffer receiving one datagram at a time
+	std::vector<char> datagramBuffer_;
+	// Endpoint linked to each datagram peer, keyed by address bytes
+	std::unordered_map<std::string, EndpointHandle> channels_;
+	// Endpoint holding each open channel token
+	std::unordered_map<std::string, EndpointHandle> channelTokens_;
+	// Whether the message being routed arrived as a datagram
+	bool routeLossy_ = false;
+	// Local socket path shared-memory clients connect to, empty when disabled
+	std::string sharedPath_;
+	// Local socket accepting shared-memory clients (INVALID_SOCKET when disabled)
+	SOCKET sharedListenSocket_ = INVALID_SOCKET;
+	// Whether in-process clients are served
+	bool localEnabled_ = false;
+	// Wakeup and ready queue of in-process clients, also rung by wake() (null unless connected on Linux)
+	std::shared_ptr<LocalHub> localHub_;
+	// Channels taken off the hub by the current serviceLocal(), reused between polls
+	std::vector<std::shared_ptr<LocalChannel>> localReady_;
+	// Payload of the message being routed when an in-process sender handed it over whole, forwarded instead of copied
+	Payload routePayload_;
+	// Journal of routed messages (null when disabled)
+	std::unique_ptr<Journal> journal_;
+	// MetricsRegistry::now() stamp by which journaled messages are synced, 0 while none are unsynced
+	uint64_t journalDeadline_ = 0;
+	// Endpoints with a catch-up replay in progress
+	std::vector<std::shared_ptr<Endpoint>> replaying_;
+	// Whether a replay stopped at its per-poll share of records rather than a full queue
+	bool replayPending_ = false;
+	// Disconnected sessions by identifier, kept out of the endpoint slots until resumed or expired
+	std::unordered_map<std::string, std::shared_ptr<Endpoint>> sessions_;
+	// Grace period and limit of disconnected sessions
+	SessionPolicy sessionPolicy_ = DEFAULT_SESSION_POLICY;
+	// Earliest detachedUntil stamp among disconnected sessions
+	uint64_t sessionExpiry_ = 0;
+	// Local socket path a successor process connects to, empty when disabled
+	std::string upgradePath_;
+	// Local socket accepting a successor (INVALID_SOCKET when disabled)
+	SOCKET upgradeListenSocket_ = INVALID_SOCKET;
+	// Set once a successor took over the listener and connections
+	bool handedOff_ = false;
 };
 
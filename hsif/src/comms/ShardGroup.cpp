@@ -0,0 +1,254 @@
+#include "ShardGroup.hpp"
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+ShardGroup::ShardGroup(std::string ip, unsigned int port, std::shared_ptr<Logger> logger, bool logToFile, size_t shards) :
+    registrationGeneration_(0),
+    running_(false),
+    logger_(logger),
+    logToFile_(logToFile)
+{
+    // Create one epoll server per shard, each aware of its place in the group
+    for (size_t index = 0; index < shards; index++)
+    {
+        auto shard = std::make_unique<Shard>(Server(ip, port, logger, logToFile, PollBackend::Epoll));
+#ifdef __linux__
+        shard->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+        shard->server.joinShardGroup(this, index);
+        shards_.push_back(std::move(shard));
+    }
+}
+
+ShardGroup::~ShardGroup()
+{
+    stop();
+    for (auto& shard : shards_)
+    {
+        shard->server.cleanup();
+        if (shard->wakeFd != -1)
+            ::close(shard->wakeFd);
+    }
+}
+
+bool ShardGroup::start()
+{
+    // Bind every shard listener before accepting on any of them
+    for (auto& shard : shards_)
+    {
+        if (shard->wakeFd == -1 || !shard->server.connect())
+        {
+            LOG_ERROR(logger_, logToFile_, "Shard initialization failed");
+            return false;
+        }
+    }
+
+    // Run each shard reactor on its own thread until stopped
+    running_ = true;
+    for (auto& shard : shards_)
+    {
+        Server* server = &shard->server;
+        shard->thread = std::thread([this, server]()
+        {
+            bool running = true;
+            while (running && running_)
+                running = server->poll();
+            if (!running)
+            {
+                // A dead shard would strand its listener and endpoints, so the whole group stops
+                LOG_ERROR(logger_, logToFile_, "Reactor shard failed, stopping shard group");
+                running_ = false;
+                for (size_t index = 0; index < shards_.size(); index++)
+                    wake(index);
+            }
+        });
+    }
+    LOG_INFO(logger_, logToFile_, "Started " + std::to_string(shards_.size()) + " reactor shards");
+    return true;
+}
+
+void ShardGroup::setRoutingMode(RoutingMode mode)
+{
+    for (auto& shard : shards_)
+        shard->server.setRoutingMode(mode);
+}
+
+void ShardGroup::setParkingPolicy(ParkingPolicy policy)
+{
+    for (auto& shard : shards_)
+        shard->server.setParkingPolicy(policy);
+}
+
+void ShardGroup::setBackpressurePolicy(BackpressurePolicy policy)
+{
+    for (auto& shard : shards_)
+        shard->server.setBackpressurePolicy(policy);
+}
+
+void ShardGroup::setTopicConflation(const std::string& topic, bool conflate)
+{
+    for (auto& shard : shards_)
+        shard->server.setTopicConflation(topic, conflate);
+}
+
+void ShardGroup::setLocalEndpoints(bool enabled)
+{
+    for (auto& shard : shards_)
+        shard->server.setLocalEndpoints(enabled);
+}
+
+void ShardGroup::stop()
+{
+    // Clear flag then wake every shard so blocked polls observe it
+    running_ = false;
+    for (size_t index = 0; index < shards_.size(); index++)
+        wake(index);
+    join();
+}
+
+void ShardGroup::join()
+{
+    for (auto& shard : shards_)
+    {
+        if (shard->thread.joinable())
+            shard->thread.join();
+    }
+}
+
+Server& ShardGroup::server(size_t shard)
+{
+    return shards_[shard]->server;
+}
+
+std::shared_ptr<MetricsRegistry> ShardGroup::metrics(size_t shard)
+{
+    return shards_[shard]->server.metrics();
+}
+
+size_t ShardGroup::numShards()
+{
+    return shards_.size();
+}
+
+bool ShardGroup::registerEndpoint(const std::string& id, EndpointLocation location)
+{
+    {
+        std::unique_lock<std::shared_mutex> lock(directoryMutex_);
+        if (directory_.insert({ id, location }).second == false)
+            return false;
+    }
+
+    // Let other shards retry messages that were waiting for this identifier
+    registrationGeneration_++;
+    for (size_t index = 0; index < shards_.size(); index++)
+    {
+        if (index != location.shard)
+            wake(index);
+    }
+    return true;
+}
+
+void ShardGroup::unregisterEndpoint(const std::string& id, size_t shard)
+{
+    std::unique_lock<std::shared_mutex> lock(directoryMutex_);
+    auto found = directory_.find(id);
+    if (found != directory_.end() && found->second.shard == shard)
+        directory_.erase(found);
+}
+
+bool ShardGroup::locate(const std::string& id, EndpointLocation& location)
+{
+    std::shared_lock<std::shared_mutex> lock(directoryMutex_);
+    auto found = directory_.find(id);
+    if (found == directory_.end())
+        return false;
+    location = found->second;
+    return true;
+}
+
+void ShardGroup::subscribeTopic(const std::string& topic, size_t shard)
+{
+    std::unique_lock<std::shared_mutex> lock(directoryMutex_);
+    std::vector<size_t>& shards = topics_[topic];
+    if (std::find(shards.begin(), shards.end(), shard) == shards.end())
+        shards.push_back(shard);
+}
+
+void ShardGroup::unsubscribeTopic(const std::string& topic, size_t shard)
+{
+    std::unique_lock<std::shared_mutex> lock(directoryMutex_);
+    auto found = topics_.find(topic);
+    if (found == topics_.end())
+        return;
+    std::vector<size_t>& shards = found->second;
+    shards.erase(std::remove(shards.begin(), shards.end(), shard), shards.end());
+    if (shards.empty())
+        topics_.erase(found);
+}
+
+void ShardGroup::topicShards(const std::string& topic, std::vector<size_t>& shards)
+{
+    shards.clear();
+    std::shared_lock<std::shared_mutex> lock(directoryMutex_);
+    auto found = topics_.find(topic);
+    if (found != topics_.end())
+        shards = found->second;
+}
+
+void ShardGroup::forward(size_t shard, ShardMessage msg)
+{
+    // Publish message before signalling so the woken shard always observes it
+    shards_[shard]->inbox.push(std::move(msg));
+    wake(shard);
+}
+
+bool ShardGroup::nextMessage(size_t shard, ShardMessage& msg)
+{
+    return shards_[shard]->inbox.pop(msg);
+}
+
+int ShardGroup::wakeHandle(size_t shard)
+{
+    return shards_[shard]->wakeFd;
+}
+
+uint64_t ShardGroup::registrationGeneration()
+{
+    return registrationGeneration_.load();
+}
+
+void ShardGroup::wake(size_t shard)
+{
+#ifdef __linux__
+    uint64_t one = 1;
+    if (shards_[shard]->wakeFd != -1)
+        (void)::write(shards_[shard]->wakeFd, &one, sizeof(one));
+#endif
+}
+
+void ShardGroup::clearWake(size_t shard)
+{
+#ifdef __linux__
+    uint64_t count;
+    (void)::read(shards_[shard]->wakeFd, &count, sizeof(count));
+#endif
+}
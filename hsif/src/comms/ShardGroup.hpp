@@ -0,0 +1,270 @@
+#pragma once
+
+#include "Server.hpp"
+#include "MpscQueue.hpp"
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Message handed from the shard that routed it to the shard that owns the destination.
+/// </summary>
+struct ShardMessage
+{
+	// Identifier of destination endpoint, or topic name for published messages
+	std::string to;
+	// Serialized JSON message, shared with every other recipient
+	Payload payload;
+	// Whether the message is delivered to the subscribers of topic "to"
+	bool publish;
+	// MetricsRegistry::now() stamp of the original receive, 0 if unknown
+	uint64_t receivedAt;
+};
+
+/// <summary>
+/// Location of a registered endpoint within the shard group.
+/// </summary>
+struct EndpointLocation
+{
+	// Index of shard owning the endpoint
+	size_t shard;
+	// Handle of the endpoint within the owning shard
+	EndpointHandle handle;
+};
+
+using EndpointDirectory = std::unordered_map<std::string, EndpointLocation>;
+using TopicDirectory = std::unordered_map<std::string, std::vector<size_t>>;
+
+/// <summary>
+/// Runs several Server reactors on their own threads. Each shard binds the same
+/// port with SO_REUSEPORT so the kernel spreads connections between them, and
+/// owns every endpoint it accepted. A global directory maps identifiers to the
+/// owning shard; messages for another shard cross over through that shard's
+/// lock-free inbox and an eventfd wakeup. Requires Linux and the epoll backend.
+/// </summary>
+class ShardGroup
+{
+public:
+	ShardGroup() = delete;
+
+	/// <summary>
+	/// Shard group initialization with socket and logging parameters.
+	/// </summary>
+	/// <param name="ip">Ip address to accept connections. Provide "" to accept connections on any ip.</param>
+	/// <param name="port">TCP port shared by every shard.</param>
+	/// <param name="logger">Pointer reference to Logger utility object.</param>
+	/// <param name="logToFile">Determines whether or not to log to file.</param>
+	/// <param name="shards">Number of reactor threads.</param>
+	ShardGroup(std::string ip, unsigned int port, std::shared_ptr<Logger> logger, bool logToFile, size_t shards);
+
+	/// <summary>
+	/// Stops reactor threads and releases wakeup handles.
+	/// </summary>
+	~ShardGroup();
+
+	// Shards hold a pointer back to their group
+	ShardGroup(const ShardGroup&) = delete;
+	ShardGroup& operator=(const ShardGroup&) = delete;
+
+	/// <summary>
+	/// Connects every shard and starts one poll thread per shard.
+	/// </summary>
+	/// <returns>Returns whether or not every shard started.</returns>
+	bool start();
+
+	/// <summary>
+	/// Selects how every shard reads messages when routing. Call before start().
+	/// </summary>
+	/// <param name="mode">Routing mode.</param>
+	void setRoutingMode(RoutingMode mode);
+
+	/// <summary>
+	/// Sets parking limits of every shard. Call before start().
+	/// </summary>
+	/// <param name="policy">Parking limits.</param>
+	void setParkingPolicy(ParkingPolicy policy);
+
+	/// <summary>
+	/// Sets outbound watermarks and overflow policy of every shard. Call before start().
+	/// </summary>
+	/// <param name="policy">Backpressure limits.</param>
+	void setBackpressurePolicy(BackpressurePolicy policy);
+
+	/// <summary>
+	/// Sets whether publishes to a topic conflate on every shard. Call before start().
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="conflate">Whether publishes to the topic conflate.</param>
+	void setTopicConflation(const std::string& topic, bool conflate);
+
+	/// <summary>
+	/// Makes every shard serve in-process clients handed over with Server::attachLocal(). Call before start().
+	/// </summary>
+	/// <param name="enabled">Whether in-process clients are served.</param>
+	void setLocalEndpoints(bool enabled);
+
+	/// <summary>
+	/// Signals every shard to stop and waits for their threads to exit.
+	/// </summary>
+	void stop();
+
+	/// <summary>
+	/// Blocks until every shard thread has exited.
+	/// </summary>
+	void join();
+
+	/// <summary>
+	/// Returns the server instance of a shard.
+	/// </summary>
+	/// <param name="shard">Shard index.</param>
+	/// <returns>Reference to shard server.</returns>
+	Server& server(size_t shard);
+
+	/// <summary>
+	/// Returns the metrics registry of a shard. Safe from any thread.
+	/// </summary>
+	/// <param name="shard">Shard index.</param>
+	/// <returns>Shard metrics.</returns>
+	std::shared_ptr<MetricsRegistry> metrics(size_t shard);
+
+	/// <summary>
+	/// Helper function used to determine number of shards.
+	/// </summary>
+	/// <returns>Number of reactor threads.</returns>
+	size_t numShards();
+
+	/// <summary>
+	/// Claims an identifier in the global directory.
+	/// </summary>
+	/// <param name="id">Endpoint identifier.</param>
+	/// <param name="location">Owning shard and endpoint handle.</param>
+	/// <returns>False if the identifier is already registered.</returns>
+	bool registerEndpoint(const std::string& id, EndpointLocation location);
+
+	/// <summary>
+	/// Releases an identifier if it is still owned by the given shard.
+	/// </summary>
+	/// <param name="id">Endpoint identifier.</param>
+	/// <param name="shard">Shard that owned the endpoint.</param>
+	void unregisterEndpoint(const std::string& id, size_t shard);
+
+	/// <summary>
+	/// Looks up the shard owning an identifier.
+	/// </summary>
+	/// <param name="id">Endpoint identifier.</param>
+	/// <param name="location">Receives owning shard and endpoint handle.</param>
+	/// <returns>True if the identifier is registered.</returns>
+	bool locate(const std::string& id, EndpointLocation& location);
+
+	/// <summary>
+	/// Records that a shard has at least one subscriber of a topic.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="shard">Subscribing shard.</param>
+	void subscribeTopic(const std::string& topic, size_t shard);
+
+	/// <summary>
+	/// Records that a shard no longer has subscribers of a topic.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="shard">Shard whose last subscriber left.</param>
+	void unsubscribeTopic(const std::string& topic, size_t shard);
+
+	/// <summary>
+	/// Looks up the shards with subscribers of a topic.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <param name="shards">Receives subscribing shard indexes.</param>
+	void topicShards(const std::string& topic, std::vector<size_t>& shards);
+
+	/// <summary>
+	/// Queues a message on another shard and wakes it. Safe from any shard thread.
+	/// </summary>
+	/// <param name="shard">Destination shard.</param>
+	/// <param name="msg">Message to deliver.</param>
+	void forward(size_t shard, ShardMessage msg);
+
+	/// <summary>
+	/// Dequeues the next cross-shard message. Only called by the owning shard.
+	/// </summary>
+	/// <param name="shard">Calling shard.</param>
+	/// <param name="msg">Receives the message.</param>
+	/// <returns>False if no messages are waiting.</returns>
+	bool nextMessage(size_t shard, ShardMessage& msg);
+
+	/// <summary>
+	/// Returns the eventfd a shard watches for cross-shard wakeups.
+	/// </summary>
+	/// <param name="shard">Shard index.</param>
+	/// <returns>Wakeup descriptor, -1 where unsupported.</returns>
+	int wakeHandle(size_t shard);
+
+	/// <summary>
+	/// Consumes pending wakeups. Only called by the owning shard.
+	/// </summary>
+	/// <param name="shard">Shard index.</param>
+	void clearWake(size_t shard);
+
+	/// <summary>
+	/// Returns a counter that increases on every registration in any shard. Shards
+	/// compare it against the last value seen to retry messages waiting on unknown endpoints.
+	/// </summary>
+	/// <returns>Registration generation.</returns>
+	uint64_t registrationGeneration();
+
+private:
+	/// <summary>
+	/// Signals a shard's wakeup handle.
+	/// </summary>
+	/// <param name="shard">Shard index.</param>
+	void wake(size_t shard);
+
+	/// <summary>
+	/// Reactor state owned by a single shard thread.
+	/// </summary>
+	struct Shard
+	{
+		Shard(Server server) : server(std::move(server)), wakeFd(-1) {};
+		// Shard server instance
+		Server server;
+		// Messages routed to this shard by other shards
+		MpscQueue<ShardMessage> inbox;
+		// Wakeup eventfd watched by the shard reactor
+		int wakeFd;
+		// Poll thread
+		std::thread thread;
+	};
+
+	// Shards in the group
+	std::vector<std::unique_ptr<Shard>> shards_;
+	// Global identifier directory
+	EndpointDirectory directory_;
+	// Shards subscribed to each topic
+	TopicDirectory topics_;
+	// Guards directory and topics (lookups vastly outnumber registrations)
+	std::shared_mutex directoryMutex_;
+	// Incremented on every registration
+	std::atomic<uint64_t> registrationGeneration_;
+	// Cleared to stop shard threads
+	std::atomic<bool> running_;
+	// Current logger object
+	std::shared_ptr<Logger> logger_;
+	// Determines whether or not to log to a file
+	bool logToFile_;
+};
@@ -0,0 +1,177 @@
+#include "SharedClient.hpp"
+#include <chrono>
+#include <charconv>
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+using SpinClock = std::chrono::steady_clock;
+
+SharedClient::SharedClient() :
+    control_(INVALID_SOCKET),
+    frames_(SHARED_READ_SIZE)
+{}
+
+SharedClient::~SharedClient()
+{
+    close();
+}
+
+bool SharedClient::connect(const std::string& path)
+{
+    if ((control_ = sock::connectLocal(path)) == INVALID_SOCKET)
+        return false;
+    if (!channel_.receiveHandles(control_))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool SharedClient::send(std::string_view payload)
+{
+    return send(payload, WireFormat::Text);
+}
+
+bool SharedClient::send(std::string_view payload, WireFormat format)
+{
+    if (control_ == INVALID_SOCKET)
+        return false;
+
+    // Same framing as a socket stream
+    char header[24];
+    size_t headerSize = BINARY_HEADER_SIZE;
+    if (format == WireFormat::Text)
+    {
+        char* end = std::to_chars(header, header + sizeof(header) - 1, payload.length()).ptr;
+        *end = '\r';
+        headerSize = end + 1 - header;
+    }
+    else
+        framing::writeBinaryHeader(header, format, 0, static_cast<uint32_t>(payload.length()));
+    IoVec vecs[2];
+    sock::setIoVec(vecs[0], header, headerSize);
+    sock::setIoVec(vecs[1], payload.data(), payload.length());
+
+    SharedRing& ring = channel_.sending();
+    size_t first = 0;
+    while (first < 2)
+    {
+        size_t written = ring.write(vecs + first, 2 - first);
+        if (written == SHARED_RING_ERROR)
+            return false;
+        if (written == 0)
+        {
+            // Full, the server rings once it has read
+            if (ring.prepareWait() && !waitBell(-1))
+                return false;
+            continue;
+        }
+        if (ring.wakeConsumer())
+            channel_.ringPeer();
+
+        // Skip what was written, a buffer may have gone in partly
+        while (first < 2 && written >= sock::ioVecView(vecs[first]).length())
+            written -= sock::ioVecView(vecs[first++]).length();
+        if (first < 2)
+        {
+            std::string_view rest = sock::ioVecView(vecs[first]).substr(written);
+            sock::setIoVec(vecs[first], rest.data(), rest.length());
+        }
+    }
+    return true;
+}
+
+bool SharedClient::receive(RecvFrame& frame, int timeoutMs)
+{
+    if (control_ == INVALID_SOCKET)
+        return false;
+    frames_.release();
+
+    SharedRing& ring = channel_.receiving();
+    SpinClock::time_point deadline = SpinClock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        FrameStatus status = frames_.nextFrame(frame);
+        if (status != FrameStatus::Incomplete)
+            return status == FrameStatus::Ready;
+
+        size_t bytes = ring.read(frames_.writePointer(), SHARED_READ_SIZE);
+        if (bytes == SHARED_RING_ERROR)
+            return false;
+        if (bytes > 0)
+        {
+            frames_.commit(bytes);
+            // The server may be waiting to write more
+            if (ring.wakeProducer())
+                channel_.ringPeer();
+            continue;
+        }
+
+        // A busy stream is usually picked up by polling, without a syscall on either side
+        SpinClock::time_point spinEnd = SpinClock::now() + std::chrono::microseconds(SHARED_SPIN_US);
+        while (ring.readable() == 0 && SpinClock::now() < spinEnd);
+        if (ring.readable() > 0 || !ring.prepareSleep())
+            continue;
+        int remaining = -1;
+        if (timeoutMs >= 0)
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - SpinClock::now()).count();
+            remaining = left > 0 ? static_cast<int>(left) : 0;
+        }
+        if (!waitBell(remaining) && (control_ == INVALID_SOCKET || ring.readable() == 0))
+            return false;
+    }
+}
+
+#ifdef __linux__
+
+bool SharedClient::waitBell(int timeoutMs)
+{
+    pollfd handles[2] = { { channel_.bell(), POLLIN, 0 }, { control_, POLLIN, 0 } };
+    if (::poll(handles, 2, timeoutMs) <= 0)
+        return false;
+    // The server never writes to the control socket after the handshake, readability means it closed
+    if (handles[1].revents != 0)
+    {
+        close();
+        return false;
+    }
+    channel_.clearBell();
+    return true;
+}
+
+#else
+
+bool SharedClient::waitBell(int timeoutMs)
+{
+    return false;
+}
+
+#endif
+
+void SharedClient::close()
+{
+    channel_.close();
+    if (control_ != INVALID_SOCKET)
+        sock::close(control_);
+    control_ = INVALID_SOCKET;
+}
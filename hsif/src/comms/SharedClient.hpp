@@ -0,0 +1,94 @@
+#pragma once
+
+#include "SharedRing.hpp"
+#include "FrameBuffer.hpp"
+#include <string>
+#include <string_view>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Time a receive polls the ring before sleeping on the doorbell, in microseconds
+#define SHARED_SPIN_US 50
+// Bytes copied out of the ring per read
+#define SHARED_READ_SIZE 65536
+
+/// <summary>
+/// Client of a broker on the same host, exchanging frames through a shared
+/// memory channel instead of a TCP connection. The client speaks the same
+/// protocol as a socket client: it registers, then sends and receives framed
+/// messages. Only functional on Linux.
+/// </summary>
+class SharedClient
+{
+public:
+	SharedClient();
+	~SharedClient();
+
+	// Client owns its control socket and channel
+	SharedClient(const SharedClient&) = delete;
+	SharedClient& operator=(const SharedClient&) = delete;
+
+	/// <summary>
+	/// Connects to the local socket a server accepts shared-memory clients on and maps the channel it hands over.
+	/// </summary>
+	/// <param name="path">Path given to Server::setSharedPath.</param>
+	/// <returns>True if successful.</returns>
+	bool connect(const std::string& path);
+
+	/// <summary>
+	/// Sends one text frame, waiting while the channel is full.
+	/// </summary>
+	/// <param name="payload">JSON message.</param>
+	/// <returns>False if the server closed the channel.</returns>
+	bool send(std::string_view payload);
+
+	/// <summary>
+	/// Sends one frame in the given format, waiting while the channel is full.
+	/// </summary>
+	/// <param name="payload">Encoded message.</param>
+	/// <param name="format">Encoding of payload.</param>
+	/// <returns>False if the server closed the channel.</returns>
+	bool send(std::string_view payload, WireFormat format);
+
+	/// <summary>
+	/// Receives the next frame. Polls the channel briefly, then sleeps on the doorbell.
+	/// </summary>
+	/// <param name="frame">Receives the frame, valid until the next receive.</param>
+	/// <param name="timeoutMs">Milliseconds to wait, -1 to wait indefinitely.</param>
+	/// <returns>False on timeout, a malformed stream, or if the server closed the channel.</returns>
+	bool receive(RecvFrame& frame, int timeoutMs);
+
+	/// <summary>
+	/// Closes the channel. The server removes the endpoint once it sees the control socket close.
+	/// </summary>
+	void close();
+
+private:
+	/// <summary>
+	/// Sleeps until the doorbell rings, the timeout passes or the server closes the control socket.
+	/// </summary>
+	/// <param name="timeoutMs">Milliseconds to wait, -1 to wait indefinitely.</param>
+	/// <returns>True if the doorbell rang.</returns>
+	bool waitBell(int timeoutMs);
+
+	// Local socket the channel was received over, watched for the server closing
+	SOCKET control_;
+	// Shared rings and doorbells
+	SharedChannel channel_;
+	// Bytes read from the ring, split into frames in place
+	FrameBuffer frames_;
+};
@@ -0,0 +1,310 @@
+#include "SharedRing.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Both processes update the same atomics, which must not hide a lock inside either address space
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared ring positions must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared ring flags must be lock-free");
+
+SharedRing::SharedRing() :
+    header_(nullptr),
+    data_(nullptr),
+    mask_(0)
+{}
+
+SharedRing::SharedRing(SharedRingHeader* header, char* data, size_t capacity) :
+    header_(header),
+    data_(data),
+    mask_(capacity - 1)
+{}
+
+size_t SharedRing::write(const IoVec* vecs, size_t count)
+{
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    uint64_t used = tail - header_->head.load(std::memory_order_acquire);
+    // The other process moves head, a position past the data would send the copy outside the ring
+    if (used > mask_ + 1)
+        return SHARED_RING_ERROR;
+    size_t space = mask_ + 1 - static_cast<size_t>(used);
+    size_t written = 0;
+    for (size_t index = 0; index < count && space > 0; index++)
+    {
+        std::string_view bytes = sock::ioVecView(vecs[index]);
+        size_t length = std::min(bytes.size(), space);
+        // Copy up to the end of the data area, then wrap to its start
+        size_t offset = static_cast<size_t>(tail + written) & mask_;
+        size_t first = std::min(length, mask_ + 1 - offset);
+        std::memcpy(data_ + offset, bytes.data(), first);
+        std::memcpy(data_, bytes.data() + first, length - first);
+        written += length;
+        space -= length;
+    }
+    // Publish the bytes only once they are in place
+    if (written > 0)
+        header_->tail.store(tail + written, std::memory_order_release);
+    return written;
+}
+
+size_t SharedRing::read(char* buffer, size_t length)
+{
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    uint64_t used = header_->tail.load(std::memory_order_acquire) - head;
+    if (used > mask_ + 1)
+        return SHARED_RING_ERROR;
+    length = std::min(length, static_cast<size_t>(used));
+    if (length == 0)
+        return 0;
+    size_t offset = static_cast<size_t>(head) & mask_;
+    size_t first = std::min(length, mask_ + 1 - offset);
+    std::memcpy(buffer, data_ + offset, first);
+    std::memcpy(buffer + first, data_, length - first);
+    // Hand the space back only once the bytes are copied out
+    header_->head.store(head + length, std::memory_order_release);
+    return length;
+}
+
+size_t SharedRing::readable() const
+{
+    return static_cast<size_t>(header_->tail.load(std::memory_order_acquire) - header_->head.load(std::memory_order_relaxed));
+}
+
+bool SharedRing::prepareSleep()
+{
+    // The flag must be visible before the emptiness check, or a write between them would go unnoticed
+    header_->consumerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (readable() == 0)
+        return true;
+    header_->consumerWaiting.store(0, std::memory_order_relaxed);
+    return false;
+}
+
+bool SharedRing::prepareWait()
+{
+    header_->producerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t used = header_->tail.load(std::memory_order_relaxed) - header_->head.load(std::memory_order_acquire);
+    if (used == mask_ + 1)
+        return true;
+    header_->producerWaiting.store(0, std::memory_order_relaxed);
+    return false;
+}
+
+bool SharedRing::wakeConsumer()
+{
+    // Pairs with the fence in prepareSleep: either the consumer sees the new tail or the producer sees the flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return header_->consumerWaiting.load(std::memory_order_relaxed) != 0 && header_->consumerWaiting.exchange(0) != 0;
+}
+
+bool SharedRing::wakeProducer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return header_->producerWaiting.load(std::memory_order_relaxed) != 0 && header_->producerWaiting.exchange(0) != 0;
+}
+
+bool SharedRing::valid() const
+{
+    return header_ != nullptr;
+}
+
+SharedChannel::SharedChannel() :
+    region_(nullptr),
+    regionSize_(0),
+    memoryFd_(-1),
+    bells_{ -1, -1 },
+    side_(0)
+{}
+
+SharedChannel::~SharedChannel()
+{
+    close();
+}
+
+SharedRing& SharedChannel::receiving()
+{
+    return rings_[side_];
+}
+
+SharedRing& SharedChannel::sending()
+{
+    return rings_[1 - side_];
+}
+
+SOCKET SharedChannel::bell()
+{
+    return static_cast<SOCKET>(bells_[side_]);
+}
+
+#ifdef __linux__
+
+bool SharedChannel::create(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    side_ = 0;
+    memoryFd_ = memfd_create("hsif-channel", MFD_CLOEXEC);
+    bells_[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    bells_[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    size_t regionSize = sizeof(SharedRegionHeader) + 2 * size;
+    if (memoryFd_ == -1 || bells_[0] == -1 || bells_[1] == -1 || ftruncate(memoryFd_, regionSize) == -1)
+    {
+        close();
+        return false;
+    }
+    void* region = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd_, 0);
+    if (region == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    // Fresh memfd pages read as zero, so both rings start empty with no one waiting
+    SharedRegionHeader* header = new (region) SharedRegionHeader{};
+    header->capacity = static_cast<uint32_t>(size);
+    header->magic = SHARED_CHANNEL_MAGIC;
+    munmap(region, regionSize);
+    return map(regionSize);
+}
+
+bool SharedChannel::sendHandles(SOCKET control)
+{
+    int handles[3] = { memoryFd_, bells_[0], bells_[1] };
+    if (!sock::sendHandles(control, handles, 3))
+        return false;
+    // The mapping outlives its descriptor, which only needed to reach the client
+    ::close(memoryFd_);
+    memoryFd_ = -1;
+    return true;
+}
+
+bool SharedChannel::receiveHandles(SOCKET control)
+{
+    int handles[3];
+    if (!sock::recvHandles(control, handles, 3))
+        return false;
+    memoryFd_ = handles[0];
+    bells_[0] = handles[1];
+    bells_[1] = handles[2];
+    side_ = 1;
+    struct stat status;
+    bool mapped = fstat(memoryFd_, &status) == 0 && map(static_cast<size_t>(status.st_size));
+    ::close(memoryFd_);
+    memoryFd_ = -1;
+    if (!mapped)
+        close();
+    return mapped;
+}
+
+bool SharedChannel::map(size_t size)
+{
+    if (size < sizeof(SharedRegionHeader))
+        return false;
+    void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd_, 0);
+    if (region == MAP_FAILED)
+        return false;
+    region_ = region;
+    regionSize_ = size;
+
+    // A region from the other side is trusted only as far as its sizes agree
+    SharedRegionHeader* header = static_cast<SharedRegionHeader*>(region_);
+    size_t capacity = header->capacity;
+    if (header->magic != SHARED_CHANNEL_MAGIC || capacity == 0 || (capacity & (capacity - 1)) != 0 || size < sizeof(SharedRegionHeader) + 2 * capacity)
+        return false;
+    char* data = static_cast<char*>(region_) + sizeof(SharedRegionHeader);
+    rings_[0] = SharedRing(&header->rings[0], data, capacity);
+    rings_[1] = SharedRing(&header->rings[1], data + capacity, capacity);
+    return true;
+}
+
+void SharedChannel::clearBell()
+{
+    uint64_t count;
+    (void)::read(bells_[side_], &count, sizeof(count));
+}
+
+void SharedChannel::ringPeer()
+{
+    uint64_t one = 1;
+    (void)::write(bells_[1 - side_], &one, sizeof(one));
+}
+
+void SharedChannel::ringSelf()
+{
+    uint64_t one = 1;
+    (void)::write(bells_[side_], &one, sizeof(one));
+}
+
+void SharedChannel::close()
+{
+    if (region_)
+        munmap(region_, regionSize_);
+    region_ = nullptr;
+    rings_[0] = SharedRing();
+    rings_[1] = SharedRing();
+    for (int* handle : { &memoryFd_, &bells_[0], &bells_[1] })
+    {
+        if (*handle != -1)
+            ::close(*handle);
+        *handle = -1;
+    }
+}
+
+#else
+
+bool SharedChannel::create(size_t capacity)
+{
+    return false;
+}
+
+bool SharedChannel::sendHandles(SOCKET control)
+{
+    return false;
+}
+
+bool SharedChannel::receiveHandles(SOCKET control)
+{
+    return false;
+}
+
+bool SharedChannel::map(size_t size)
+{
+    return false;
+}
+
+void SharedChannel::clearBell()
+{}
+
+void SharedChannel::ringPeer()
+{}
+
+void SharedChannel::ringSelf()
+{}
+
+void SharedChannel::close()
+{}
+
+#endif
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "Socket.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Marks a mapped region as an HSIF shared channel ("HSIF")
+#define SHARED_CHANNEL_MAGIC 0x46495348u
+// Bytes buffered in each direction of a shared channel
+#define SHARED_RING_CAPACITY (1024 * 1024)
+// Returned by ring reads and writes when the peer left positions no valid ring can have
+#define SHARED_RING_ERROR SIZE_MAX
+
+/// <summary>
+/// Positions and wakeup flags of one ring direction, placed in shared memory.
+/// Producer and consumer positions sit on separate cache lines.
+/// </summary>
+struct SharedRingHeader
+{
+	// Total bytes written by the producer
+	alignas(64) std::atomic<uint64_t> tail;
+	// Total bytes read by the consumer
+	alignas(64) std::atomic<uint64_t> head;
+	// Set by a consumer about to sleep on its doorbell
+	alignas(64) std::atomic<uint32_t> consumerWaiting;
+	// Set by a producer that found the ring full
+	std::atomic<uint32_t> producerWaiting;
+};
+
+/// <summary>
+/// Start of a shared channel mapping, followed by the data of both rings.
+/// </summary>
+struct SharedRegionHeader
+{
+	// SHARED_CHANNEL_MAGIC once initialized
+	uint32_t magic;
+	// Data bytes of each ring, a power of two
+	uint32_t capacity;
+	// Client to server, then server to client
+	SharedRingHeader rings[2];
+};
+
+/// <summary>
+/// Single-producer single-consumer byte ring over shared memory. Carries the
+/// same framed byte stream a socket would, so writes may end mid-frame and
+/// readers reassemble frames exactly as they do from a socket. Positions only
+/// grow; indexes are positions masked by the capacity.
+/// </summary>
+class SharedRing
+{
+public:
+	SharedRing();
+
+	/// <summary>
+	/// Ring over an initialized header and its data.
+	/// </summary>
+	/// <param name="header">Shared positions and flags.</param>
+	/// <param name="data">Shared data area.</param>
+	/// <param name="capacity">Data area size, a power of two.</param>
+	SharedRing(SharedRingHeader* header, char* data, size_t capacity);
+
+	/// <summary>
+	/// Copies as many bytes of the buffers as fit. Producer only.
+	/// </summary>
+	/// <param name="vecs">Buffers to write in order.</param>
+	/// <param name="count">Number of buffers.</param>
+	/// <returns>Bytes written, 0 if the ring is full, or SHARED_RING_ERROR if the positions
+	/// are more than the capacity apart.</returns>
+	size_t write(const IoVec* vecs, size_t count);
+
+	/// <summary>
+	/// Copies up to length buffered bytes out. Consumer only.
+	/// </summary>
+	/// <param name="buffer">Destination buffer.</param>
+	/// <param name="length">Capacity of destination buffer.</param>
+	/// <returns>Bytes read, 0 if the ring is empty, or SHARED_RING_ERROR if the positions
+	/// are more than the capacity apart.</returns>
+	size_t read(char* buffer, size_t length);
+
+	/// <summary>
+	/// Returns number of buffered bytes.
+	/// </summary>
+	/// <returns>Readable byte count.</returns>
+	size_t readable() const;
+
+	/// <summary>
+	/// Announces that the consumer is about to wait for its doorbell. Consumer only.
+	/// </summary>
+	/// <returns>False if bytes arrived meanwhile and the consumer should read instead.</returns>
+	bool prepareSleep();
+
+	/// <summary>
+	/// Announces that the producer is waiting for space. Producer only.
+	/// </summary>
+	/// <returns>False if space was freed meanwhile and the producer should write instead.</returns>
+	bool prepareWait();
+
+	/// <summary>
+	/// Tells whether the consumer sleeps and must be woken after a write. Producer only.
+	/// </summary>
+	/// <returns>True once per sleep of the consumer.</returns>
+	bool wakeConsumer();
+
+	/// <summary>
+	/// Tells whether the producer waits and must be woken after a read. Consumer only.
+	/// </summary>
+	/// <returns>True once per wait of the producer.</returns>
+	bool wakeProducer();
+
+	/// <summary>
+	/// Returns whether the ring is mapped.
+	/// </summary>
+	/// <returns>True if usable.</returns>
+	bool valid() const;
+
+private:
+	// Shared positions and flags
+	SharedRingHeader* header_;
+	// Shared data area
+	char* data_;
+	// Capacity minus one
+	size_t mask_;
+};
+
+/// <summary>
+/// Pair of SharedRings in one memfd mapping plus an eventfd doorbell per side,
+/// connecting a broker with a client on the same host. The server creates the
+/// channel and passes the memfd and both doorbells to the client over a local
+/// socket. A side only rings the other's doorbell when the other announced it
+/// is sleeping or waiting for space, so a busy stream costs no syscalls.
+/// Only functional on Linux.
+/// </summary>
+class SharedChannel
+{
+public:
+	SharedChannel();
+	~SharedChannel();
+
+	// Channel owns its mapping and handles
+	SharedChannel(const SharedChannel&) = delete;
+	SharedChannel& operator=(const SharedChannel&) = delete;
+
+	/// <summary>
+	/// Creates the mapping and doorbells as the server side.
+	/// </summary>
+	/// <param name="capacity">Minimum bytes buffered in each direction, rounded up to a power of two.</param>
+	/// <returns>True if successful.</returns>
+	bool create(size_t capacity);
+
+	/// <summary>
+	/// Passes the mapping and doorbells to the client. Server only.
+	/// </summary>
+	/// <param name="control">Local socket connected to the client.</param>
+	/// <returns>True if successful.</returns>
+	bool sendHandles(SOCKET control);
+
+	/// <summary>
+	/// Receives and maps a channel as the client side.
+	/// </summary>
+	/// <param name="control">Local socket connected to the server.</param>
+	/// <returns>True if successful.</returns>
+	bool receiveHandles(SOCKET control);
+
+	/// <summary>
+	/// Returns the ring this side reads from.
+	/// </summary>
+	/// <returns>Receiving ring.</returns>
+	SharedRing& receiving();
+
+	/// <summary>
+	/// Returns the ring this side writes to.
+	/// </summary>
+	/// <returns>Sending ring.</returns>
+	SharedRing& sending();
+
+	/// <summary>
+	/// Returns the doorbell this side waits on, readable once rung.
+	/// </summary>
+	/// <returns>Eventfd handle.</returns>
+	SOCKET bell();
+
+	/// <summary>
+	/// Consumes pending rings of this side's doorbell.
+	/// </summary>
+	void clearBell();
+
+	/// <summary>
+	/// Rings the other side's doorbell.
+	/// </summary>
+	void ringPeer();
+
+	/// <summary>
+	/// Rings this side's own doorbell, so its next wait returns at once.
+	/// </summary>
+	void ringSelf();
+
+	/// <summary>
+	/// Unmaps the channel and closes its handles.
+	/// </summary>
+	void close();
+
+private:
+	/// <summary>
+	/// Maps the channel memfd, checks its header and points both rings into it.
+	/// </summary>
+	/// <param name="size">Size of the memfd.</param>
+	/// <returns>False if mapping failed or the header does not describe a channel of that size.</returns>
+	bool map(size_t size);
+
+	// Mapping and its size
+	void* region_;
+	size_t regionSize_;
+	// Memfd backing the mapping
+	int memoryFd_;
+	// Doorbells of the server and of the client
+	int bells_[2];
+	// 0 on the server side, 1 on the client side
+	size_t side_;
+	// Rings indexed like SharedRegionHeader::rings
+	SharedRing rings_[2];
+};
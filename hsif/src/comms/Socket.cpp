@@ -0,0 +1,396 @@
+#include "Socket.hpp"
+#include <cstring>
+#include <vector>
+#ifndef _WIN32
+#include <sys/un.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+#ifdef _WIN32
+
+int sock::startup()
+{
+    WSADATA wsaData;
+    return WSAStartup(0x0202, &wsaData);
+}
+
+void sock::teardown()
+{
+    WSACleanup();
+}
+
+int sock::lastError()
+{
+    return WSAGetLastError();
+}
+
+bool sock::wouldBlock(int error)
+{
+    return error == WSAEWOULDBLOCK;
+}
+
+bool sock::acceptAborted(int error)
+{
+    return error == WSAECONNRESET;
+}
+
+bool sock::setNonBlocking(SOCKET socket)
+{
+    ULONG nonBlock = 1;
+    return ioctlsocket(socket, FIONBIO, &nonBlock) != SOCKET_ERROR;
+}
+
+bool sock::setReuseAddress(SOCKET socket)
+{
+    // SO_REUSEADDR on windows allows other processes to steal the port
+    return true;
+}
+
+bool sock::setReusePort(SOCKET socket)
+{
+    return false;
+}
+
+bool sock::fitsSelect(SOCKET socket)
+{
+    return socket != INVALID_SOCKET;
+}
+
+bool sock::setNoDelay(SOCKET socket, bool enabled)
+{
+    BOOL value = enabled ? TRUE : FALSE;
+    return setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&value, sizeof(value)) != SOCKET_ERROR;
+}
+
+bool sock::setCork(SOCKET socket, bool enabled)
+{
+    return false;
+}
+
+int sock::recv(SOCKET socket, char* buffer, size_t length)
+{
+    return ::recv(socket, buffer, static_cast<int>(length), 0);
+}
+
+int sock::send(SOCKET socket, const char* buffer, size_t length)
+{
+    return ::send(socket, buffer, static_cast<int>(length), 0);
+}
+
+int sock::sendv(SOCKET socket, IoVec* vecs, size_t count)
+{
+    DWORD bytesSent;
+    if (WSASend(socket, vecs, static_cast<DWORD>(count), &bytesSent, 0, NULL, NULL) == SOCKET_ERROR)
+        return SOCKET_ERROR;
+    return static_cast<int>(bytesSent);
+}
+
+int sock::recvFrom(SOCKET socket, char* buffer, size_t length, DatagramAddress& from)
+{
+    from.length = sizeof(from.storage);
+    return ::recvfrom(socket, buffer, static_cast<int>(length), 0, (sockaddr*)&from.storage, &from.length);
+}
+
+int sock::sendTo(SOCKET socket, IoVec* vecs, size_t count, const DatagramAddress& to)
+{
+    DWORD bytesSent;
+    if (WSASendTo(socket, vecs, static_cast<DWORD>(count), &bytesSent, 0, (const sockaddr*)&to.storage, to.length, NULL, NULL) == SOCKET_ERROR)
+        return SOCKET_ERROR;
+    return static_cast<int>(bytesSent);
+}
+
+void sock::setIoVec(IoVec& vec, const char* buffer, size_t length)
+{
+    vec.buf = const_cast<char*>(buffer);
+    vec.len = static_cast<ULONG>(length);
+}
+
+std::string_view sock::ioVecView(const IoVec& vec)
+{
+    return std::string_view(vec.buf, vec.len);
+}
+
+unsigned int sock::localPort(SOCKET socket)
+{
+    sockaddr_in address = {};
+    int length = sizeof(address);
+    if (getsockname(socket, (sockaddr*)&address, &length) == SOCKET_ERROR)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+SOCKET sock::listenLocal(const std::string& path)
+{
+    WSASetLastError(WSAEAFNOSUPPORT);
+    return INVALID_SOCKET;
+}
+
+SOCKET sock::connectLocal(const std::string& path)
+{
+    WSASetLastError(WSAEAFNOSUPPORT);
+    return INVALID_SOCKET;
+}
+
+bool sock::sendHandles(SOCKET socket, const int* handles, size_t count)
+{
+    return false;
+}
+
+bool sock::recvHandles(SOCKET socket, int* handles, size_t count)
+{
+    return false;
+}
+
+void sock::close(SOCKET socket)
+{
+    closesocket(socket);
+}
+
+#else
+
+int sock::startup()
+{
+    return 0;
+}
+
+void sock::teardown()
+{}
+
+int sock::lastError()
+{
+    return errno;
+}
+
+bool sock::wouldBlock(int error)
+{
+    return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+}
+
+bool sock::acceptAborted(int error)
+{
+    // Linux also passes on network errors already pending on the new connection
+    return error == ECONNABORTED || error == EPROTO || error == ENETDOWN || error == ENETUNREACH ||
+           error == EHOSTUNREACH || error == EHOSTDOWN || error == ENOPROTOOPT || error == EOPNOTSUPP;
+}
+
+bool sock::setNonBlocking(SOCKET socket)
+{
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags == -1)
+        return false;
+    return fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+bool sock::setReuseAddress(SOCKET socket)
+{
+    int enable = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == 0;
+}
+
+bool sock::setReusePort(SOCKET socket)
+{
+#ifdef SO_REUSEPORT
+    int enable = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == 0;
+#else
+    return false;
+#endif
+}
+
+bool sock::fitsSelect(SOCKET socket)
+{
+    return socket >= 0 && socket < FD_SETSIZE;
+}
+
+bool sock::setNoDelay(SOCKET socket, bool enabled)
+{
+    int value = enabled ? 1 : 0;
+    return setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) == 0;
+}
+
+bool sock::setCork(SOCKET socket, bool enabled)
+{
+#ifdef TCP_CORK
+    int value = enabled ? 1 : 0;
+    return setsockopt(socket, IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) == 0;
+#else
+    return false;
+#endif
+}
+
+int sock::recv(SOCKET socket, char* buffer, size_t length)
+{
+    return static_cast<int>(::recv(socket, buffer, length, 0));
+}
+
+int sock::send(SOCKET socket, const char* buffer, size_t length)
+{
+    // Broken connections are reported through EPIPE rather than killing the process
+    return static_cast<int>(::send(socket, buffer, length, MSG_NOSIGNAL));
+}
+
+int sock::sendv(SOCKET socket, IoVec* vecs, size_t count)
+{
+    // sendmsg rather than writev so MSG_NOSIGNAL applies
+    msghdr message = {};
+    message.msg_iov = vecs;
+    message.msg_iovlen = count;
+    return static_cast<int>(::sendmsg(socket, &message, MSG_NOSIGNAL));
+}
+
+int sock::recvFrom(SOCKET socket, char* buffer, size_t length, DatagramAddress& from)
+{
+    from.length = sizeof(from.storage);
+    return static_cast<int>(::recvfrom(socket, buffer, length, 0, (sockaddr*)&from.storage, &from.length));
+}
+
+int sock::sendTo(SOCKET socket, IoVec* vecs, size_t count, const DatagramAddress& to)
+{
+    msghdr message = {};
+    message.msg_name = const_cast<sockaddr_storage*>(&to.storage);
+    message.msg_namelen = to.length;
+    message.msg_iov = vecs;
+    message.msg_iovlen = count;
+    return static_cast<int>(::sendmsg(socket, &message, MSG_NOSIGNAL));
+}
+
+void sock::setIoVec(IoVec& vec, const char* buffer, size_t length)
+{
+    vec.iov_base = const_cast<char*>(buffer);
+    vec.iov_len = length;
+}
+
+std::string_view sock::ioVecView(const IoVec& vec)
+{
+    return std::string_view(static_cast<const char*>(vec.iov_base), vec.iov_len);
+}
+
+unsigned int sock::localPort(SOCKET socket)
+{
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    if (getsockname(socket, (sockaddr*)&address, &length) == SOCKET_ERROR)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+// Fills a local socket address, false if the path does not fit
+static bool localAddress(const std::string& path, sockaddr_un& address)
+{
+    address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+    return true;
+}
+
+SOCKET sock::listenLocal(const std::string& path)
+{
+    sockaddr_un address;
+    if (!localAddress(path, address))
+        return INVALID_SOCKET;
+    SOCKET socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket == INVALID_SOCKET)
+        return INVALID_SOCKET;
+    // A socket file outlives the process that bound it
+    ::unlink(path.c_str());
+    if (bind(socket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR || listen(socket, SOMAXCONN) == SOCKET_ERROR || !setNonBlocking(socket))
+    {
+        int error = errno;
+        ::close(socket);
+        errno = error;
+        return INVALID_SOCKET;
+    }
+    return socket;
+}
+
+SOCKET sock::connectLocal(const std::string& path)
+{
+    sockaddr_un address;
+    if (!localAddress(path, address))
+        return INVALID_SOCKET;
+    SOCKET socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket == INVALID_SOCKET)
+        return INVALID_SOCKET;
+    if (::connect(socket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR)
+    {
+        int error = errno;
+        ::close(socket);
+        errno = error;
+        return INVALID_SOCKET;
+    }
+    return socket;
+}
+
+bool sock::sendHandles(SOCKET socket, const int* handles, size_t count)
+{
+    // Ancillary data needs a byte of regular data to travel with
+    char byte = 0;
+    iovec vec = { &byte, 1 };
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+    msghdr message = {};
+    message.msg_iov = &vec;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    std::memcpy(CMSG_DATA(header), handles, sizeof(int) * count);
+    return ::sendmsg(socket, &message, MSG_NOSIGNAL) == 1;
+}
+
+bool sock::recvHandles(SOCKET socket, int* handles, size_t count)
+{
+    char byte;
+    iovec vec = { &byte, 1 };
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+    msghdr message = {};
+    message.msg_iov = &vec;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+    if (::recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != 1)
+        return false;
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(int) * count))
+    {
+        // Close whatever did arrive rather than leak it
+        if (header && header->cmsg_type == SCM_RIGHTS)
+        {
+            size_t received = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t index = 0; index < received; index++)
+                ::close(reinterpret_cast<int*>(CMSG_DATA(header))[index]);
+        }
+        return false;
+    }
+    std::memcpy(handles, CMSG_DATA(header), sizeof(int) * count);
+    return true;
+}
+
+void sock::close(SOCKET socket)
+{
+    ::close(socket);
+}
+
+#endif
@@ -0,0 +1,270 @@
+#pragma once
+
+#ifdef _WIN32
+
+#undef UNICODE
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#pragma comment (lib, "Ws2_32.lib")
+
+// Scatter-gather element
+using IoVec = WSABUF;
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+
+// Map winsock types and constants onto their POSIX equivalents
+using SOCKET = int;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define SD_SEND SHUT_WR
+#define SD_BOTH SHUT_RDWR
+
+// Scatter-gather element
+using IoVec = iovec;
+
+#endif
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/// <summary>
+/// Address of a datagram peer, as filled by sock::recvFrom.
+/// </summary>
+struct DatagramAddress
+{
+	sockaddr_storage storage;
+	socklen_t length;
+};
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Thin portability layer over winsock and POSIX sockets. Server and Endpoint
+/// only talk to sockets through these functions.
+/// </summary>
+namespace sock
+{
+	/// <summary>
+	/// Initializes the socket library (WSAStartup on windows, no-op on POSIX).
+	/// </summary>
+	/// <returns>Zero on success, platform error code otherwise.</returns>
+	int startup();
+
+	/// <summary>
+	/// Releases the socket library (WSACleanup on windows, no-op on POSIX).
+	/// </summary>
+	void teardown();
+
+	/// <summary>
+	/// Returns the last socket error code for the calling thread.
+	/// </summary>
+	/// <returns>WSAGetLastError() on windows, errno on POSIX.</returns>
+	int lastError();
+
+	/// <summary>
+	/// Determines whether an error code means the operation would have blocked.
+	/// </summary>
+	/// <param name="error">Error code returned by lastError().</param>
+	/// <returns>True if the socket is simply not ready.</returns>
+	bool wouldBlock(int error);
+
+	/// <summary>
+	/// Determines whether an accept() error only concerns the connection being
+	/// accepted, such as a client resetting during the handshake, so the
+	/// listener may go on accepting.
+	/// </summary>
+	/// <param name="error">Error code returned by lastError().</param>
+	/// <returns>True if the next pending connection may be accepted.</returns>
+	bool acceptAborted(int error);
+
+	/// <summary>
+	/// Places socket in non-blocking mode.
+	/// </summary>
+	/// <param name="socket">Socket to modify.</param>
+	/// <returns>True if successful.</returns>
+	bool setNonBlocking(SOCKET socket);
+
+	/// <summary>
+	/// Returns whether select() can watch the socket. POSIX fd_sets are bitmaps
+	/// of FD_SETSIZE descriptors, so larger descriptors cannot be added safely.
+	/// Winsock fd_sets hold handles of any value.
+	/// </summary>
+	/// <param name="socket">Socket to check.</param>
+	/// <returns>True if the socket may be passed to FD_SET.</returns>
+	bool fitsSelect(SOCKET socket);
+
+	/// <summary>
+	/// Allows a listening socket to rebind an address still in TIME_WAIT. Only
+	/// applied on POSIX, where SO_REUSEADDR does not permit port hijacking.
+	/// </summary>
+	/// <param name="socket">Listening socket to modify.</param>
+	/// <returns>True if successful.</returns>
+	bool setReuseAddress(SOCKET socket);
+
+	/// <summary>
+	/// Allows several listening sockets to bind the same port so the kernel
+	/// load balances incoming connections between them (SO_REUSEPORT).
+	/// </summary>
+	/// <param name="socket">Listening socket to modify.</param>
+	/// <returns>True if successful, false where unsupported.</returns>
+	bool setReusePort(SOCKET socket);
+
+	/// <summary>
+	/// Enables or disables Nagle's algorithm (TCP_NODELAY). With it disabled
+	/// small writes leave immediately instead of waiting for outstanding acks.
+	/// </summary>
+	/// <param name="socket">Connected socket to modify.</param>
+	/// <param name="enabled">True to send small writes without delay.</param>
+	/// <returns>True if successful.</returns>
+	bool setNoDelay(SOCKET socket, bool enabled);
+
+	/// <summary>
+	/// Corks or uncorks a socket (TCP_CORK). While corked only full segments
+	/// are sent; uncorking flushes whatever remains.
+	/// </summary>
+	/// <param name="socket">Connected socket to modify.</param>
+	/// <param name="enabled">True to cork, false to uncork and flush.</param>
+	/// <returns>True if successful, false where unsupported.</returns>
+	bool setCork(SOCKET socket, bool enabled);
+
+	/// <summary>
+	/// Receives available bytes from socket.
+	/// </summary>
+	/// <param name="socket">Connected socket.</param>
+	/// <param name="buffer">Destination buffer.</param>
+	/// <param name="length">Capacity of destination buffer.</param>
+	/// <returns>Bytes received, 0 on orderly close, or SOCKET_ERROR.</returns>
+	int recv(SOCKET socket, char* buffer, size_t length);
+
+	/// <summary>
+	/// Sends bytes on socket without raising SIGPIPE.
+	/// </summary>
+	/// <param name="socket">Connected socket.</param>
+	/// <param name="buffer">Source buffer.</param>
+	/// <param name="length">Number of bytes to send.</param>
+	/// <returns>Bytes sent or SOCKET_ERROR.</returns>
+	int send(SOCKET socket, const char* buffer, size_t length);
+
+	/// <summary>
+	/// Sends several buffers in one call (sendmsg/WSASend) without raising SIGPIPE.
+	/// </summary>
+	/// <param name="socket">Connected socket.</param>
+	/// <param name="vecs">Buffers to send in order.</param>
+	/// <param name="count">Number of buffers.</param>
+	/// <returns>Bytes sent or SOCKET_ERROR.</returns>
+	int sendv(SOCKET socket, IoVec* vecs, size_t count);
+
+	/// <summary>
+	/// Receives one datagram and the address it came from.
+	/// </summary>
+	/// <param name="socket">Bound datagram socket.</param>
+	/// <param name="buffer">Destination buffer.</param>
+	/// <param name="length">Capacity of destination buffer, longer datagrams are truncated.</param>
+	/// <param name="from">Receives sender address.</param>
+	/// <returns>Bytes received or SOCKET_ERROR.</returns>
+	int recvFrom(SOCKET socket, char* buffer, size_t length, DatagramAddress& from);
+
+	/// <summary>
+	/// Sends several buffers as one datagram (sendmsg/WSASendTo).
+	/// </summary>
+	/// <param name="socket">Bound datagram socket.</param>
+	/// <param name="vecs">Buffers making up the datagram in order.</param>
+	/// <param name="count">Number of buffers.</param>
+	/// <param name="to">Destination address.</param>
+	/// <returns>Bytes sent or SOCKET_ERROR.</returns>
+	int sendTo(SOCKET socket, IoVec* vecs, size_t count, const DatagramAddress& to);
+
+	/// <summary>
+	/// Points a scatter-gather element at a buffer.
+	/// </summary>
+	/// <param name="vec">Element to fill.</param>
+	/// <param name="buffer">Start of buffer.</param>
+	/// <param name="length">Buffer length.</param>
+	void setIoVec(IoVec& vec, const char* buffer, size_t length);
+
+	/// <summary>
+	/// Returns the buffer a scatter-gather element points at.
+	/// </summary>
+	/// <param name="vec">Filled element.</param>
+	/// <returns>View of the element's bytes.</returns>
+	std::string_view ioVecView(const IoVec& vec);
+
+	/// <summary>
+	/// Returns the local port a socket is bound to.
+	/// </summary>
+	/// <param name="socket">Bound socket.</param>
+	/// <returns>Port in host byte order, 0 on failure.</returns>
+	unsigned int localPort(SOCKET socket);
+
+	/// <summary>
+	/// Creates a non-blocking stream socket listening on a local (Unix domain) path,
+	/// replacing any socket file left at the path. Not supported on windows.
+	/// </summary>
+	/// <param name="path">Filesystem path of the socket.</param>
+	/// <returns>Listening socket or INVALID_SOCKET.</returns>
+	SOCKET listenLocal(const std::string& path);
+
+	/// <summary>
+	/// Connects a blocking stream socket to a local (Unix domain) path. Not supported on windows.
+	/// </summary>
+	/// <param name="path">Filesystem path of the socket.</param>
+	/// <returns>Connected socket or INVALID_SOCKET.</returns>
+	SOCKET connectLocal(const std::string& path);
+
+	/// <summary>
+	/// Passes open handles to the peer of a local socket (SCM_RIGHTS) along with
+	/// one byte of data. Not supported on windows.
+	/// </summary>
+	/// <param name="socket">Connected local socket.</param>
+	/// <param name="handles">Handles to duplicate into the peer.</param>
+	/// <param name="count">Number of handles.</param>
+	/// <returns>True if the handles were sent.</returns>
+	bool sendHandles(SOCKET socket, const int* handles, size_t count);
+
+	/// <summary>
+	/// Receives handles passed with sock::sendHandles, blocking until they arrive.
+	/// Not supported on windows.
+	/// </summary>
+	/// <param name="socket">Connected local socket.</param>
+	/// <param name="handles">Receives the handles.</param>
+	/// <param name="count">Number of handles expected.</param>
+	/// <returns>False unless exactly count handles arrived.</returns>
+	bool recvHandles(SOCKET socket, int* handles, size_t count);
+
+	/// <summary>
+	/// Closes socket handle.
+	/// </summary>
+	/// <param name="socket">Socket to close.</param>
+	void close(SOCKET socket);
+}
@@ -0,0 +1,204 @@
+#include "MsgHeader.hpp"
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+namespace
+{
+	/// <summary>
+	/// Cursor over a payload with the skipping rules the header scan needs.
+	/// </summary>
+	struct Scanner
+	{
+		const char* pos;
+		const char* end;
+
+		// Advances past JSON whitespace, returns false at end of input
+		bool skipSpace()
+		{
+			while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+				pos++;
+			return pos < end;
+		}
+
+		// Reads a string starting at the opening quote, reporting whether it contains escapes
+		bool readString(std::string_view& text, bool& escaped)
+		{
+			if (pos >= end || *pos != '"')
+				return false;
+			const char* start = ++pos;
+			escaped = false;
+			while (pos < end && *pos != '"')
+			{
+				// Escaped character can never close the string
+				if (*pos == '\\')
+				{
+					escaped = true;
+					pos++;
+				}
+				pos++;
+			}
+			if (pos >= end)
+				return false;
+			text = std::string_view(start, pos - start);
+			pos++;
+			return true;
+		}
+
+		// Skips any value, tracking only nesting depth and string boundaries
+		bool skipValue()
+		{
+			std::string_view text;
+			bool escaped;
+			if (pos >= end)
+				return false;
+			if (*pos == '"')
+				return readString(text, escaped);
+			if (*pos == '{' || *pos == '[')
+			{
+				int depth = 0;
+				while (pos < end)
+				{
+					char current = *pos;
+					if (current == '"')
+					{
+						if (!readString(text, escaped))
+							return false;
+						continue;
+					}
+					if (current == '{' || current == '[')
+						depth++;
+					else if (current == '}' || current == ']')
+					{
+						if (--depth == 0)
+						{
+							pos++;
+							return true;
+						}
+					}
+					pos++;
+				}
+				return false;
+			}
+			// Number or literal runs until the next delimiter
+			const char* start = pos;
+			while (pos < end && *pos != ',' && *pos != '}' && *pos != ']' && *pos != ' ' && *pos != '\t' && *pos != '\n' && *pos != '\r')
+				pos++;
+			return pos > start;
+		}
+	};
+}
+
+bool MsgHeader::scan(std::string_view payload)
+{
+	type = to = from = value = key = std::string_view();
+	Scanner scanner = { payload.data(), payload.data() + payload.size() };
+	if (!scanner.skipSpace() || *scanner.pos != '{')
+		return false;
+	scanner.pos++;
+
+	bool haveType = false;
+	bool haveTo = false;
+	bool haveFrom = false;
+	bool haveValue = false;
+	while (scanner.skipSpace())
+	{
+		// A type missing the field it routes on is left to the full parser, which rejects it
+		if (*scanner.pos == '}')
+			return haveType && !(((type == "message" || type == "publish") && !haveTo) ||
+			                     ((type == "registration" || type == "subscribe" || type == "unsubscribe" || type == "channel") && !haveValue));
+		if (*scanner.pos == ',')
+		{
+			scanner.pos++;
+			continue;
+		}
+
+		// Read key and separator
+		std::string_view key;
+		bool escaped;
+		if (!scanner.readString(key, escaped) || !scanner.skipSpace() || *scanner.pos != ':')
+			return false;
+		scanner.pos++;
+		if (!scanner.skipSpace())
+			return false;
+
+		// Capture routing fields, skip everything else unparsed
+		std::string_view* field = nullptr;
+		bool* seen = nullptr;
+		if (key == "type")
+			field = &type, seen = &haveType;
+		else if (key == "to")
+			field = &to, seen = &haveTo;
+		else if (key == "from")
+			field = &from, seen = &haveFrom;
+		else if (key == "value")
+			field = &value, seen = &haveValue;
+
+		if (field)
+		{
+			// Escaped or non-string routing fields need the full parser
+			if (!scanner.readString(*field, escaped) || escaped)
+				return false;
+			*seen = true;
+		}
+		else if (!scanner.skipValue())
+			return false;
+
+		// Stop once the fields this message type routes on are known
+		if (haveType && (((type == "message" || type == "publish") && haveTo && haveFrom) ||
+		                 ((type == "registration" || type == "subscribe" || type == "unsubscribe" || type == "channel") && haveValue)))
+			return true;
+	}
+	return false;
+}
+
+bool MsgHeader::scanKey(std::string_view payload)
+{
+	type = to = from = value = key = std::string_view();
+	Scanner scanner = { payload.data(), payload.data() + payload.size() };
+	if (!scanner.skipSpace() || *scanner.pos != '{')
+		return false;
+	scanner.pos++;
+
+	while (scanner.skipSpace())
+	{
+		if (*scanner.pos == '}')
+			return true;
+		if (*scanner.pos == ',')
+		{
+			scanner.pos++;
+			continue;
+		}
+
+		std::string_view name;
+		bool escaped;
+		if (!scanner.readString(name, escaped) || !scanner.skipSpace() || *scanner.pos != ':')
+			return false;
+		scanner.pos++;
+		if (!scanner.skipSpace())
+			return false;
+
+		std::string_view* field = name == "from" ? &from : name == "key" ? &key : nullptr;
+		if (field)
+		{
+			if (!scanner.readString(*field, escaped) || escaped)
+				return false;
+		}
+		else if (!scanner.skipValue())
+			return false;
+	}
+	return false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string_view>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Routing fields of a JSON message, located without building a JSON document.
+/// Values are views into the scanned payload.
+/// </summary>
+struct MsgHeader
+{
+public:
+	/// <summary>
+	/// Scans the top level of a JSON object for "type", "to", "from" and "value".
+	/// Nested values are skipped without being parsed and scanning stops as soon
+	/// as every field routing needs has been seen, so the cost does not grow with
+	/// payload data placed after the routing fields.
+	/// </summary>
+	/// <param name="payload">Serialized JSON message.</param>
+	/// <returns>False if the payload is not an object, a routing field is not a plain string,
+	/// or the field its type routes on is missing, in which case the message must be parsed in full.</returns>
+	bool scan(std::string_view payload);
+
+	/// <summary>
+	/// Scans the whole top level of a JSON object for "from" and "key", the fields
+	/// conflation groups messages by. Unlike scan() it cannot stop early, since
+	/// "key" may follow the payload data. Other fields are left empty.
+	/// </summary>
+	/// <param name="payload">Serialized JSON message.</param>
+	/// <returns>False if the payload is not an object or either field is not a plain string,
+	/// in which case the message must be parsed in full.</returns>
+	bool scanKey(std::string_view payload);
+
+	// Message type
+	std::string_view type;
+	// Destination identifier, or topic name of a publish
+	std::string_view to;
+	// Sender identifier
+	std::string_view from;
+	// Registration identifier, topic name of a subscription, or datagram channel token
+	std::string_view value;
+	// Conflation key, only filled by scanKey()
+	std::string_view key;
+};
@@ -0,0 +1,646 @@
+#include "MsgSchema.hpp"
+#include <cmath>
+#include <cstring>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+namespace
+{
+	// Appends a code point as UTF-8
+	void appendUtf8(std::string& out, uint32_t codePoint)
+	{
+		if (codePoint < 0x80)
+			out += static_cast<char>(codePoint);
+		else if (codePoint < 0x800)
+		{
+			out += static_cast<char>(0xc0 | (codePoint >> 6));
+			out += static_cast<char>(0x80 | (codePoint & 0x3f));
+		}
+		else if (codePoint < 0x10000)
+		{
+			out += static_cast<char>(0xe0 | (codePoint >> 12));
+			out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+			out += static_cast<char>(0x80 | (codePoint & 0x3f));
+		}
+		else
+		{
+			out += static_cast<char>(0xf0 | (codePoint >> 18));
+			out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+			out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+			out += static_cast<char>(0x80 | (codePoint & 0x3f));
+		}
+	}
+
+	// Appends a MessagePack type byte followed by a big-endian integer of some width
+	void packBigEndian(std::string& out, uint8_t type, uint64_t value, size_t bytes)
+	{
+		char buffer[9];
+		buffer[0] = static_cast<char>(type);
+		for (size_t index = 0; index < bytes; index++)
+			buffer[1 + index] = static_cast<char>(value >> (8 * (bytes - 1 - index)));
+		out.append(buffer, 1 + bytes);
+	}
+
+	// Appends a length with the smallest of three MessagePack encodings
+	void packLength(std::string& out, size_t size, uint8_t type8, uint8_t type16, uint8_t type32)
+	{
+		if (size <= 0xff && type8)
+			packBigEndian(out, type8, size, 1);
+		else if (size <= 0xffff)
+			packBigEndian(out, type16, size, 2);
+		else
+			packBigEndian(out, type32, size, 4);
+	}
+}
+
+void schema::writeJsonString(std::string& out, std::string_view text)
+{
+	static const char hex[] = "0123456789abcdef";
+	out += '"';
+	size_t start = 0;
+	for (size_t index = 0; index < text.size(); index++)
+	{
+		unsigned char character = static_cast<unsigned char>(text[index]);
+		if (character >= 0x20 && character != '"' && character != '\\')
+			continue;
+
+		// Copy the clean run before the character, then its escape
+		out.append(text.data() + start, index - start);
+		start = index + 1;
+		switch (character)
+		{
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		case '\b':
+			out += "\\b";
+			break;
+		case '\f':
+			out += "\\f";
+			break;
+		default:
+			out += "\\u00";
+			out += hex[character >> 4];
+			out += hex[character & 0xf];
+		}
+	}
+	out.append(text.data() + start, text.size() - start);
+	out += '"';
+}
+
+void schema::writeJsonNumber(std::string& out, double number)
+{
+	// JSON has no infinity or NaN, nlohmann::json writes them as null too
+	if (!std::isfinite(number))
+	{
+		out += "null";
+		return;
+	}
+	char digits[32];
+
+	// Readings mostly carry a few decimals. Writing those as scaled integers is several times faster
+	// than shortest formatting, and exact whenever dividing back by the scale gives the same double
+	static const double scales[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8 };
+	static const int64_t integerScales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+	if (number != 0 && std::fabs(number) < 1e9)
+	{
+		for (int decimals = 0; decimals < 9; decimals++)
+		{
+			double scaled = number * scales[decimals];
+			int64_t units = static_cast<int64_t>(scaled);
+			if (static_cast<double>(units) != scaled || static_cast<double>(units) / scales[decimals] != number)
+				continue;
+			if (units < 0)
+			{
+				out += '-';
+				units = -units;
+			}
+			char* end = std::to_chars(digits, digits + sizeof(digits), units / integerScales[decimals]).ptr;
+			if (decimals)
+			{
+				// Fraction digits with leading zeros kept
+				*end++ = '.';
+				int64_t fraction = units % integerScales[decimals];
+				for (int digit = decimals - 1; digit >= 0; digit--, fraction /= 10)
+					end[digit] = static_cast<char>('0' + fraction % 10);
+				end += decimals;
+			}
+			out.append(digits, end);
+			return;
+		}
+	}
+	out.append(digits, std::to_chars(digits, digits + sizeof(digits), number).ptr);
+}
+
+void schema::writeJsonNumber(std::string& out, float number)
+{
+	if (!std::isfinite(number))
+	{
+		out += "null";
+		return;
+	}
+	char digits[32];
+	out.append(digits, std::to_chars(digits, digits + sizeof(digits), number).ptr);
+}
+
+bool schema::JsonReader::readString(std::string& text)
+{
+	if (!skipSpace() || *pos_ != '"')
+		return false;
+	const char* start = ++pos_;
+	while (pos_ < end_ && *pos_ != '"' && *pos_ != '\\')
+		pos_++;
+	text.assign(start, pos_ - start);
+	while (pos_ < end_)
+	{
+		char character = *pos_++;
+		if (character == '"')
+			return true;
+		if (character != '\\')
+		{
+			text += character;
+			continue;
+		}
+		if (pos_ >= end_)
+			return false;
+		switch (*pos_++)
+		{
+		case '"':
+			text += '"';
+			break;
+		case '\\':
+			text += '\\';
+			break;
+		case '/':
+			text += '/';
+			break;
+		case 'n':
+			text += '\n';
+			break;
+		case 'r':
+			text += '\r';
+			break;
+		case 't':
+			text += '\t';
+			break;
+		case 'b':
+			text += '\b';
+			break;
+		case 'f':
+			text += '\f';
+			break;
+		case 'u':
+		{
+			uint32_t codePoint;
+			if (!readCodePoint(codePoint))
+				return false;
+			appendUtf8(text, codePoint);
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+	return false;
+}
+
+bool schema::JsonReader::readCodePoint(uint32_t& codePoint)
+{
+	auto readHex = [this](uint32_t& unit)
+	{
+		if (end_ - pos_ < 4)
+			return false;
+		unit = 0;
+		for (int digit = 0; digit < 4; digit++)
+		{
+			char character = *pos_++;
+			unit <<= 4;
+			if (character >= '0' && character <= '9')
+				unit |= character - '0';
+			else if (character >= 'a' && character <= 'f')
+				unit |= character - 'a' + 10;
+			else if (character >= 'A' && character <= 'F')
+				unit |= character - 'A' + 10;
+			else
+				return false;
+		}
+		return true;
+	};
+	if (!readHex(codePoint))
+		return false;
+	if (codePoint >= 0xdc00 && codePoint <= 0xdfff)
+		return false;
+	if (codePoint < 0xd800 || codePoint > 0xdbff)
+		return true;
+
+	// High surrogate must be followed by an escaped low surrogate
+	uint32_t low;
+	if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u')
+		return false;
+	pos_ += 2;
+	if (!readHex(low) || low < 0xdc00 || low > 0xdfff)
+		return false;
+	codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+	return true;
+}
+
+bool schema::JsonReader::readKey(std::string_view& key, std::string& scratch)
+{
+	if (!skipSpace() || *pos_ != '"')
+		return false;
+	const char* start = pos_ + 1;
+	const char* current = start;
+	while (current < end_ && *current != '"' && *current != '\\')
+		current++;
+	if (current < end_ && *current == '"')
+	{
+		key = std::string_view(start, current - start);
+		pos_ = current + 1;
+		return true;
+	}
+	if (!readString(scratch))
+		return false;
+	key = scratch;
+	return true;
+}
+
+bool schema::JsonReader::readBool(bool& value)
+{
+	if (!skipSpace())
+		return false;
+	if (end_ - pos_ >= 4 && std::memcmp(pos_, "true", 4) == 0)
+	{
+		value = true;
+		pos_ += 4;
+		return true;
+	}
+	if (end_ - pos_ >= 5 && std::memcmp(pos_, "false", 5) == 0)
+	{
+		value = false;
+		pos_ += 5;
+		return true;
+	}
+	return false;
+}
+
+bool schema::JsonReader::readNull()
+{
+	if (!skipSpace() || end_ - pos_ < 4 || std::memcmp(pos_, "null", 4) != 0)
+		return false;
+	pos_ += 4;
+	return true;
+}
+
+bool schema::JsonReader::skipValue()
+{
+	if (!skipSpace())
+		return false;
+	if (*pos_ == '"' || *pos_ == '{' || *pos_ == '[')
+	{
+		// Track nesting depth and string boundaries only
+		int depth = 0;
+		while (pos_ < end_)
+		{
+			char character = *pos_++;
+			if (character == '"')
+			{
+				while (pos_ < end_ && *pos_ != '"')
+				{
+					// Escaped character can never close the string
+					if (*pos_ == '\\' && end_ - pos_ > 1)
+						pos_++;
+					pos_++;
+				}
+				if (pos_ >= end_)
+					return false;
+				pos_++;
+			}
+			else if (character == '{' || character == '[')
+				depth++;
+			else if (character == '}' || character == ']')
+				depth--;
+			if (depth == 0)
+				return true;
+		}
+		return false;
+	}
+	// Number or literal runs until the next delimiter
+	const char* start = pos_;
+	while (pos_ < end_ && *pos_ != ',' && *pos_ != '}' && *pos_ != ']' && *pos_ != ' ' && *pos_ != '\t' && *pos_ != '\n' && *pos_ != '\r')
+		pos_++;
+	return pos_ > start;
+}
+
+void schema::packNil(std::string& out)
+{
+	out += '\xc0';
+}
+
+void schema::packBool(std::string& out, bool value)
+{
+	out += value ? '\xc3' : '\xc2';
+}
+
+void schema::packUnsigned(std::string& out, uint64_t value)
+{
+	if (value <= 0x7f)
+		out += static_cast<char>(value);
+	else if (value <= 0xff)
+		packBigEndian(out, 0xcc, value, 1);
+	else if (value <= 0xffff)
+		packBigEndian(out, 0xcd, value, 2);
+	else if (value <= 0xffffffff)
+		packBigEndian(out, 0xce, value, 4);
+	else
+		packBigEndian(out, 0xcf, value, 8);
+}
+
+void schema::packSigned(std::string& out, int64_t value)
+{
+	if (value >= 0)
+		packUnsigned(out, static_cast<uint64_t>(value));
+	else if (value >= -32)
+		out += static_cast<char>(value);
+	else if (value >= INT8_MIN)
+		packBigEndian(out, 0xd0, static_cast<uint64_t>(value), 1);
+	else if (value >= INT16_MIN)
+		packBigEndian(out, 0xd1, static_cast<uint64_t>(value), 2);
+	else if (value >= INT32_MIN)
+		packBigEndian(out, 0xd2, static_cast<uint64_t>(value), 4);
+	else
+		packBigEndian(out, 0xd3, static_cast<uint64_t>(value), 8);
+}
+
+void schema::packFloat(std::string& out, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	packBigEndian(out, 0xca, bits, 4);
+}
+
+void schema::packDouble(std::string& out, double value)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	packBigEndian(out, 0xcb, bits, 8);
+}
+
+void schema::packString(std::string& out, std::string_view text)
+{
+	if (text.size() <= 31)
+		out += static_cast<char>(0xa0 | text.size());
+	else
+		packLength(out, text.size(), 0xd9, 0xda, 0xdb);
+	out.append(text.data(), text.size());
+}
+
+void schema::packArray(std::string& out, size_t size)
+{
+	if (size <= 15)
+		out += static_cast<char>(0x90 | size);
+	else
+		packLength(out, size, 0, 0xdc, 0xdd);
+}
+
+void schema::packMap(std::string& out, size_t size)
+{
+	if (size <= 15)
+		out += static_cast<char>(0x80 | size);
+	else
+		packLength(out, size, 0, 0xde, 0xdf);
+}
+
+bool schema::PackReader::readBigEndian(size_t bytes, uint64_t& value)
+{
+	if (static_cast<size_t>(end_ - pos_) < bytes)
+		return false;
+	value = 0;
+	for (size_t index = 0; index < bytes; index++)
+		value = (value << 8) | *pos_++;
+	return true;
+}
+
+bool schema::PackReader::readNil()
+{
+	if (pos_ >= end_ || *pos_ != 0xc0)
+		return false;
+	pos_++;
+	return true;
+}
+
+bool schema::PackReader::readBool(bool& value)
+{
+	if (pos_ >= end_ || (*pos_ != 0xc2 && *pos_ != 0xc3))
+		return false;
+	value = *pos_++ == 0xc3;
+	return true;
+}
+
+bool schema::PackReader::readInteger(uint64_t& bits, bool& negative)
+{
+	if (pos_ >= end_)
+		return false;
+	uint8_t type = *pos_;
+	negative = false;
+	if (type <= 0x7f)
+	{
+		bits = *pos_++;
+		return true;
+	}
+	if (type >= 0xe0)
+	{
+		bits = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int8_t>(*pos_++)));
+		negative = true;
+		return true;
+	}
+	if (type < 0xcc || type > 0xd3)
+		return false;
+	pos_++;
+	size_t bytes = size_t(1) << ((type - 0xcc) & 3);
+	if (!readBigEndian(bytes, bits))
+		return false;
+	if (type >= 0xd0)
+	{
+		// Sign-extend from the encoded width
+		unsigned shift = static_cast<unsigned>(64 - 8 * bytes);
+		int64_t value = static_cast<int64_t>(bits << shift) >> shift;
+		bits = static_cast<uint64_t>(value);
+		negative = value < 0;
+	}
+	return true;
+}
+
+bool schema::PackReader::readDouble(double& value)
+{
+	if (pos_ >= end_)
+		return false;
+	uint64_t bits;
+	if (*pos_ == 0xca)
+	{
+		pos_++;
+		if (!readBigEndian(4, bits))
+			return false;
+		uint32_t narrow = static_cast<uint32_t>(bits);
+		float single;
+		std::memcpy(&single, &narrow, sizeof(single));
+		value = single;
+		return true;
+	}
+	if (*pos_ == 0xcb)
+	{
+		pos_++;
+		if (!readBigEndian(8, bits))
+			return false;
+		std::memcpy(&value, &bits, sizeof(value));
+		return true;
+	}
+
+	// Whole numbers may arrive as integers from other encoders
+	bool negative;
+	if (!readInteger(bits, negative))
+		return false;
+	value = negative ? static_cast<double>(static_cast<int64_t>(bits)) : static_cast<double>(bits);
+	return true;
+}
+
+bool schema::PackReader::readString(std::string_view& text)
+{
+	if (pos_ >= end_)
+		return false;
+	uint8_t type = *pos_++;
+	uint64_t size;
+	if (type >= 0xa0 && type <= 0xbf)
+		size = type & 0x1f;
+	else if (type < 0xd9 || type > 0xdb || !readBigEndian(size_t(1) << (type - 0xd9), size))
+		return false;
+	if (static_cast<uint64_t>(end_ - pos_) < size)
+		return false;
+	text = std::string_view(reinterpret_cast<const char*>(pos_), size);
+	pos_ += size;
+	return true;
+}
+
+bool schema::PackReader::readArray(size_t& size)
+{
+	if (pos_ >= end_)
+		return false;
+	uint8_t type = *pos_++;
+	uint64_t count;
+	if (type >= 0x90 && type <= 0x9f)
+		count = type & 0x0f;
+	else if ((type != 0xdc && type != 0xdd) || !readBigEndian(type == 0xdc ? 2 : 4, count))
+		return false;
+	// Every element takes at least a byte, so a count beyond the input is malformed
+	if (count > static_cast<uint64_t>(end_ - pos_))
+		return false;
+	size = static_cast<size_t>(count);
+	return true;
+}
+
+bool schema::PackReader::readMap(size_t& size)
+{
+	if (pos_ >= end_)
+		return false;
+	uint8_t type = *pos_++;
+	uint64_t count;
+	if (type >= 0x80 && type <= 0x8f)
+		count = type & 0x0f;
+	else if ((type != 0xde && type != 0xdf) || !readBigEndian(type == 0xde ? 2 : 4, count))
+		return false;
+	if (count > static_cast<uint64_t>(end_ - pos_) / 2)
+		return false;
+	size = static_cast<size_t>(count);
+	return true;
+}
+
+bool schema::PackReader::skipValue()
+{
+	if (pos_ >= end_)
+		return false;
+	uint8_t type = *pos_;
+	uint64_t skip = 0;
+	size_t size;
+	std::string_view text;
+	if (type <= 0x7f || type >= 0xe0 || type == 0xc0 || type == 0xc2 || type == 0xc3)
+		skip = 1;
+	else if ((type >= 0xa0 && type <= 0xbf) || (type >= 0xd9 && type <= 0xdb))
+		return readString(text);
+	else if ((type >= 0x90 && type <= 0x9f) || type == 0xdc || type == 0xdd)
+	{
+		if (!readArray(size))
+			return false;
+		for (size_t index = 0; index < size; index++)
+		{
+			if (!skipValue())
+				return false;
+		}
+		return true;
+	}
+	else if ((type >= 0x80 && type <= 0x8f) || type == 0xde || type == 0xdf)
+	{
+		if (!readMap(size))
+			return false;
+		for (size_t index = 0; index < 2 * size; index++)
+		{
+			if (!skipValue())
+				return false;
+		}
+		return true;
+	}
+	else if (type >= 0xcc && type <= 0xd3)
+		skip = 1 + (size_t(1) << ((type - 0xcc) & 3));
+	else if (type == 0xca)
+		skip = 5;
+	else if (type == 0xcb)
+		skip = 9;
+	else if (type >= 0xd4 && type <= 0xd8)
+		// Fixed extension: type byte, extension type and 1 to 16 data bytes
+		skip = 2 + (size_t(1) << (type - 0xd4));
+	else if (type >= 0xc4 && type <= 0xc9)
+	{
+		// Binary (c4-c6) or extension (c7-c9) with an 8, 16 or 32 bit length
+		bool extension = type >= 0xc7;
+		size_t lengthBytes = size_t(1) << ((type - (extension ? 0xc7 : 0xc4)));
+		uint64_t length;
+		pos_++;
+		if (!readBigEndian(lengthBytes, length))
+			return false;
+		skip = length + (extension ? 1 : 0);
+		if (static_cast<uint64_t>(end_ - pos_) < skip)
+			return false;
+		pos_ += skip;
+		return true;
+	}
+	else
+		return false;
+	if (static_cast<uint64_t>(end_ - pos_) < skip)
+		return false;
+	pos_ += skip;
+	return true;
+}
@@ -0,0 +1,778 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Most fields a schema may declare, one bit each when tracking which were parsed
+#define SCHEMA_MAX_FIELDS 64
+
+/// <summary>
+/// Declares the fields of a message struct for typed serialization, an
+/// alternative to MsgData for messages of fixed shape. Specialize it with a
+/// constexpr tuple of schema::field() entries in wire order:
+///
+///     template <>
+///     struct MsgSchema<Reading>
+///     {
+///         static constexpr auto fields = std::make_tuple(
+///             schema::field("sensor", &Reading::sensor),
+///             schema::field("celsius", &Reading::celsius));
+///     };
+///
+/// Members held in std::optional may be missing on the wire, every other member
+/// is required. Members may be bool, arithmetic, std::string, std::vector or
+/// std::optional of a supported type, or another struct with a schema.
+/// </summary>
+template <typename T>
+struct MsgSchema
+{
+};
+
+/// <summary>
+/// HSIF message envelope around typed data. Its routing fields are written
+/// first, so header routing finds them without reaching the data.
+/// </summary>
+template <typename T>
+struct TypedMsg
+{
+	// "message" or "publish"
+	std::string type = "message";
+	// Destination identifier, or topic name of a publish
+	std::string to;
+	// Sender identifier
+	std::string from;
+	// Message data
+	T data;
+};
+
+/// <summary>
+/// Serializers and parsers generated from a MsgSchema. Text is JSON and
+/// binary is MessagePack, both readable by nlohmann::json; neither direction
+/// builds a document. Schema mistakes, such as duplicate field names or
+/// unsupported member types, fail to compile.
+/// </summary>
+namespace schema
+{
+	/// <summary>
+	/// Name and member of one schema field.
+	/// </summary>
+	template <typename T, typename Member>
+	struct Field
+	{
+		std::string_view name;
+		Member T::* member;
+	};
+
+	/// <summary>
+	/// Declares a schema field.
+	/// </summary>
+	/// <param name="name">Field name on the wire.</param>
+	/// <param name="member">Member holding the field.</param>
+	/// <returns>Field entry for MsgSchema::fields.</returns>
+	template <typename T, typename Member>
+	constexpr Field<T, Member> field(std::string_view name, Member T::* member)
+	{
+		return { name, member };
+	}
+
+	template <typename T, typename = void>
+	struct HasSchema : std::false_type {};
+
+	template <typename T>
+	struct HasSchema<T, std::void_t<decltype(MsgSchema<T>::fields)>> : std::true_type {};
+
+	template <typename T>
+	struct IsOptional : std::false_type {};
+
+	template <typename T>
+	struct IsOptional<std::optional<T>> : std::true_type {};
+
+	template <typename T>
+	struct IsVector : std::false_type {};
+
+	template <typename T, typename Allocator>
+	struct IsVector<std::vector<T, Allocator>> : std::true_type {};
+
+	// Number of fields a schema declares
+	template <typename T>
+	constexpr size_t fieldCount()
+	{
+		return std::tuple_size_v<std::decay_t<decltype(MsgSchema<T>::fields)>>;
+	}
+
+	// Member type of a schema's I-th field
+	template <typename T, size_t I>
+	using FieldType = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<T&>().*(std::get<I>(MsgSchema<T>::fields).member))>>;
+
+	/// <summary>
+	/// Returns whether a member type can be serialized.
+	/// </summary>
+	template <typename V>
+	constexpr bool supported()
+	{
+		if constexpr (std::is_same_v<V, bool> || std::is_same_v<V, std::string>)
+			return true;
+		else if constexpr (std::is_integral_v<V>)
+			return sizeof(V) <= sizeof(uint64_t);
+		else if constexpr (std::is_floating_point_v<V>)
+			return sizeof(V) <= sizeof(double);
+		else if constexpr (IsOptional<V>::value)
+			return supported<typename V::value_type>() && !IsOptional<typename V::value_type>::value;
+		else if constexpr (IsVector<V>::value)
+			return supported<typename V::value_type>();
+		else
+			return HasSchema<V>::value;
+	}
+
+	template <typename T, size_t... I>
+	constexpr bool fieldsSupported(std::index_sequence<I...>)
+	{
+		return (supported<FieldType<T, I>>() && ...);
+	}
+
+	template <typename T, size_t... I>
+	constexpr std::array<std::string_view, sizeof...(I)> fieldNames(std::index_sequence<I...>)
+	{
+		return { std::get<I>(MsgSchema<T>::fields).name... };
+	}
+
+	// Names of a schema's fields in declaration order
+	template <typename T>
+	constexpr std::array<std::string_view, fieldCount<T>()> fieldNames()
+	{
+		return fieldNames<T>(std::make_index_sequence<fieldCount<T>()>());
+	}
+
+	// Whether every field name is non-empty, distinct, and free of characters JSON would escape
+	template <typename T>
+	constexpr bool namesValid()
+	{
+		constexpr auto names = fieldNames<T>();
+		for (size_t index = 0; index < names.size(); index++)
+		{
+			if (names[index].empty())
+				return false;
+			for (char character : names[index])
+			{
+				if (character == '"' || character == '\\' || static_cast<unsigned char>(character) < 0x20)
+					return false;
+			}
+			for (size_t other = index + 1; other < names.size(); other++)
+			{
+				if (names[index] == names[other])
+					return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename T, size_t... I>
+	constexpr uint64_t requiredMask(std::index_sequence<I...>)
+	{
+		return ((IsOptional<FieldType<T, I>>::value ? uint64_t(0) : uint64_t(1) << I) | ... | uint64_t(0));
+	}
+
+	// Bit per field that must be present when parsing
+	template <typename T>
+	constexpr uint64_t requiredMask()
+	{
+		return requiredMask<T>(std::make_index_sequence<fieldCount<T>()>());
+	}
+
+	// Checks a schema once per type, wherever it is first serialized or parsed
+	template <typename T>
+	constexpr bool checkSchema()
+	{
+		static_assert(HasSchema<T>::value, "Type has no MsgSchema specialization");
+		static_assert(fieldCount<T>() > 0 && fieldCount<T>() <= SCHEMA_MAX_FIELDS, "MsgSchema must declare between 1 and SCHEMA_MAX_FIELDS fields");
+		static_assert(fieldsSupported<T>(std::make_index_sequence<fieldCount<T>()>()), "MsgSchema field has an unsupported member type");
+		static_assert(namesValid<T>(), "MsgSchema field names must be non-empty, unique and need no escaping");
+		return true;
+	}
+
+	/// <summary>
+	/// Appends a string as a quoted, escaped JSON string.
+	/// </summary>
+	void writeJsonString(std::string& out, std::string_view text);
+
+	/// <summary>
+	/// Appends a number in its shortest round-trip form, null if not finite.
+	/// </summary>
+	void writeJsonNumber(std::string& out, double number);
+	void writeJsonNumber(std::string& out, float number);
+
+	/// <summary>
+	/// Cursor over JSON text for generated parsers.
+	/// </summary>
+	class JsonReader
+	{
+	public:
+		JsonReader(std::string_view text) : pos_(text.data()), end_(text.data() + text.size()) {};
+
+		// Consumes a character after any whitespace, returns false if another comes next
+		bool consume(char expected)
+		{
+			if (!skipSpace() || *pos_ != expected)
+				return false;
+			pos_++;
+			return true;
+		};
+
+		// Returns whether only whitespace is left
+		bool atEnd()
+		{
+			return !skipSpace();
+		};
+
+		// Reads a string, unescaping it
+		bool readString(std::string& text);
+
+		// Reads an object key, a view of the input unless it has escapes, in which case it is unescaped into scratch
+		bool readKey(std::string_view& key, std::string& scratch);
+
+		// Reads true or false
+		bool readBool(bool& value);
+
+		// Consumes null if it comes next
+		bool readNull();
+
+		// Skips any value
+		bool skipValue();
+
+		// Reads a number into an integer or floating point member, failing if it does not fit
+		template <typename V>
+		bool readNumber(V& number)
+		{
+			if (!skipSpace())
+				return false;
+			const char* start = pos_;
+			while (pos_ < end_ && ((*pos_ >= '0' && *pos_ <= '9') || *pos_ == '-' || *pos_ == '+' || *pos_ == '.' || *pos_ == 'e' || *pos_ == 'E'))
+				pos_++;
+			auto parsed = std::from_chars(start, pos_, number);
+			return parsed.ec == std::errc() && parsed.ptr == pos_ && pos_ > start;
+		};
+
+	private:
+		// Advances past whitespace, returns false at end of input
+		bool skipSpace()
+		{
+			while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\n' || *pos_ == '\r'))
+				pos_++;
+			return pos_ < end_;
+		};
+
+		// Reads the code point of a \u escape, pos_ after the 'u'
+		bool readCodePoint(uint32_t& codePoint);
+
+		const char* pos_;
+		const char* end_;
+	};
+
+	/// <summary>
+	/// Appends MessagePack values in their most compact encoding.
+	/// </summary>
+	void packNil(std::string& out);
+	void packBool(std::string& out, bool value);
+	void packUnsigned(std::string& out, uint64_t value);
+	void packSigned(std::string& out, int64_t value);
+	void packFloat(std::string& out, float value);
+	void packDouble(std::string& out, double value);
+	void packString(std::string& out, std::string_view text);
+	void packArray(std::string& out, size_t size);
+	void packMap(std::string& out, size_t size);
+
+	/// <summary>
+	/// Cursor over MessagePack bytes for generated parsers.
+	/// </summary>
+	class PackReader
+	{
+	public:
+		PackReader(std::string_view bytes) : pos_(reinterpret_cast<const uint8_t*>(bytes.data())), end_(pos_ + bytes.size()) {};
+
+		// Returns whether every byte was read
+		bool atEnd() const
+		{
+			return pos_ == end_;
+		};
+
+		// Consumes nil if it comes next
+		bool readNil();
+
+		// Reads a boolean
+		bool readBool(bool& value);
+
+		// Reads an integer of any width. Negative values are returned as their int64_t bit pattern
+		bool readInteger(uint64_t& bits, bool& negative);
+
+		// Reads a float, double or integer as a double
+		bool readDouble(double& value);
+
+		// Reads a string as a view of the input
+		bool readString(std::string_view& text);
+
+		// Reads an array or map header
+		bool readArray(size_t& size);
+		bool readMap(size_t& size);
+
+		// Skips any value
+		bool skipValue();
+
+		// Reads an integer or floating point member, failing if the value does not fit
+		template <typename V>
+		bool readNumber(V& number)
+		{
+			if constexpr (std::is_floating_point_v<V>)
+			{
+				double value;
+				if (!readDouble(value))
+					return false;
+				number = static_cast<V>(value);
+				return true;
+			}
+			else
+			{
+				uint64_t bits;
+				bool negative;
+				if (!readInteger(bits, negative))
+					return false;
+				if (negative)
+				{
+					int64_t value = static_cast<int64_t>(bits);
+					if constexpr (std::is_unsigned_v<V>)
+						return false;
+					else if (value < static_cast<int64_t>(std::numeric_limits<V>::min()))
+						return false;
+					number = static_cast<V>(value);
+					return true;
+				}
+				if (bits > static_cast<uint64_t>(std::numeric_limits<V>::max()))
+					return false;
+				number = static_cast<V>(bits);
+				return true;
+			}
+		};
+
+	private:
+		// Reads a big-endian integer of some width
+		bool readBigEndian(size_t bytes, uint64_t& value);
+
+		const uint8_t* pos_;
+		const uint8_t* end_;
+	};
+
+	template <typename T>
+	void writeJsonObject(std::string& out, const T& value);
+
+	template <typename T>
+	bool readJsonObject(JsonReader& reader, T& value);
+
+	template <typename T>
+	void writePackObject(std::string& out, const T& value);
+
+	template <typename T>
+	bool readPackObject(PackReader& reader, T& value);
+
+	template <typename V>
+	void writeJsonValue(std::string& out, const V& value)
+	{
+		if constexpr (std::is_same_v<V, bool>)
+			out += value ? "true" : "false";
+		else if constexpr (std::is_integral_v<V>)
+		{
+			char digits[24];
+			out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+		}
+		else if constexpr (std::is_floating_point_v<V>)
+			writeJsonNumber(out, value);
+		else if constexpr (std::is_same_v<V, std::string>)
+			writeJsonString(out, value);
+		else if constexpr (IsOptional<V>::value)
+		{
+			if (value)
+				writeJsonValue(out, *value);
+			else
+				out += "null";
+		}
+		else if constexpr (IsVector<V>::value)
+		{
+			out += '[';
+			for (size_t index = 0; index < value.size(); index++)
+			{
+				if (index)
+					out += ',';
+				writeJsonValue(out, static_cast<const typename V::value_type&>(value[index]));
+			}
+			out += ']';
+		}
+		else
+			writeJsonObject(out, value);
+	}
+
+	template <typename V>
+	bool readJsonValue(JsonReader& reader, V& value)
+	{
+		if constexpr (std::is_same_v<V, bool>)
+			return reader.readBool(value);
+		else if constexpr (std::is_arithmetic_v<V>)
+			return reader.readNumber(value);
+		else if constexpr (std::is_same_v<V, std::string>)
+			return reader.readString(value);
+		else if constexpr (IsOptional<V>::value)
+		{
+			if (reader.readNull())
+			{
+				value.reset();
+				return true;
+			}
+			if (!value)
+				value.emplace();
+			return readJsonValue(reader, *value);
+		}
+		else if constexpr (IsVector<V>::value)
+		{
+			value.clear();
+			if (!reader.consume('['))
+				return false;
+			if (reader.consume(']'))
+				return true;
+			do
+			{
+				typename V::value_type element{};
+				if (!readJsonValue(reader, element))
+					return false;
+				value.push_back(std::move(element));
+			} while (reader.consume(','));
+			return reader.consume(']');
+		}
+		else
+			return readJsonObject(reader, value);
+	}
+
+	template <typename V>
+	void writePackValue(std::string& out, const V& value)
+	{
+		if constexpr (std::is_same_v<V, bool>)
+			packBool(out, value);
+		else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>)
+			packSigned(out, value);
+		else if constexpr (std::is_integral_v<V>)
+			packUnsigned(out, value);
+		else if constexpr (std::is_same_v<V, float>)
+			packFloat(out, value);
+		else if constexpr (std::is_floating_point_v<V>)
+			packDouble(out, value);
+		else if constexpr (std::is_same_v<V, std::string>)
+			packString(out, value);
+		else if constexpr (IsOptional<V>::value)
+		{
+			if (value)
+				writePackValue(out, *value);
+			else
+				packNil(out);
+		}
+		else if constexpr (IsVector<V>::value)
+		{
+			packArray(out, value.size());
+			for (size_t index = 0; index < value.size(); index++)
+				writePackValue(out, static_cast<const typename V::value_type&>(value[index]));
+		}
+		else
+			writePackObject(out, value);
+	}
+
+	template <typename V>
+	bool readPackValue(PackReader& reader, V& value)
+	{
+		if constexpr (std::is_same_v<V, bool>)
+			return reader.readBool(value);
+		else if constexpr (std::is_arithmetic_v<V>)
+			return reader.readNumber(value);
+		else if constexpr (std::is_same_v<V, std::string>)
+		{
+			std::string_view text;
+			if (!reader.readString(text))
+				return false;
+			value.assign(text.data(), text.size());
+			return true;
+		}
+		else if constexpr (IsOptional<V>::value)
+		{
+			if (reader.readNil())
+			{
+				value.reset();
+				return true;
+			}
+			if (!value)
+				value.emplace();
+			return readPackValue(reader, *value);
+		}
+		else if constexpr (IsVector<V>::value)
+		{
+			size_t size;
+			if (!reader.readArray(size))
+				return false;
+			value.clear();
+			for (size_t index = 0; index < size; index++)
+			{
+				typename V::value_type element{};
+				if (!readPackValue(reader, element))
+					return false;
+				value.push_back(std::move(element));
+			}
+			return true;
+		}
+		else
+			return readPackObject(reader, value);
+	}
+
+	// Appends one field of an object, skipping optional fields without a value
+	template <typename V>
+	void writeJsonField(std::string& out, std::string_view name, const V& value, bool& first)
+	{
+		if constexpr (IsOptional<V>::value)
+		{
+			if (!value)
+				return;
+		}
+		if (!first)
+			out += ',';
+		first = false;
+		out += '"';
+		out.append(name.data(), name.size());
+		out += "\":";
+		writeJsonValue(out, value);
+	}
+
+	template <typename V>
+	void writePackField(std::string& out, std::string_view name, const V& value)
+	{
+		if constexpr (IsOptional<V>::value)
+		{
+			if (!value)
+				return;
+		}
+		packString(out, name);
+		writePackValue(out, value);
+	}
+
+	template <typename V>
+	size_t presentField(const V& value)
+	{
+		if constexpr (IsOptional<V>::value)
+			return value ? 1 : 0;
+		else
+			return 1;
+	}
+
+	// Reads the value of the field at a runtime index
+	template <typename T, typename Reader, size_t... I>
+	bool readFieldAt(Reader& reader, T& value, size_t index, std::index_sequence<I...>)
+	{
+		bool read = false;
+		if constexpr (std::is_same_v<Reader, JsonReader>)
+			((index == I && (read = readJsonValue(reader, value.*(std::get<I>(MsgSchema<T>::fields).member)), true)) || ...);
+		else
+			((index == I && (read = readPackValue(reader, value.*(std::get<I>(MsgSchema<T>::fields).member)), true)) || ...);
+		return read;
+	}
+
+	// Clears optional fields that were not parsed, so a reused value keeps nothing from before
+	template <typename T, size_t... I>
+	void resetMissing(T& value, uint64_t seen, std::index_sequence<I...>)
+	{
+		auto reset = [](auto& member, bool present)
+		{
+			if constexpr (IsOptional<std::remove_reference_t<decltype(member)>>::value)
+			{
+				if (!present)
+					member.reset();
+			}
+		};
+		(reset(value.*(std::get<I>(MsgSchema<T>::fields).member), (seen >> I) & 1), ...);
+	}
+
+	// Finds a field by name, trying the field after the last one found first since senders usually keep declaration order
+	template <typename T>
+	bool findField(std::string_view key, size_t& index)
+	{
+		constexpr auto names = fieldNames<T>();
+		for (size_t tried = 0; tried < names.size(); tried++)
+		{
+			if (names[index] == key)
+				return true;
+			index = index + 1 == names.size() ? 0 : index + 1;
+		}
+		return false;
+	}
+
+	template <typename T>
+	void writeJsonObject(std::string& out, const T& value)
+	{
+		static_assert(checkSchema<T>());
+		out += '{';
+		bool first = true;
+		std::apply([&](const auto&... field) { (writeJsonField(out, field.name, value.*(field.member), first), ...); }, MsgSchema<T>::fields);
+		out += '}';
+	}
+
+	template <typename T>
+	bool readJsonObject(JsonReader& reader, T& value)
+	{
+		static_assert(checkSchema<T>());
+		constexpr size_t count = fieldCount<T>();
+		if (!reader.consume('{'))
+			return false;
+		uint64_t seen = 0;
+		if (!reader.consume('}'))
+		{
+			std::string scratch;
+			size_t index = 0;
+			do
+			{
+				std::string_view key;
+				if (!reader.readKey(key, scratch) || !reader.consume(':'))
+					return false;
+				// Fields outside the schema are skipped
+				if (!findField<T>(key, index))
+				{
+					if (!reader.skipValue())
+						return false;
+					continue;
+				}
+				if (!readFieldAt(reader, value, index, std::make_index_sequence<count>()))
+					return false;
+				seen |= uint64_t(1) << index;
+				index = index + 1 == count ? 0 : index + 1;
+			} while (reader.consume(','));
+			if (!reader.consume('}'))
+				return false;
+		}
+		resetMissing(value, seen, std::make_index_sequence<count>());
+		return (seen & requiredMask<T>()) == requiredMask<T>();
+	}
+
+	template <typename T>
+	void writePackObject(std::string& out, const T& value)
+	{
+		static_assert(checkSchema<T>());
+		size_t present = std::apply([&](const auto&... field) { return (presentField(value.*(field.member)) + ...); }, MsgSchema<T>::fields);
+		packMap(out, present);
+		std::apply([&](const auto&... field) { (writePackField(out, field.name, value.*(field.member)), ...); }, MsgSchema<T>::fields);
+	}
+
+	template <typename T>
+	bool readPackObject(PackReader& reader, T& value)
+	{
+		static_assert(checkSchema<T>());
+		constexpr size_t count = fieldCount<T>();
+		size_t size;
+		if (!reader.readMap(size))
+			return false;
+		uint64_t seen = 0;
+		size_t index = 0;
+		for (size_t entry = 0; entry < size; entry++)
+		{
+			std::string_view key;
+			if (!reader.readString(key))
+				return false;
+			if (!findField<T>(key, index))
+			{
+				if (!reader.skipValue())
+					return false;
+				continue;
+			}
+			if (!readFieldAt(reader, value, index, std::make_index_sequence<count>()))
+				return false;
+			seen |= uint64_t(1) << index;
+			index = index + 1 == count ? 0 : index + 1;
+		}
+		resetMissing(value, seen, std::make_index_sequence<count>());
+		return (seen & requiredMask<T>()) == requiredMask<T>();
+	}
+
+	/// <summary>
+	/// Appends a value as a JSON object. Appending lets a caller reuse one buffer for every message.
+	/// </summary>
+	/// <param name="value">Value of a type with a MsgSchema.</param>
+	/// <param name="out">Receives the JSON text.</param>
+	template <typename T>
+	void writeJson(const T& value, std::string& out)
+	{
+		writeJsonObject(out, value);
+	}
+
+	/// <summary>
+	/// Parses a JSON object into a value. Fields outside the schema are skipped.
+	/// </summary>
+	/// <param name="text">JSON text holding one object.</param>
+	/// <param name="value">Receives the fields.</param>
+	/// <returns>False if the text is malformed, a field has the wrong type or does not fit its
+	/// member, or a required field is missing.</returns>
+	template <typename T>
+	bool readJson(std::string_view text, T& value)
+	{
+		JsonReader reader(text);
+		return readJsonObject(reader, value) && reader.atEnd();
+	}
+
+	/// <summary>
+	/// Appends a value as a MessagePack map.
+	/// </summary>
+	/// <param name="value">Value of a type with a MsgSchema.</param>
+	/// <param name="out">Receives the MessagePack bytes.</param>
+	template <typename T>
+	void writeMsgPack(const T& value, std::string& out)
+	{
+		writePackObject(out, value);
+	}
+
+	/// <summary>
+	/// Parses a MessagePack map into a value. Fields outside the schema are skipped.
+	/// </summary>
+	/// <param name="bytes">MessagePack bytes holding one map.</param>
+	/// <param name="value">Receives the fields.</param>
+	/// <returns>False if the bytes are malformed, a field has the wrong type or does not fit its
+	/// member, or a required field is missing.</returns>
+	template <typename T>
+	bool readMsgPack(std::string_view bytes, T& value)
+	{
+		PackReader reader(bytes);
+		return readPackObject(reader, value) && reader.atEnd();
+	}
+}
+
+template <typename T>
+struct MsgSchema<TypedMsg<T>>
+{
+	static constexpr auto fields = std::make_tuple(
+		schema::field("type", &TypedMsg<T>::type),
+		schema::field("to", &TypedMsg<T>::to),
+		schema::field("from", &TypedMsg<T>::from),
+		schema::field("data", &TypedMsg<T>::data));
+};
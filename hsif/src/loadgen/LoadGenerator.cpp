@@ -0,0 +1,383 @@
+#include "LoadGenerator.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <thread>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Nanoseconds per millisecond
+#define NANOS_PER_MS 1000000ull
+// Longest reactor wait while nothing is scheduled, in milliseconds
+#define LOAD_IDLE_WAIT_MS 10
+
+// Identifier of a connection
+static std::string loadId(size_t index)
+{
+    return LOAD_ID_PREFIX + std::to_string(index);
+}
+
+// Number of connections sending under a pattern, the rate is shared between them
+static size_t plannedSenders(LoadPattern pattern, size_t connections)
+{
+    if (pattern == LoadPattern::Pairwise)
+        return connections;
+    if (pattern == LoadPattern::ManyToOne)
+        return connections > 0 ? connections - 1 : 0;
+    return connections > 0 ? 1 : 0;
+}
+
+// Message text up to the send stamp, empty for connections that only receive
+static std::string messagePrefix(const LoadConfig& config, size_t index)
+{
+    std::string type = "message";
+    std::string to;
+    if (config.pattern == LoadPattern::Pairwise)
+    {
+        // An odd connection out talks to itself
+        size_t peer = index ^ 1;
+        to = loadId(peer < config.connections ? peer : index);
+    }
+    else if (config.pattern == LoadPattern::ManyToOne)
+    {
+        if (index == 0)
+            return "";
+        to = loadId(0);
+    }
+    else
+    {
+        if (index != 0)
+            return "";
+        type = "publish";
+        to = LOAD_TOPIC;
+    }
+    return "{\"type\":\"" + type + "\",\"from\":\"" + loadId(index) + "\",\"to\":\"" + to +
+        "\",\"data\":{\"pad\":\"" + std::string(config.payloadSize, 'x') + "\",\"sent\":";
+}
+
+// Reads the send stamp embedded in a delivery, 0 if there is none
+static uint64_t sentStamp(std::string_view payload)
+{
+    static const std::string_view key = "\"sent\":";
+    size_t position = payload.rfind(key);
+    if (position == std::string_view::npos)
+        return 0;
+    uint64_t stamp = 0;
+    for (position += key.size(); position < payload.size() && payload[position] >= '0' && payload[position] <= '9'; position++)
+        stamp = stamp * 10 + (payload[position] - '0');
+    return stamp;
+}
+
+LoadGenerator::LoadGenerator(LoadConfig config) :
+    config_(std::move(config)),
+    workersReady_(0),
+    sendStart_(0)
+{}
+
+bool LoadGenerator::parsePattern(const std::string& name, LoadPattern& pattern)
+{
+    if (name == "pairwise")
+        pattern = LoadPattern::Pairwise;
+    else if (name == "many-to-one")
+        pattern = LoadPattern::ManyToOne;
+    else if (name == "fan-out")
+        pattern = LoadPattern::FanOut;
+    else
+        return false;
+    return true;
+}
+
+bool LoadGenerator::run(LoadReport& report)
+{
+    // Connections are dealt to threads round robin so every thread carries a similar share of senders
+    size_t threads = std::max<size_t>(1, std::min(config_.threads, config_.connections));
+    workers_.clear();
+    for (size_t index = 0; index < threads; index++)
+    {
+        workers_.push_back(std::make_unique<Worker>());
+        workers_.back()->measureStart = UINT64_MAX;
+    }
+    for (size_t index = 0; index < config_.connections; index++)
+        workers_[index % threads]->connections.push_back({ index, nullptr, messagePrefix(config_, index), false, false, false });
+    workersReady_ = 0;
+    sendStart_ = 0;
+
+    // Calling thread runs the first worker
+    std::vector<std::thread> pool;
+    for (size_t index = 1; index < threads; index++)
+        pool.emplace_back(&LoadGenerator::runWorker, this, std::ref(*workers_[index]));
+    runWorker(*workers_[0]);
+    for (std::thread& thread : pool)
+        thread.join();
+
+    report = LoadReport{};
+    report.seconds = config_.durationMs / 1000.0;
+    for (const std::unique_ptr<Worker>& worker : workers_)
+    {
+        report.connected += worker->ready;
+        report.sent += worker->sent;
+        report.received += worker->received;
+        report.errors += worker->errors;
+        HistogramSnapshot latency;
+        worker->latency.snapshot(latency);
+        report.latency.merge(latency);
+    }
+    return report.connected > 0;
+}
+
+void LoadGenerator::runWorker(Worker& worker)
+{
+    EpollReactor reactor;
+    std::vector<ReactorEvent> ready;
+    bool reactorReady = reactor.init();
+    for (size_t position = 0; position < worker.connections.size(); position++)
+    {
+        Connection& connection = worker.connections[position];
+        if (!reactorReady || !openConnection(connection, reactor))
+        {
+            connection.failed = true;
+            worker.errors++;
+            continue;
+        }
+        worker.sockets[connection.endpoint->socket] = position;
+        if (!connection.prefix.empty())
+            worker.senders.push_back(position);
+    }
+
+    // Services whatever became ready within the timeout
+    auto service = [&](int timeoutMs) {
+        reactor.wait(ready, timeoutMs);
+        for (const ReactorEvent& event : ready)
+        {
+            auto found = worker.sockets.find(event.socket);
+            if (found == worker.sockets.end())
+                continue;
+            Connection& connection = worker.connections[found->second];
+            if (!connection.failed)
+                serviceConnection(worker, connection, event, reactor);
+        }
+    };
+
+    // Connect and register until every connection answered its probe or failed
+    uint64_t setupEnd = MetricsRegistry::now() + config_.setupTimeoutMs * NANOS_PER_MS;
+    while (worker.ready + worker.errors < worker.connections.size() && MetricsRegistry::now() < setupEnd)
+        service(LOAD_IDLE_WAIT_MS);
+
+    // Wait for the other workers so sending starts everywhere at once
+    workersReady_++;
+    while (workersReady_ < workers_.size() && MetricsRegistry::now() < setupEnd)
+        service(LOAD_IDLE_WAIT_MS);
+    uint64_t start = 0;
+    sendStart_.compare_exchange_strong(start, MetricsRegistry::now());
+    start = sendStart_;
+
+    worker.measureStart = start + config_.warmupMs * NANOS_PER_MS;
+    uint64_t measureEnd = worker.measureStart + config_.durationMs * NANOS_PER_MS;
+    uint64_t drainEnd = measureEnd + LOAD_DRAIN_MS * NANOS_PER_MS;
+
+    // Open-loop schedule: this worker's share of the rate, independent of how fast the broker answers
+    size_t planned = plannedSenders(config_.pattern, config_.connections);
+    double interval = 0;
+    if (planned > 0 && !worker.senders.empty() && config_.rate > 0)
+        interval = 1e9 / (config_.rate * worker.senders.size() / planned);
+    double next = static_cast<double>(start);
+    size_t turn = 0;
+
+    while (true)
+    {
+        uint64_t now = MetricsRegistry::now();
+        if (now >= drainEnd)
+            break;
+
+        // Send every message that is due, stamped with the time it was due rather than the time it left
+        while (interval > 0 && next <= now && next < measureEnd)
+        {
+            uint64_t scheduled = static_cast<uint64_t>(next);
+            next += interval;
+            Connection& connection = worker.connections[worker.senders[turn++ % worker.senders.size()]];
+            // Slots of senders that never came up are lost, not rescheduled
+            if (!connection.ready || connection.failed)
+                continue;
+            connection.endpoint->receiveMsg(connection.prefix + std::to_string(scheduled) + "}}");
+            if (scheduled >= worker.measureStart)
+                worker.sent++;
+            if (!connection.endpoint->writeInterest && !flush(connection, reactor))
+                fail(worker, connection, reactor);
+        }
+
+        int timeoutMs = LOAD_IDLE_WAIT_MS;
+        if (interval > 0 && next < measureEnd)
+            timeoutMs = static_cast<int>((static_cast<uint64_t>(next) - std::min<uint64_t>(now, static_cast<uint64_t>(next))) / NANOS_PER_MS);
+        service(timeoutMs);
+    }
+
+    for (Connection& connection : worker.connections)
+    {
+        if (connection.failed)
+            continue;
+        reactor.remove(connection.endpoint->socket);
+        connection.endpoint->cleanup();
+    }
+}
+
+bool LoadGenerator::openConnection(Connection& connection, EpollReactor& reactor)
+{
+    SOCKET socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (socket == INVALID_SOCKET)
+        return false;
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config_.port);
+    int noDelay = 1;
+    if (inet_pton(AF_INET, config_.host.c_str(), &address.sin_addr) != 1 || !sock::setNonBlocking(socket) ||
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay)) == SOCKET_ERROR)
+    {
+        sock::close(socket);
+        return false;
+    }
+
+    // Connect completes in the background and is reported as writability
+    if (connect(socket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR && !sock::wouldBlock(sock::lastError()) &&
+        sock::lastError() != EINPROGRESS)
+    {
+        sock::close(socket);
+        return false;
+    }
+    if (!reactor.add(socket, true))
+    {
+        sock::close(socket);
+        return false;
+    }
+    connection.endpoint = std::make_shared<Endpoint>(socket);
+    connection.endpoint->id = loadId(connection.index);
+    connection.endpoint->writeInterest = true;
+    return true;
+}
+
+void LoadGenerator::serviceConnection(Worker& worker, Connection& connection, const ReactorEvent& event, EpollReactor& reactor)
+{
+    std::shared_ptr<Endpoint> endpoint = connection.endpoint;
+    if (!connection.connected)
+    {
+        if (!event.writable && !event.hangup)
+            return;
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(endpoint->socket, SOL_SOCKET, SO_ERROR, (char*)&error, &length) == SOCKET_ERROR || error != 0)
+        {
+            fail(worker, connection, reactor);
+            return;
+        }
+        connection.connected = true;
+
+        // Register, subscribe and then message ourselves, the broker handles them in order so the
+        // probe coming back means the connection is reachable and subscribed
+        endpoint->receiveMsg(nlohmann::json{ { "type", "registration" }, { "value", endpoint->id } }.dump());
+        if (config_.pattern == LoadPattern::FanOut && connection.index != 0)
+            endpoint->receiveMsg(nlohmann::json{ { "type", "subscribe" }, { "value", LOAD_TOPIC } }.dump());
+        endpoint->receiveMsg(nlohmann::json{ { "type", "message" }, { "from", endpoint->id }, { "to", endpoint->id },
+            { "data", { { "probe", true } } } }.dump());
+        if (!flush(connection, reactor))
+        {
+            fail(worker, connection, reactor);
+            return;
+        }
+    }
+
+    // Drain the socket, edge-triggered readiness is not reported again until more data arrives
+    if (event.readable || event.hangup)
+    {
+        while (true)
+        {
+            int recvBytes = sock::recv(endpoint->socket, endpoint->recvBuffer, PACKET_SIZE);
+            if (recvBytes == SOCKET_ERROR && sock::wouldBlock(sock::lastError()))
+                break;
+            if (recvBytes == SOCKET_ERROR || recvBytes == 0)
+            {
+                fail(worker, connection, reactor);
+                return;
+            }
+            endpoint->bytesRecv = recvBytes;
+            if (!endpoint->processRecv())
+            {
+                fail(worker, connection, reactor);
+                return;
+            }
+
+            uint64_t now = MetricsRegistry::now();
+            for (const RecvFrame& frame : endpoint->outbox)
+            {
+                if (!connection.ready)
+                {
+                    if (frame.payload.find("\"probe\"") != std::string_view::npos)
+                    {
+                        connection.ready = true;
+                        worker.ready++;
+                    }
+                    continue;
+                }
+                uint64_t stamp = sentStamp(frame.payload);
+                if (stamp >= worker.measureStart && stamp <= now)
+                {
+                    worker.received++;
+                    worker.latency.record(now - stamp);
+                }
+            }
+            endpoint->releaseFrames();
+        }
+    }
+
+    if (event.writable && !flush(connection, reactor))
+        fail(worker, connection, reactor);
+}
+
+bool LoadGenerator::flush(Connection& connection, EpollReactor& reactor)
+{
+    std::shared_ptr<Endpoint> endpoint = connection.endpoint;
+    while (endpoint->outbound.numFrames() > 0)
+    {
+        size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+        int sendBytes = sock::sendv(endpoint->socket, endpoint->sendVecs, count);
+        if (sendBytes == SOCKET_ERROR)
+        {
+            if (!sock::wouldBlock(sock::lastError()))
+                return false;
+            // Resume once the socket drains
+            if (!endpoint->writeInterest)
+            {
+                endpoint->writeInterest = true;
+                reactor.setWriteInterest(endpoint->socket, true);
+            }
+            return true;
+        }
+        endpoint->processSent(sendBytes, nullptr);
+    }
+    if (endpoint->writeInterest)
+    {
+        endpoint->writeInterest = false;
+        reactor.setWriteInterest(endpoint->socket, false);
+    }
+    return true;
+}
+
+void LoadGenerator::fail(Worker& worker, Connection& connection, EpollReactor& reactor)
+{
+    connection.failed = true;
+    worker.errors++;
+    reactor.remove(connection.endpoint->socket);
+    connection.endpoint->cleanup();
+}
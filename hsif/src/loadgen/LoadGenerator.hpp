@@ -0,0 +1,212 @@
+#pragma once
+
+#include "Endpoint.hpp"
+#include "EpollReactor.hpp"
+#include "Metrics.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Time allowed after the measured window for messages still in flight, in milliseconds
+#define LOAD_DRAIN_MS 1000
+// Topic used by LoadPattern::FanOut
+#define LOAD_TOPIC "load"
+// Prefix of generated endpoint identifiers, followed by the connection index
+#define LOAD_ID_PREFIX "load-"
+
+/// <summary>
+/// Who sends to whom.
+/// </summary>
+enum class LoadPattern
+{
+	// Connections 2k and 2k+1 send to each other
+	Pairwise,
+	// Every connection sends to connection 0
+	ManyToOne,
+	// Connection 0 publishes to a topic every other connection subscribes to
+	FanOut
+};
+
+/// <summary>
+/// Load generator settings.
+/// </summary>
+struct LoadConfig
+{
+	// Broker address
+	std::string host;
+	unsigned int port;
+	// Connections opened, each registered as LOAD_ID_PREFIX followed by its index
+	size_t connections;
+	// Traffic pattern
+	LoadPattern pattern;
+	// Messages sent per second across all senders, publishes count once however many subscribers receive them
+	double rate;
+	// Padding bytes added to each message
+	size_t payloadSize;
+	// Sending time before and during measurement, in milliseconds
+	unsigned int warmupMs;
+	unsigned int durationMs;
+	// Threads sharing the connections, each with its own reactor
+	size_t threads;
+	// Time allowed for every connection to connect and register, in milliseconds
+	unsigned int setupTimeoutMs;
+};
+
+// Settings used unless overridden on the command line
+#define DEFAULT_LOAD_CONFIG LoadConfig{ "127.0.0.1", 8888, 1000, LoadPattern::Pairwise, 10000, 64, 1000, 10000, 1, 10000 }
+
+/// <summary>
+/// Results of a load run. Counts cover messages sent inside the measured window.
+/// </summary>
+struct LoadReport
+{
+	// Connections that connected and completed registration
+	uint64_t connected;
+	// Messages sent and deliveries received
+	uint64_t sent;
+	uint64_t received;
+	// Connections that failed or were closed by the broker
+	uint64_t errors;
+	// Length of the measured window in seconds
+	double seconds;
+	// End-to-end latency of received deliveries in nanoseconds, from the scheduled send time
+	HistogramSnapshot latency;
+};
+
+/// <summary>
+/// Opens many non-blocking connections to a broker, registers each under a
+/// distinct identifier and drives a traffic pattern at a fixed rate. Every
+/// message embeds the time it was scheduled to be sent, so a late sender
+/// still charges its delay to latency instead of hiding it. Connections are
+/// split between threads, each running an edge-triggered epoll loop. Requires Linux.
+/// </summary>
+class LoadGenerator
+{
+public:
+	LoadGenerator() = delete;
+
+	/// <summary>
+	/// Load generator initialization.
+	/// </summary>
+	/// <param name="config">Load settings.</param>
+	LoadGenerator(LoadConfig config);
+
+	/// <summary>
+	/// Connects, registers, sends for the warmup and measured windows and waits for stragglers.
+	/// </summary>
+	/// <param name="report">Receives results.</param>
+	/// <returns>False if no connection could be set up.</returns>
+	bool run(LoadReport& report);
+
+	/// <summary>
+	/// Parses a pattern name: pairwise, many-to-one or fan-out.
+	/// </summary>
+	/// <param name="name">Pattern name.</param>
+	/// <param name="pattern">Receives the pattern.</param>
+	/// <returns>False if the name is unknown.</returns>
+	static bool parsePattern(const std::string& name, LoadPattern& pattern);
+
+private:
+	/// <summary>
+	/// One broker connection.
+	/// </summary>
+	struct Connection
+	{
+		// Index across every thread
+		size_t index;
+		// Socket, framing and outbound queue
+		std::shared_ptr<Endpoint> endpoint;
+		// Message text up to the send stamp, empty if the connection only receives
+		std::string prefix;
+		// Whether the connection completed and its registration probe came back
+		bool connected;
+		bool ready;
+		// Whether the connection failed
+		bool failed;
+	};
+
+	/// <summary>
+	/// Connections and results of one thread.
+	/// </summary>
+	struct Worker
+	{
+		std::vector<Connection> connections;
+		// Position of each connection by socket
+		std::unordered_map<SOCKET, size_t> sockets;
+		// Positions of connections that send
+		std::vector<size_t> senders;
+		uint64_t sent;
+		uint64_t received;
+		uint64_t errors;
+		uint64_t ready;
+		// Deliveries sent at or after this stamp are measured, UINT64_MAX until sending starts
+		uint64_t measureStart;
+		LatencyHistogram latency;
+	};
+
+	/// <summary>
+	/// Thread body. Runs every phase for the worker's connections.
+	/// </summary>
+	/// <param name="worker">Worker owned by the calling thread.</param>
+	void runWorker(Worker& worker);
+
+	/// <summary>
+	/// Starts a non-blocking connect.
+	/// </summary>
+	/// <param name="connection">Connection to open.</param>
+	/// <param name="reactor">Reactor watching the worker's sockets.</param>
+	/// <returns>False if the socket could not be created.</returns>
+	bool openConnection(Connection& connection, EpollReactor& reactor);
+
+	/// <summary>
+	/// Handles a readiness event for a connection.
+	/// </summary>
+	/// <param name="worker">Owning worker.</param>
+	/// <param name="connection">Ready connection.</param>
+	/// <param name="event">Reported readiness.</param>
+	/// <param name="reactor">Reactor watching the worker's sockets.</param>
+	void serviceConnection(Worker& worker, Connection& connection, const ReactorEvent& event, EpollReactor& reactor);
+
+	/// <summary>
+	/// Writes queued frames until the socket would block.
+	/// </summary>
+	/// <param name="connection">Connection with queued frames.</param>
+	/// <param name="reactor">Reactor watching the worker's sockets.</param>
+	/// <returns>False if the connection failed.</returns>
+	bool flush(Connection& connection, EpollReactor& reactor);
+
+	/// <summary>
+	/// Marks a connection failed and closes it.
+	/// </summary>
+	/// <param name="worker">Owning worker.</param>
+	/// <param name="connection">Failed connection.</param>
+	/// <param name="reactor">Reactor watching the worker's sockets.</param>
+	void fail(Worker& worker, Connection& connection, EpollReactor& reactor);
+
+	// Load settings
+	LoadConfig config_;
+	// Per-thread state
+	std::vector<std::unique_ptr<Worker>> workers_;
+	// Workers whose connections are all set up, sending starts once every worker is
+	std::atomic<size_t> workersReady_;
+	// MetricsRegistry::now() stamp at which every worker starts sending, 0 until set
+	std::atomic<uint64_t> sendStart_;
+};
@@ -0,0 +1,123 @@
+#include "LoadGenerator.hpp"
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+static void usage()
+{
+    std::cerr << "usage: hsifLoad [--host <address>] [--port <port>] [--connections <count>]\n"
+        "                [--pattern pairwise|many-to-one|fan-out] [--rate <messages/s>] [--payload <bytes>]\n"
+        "                [--warmup <ms>] [--duration <ms>] [--threads <count>] [--json]\n";
+}
+
+int main(int argc, char* argv[])
+{
+    LoadConfig config = DEFAULT_LOAD_CONFIG;
+    bool jsonOutput = false;
+    for (int index = 1; index < argc; index++)
+    {
+        std::string flag = argv[index];
+        if (flag == "--json")
+        {
+            jsonOutput = true;
+            continue;
+        }
+        if (index + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++index];
+        if (flag == "--host")
+            config.host = value;
+        else if (flag == "--port")
+            config.port = std::stoul(value);
+        else if (flag == "--connections")
+            config.connections = std::stoul(value);
+        else if (flag == "--pattern" && LoadGenerator::parsePattern(value, config.pattern))
+            continue;
+        else if (flag == "--rate")
+            config.rate = std::stod(value);
+        else if (flag == "--payload")
+            config.payloadSize = std::stoul(value);
+        else if (flag == "--warmup")
+            config.warmupMs = std::stoul(value);
+        else if (flag == "--duration")
+            config.durationMs = std::stoul(value);
+        else if (flag == "--threads")
+            config.threads = std::stoul(value);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+#ifdef __linux__
+    // Every connection holds a descriptor, the soft limit is often far below what a run needs
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+    sock::startup();
+
+    LoadGenerator generator(config);
+    LoadReport report;
+    bool success = generator.run(report);
+    sock::teardown();
+
+    double throughput = report.seconds > 0 ? report.received / report.seconds : 0;
+    auto micros = [&](double q) { return report.latency.percentile(q) / 1000.0; };
+    if (jsonOutput)
+    {
+        nlohmann::json result = {
+            { "connected", report.connected },
+            { "sent", report.sent },
+            { "received", report.received },
+            { "errors", report.errors },
+            { "seconds", report.seconds },
+            { "throughput", throughput },
+            { "p50_us", micros(0.5) },
+            { "p99_us", micros(0.99) },
+            { "p999_us", micros(0.999) },
+            { "max_us", report.latency.max / 1000.0 }
+        };
+        std::cout << result.dump() << std::endl;
+    }
+    else
+    {
+        std::printf("connected  %10llu\n", static_cast<unsigned long long>(report.connected));
+        std::printf("errors     %10llu\n", static_cast<unsigned long long>(report.errors));
+        std::printf("sent       %10llu\n", static_cast<unsigned long long>(report.sent));
+        std::printf("received   %10llu\n", static_cast<unsigned long long>(report.received));
+        std::printf("msg/s      %10.0f\n", throughput);
+        std::printf("p50 us     %10.1f\n", micros(0.5));
+        std::printf("p99 us     %10.1f\n", micros(0.99));
+        std::printf("p999 us    %10.1f\n", micros(0.999));
+        std::printf("max us     %10.1f\n", report.latency.max / 1000.0);
+    }
+    return success ? 0 : 1;
+}
@@ -1,8 +1,51 @@
 #include "sys/Sys.hpp"
+#include "SlabPool.hpp"
+#include <cstdlib>
 #include <iostream>
+#include <thread>
+#include <string>
 
 int main(int argc, char* argv[]) 
 {
-	Sys sys("", 8888, "testLog.txt", true);
+	// Listening port unless given with --port
+	unsigned int port = DEFAULT_BROKER_CONFIG.port;
+	bool uring = false;
+	// Local socket a successor takes this broker over on, and whether this process is that successor
+	std::string upgradePath;
+	bool takeOver = false;
+	for (int index = 1; index < argc; index++)
+	{
+		std::string arg = argv[index];
+		if (arg == "--uring")
+			uring = true;
+		else if (arg == "--port" && index + 1 < argc)
+			port = static_cast<unsigned int>(std::strtoul(argv[++index], nullptr, 10));
+		else if (arg == "--upgrade-path" && index + 1 < argc)
+			upgradePath = argv[++index];
+		else if (arg == "--take-over")
+			takeOver = true;
+	}
+#ifdef __linux__
+	// Back the allocator pool with huge pages, or transparent huge pages where none are reserved
+	SlabPool::shared().setHugePages(true);
+
+	// Single epoll reactor when it is to be handed to, or take over from, another process
+	if (!upgradePath.empty())
+	{
+		Sys sys(BrokerConfig{ "", port, "testLog.txt", true, PollBackend::Epoll, 0, RoutingMode::Header, true, upgradePath, takeOver });
+		return 0;
+	}
+	// Single io_uring reactor when requested
+	if (uring)
+	{
+		Sys sys("", port, "testLog.txt", true, PollBackend::Uring);
+		return 0;
+	}
+	// One epoll reactor shard per core, routing on message headers only
+	size_t shards = std::thread::hardware_concurrency();
+	Sys sys("", port, "testLog.txt", true, shards > 0 ? shards : 1, RoutingMode::Header);
+#else
+	Sys sys("", port, "testLog.txt", true);
+#endif
 	return 0;
 }
\ No newline at end of file
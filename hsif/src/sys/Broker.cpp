@@ -0,0 +1,178 @@
+#include "Broker.hpp"
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+Broker::Broker(BrokerConfig config) :
+	config_(std::move(config)),
+	running_(false),
+	started_(false),
+	stopped_(false),
+	nextShard_(0)
+{
+	// Initializes logger and server objects
+	logger_ = config_.logFile.empty() ? std::make_shared<Logger>() : std::make_shared<Logger>(config_.logFile);
+	if (config_.shards > 0)
+		shardGroup_ = std::make_unique<ShardGroup>(config_.ip, config_.port, logger_, config_.logToFile, config_.shards);
+	else
+		server_ = Server(config_.ip, config_.port, logger_, config_.logToFile, config_.backend);
+}
+
+Broker::~Broker()
+{
+	stop();
+}
+
+bool Broker::start()
+{
+	if (started_)
+		return true;
+	if (stopped_)
+		return false;
+	if (shardGroup_)
+	{
+		// Shards share the port with each other and are not handed to a successor
+		if (config_.takeOver)
+		{
+			LOG_ERROR(logger_, config_.logToFile, "A sharded broker cannot take over another broker");
+			return false;
+		}
+		if (!config_.upgradePath.empty())
+			LOG_WARNING(logger_, config_.logToFile, "Ignoring the upgrade path, sharded brokers are not handed off");
+		shardGroup_->setRoutingMode(config_.routing);
+#ifdef __linux__
+		shardGroup_->setLocalEndpoints(true);
+#endif
+		if (!shardGroup_->start())
+		{
+			shardGroup_->stop();
+			return false;
+		}
+		running_ = true;
+	}
+	else
+	{
+		server_.setRoutingMode(config_.routing);
+		// Datagram channels use the same port number as TCP
+		server_.setDatagramPort(config_.port);
+#ifdef __linux__
+		server_.setLocalEndpoints(true);
+#endif
+		server_.setUpgradePath(config_.upgradePath);
+		if (!(config_.takeOver ? server_.takeOver(config_.upgradePath) : server_.connect()))
+		{
+			server_.cleanup();
+			return false;
+		}
+		running_ = true;
+		thread_ = std::thread([this]() {
+			// Poll until stopped, handed off, or a failed poll ends the loop
+			bool ok = true;
+			while (ok && running_)
+				ok = server_.poll();
+			running_ = false;
+		});
+	}
+	started_ = true;
+	if (config_.exportMetrics)
+		startExporter();
+	return true;
+}
+
+void Broker::stop()
+{
+	if (!started_)
+		return;
+	started_ = false;
+	stopped_ = true;
+	running_ = false;
+	if (shardGroup_)
+	{
+		// Releasing the group stops the shards and cleans up their servers
+		shardGroup_.reset();
+	}
+	else
+	{
+		// The poll thread sees running_ cleared once its wait returns
+		server_.wake();
+		if (thread_.joinable())
+			thread_.join();
+		server_.cleanup();
+	}
+	exporter_.reset();
+}
+
+void Broker::join()
+{
+	if (shardGroup_)
+		shardGroup_->join();
+	else if (thread_.joinable())
+		thread_.join();
+}
+
+bool Broker::running()
+{
+	return running_;
+}
+
+std::unique_ptr<Client> Broker::connect(const std::string& id)
+{
+	return connect(id, WireFormat::Text);
+}
+
+std::unique_ptr<Client> Broker::connect(const std::string& id, WireFormat format)
+{
+	if (!running_)
+		return nullptr;
+	auto channel = std::make_shared<LocalChannel>(LOCAL_RING_CAPACITY);
+	// The shard a client attaches to serves it for its lifetime
+	Server& server = shardGroup_ ? shardGroup_->server(nextShard_++ % shardGroup_->numShards()) : server_;
+	if (!server.attachLocal(channel))
+		return nullptr;
+	auto client = std::make_unique<Client>(channel, id, format);
+	// Registration is the first message on the channel, routed like a socket client's
+	json registration = { { "type", "registration" }, { "value", id } };
+	if (format == WireFormat::MsgPack)
+		registration["framing"] = "msgpack";
+	else if (format == WireFormat::Cbor)
+		registration["framing"] = "cbor";
+	if (!client->send(registration.dump()))
+		return nullptr;
+	return client;
+}
+
+std::vector<std::shared_ptr<MetricsRegistry>> Broker::metrics()
+{
+	std::vector<std::shared_ptr<MetricsRegistry>> sources;
+	if (config_.shards > 0)
+	{
+		for (size_t shard = 0; shardGroup_ && shard < shardGroup_->numShards(); shard++)
+			sources.push_back(shardGroup_->metrics(shard));
+	}
+	else
+	{
+		sources.push_back(server_.metrics());
+	}
+	return sources;
+}
+
+void Broker::startExporter()
+{
+	// Broker keeps running without metrics if the port is taken
+	exporter_ = std::make_unique<MetricsExporter>(metrics(), logger_, config_.logToFile);
+	if (!exporter_->start(METRICS_PORT))
+		exporter_.reset();
+}
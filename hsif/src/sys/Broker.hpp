@@ -0,0 +1,157 @@
+#pragma once
+
+#include "Server.hpp"
+#include "ShardGroup.hpp"
+#include "MetricsExporter.hpp"
+#include "Logger.hpp"
+#include "Client.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Settings of an embedded broker.
+/// </summary>
+struct BrokerConfig
+{
+	// Ip to listen for incoming connections ("" for any)
+	std::string ip;
+	// TCP port, and UDP port of an unsharded broker
+	unsigned int port;
+	// Log file path, empty for the logger's default
+	std::string logFile;
+	// Determines whether or not to log to file
+	bool logToFile;
+	// Socket readiness mechanism of an unsharded broker
+	PollBackend backend;
+	// Number of epoll reactor threads (Linux only), 0 for a single server on the backend above
+	size_t shards;
+	// How messages are read when routing, RoutingMode::Header hands in-process payloads on without copying
+	RoutingMode routing;
+	// Whether to serve metrics on METRICS_PORT while running
+	bool exportMetrics;
+	// Local socket path a successor process takes an unsharded broker over on (Linux only), empty to disable
+	std::string upgradePath;
+	// Whether start() takes over the broker accepting successors on upgradePath instead of binding the port
+	bool takeOver;
+};
+
+// Single server on port 8888 routing on headers, without metrics or hand-off
+#define DEFAULT_BROKER_CONFIG BrokerConfig{ "", 8888, "", false, PollBackend::Select, 0, RoutingMode::Header, false, "", false }
+
+/// <summary>
+/// HSIF broker embedded in a host application. start() binds the configured server or
+/// shards and polls them on background threads, so the caller keeps its own thread.
+/// Besides socket clients, the host connects in-process clients (Linux only) whose
+/// messages reach the server thread over lock-free rings and are routed by the same
+/// routeMessage() path as remote messages.
+/// </summary>
+class Broker
+{
+public:
+	// Delete default constructor
+	Broker() = delete;
+
+	/// <summary>
+	/// Creates the logger and servers without binding them.
+	/// </summary>
+	/// <param name="config">Broker settings.</param>
+	Broker(BrokerConfig config);
+
+	/// <summary>
+	/// Stops the broker if running.
+	/// </summary>
+	~Broker();
+
+	// Broker owns its threads
+	Broker(const Broker&) = delete;
+	Broker& operator=(const Broker&) = delete;
+
+	/// <summary>
+	/// Binds the broker, or takes over the listener and connections of the broker accepting
+	/// successors on the upgrade path, and starts polling on background threads. Returns
+	/// without blocking. A stopped broker is not started again; a new one takes its place.
+	/// </summary>
+	/// <returns>True if every server bound, false once stopped.</returns>
+	bool start();
+
+	/// <summary>
+	/// Stops polling, waits for the threads to exit and closes every connection,
+	/// closing in-process clients too. Not to be called from a broker thread.
+	/// </summary>
+	void stop();
+
+	/// <summary>
+	/// Blocks until the poll threads exit, which happens on stop() from another thread, a poll failure or a hand-off to a successor.
+	/// </summary>
+	void join();
+
+	/// <summary>
+	/// Returns whether the broker started and neither stopped nor failed since.
+	/// </summary>
+	/// <returns>True while running.</returns>
+	bool running();
+
+	/// <summary>
+	/// Connects an in-process client receiving JSON text. Safe from any thread while running.
+	/// </summary>
+	/// <param name="id">Identifier to register under.</param>
+	/// <returns>Client, nullptr if not running or in-process clients are unsupported.</returns>
+	std::unique_ptr<Client> connect(const std::string& id);
+
+	/// <summary>
+	/// Connects an in-process client. Registration is routed like a socket client's, so an
+	/// identifier already taken leaves the client unregistered. Clients of a sharded broker
+	/// are spread over the shards. Safe from any thread while running.
+	/// </summary>
+	/// <param name="id">Identifier to register under.</param>
+	/// <param name="format">Encoding of the messages routed to the client.</param>
+	/// <returns>Client, nullptr if not running or in-process clients are unsupported.</returns>
+	std::unique_ptr<Client> connect(const std::string& id, WireFormat format);
+
+	/// <summary>
+	/// Returns the metrics registry of every server.
+	/// </summary>
+	/// <returns>One registry per shard, or the single server's. None once a sharded broker stopped.</returns>
+	std::vector<std::shared_ptr<MetricsRegistry>> metrics();
+
+private:
+	// Serves metrics of every server on the loopback metrics port
+	void startExporter();
+	// Broker settings
+	BrokerConfig config_;
+	// HSIF logger shared pointer instance
+	std::shared_ptr<Logger> logger_;
+	// HSIF server instance (unsharded mode only)
+	Server server_;
+	// HSIF shard group instance (sharded mode only, released once stopped)
+	std::unique_ptr<ShardGroup> shardGroup_;
+	// Prometheus exporter, runs while the broker does
+	std::unique_ptr<MetricsExporter> exporter_;
+	// Polls the unsharded server
+	std::thread thread_;
+	// Cleared to stop the poll thread
+	std::atomic<bool> running_;
+	// Set between a successful start() and stop(), owner thread only
+	bool started_;
+	// Set once stopped, owner thread only
+	bool stopped_;
+	// Shard the next in-process client attaches to
+	std::atomic<size_t> nextShard_;
+};
@@ -0,0 +1,86 @@
+#include "Client.hpp"
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+Client::Client(std::shared_ptr<LocalChannel> channel, std::string id, WireFormat format) :
+	channel_(std::move(channel)),
+	id_(std::move(id)),
+	format_(format)
+{}
+
+Client::~Client()
+{
+	close();
+}
+
+const std::string& Client::id()
+{
+	return id_;
+}
+
+WireFormat Client::format()
+{
+	return format_;
+}
+
+bool Client::send(std::string_view msg)
+{
+	return send(framing::makePayload(msg), WireFormat::Text);
+}
+
+bool Client::send(Payload msg, WireFormat format)
+{
+	return channel_->send(LocalFrame{ std::move(msg), format });
+}
+
+bool Client::trySend(Payload msg, WireFormat format)
+{
+	return channel_->trySend(LocalFrame{ std::move(msg), format });
+}
+
+bool Client::subscribe(const std::string& topic)
+{
+	// Same control message a socket client sends
+	json msg = { { "type", "subscribe" }, { "value", topic } };
+	return send(msg.dump());
+}
+
+bool Client::unsubscribe(const std::string& topic)
+{
+	json msg = { { "type", "unsubscribe" }, { "value", topic } };
+	return send(msg.dump());
+}
+
+bool Client::receive(Payload& msg, int timeoutMs)
+{
+	return channel_->receive(msg, timeoutMs);
+}
+
+bool Client::tryReceive(Payload& msg)
+{
+	return channel_->tryReceive(msg);
+}
+
+void Client::close()
+{
+	channel_->close();
+}
+
+bool Client::closed()
+{
+	return channel_->closed();
+}
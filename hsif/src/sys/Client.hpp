@@ -0,0 +1,136 @@
+#pragma once
+
+#include "LocalChannel.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// In-process endpoint of an embedded Broker. The client speaks the same protocol as a
+/// socket client and is routed by the same code, but its messages cross to the broker
+/// thread as refcounted payloads on a lock-free ring, so nothing is framed, copied or
+/// written to a socket. A client is used from one thread at a time.
+/// </summary>
+class Client
+{
+public:
+	// Delete default constructor
+	Client() = delete;
+
+	/// <summary>
+	/// Wraps a channel already attached to a server. Created by Broker::connect().
+	/// </summary>
+	/// <param name="channel">Channel to the server serving the client.</param>
+	/// <param name="id">Identifier the client registered under.</param>
+	/// <param name="format">Encoding of the messages routed to the client.</param>
+	Client(std::shared_ptr<LocalChannel> channel, std::string id, WireFormat format);
+
+	/// <summary>
+	/// Closes the channel, unregistering the client.
+	/// </summary>
+	~Client();
+
+	// Client owns its end of the channel
+	Client(const Client&) = delete;
+	Client& operator=(const Client&) = delete;
+
+	/// <summary>
+	/// Returns identifier the client registered under.
+	/// </summary>
+	/// <returns>Identifier.</returns>
+	const std::string& id();
+
+	/// <summary>
+	/// Returns encoding of the messages routed to the client.
+	/// </summary>
+	/// <returns>Wire format.</returns>
+	WireFormat format();
+
+	/// <summary>
+	/// Sends a JSON text message, copied once into a payload. Waits while the ring is full.
+	/// </summary>
+	/// <param name="msg">Message as JSON text.</param>
+	/// <returns>False if the client is closed.</returns>
+	bool send(std::string_view msg);
+
+	/// <summary>
+	/// Hands a message to the broker without copying it. Waits while the ring is full.
+	/// Routing on headers forwards the same payload to the receivers.
+	/// </summary>
+	/// <param name="msg">Message payload, left untouched once sent.</param>
+	/// <param name="format">Encoding of the payload.</param>
+	/// <returns>False if the client is closed.</returns>
+	bool send(Payload msg, WireFormat format);
+
+	/// <summary>
+	/// Hands a message to the broker without copying it if the ring has room.
+	/// </summary>
+	/// <param name="msg">Message payload, left untouched once sent.</param>
+	/// <param name="format">Encoding of the payload.</param>
+	/// <returns>False if the ring is full or the client closed.</returns>
+	bool trySend(Payload msg, WireFormat format);
+
+	/// <summary>
+	/// Subscribes the client to a topic.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <returns>False if the client is closed.</returns>
+	bool subscribe(const std::string& topic);
+
+	/// <summary>
+	/// Unsubscribes the client from a topic.
+	/// </summary>
+	/// <param name="topic">Topic name.</param>
+	/// <returns>False if the client is closed.</returns>
+	bool unsubscribe(const std::string& topic);
+
+	/// <summary>
+	/// Takes the next message routed to the client, waiting for one.
+	/// </summary>
+	/// <param name="msg">Receives the message, encoded in the client's format.</param>
+	/// <param name="timeoutMs">Milliseconds to wait, -1 to wait indefinitely.</param>
+	/// <returns>False on timeout, or once the client closed and every message was taken.</returns>
+	bool receive(Payload& msg, int timeoutMs);
+
+	/// <summary>
+	/// Takes the next message routed to the client if one is waiting.
+	/// </summary>
+	/// <param name="msg">Receives the message, encoded in the client's format.</param>
+	/// <returns>False if no message is waiting.</returns>
+	bool tryReceive(Payload& msg);
+
+	/// <summary>
+	/// Closes the client. The broker removes its endpoint and a blocked receive returns.
+	/// </summary>
+	void close();
+
+	/// <summary>
+	/// Returns whether the client or the broker closed the channel.
+	/// </summary>
+	/// <returns>True once closed.</returns>
+	bool closed();
+
+private:
+	// Channel to the server thread serving the client
+	std::shared_ptr<LocalChannel> channel_;
+	// Identifier the client registered under
+	std::string id_;
+	// Encoding of the messages routed to the client
+	WireFormat format_;
+};
@@ -18,31 +18,41 @@ limitations under the License.
 
 Sys::Sys(std::string ip, unsigned int port, bool logToFile)
 {
-	// Initializes logger and server objects
-	logger_ = std::make_shared<Logger>();
-	server_ = Server(ip, port, logger_, logToFile);
-	// Start server instance
-	startServer();
+	// Single server routing on parsed messages, with the logger's default file
+	run(BrokerConfig{ ip, port, "", logToFile, PollBackend::Select, 0, RoutingMode::Parse, true, "", false });
 }
 
 Sys::Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile)
 {
-	// Initializes logger and server objects
-	logger_ = std::make_shared<Logger>(logFile);
-	server_ = Server(ip, port, logger_, logToFile);
-	// Start server instance
-	startServer();
+	run(BrokerConfig{ ip, port, logFile, logToFile, PollBackend::Select, 0, RoutingMode::Parse, true, "", false });
 }
 
-void Sys::startServer()
+Sys::Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile, PollBackend backend)
 {
-	// Tracks poll execution
-	bool running = true;
-	// Bind server to ip and port provided
-	running = server_.connect();
-	// While no exceptions, run server
-	while (running)
-	{
-		running = server_.poll();
-	}
-}
\ No newline at end of file
+	run(BrokerConfig{ ip, port, logFile, logToFile, backend, 0, RoutingMode::Parse, true, "", false });
+}
+
+Sys::Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile, size_t shards)
+{
+	// One epoll server per shard
+	run(BrokerConfig{ ip, port, logFile, logToFile, PollBackend::Epoll, shards, RoutingMode::Parse, true, "", false });
+}
+
+Sys::Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile, size_t shards, RoutingMode routing)
+{
+	run(BrokerConfig{ ip, port, logFile, logToFile, PollBackend::Epoll, shards, routing, true, "", false });
+}
+
+Sys::Sys(BrokerConfig config)
+{
+	run(std::move(config));
+}
+
+void Sys::run(BrokerConfig config)
+{
+	broker_ = std::make_unique<Broker>(std::move(config));
+	// Broker polls on its own threads, this one waits for them to exit
+	if (broker_->start())
+		broker_->join();
+	broker_->stop();
+}
@@ -1,7 +1,6 @@
 #pragma once
 
-#include "Server.hpp"
-#include "Logger.hpp"
+#include "Broker.hpp"
 
 /*
 Copyright 2020 Itreau Bigsby
@@ -44,11 +43,46 @@ public:
 	/// <param name="logFile">Specified filepath for log.</param>
 	/// <param name="logToFile">Determines whether or not to log to file.</param>
 	Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile);
+
+	/// <summary>
+	/// Constructor for system given server, logger and poll backend parameters.
+	/// </summary>
+	/// <param name="ip">Ip to listen for incoming connections.</param>
+	/// <param name="port">Port to listen for incoming connections.</param>
+	/// <param name="logFile">Specified filepath for log.</param>
+	/// <param name="logToFile">Determines whether or not to log to file.</param>
+	/// <param name="backend">Socket readiness mechanism used by the server.</param>
+	Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile, PollBackend backend);
+
+	/// <summary>
+	/// Constructor for a sharded system running one epoll reactor thread per shard (Linux only).
+	/// </summary>
+	/// <param name="ip">Ip to listen for incoming connections.</param>
+	/// <param name="port">Port shared by every shard.</param>
+	/// <param name="logFile">Specified filepath for log.</param>
+	/// <param name="logToFile">Determines whether or not to log to file.</param>
+	/// <param name="shards">Number of reactor threads.</param>
+	Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile, size_t shards);
+
+	/// <summary>
+	/// Constructor for a sharded system with a message routing mode (Linux only).
+	/// </summary>
+	/// <param name="ip">Ip to listen for incoming connections.</param>
+	/// <param name="port">Port shared by every shard.</param>
+	/// <param name="logFile">Specified filepath for log.</param>
+	/// <param name="logToFile">Determines whether or not to log to file.</param>
+	/// <param name="shards">Number of reactor threads.</param>
+	/// <param name="routing">How messages are read when routing.</param>
+	Sys(std::string ip, unsigned int port, std::string logFile, bool logToFile, size_t shards, RoutingMode routing);
+
+	/// <summary>
+	/// Constructor for system given broker settings.
+	/// </summary>
+	/// <param name="config">Broker settings.</param>
+	Sys(BrokerConfig config);
 private:
-	// Binds server instance to provided ip and port
-	void startServer();
-	// HSIF server instance
-	Server server_;
-	// HSIF logger shared pointer instance
-	std::shared_ptr<Logger> logger_;
-};
\ No newline at end of file
+	// Starts the broker and blocks until it stops
+	void run(BrokerConfig config);
+	// HSIF broker instance
+	std::unique_ptr<Broker> broker_;
+};
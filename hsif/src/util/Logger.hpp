@@ -4,6 +4,10 @@
 #include <chrono>
 #include <iostream>
 #include <ctime>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "MpscRing.hpp"
 
 /*
 Copyright 2020 Itreau Bigsby
@@ -21,8 +25,48 @@ limitations under the License.
 @author   Itreau Bigsby    mailto:ibigsby@asu.edu
  */
 
+// Records buffered between the logging threads and the writer
+#define LOG_RING_SIZE 8192
+// Writer sleep when the ring is empty, in milliseconds
+#define LOG_FLUSH_INTERVAL 10
+
+// Lowest severity compiled in (0 debug, 1 info, 2 warning, 3 error); release builds drop debug logging
+#ifndef HSIF_LOG_LEVEL
+#ifdef NDEBUG
+#define HSIF_LOG_LEVEL 1
+#else
+#define HSIF_LOG_LEVEL 0
+#endif
+#endif
+
+// Logs a message only if its level is compiled in and enabled; the message expression is not evaluated otherwise
+#define HSIF_LOG(logger, level, toFile, message) \
+	do { if (static_cast<int>(level) >= HSIF_LOG_LEVEL && (logger)->enabled(level)) (logger)->logMsg(level, message, toFile); } while (0)
+#define LOG_DEBUG(logger, toFile, message) HSIF_LOG(logger, LogLevel::Debug, toFile, message)
+#define LOG_INFO(logger, toFile, message) HSIF_LOG(logger, LogLevel::Info, toFile, message)
+#define LOG_WARNING(logger, toFile, message) HSIF_LOG(logger, LogLevel::Warning, toFile, message)
+#define LOG_ERROR(logger, toFile, message) HSIF_LOG(logger, LogLevel::Error, toFile, message)
+
+/// <summary>
+/// Severity of a log message.
+/// </summary>
+enum class LogLevel
+{
+	// Per-message and per-poll tracing
+	Debug = 0,
+	// Connection and registration lifecycle
+	Info = 1,
+	// Recoverable problems such as refused or dropped messages
+	Warning = 2,
+	// Failed system calls and broken connections
+	Error = 3
+};
+
 /// <summary>
 /// Encapsulates logging functionality for console and file-based logging.
+/// Logging threads only format their message and push it onto a lock-free
+/// ring; a background writer timestamps, batches and writes records. A full
+/// ring drops the message and counts it instead of blocking the caller.
 /// </summary>
 class Logger
 {
@@ -30,37 +74,179 @@ public:
 	/// <summary>
 	/// Default constructor.
 	/// </summary>
-	Logger() : logFile_(std::ofstream("default_log.txt", std::ofstream::out)) {};
+	Logger() : Logger("default_log.txt") {};
 
 	/// <summary>
 	/// Constructor with custom filepath.
 	/// </summary>
 	/// <param name="filePath">Specified path to file to log to.</param>
-	Logger(std::string filePath) : logFile_(std::ofstream(filePath, std::ofstream::out)) {};
+	Logger(std::string filePath) :
+		logFile_(std::ofstream(filePath, std::ofstream::out)),
+		ring_(LOG_RING_SIZE),
+		level_(static_cast<int>(LogLevel::Info)),
+		dropped_(0),
+		pending_(0),
+		running_(true)
+	{
+		writer_ = std::thread(&Logger::writeLoop, this);
+	};
+
+	// Writer thread refers to this instance
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
 
-	/// Default destructor.
-	~Logger() { logFile_.close(); };
+	/// Default destructor. Writes every queued record before closing the file.
+	~Logger()
+	{
+		running_ = false;
+		writer_.join();
+		logFile_.close();
+	};
 
 	/// <summary>
-	/// Logs message to console and file if specified.
+	/// Logs message to console and file if specified at LogLevel::Info.
 	/// </summary>
 	/// <param name="message">String message to log.</param>
 	/// <param name="toFile">Designates whether or not to log message to file.</param>
 	void logMsg(std::string message, bool toFile)
 	{
-		// Generate current time
-		auto rawTime = std::chrono::system_clock::now();
-		auto convertTime = std::chrono::system_clock::to_time_t(rawTime);
-		// Create formatted message with timestamp
-		auto formattedMsg = "HSIF>> " + message + " - time: " + std::ctime(&convertTime);
-		// Write to console
-		std::cout << formattedMsg << std::endl;
-		// Write to file if specified
-		if (toFile)
-			logFile_ << formattedMsg;
+		logMsg(LogLevel::Info, std::move(message), toFile);
+	};
+
+	/// <summary>
+	/// Queues message for the writer thread if its level is enabled. Never blocks.
+	/// </summary>
+	/// <param name="level">Message severity.</param>
+	/// <param name="message">String message to log.</param>
+	/// <param name="toFile">Designates whether or not to log message to file.</param>
+	void logMsg(LogLevel level, std::string message, bool toFile)
+	{
+		if (!enabled(level))
+			return;
+		// Timestamp is taken now, formatting it is left to the writer
+		pending_.fetch_add(1, std::memory_order_relaxed);
+		if (!ring_.tryPush({ level, toFile, std::chrono::system_clock::now(), std::move(message) }))
+		{
+			pending_.fetch_sub(1, std::memory_order_relaxed);
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+
+	/// <summary>
+	/// Determines whether messages of a level are currently logged.
+	/// </summary>
+	/// <param name="level">Message severity.</param>
+	/// <returns>True if at or above the runtime level.</returns>
+	bool enabled(LogLevel level)
+	{
+		return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Sets lowest severity logged at runtime. Levels removed at compile time stay removed.
+	/// </summary>
+	/// <param name="level">Minimum severity.</param>
+	void setLevel(LogLevel level)
+	{
+		level_.store(static_cast<int>(level), std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Returns number of messages dropped because the ring was full.
+	/// </summary>
+	/// <returns>Dropped message count.</returns>
+	uint64_t dropped()
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Blocks until every message queued so far has been written.
+	/// </summary>
+	void flush()
+	{
+		while (pending_.load(std::memory_order_acquire) > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	};
 
 private:
-	// Log file object
+	/// <summary>
+	/// Message queued by a logging thread.
+	/// </summary>
+	struct LogRecord
+	{
+		LogLevel level;
+		bool toFile;
+		std::chrono::system_clock::time_point time;
+		std::string message;
+	};
+
+	/// <summary>
+	/// Writer thread body. Drains the ring in batches, one console and one file write per batch.
+	/// </summary>
+	void writeLoop()
+	{
+		static const char* levelNames[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+		std::string consoleBatch;
+		std::string fileBatch;
+		LogRecord record;
+		while (true)
+		{
+			// Read the flag first so records pushed before shutdown are still drained
+			bool running = running_.load();
+			size_t written = 0;
+			while (ring_.pop(record))
+			{
+				char timestamp[32];
+				std::time_t convertTime = std::chrono::system_clock::to_time_t(record.time);
+				std::tm local;
+#ifdef _WIN32
+				localtime_s(&local, &convertTime);
+#else
+				localtime_r(&convertTime, &local);
+#endif
+				std::strftime(timestamp, sizeof(timestamp), "%a %b %e %H:%M:%S %Y", &local);
+				std::string formattedMsg = std::string("HSIF>> [") + levelNames[static_cast<int>(record.level)] + "] " +
+					record.message + " - time: " + timestamp + "\n";
+				consoleBatch += formattedMsg;
+				if (record.toFile)
+					fileBatch += formattedMsg;
+				written++;
+			}
+
+			if (!consoleBatch.empty())
+			{
+				std::cout.write(consoleBatch.data(), consoleBatch.size());
+				std::cout.flush();
+				consoleBatch.clear();
+			}
+			if (!fileBatch.empty())
+			{
+				logFile_.write(fileBatch.data(), fileBatch.size());
+				logFile_.flush();
+				fileBatch.clear();
+			}
+			pending_.fetch_sub(written, std::memory_order_release);
+
+			if (!running)
+				return;
+			if (written == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_INTERVAL));
+		}
+	};
+
+	// Log file object, only touched by the writer thread
 	std::ofstream logFile_;
-};
\ No newline at end of file
+	// Records waiting for the writer
+	MpscRing<LogRecord> ring_;
+	// Lowest severity logged at runtime
+	std::atomic<int> level_;
+	// Messages refused because the ring was full
+	std::atomic<uint64_t> dropped_;
+	// Messages queued but not yet written
+	std::atomic<size_t> pending_;
+	// Cleared to stop the writer once the ring is drained
+	std::atomic<bool> running_;
+	// Background writer thread
+	std::thread writer_;
+};
@@ -0,0 +1,659 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Linear sub-buckets per power of two, bounding histogram error to 1 / 2^bits (6.25%)
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+// Largest power of two resolved, larger values land in the last bucket (2^41 ns is about 36 minutes)
+#define LATENCY_MAX_EXPONENT 40
+#define LATENCY_BUCKETS ((LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+using MetricClock = std::chrono::steady_clock;
+
+/// <summary>
+/// Monotonic counter. Each counter has a single writing thread, so updates are
+/// a relaxed load and store with no locked instruction; any thread may read.
+/// </summary>
+class Counter
+{
+public:
+	Counter() : value_(0) {};
+
+	/// <summary>
+	/// Adds to the counter. Only called by the owning thread.
+	/// </summary>
+	/// <param name="amount">Amount to add.</param>
+	void add(uint64_t amount)
+	{
+		value_.store(value_.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Adds one to the counter. Only called by the owning thread.
+	/// </summary>
+	void inc()
+	{
+		add(1);
+	};
+
+	/// <summary>
+	/// Mirrors a monotonic count kept elsewhere by the owning thread.
+	/// </summary>
+	/// <param name="value">Current count.</param>
+	void set(uint64_t value)
+	{
+		value_.store(value, std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Returns the current count. Safe from any thread.
+	/// </summary>
+	/// <returns>Count.</returns>
+	uint64_t value() const
+	{
+		return value_.load(std::memory_order_relaxed);
+	};
+
+private:
+	std::atomic<uint64_t> value_;
+};
+
+/// <summary>
+/// Point-in-time level such as a queue depth. Written by one thread, read by any.
+/// </summary>
+class Gauge
+{
+public:
+	Gauge() : value_(0) {};
+
+	/// <summary>
+	/// Sets the current level. Only called by the owning thread.
+	/// </summary>
+	/// <param name="value">Current level.</param>
+	void set(uint64_t value)
+	{
+		value_.store(value, std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Returns the current level. Safe from any thread.
+	/// </summary>
+	/// <returns>Level.</returns>
+	uint64_t value() const
+	{
+		return value_.load(std::memory_order_relaxed);
+	};
+
+private:
+	std::atomic<uint64_t> value_;
+};
+
+/// <summary>
+/// Copy of a histogram's buckets taken for reporting.
+/// </summary>
+struct HistogramSnapshot
+{
+	std::string name;
+	std::string help;
+	// Values recorded in each bucket
+	std::vector<uint64_t> buckets;
+	// Number and sum of recorded values
+	uint64_t count;
+	uint64_t sum;
+	// Largest recorded value
+	uint64_t max;
+
+	/// <summary>
+	/// Returns the value below which a fraction of recorded values fall, to bucket precision.
+	/// </summary>
+	/// <param name="quantile">Fraction between 0 and 1.</param>
+	/// <returns>Upper bound of the bucket holding the quantile, 0 if empty.</returns>
+	uint64_t percentile(double quantile) const;
+
+	/// <summary>
+	/// Adds another snapshot of the same histogram, such as another shard's.
+	/// </summary>
+	/// <param name="other">Snapshot to add.</param>
+	void merge(const HistogramSnapshot& other)
+	{
+		if (buckets.size() < other.buckets.size())
+			buckets.resize(other.buckets.size(), 0);
+		for (size_t bucket = 0; bucket < other.buckets.size(); bucket++)
+			buckets[bucket] += other.buckets[bucket];
+		count += other.count;
+		sum += other.sum;
+		max = std::max(max, other.max);
+	};
+};
+
+/// <summary>
+/// HDR-style log-linear histogram of durations in nanoseconds. Each power of two
+/// is split into LATENCY_SUB_BUCKETS linear buckets, so any recorded value is
+/// reported within 6.25% using fixed memory and O(1) recording. Written by one
+/// thread without locked instructions, read by any.
+/// </summary>
+class LatencyHistogram
+{
+public:
+	LatencyHistogram() : count_(0), sum_(0), max_(0)
+	{
+		for (std::atomic<uint64_t>& bucket : buckets_)
+			bucket.store(0, std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Records a value. Only called by the owning thread.
+	/// </summary>
+	/// <param name="value">Duration in nanoseconds.</param>
+	void record(uint64_t value)
+	{
+		std::atomic<uint64_t>& bucket = buckets_[bucketIndex(value)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		if (value > max_.load(std::memory_order_relaxed))
+			max_.store(value, std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Returns number of recorded values. Safe from any thread.
+	/// </summary>
+	/// <returns>Value count.</returns>
+	uint64_t count() const
+	{
+		return count_.load(std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Copies the buckets. Safe from any thread; values recorded meanwhile may be partly included.
+	/// </summary>
+	/// <param name="snapshot">Receives bucket counts and totals.</param>
+	void snapshot(HistogramSnapshot& snapshot) const
+	{
+		snapshot.buckets.resize(LATENCY_BUCKETS);
+		snapshot.count = 0;
+		// Count is summed from the copied buckets so percentiles stay consistent
+		for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+		{
+			snapshot.buckets[bucket] = buckets_[bucket].load(std::memory_order_relaxed);
+			snapshot.count += snapshot.buckets[bucket];
+		}
+		snapshot.sum = sum_.load(std::memory_order_relaxed);
+		snapshot.max = max_.load(std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Maps a value to its bucket.
+	/// </summary>
+	/// <param name="value">Duration in nanoseconds.</param>
+	/// <returns>Bucket index below LATENCY_BUCKETS.</returns>
+	static size_t bucketIndex(uint64_t value)
+	{
+		if (value < LATENCY_SUB_BUCKETS)
+			return static_cast<size_t>(value);
+		int exponent = 63;
+		while (!(value >> exponent))
+			exponent--;
+		if (exponent > LATENCY_MAX_EXPONENT)
+			return LATENCY_BUCKETS - 1;
+		// Bucket group per power of two, then the next LATENCY_SUB_BUCKET_BITS bits below the leading one
+		size_t group = exponent - LATENCY_SUB_BUCKET_BITS + 1;
+		size_t sub = static_cast<size_t>(value >> (exponent - LATENCY_SUB_BUCKET_BITS)) - LATENCY_SUB_BUCKETS;
+		return group * LATENCY_SUB_BUCKETS + sub;
+	};
+
+	/// <summary>
+	/// Returns the largest value that maps to a bucket.
+	/// </summary>
+	/// <param name="bucket">Bucket index.</param>
+	/// <returns>Inclusive upper bound in nanoseconds.</returns>
+	static uint64_t bucketUpperBound(size_t bucket)
+	{
+		if (bucket < LATENCY_SUB_BUCKETS)
+			return bucket;
+		size_t group = bucket / LATENCY_SUB_BUCKETS;
+		uint64_t width = uint64_t(1) << (group - 1);
+		return (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) * width + width - 1;
+	};
+
+private:
+	std::atomic<uint64_t> buckets_[LATENCY_BUCKETS];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sum_;
+	std::atomic<uint64_t> max_;
+};
+
+inline uint64_t HistogramSnapshot::percentile(double quantile) const
+{
+	if (count == 0)
+		return 0;
+	uint64_t rank = static_cast<uint64_t>(quantile * count + 0.5);
+	rank = std::max<uint64_t>(rank, 1);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < buckets.size(); bucket++)
+	{
+		seen += buckets[bucket];
+		if (seen >= rank)
+			return std::min(LatencyHistogram::bucketUpperBound(bucket), max);
+	}
+	return max;
+}
+
+/// <summary>
+/// Traffic counters and outbound queue depth of one endpoint.
+/// </summary>
+struct EndpointMetrics
+{
+	Counter bytesIn;
+	Counter bytesOut;
+	Counter messagesIn;
+	Counter messagesOut;
+	Gauge queuedBytes;
+	Gauge queuedMessages;
+	// Registered identifier, guarded by the owning registry's mutex
+	std::string id;
+	// Position in the registry's endpoint list, guarded by the owning registry's mutex
+	size_t position;
+};
+
+/// <summary>
+/// Named value of a counter or gauge taken for reporting.
+/// </summary>
+struct MetricSample
+{
+	std::string name;
+	std::string help;
+	uint64_t value;
+};
+
+/// <summary>
+/// Endpoint values taken for reporting.
+/// </summary>
+struct EndpointSample
+{
+	std::string id;
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+	uint64_t messagesIn;
+	uint64_t messagesOut;
+	uint64_t queuedBytes;
+	uint64_t queuedMessages;
+};
+
+/// <summary>
+/// Every value of a registry at one point in time.
+/// </summary>
+struct MetricsSnapshot
+{
+	// Shard label, empty for a single server
+	std::string shard;
+	std::vector<MetricSample> counters;
+	std::vector<MetricSample> gauges;
+	std::vector<HistogramSnapshot> histograms;
+	// Registered endpoints only
+	std::vector<EndpointSample> endpoints;
+};
+
+/// <summary>
+/// Owns the metrics of one server. Metrics are created once at startup and
+/// updated by the server thread without locking; the mutex only guards the
+/// set of endpoints, which changes on connect, registration and disconnect.
+/// Snapshots and Prometheus text can be taken from any thread.
+/// </summary>
+class MetricsRegistry
+{
+public:
+	MetricsRegistry() = default;
+
+	// Metrics are referenced by address
+	MetricsRegistry(const MetricsRegistry&) = delete;
+	MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+	/// <summary>
+	/// Creates a counter. Call before the registry is shared with other threads.
+	/// </summary>
+	/// <param name="name">Prometheus metric name.</param>
+	/// <param name="help">One line description.</param>
+	/// <returns>Counter owned by the registry.</returns>
+	Counter* counter(std::string name, std::string help)
+	{
+		counters_.push_back({ std::move(name), std::move(help), std::make_unique<Counter>() });
+		return counters_.back().metric.get();
+	};
+
+	/// <summary>
+	/// Creates a gauge. Call before the registry is shared with other threads.
+	/// </summary>
+	/// <param name="name">Prometheus metric name.</param>
+	/// <param name="help">One line description.</param>
+	/// <returns>Gauge owned by the registry.</returns>
+	Gauge* gauge(std::string name, std::string help)
+	{
+		gauges_.push_back({ std::move(name), std::move(help), std::make_unique<Gauge>() });
+		return gauges_.back().metric.get();
+	};
+
+	/// <summary>
+	/// Creates a latency histogram. Call before the registry is shared with other threads.
+	/// </summary>
+	/// <param name="name">Prometheus metric name, reported in seconds.</param>
+	/// <param name="help">One line description.</param>
+	/// <returns>Histogram owned by the registry.</returns>
+	LatencyHistogram* histogram(std::string name, std::string help)
+	{
+		histograms_.push_back({ std::move(name), std::move(help), std::make_unique<LatencyHistogram>() });
+		return histograms_.back().metric.get();
+	};
+
+	/// <summary>
+	/// Sets the shard label attached to every exported value.
+	/// </summary>
+	/// <param name="shard">Shard label.</param>
+	void setShard(std::string shard)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		shard_ = std::move(shard);
+	};
+
+	/// <summary>
+	/// Creates metrics for a new endpoint.
+	/// </summary>
+	/// <returns>Endpoint metrics, reported once the endpoint is named.</returns>
+	std::shared_ptr<EndpointMetrics> addEndpoint()
+	{
+		auto endpoint = std::make_shared<EndpointMetrics>();
+		std::lock_guard<std::mutex> lock(mutex_);
+		endpoint->position = endpoints_.size();
+		endpoints_.push_back(endpoint);
+		return endpoint;
+	};
+
+	/// <summary>
+	/// Names an endpoint after it registers.
+	/// </summary>
+	/// <param name="endpoint">Endpoint metrics.</param>
+	/// <param name="id">Registered identifier.</param>
+	void nameEndpoint(const std::shared_ptr<EndpointMetrics>& endpoint, std::string id)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		endpoint->id = std::move(id);
+	};
+
+	/// <summary>
+	/// Stops reporting an endpoint, folding its traffic into the registry totals.
+	/// </summary>
+	/// <param name="endpoint">Endpoint metrics.</param>
+	void removeEndpoint(const std::shared_ptr<EndpointMetrics>& endpoint)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		size_t position = endpoint->position;
+		if (position >= endpoints_.size() || endpoints_[position] != endpoint)
+			return;
+		retired_.bytesIn += endpoint->bytesIn.value();
+		retired_.bytesOut += endpoint->bytesOut.value();
+		retired_.messagesIn += endpoint->messagesIn.value();
+		retired_.messagesOut += endpoint->messagesOut.value();
+
+		// Move last endpoint into the hole
+		endpoints_[position] = std::move(endpoints_.back());
+		endpoints_[position]->position = position;
+		endpoints_.pop_back();
+	};
+
+	/// <summary>
+	/// Takes a copy of every value. Safe from any thread.
+	/// </summary>
+	/// <returns>Snapshot with traffic totals of current and removed endpoints.</returns>
+	MetricsSnapshot snapshot()
+	{
+		MetricsSnapshot snapshot;
+		for (const Named<Counter>& counter : counters_)
+			snapshot.counters.push_back({ counter.name, counter.help, counter.metric->value() });
+		for (const Named<Gauge>& gauge : gauges_)
+			snapshot.gauges.push_back({ gauge.name, gauge.help, gauge.metric->value() });
+		for (const Named<LatencyHistogram>& histogram : histograms_)
+		{
+			snapshot.histograms.push_back({ histogram.name, histogram.help, {}, 0, 0, 0 });
+			histogram.metric->snapshot(snapshot.histograms.back());
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		snapshot.shard = shard_;
+		EndpointSample totals = retired_;
+		for (const std::shared_ptr<EndpointMetrics>& endpoint : endpoints_)
+		{
+			EndpointSample sample = { endpoint->id, endpoint->bytesIn.value(), endpoint->bytesOut.value(),
+				endpoint->messagesIn.value(), endpoint->messagesOut.value(), endpoint->queuedBytes.value(), endpoint->queuedMessages.value() };
+			totals.bytesIn += sample.bytesIn;
+			totals.bytesOut += sample.bytesOut;
+			totals.messagesIn += sample.messagesIn;
+			totals.messagesOut += sample.messagesOut;
+			totals.queuedBytes += sample.queuedBytes;
+			totals.queuedMessages += sample.queuedMessages;
+			// Connections that never registered count towards totals only
+			if (!sample.id.empty())
+				snapshot.endpoints.push_back(std::move(sample));
+		}
+		snapshot.counters.push_back({ "hsif_bytes_received_total", "Bytes read from endpoint sockets.", totals.bytesIn });
+		snapshot.counters.push_back({ "hsif_bytes_sent_total", "Bytes written to endpoint sockets.", totals.bytesOut });
+		snapshot.counters.push_back({ "hsif_messages_received_total", "Frames received from endpoints.", totals.messagesIn });
+		snapshot.counters.push_back({ "hsif_messages_sent_total", "Frames fully written to endpoints.", totals.messagesOut });
+		snapshot.gauges.push_back({ "hsif_queued_bytes", "Outbound bytes waiting to be written.", totals.queuedBytes });
+		snapshot.gauges.push_back({ "hsif_queued_messages", "Outbound frames waiting to be written.", totals.queuedMessages });
+		return snapshot;
+	};
+
+	/// <summary>
+	/// Returns a timestamp for latency measurements.
+	/// </summary>
+	/// <returns>Nanoseconds on the steady clock, never 0.</returns>
+	static uint64_t now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(MetricClock::now().time_since_epoch()).count()) | 1;
+	};
+
+	/// <summary>
+	/// Adds snapshots of several registries together, such as every shard of a group.
+	/// </summary>
+	/// <param name="snapshots">Snapshots of registries with the same metrics.</param>
+	/// <returns>Summed values and every registered endpoint.</returns>
+	static MetricsSnapshot merge(const std::vector<MetricsSnapshot>& snapshots)
+	{
+		MetricsSnapshot merged;
+		for (const MetricsSnapshot& snapshot : snapshots)
+		{
+			if (merged.counters.empty() && merged.gauges.empty() && merged.histograms.empty())
+			{
+				merged.counters = snapshot.counters;
+				merged.gauges = snapshot.gauges;
+				merged.histograms = snapshot.histograms;
+			}
+			else
+			{
+				for (size_t index = 0; index < snapshot.counters.size() && index < merged.counters.size(); index++)
+					merged.counters[index].value += snapshot.counters[index].value;
+				for (size_t index = 0; index < snapshot.gauges.size() && index < merged.gauges.size(); index++)
+					merged.gauges[index].value += snapshot.gauges[index].value;
+				for (size_t index = 0; index < snapshot.histograms.size() && index < merged.histograms.size(); index++)
+					merged.histograms[index].merge(snapshot.histograms[index]);
+			}
+			merged.endpoints.insert(merged.endpoints.end(), snapshot.endpoints.begin(), snapshot.endpoints.end());
+		}
+		return merged;
+	};
+
+	/// <summary>
+	/// Formats snapshots in the Prometheus text exposition format. Each snapshot's
+	/// shard label is attached to its values; histograms are exported as summaries.
+	/// </summary>
+	/// <param name="snapshots">Snapshots of registries with the same metrics.</param>
+	/// <returns>Exposition text.</returns>
+	static std::string toPrometheus(const std::vector<MetricsSnapshot>& snapshots)
+	{
+		static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+		std::string text;
+		if (snapshots.empty())
+			return text;
+		const MetricsSnapshot& first = snapshots.front();
+
+		for (size_t index = 0; index < first.counters.size(); index++)
+		{
+			writeFamily(text, first.counters[index], "counter");
+			for (const MetricsSnapshot& snapshot : snapshots)
+				writeValue(text, first.counters[index].name, labels(snapshot, ""), std::to_string(snapshot.counters[index].value));
+		}
+		for (size_t index = 0; index < first.gauges.size(); index++)
+		{
+			writeFamily(text, first.gauges[index], "gauge");
+			for (const MetricsSnapshot& snapshot : snapshots)
+				writeValue(text, first.gauges[index].name, labels(snapshot, ""), std::to_string(snapshot.gauges[index].value));
+		}
+		for (size_t index = 0; index < first.histograms.size(); index++)
+		{
+			const std::string& name = first.histograms[index].name;
+			writeFamily(text, { name, first.histograms[index].help, 0 }, "summary");
+			for (const MetricsSnapshot& snapshot : snapshots)
+			{
+				const HistogramSnapshot& histogram = snapshot.histograms[index];
+				for (double quantile : quantiles)
+				{
+					char extra[32];
+					std::snprintf(extra, sizeof(extra), "quantile=\"%g\"", quantile);
+					writeValue(text, name, labels(snapshot, extra), seconds(histogram.percentile(quantile)));
+				}
+				writeValue(text, name + "_sum", labels(snapshot, ""), seconds(histogram.sum));
+				writeValue(text, name + "_count", labels(snapshot, ""), std::to_string(histogram.count));
+			}
+		}
+
+		// Per-endpoint families, labelled with the endpoint identifier
+		struct EndpointFamily
+		{
+			const char* name;
+			const char* help;
+			const char* type;
+			uint64_t EndpointSample::* field;
+		};
+		static const EndpointFamily families[] = {
+			{ "hsif_endpoint_bytes_received_total", "Bytes read from an endpoint.", "counter", &EndpointSample::bytesIn },
+			{ "hsif_endpoint_bytes_sent_total", "Bytes written to an endpoint.", "counter", &EndpointSample::bytesOut },
+			{ "hsif_endpoint_messages_received_total", "Frames received from an endpoint.", "counter", &EndpointSample::messagesIn },
+			{ "hsif_endpoint_messages_sent_total", "Frames fully written to an endpoint.", "counter", &EndpointSample::messagesOut },
+			{ "hsif_endpoint_queued_bytes", "Outbound bytes waiting for an endpoint.", "gauge", &EndpointSample::queuedBytes },
+			{ "hsif_endpoint_queued_messages", "Outbound frames waiting for an endpoint.", "gauge", &EndpointSample::queuedMessages }
+		};
+		for (const EndpointFamily& family : families)
+		{
+			writeFamily(text, { family.name, family.help, 0 }, family.type);
+			for (const MetricsSnapshot& snapshot : snapshots)
+			{
+				for (const EndpointSample& endpoint : snapshot.endpoints)
+					writeValue(text, family.name, labels(snapshot, "endpoint=\"" + escapeLabel(endpoint.id) + "\""), std::to_string(endpoint.*family.field));
+			}
+		}
+		return text;
+	};
+
+private:
+	/// <summary>
+	/// Metric with its exported name and description.
+	/// </summary>
+	template <typename T>
+	struct Named
+	{
+		std::string name;
+		std::string help;
+		std::unique_ptr<T> metric;
+	};
+
+	// Writes HELP and TYPE lines of a metric family
+	static void writeFamily(std::string& text, const MetricSample& family, const char* type)
+	{
+		text += "# HELP " + family.name + " " + family.help + "\n";
+		text += "# TYPE " + family.name + " " + type + "\n";
+	};
+
+	// Writes one sample line
+	static void writeValue(std::string& text, const std::string& name, const std::string& labels, const std::string& value)
+	{
+		text += name;
+		if (!labels.empty())
+			text += "{" + labels + "}";
+		text += " " + value + "\n";
+	};
+
+	// Builds the label set of a sample from its shard and any extra labels
+	static std::string labels(const MetricsSnapshot& snapshot, const std::string& extra)
+	{
+		std::string labels;
+		if (!snapshot.shard.empty())
+			labels = "shard=\"" + escapeLabel(snapshot.shard) + "\"";
+		if (!extra.empty())
+			labels += (labels.empty() ? "" : ",") + extra;
+		return labels;
+	};
+
+	// Escapes backslash, quote and newline in a label value
+	static std::string escapeLabel(const std::string& value)
+	{
+		std::string escaped;
+		for (char character : value)
+		{
+			if (character == '\\' || character == '"')
+				escaped += '\\';
+			if (character == '\n')
+			{
+				escaped += "\\n";
+				continue;
+			}
+			escaped += character;
+		}
+		return escaped;
+	};
+
+	// Formats nanoseconds as seconds
+	static std::string seconds(uint64_t nanoseconds)
+	{
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%.9f", nanoseconds / 1e9);
+		return buffer;
+	};
+
+	// Metrics created at startup, never removed
+	std::vector<Named<Counter>> counters_;
+	std::vector<Named<Gauge>> gauges_;
+	std::vector<Named<LatencyHistogram>> histograms_;
+	// Guards the endpoint list, endpoint names, removed totals and shard label
+	std::mutex mutex_;
+	// Connected endpoints
+	std::vector<std::shared_ptr<EndpointMetrics>> endpoints_;
+	// Traffic of removed endpoints
+	EndpointSample retired_ = { "", 0, 0, 0, 0, 0, 0 };
+	// Shard label
+	std::string shard_;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Unbounded lock-free multi-producer single-consumer queue. Producers never
+/// block each other beyond a single atomic exchange; only one thread may pop.
+/// </summary>
+template <typename T>
+class MpscQueue
+{
+public:
+	/// <summary>
+	/// Initializes queue with an empty stub node.
+	/// </summary>
+	MpscQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed)) {};
+
+	/// <summary>
+	/// Releases any values still queued.
+	/// </summary>
+	~MpscQueue()
+	{
+		T discard;
+		while (pop(discard));
+		delete tail_;
+	};
+
+	// Nodes are owned by the queue
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	/// <summary>
+	/// Appends a value. Safe to call from any thread.
+	/// </summary>
+	/// <param name="value">Value to enqueue.</param>
+	void push(T value)
+	{
+		Node* node = new Node();
+		node->value = std::move(value);
+		// Claim the head position, then link the previous head to the new node
+		Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	};
+
+	/// <summary>
+	/// Removes the oldest value. Must only be called from the consumer thread.
+	/// </summary>
+	/// <param name="value">Receives the dequeued value.</param>
+	/// <returns>False if the queue is empty (or a push is still being linked).</returns>
+	bool pop(T& value)
+	{
+		Node* tail = tail_;
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+			return false;
+		value = std::move(next->value);
+		tail_ = next;
+		delete tail;
+		return true;
+	};
+
+	/// <summary>
+	/// Determines whether the queue currently has values. Consumer thread only.
+	/// </summary>
+	/// <returns>True if no values are linked.</returns>
+	bool empty()
+	{
+		return tail_->next.load(std::memory_order_acquire) == nullptr;
+	};
+
+private:
+	// Singly linked queue node
+	struct Node
+	{
+		std::atomic<Node*> next{ nullptr };
+		T value;
+	};
+	// Most recently pushed node (producers)
+	std::atomic<Node*> head_;
+	// Stub node preceding the oldest value (consumer)
+	Node* tail_;
+};
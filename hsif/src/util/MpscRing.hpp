@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Bounded lock-free multi-producer single-consumer ring. Each cell carries a
+/// sequence number telling producers and the consumer whose turn it is, so a
+/// push is one compare-exchange on the shared position and never allocates.
+/// A full ring refuses new values instead of blocking.
+/// </summary>
+template <typename T>
+class MpscRing
+{
+public:
+	/// <summary>
+	/// Initializes ring with capacity rounded up to a power of two.
+	/// </summary>
+	/// <param name="capacity">Minimum number of values held.</param>
+	MpscRing(size_t capacity) : pushPos_(0), popPos_(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		mask_ = size - 1;
+		cells_ = std::make_unique<Cell[]>(size);
+		for (size_t index = 0; index < size; index++)
+			cells_[index].sequence.store(index, std::memory_order_relaxed);
+	};
+
+	// Cells are owned by the ring
+	MpscRing(const MpscRing&) = delete;
+	MpscRing& operator=(const MpscRing&) = delete;
+
+	/// <summary>
+	/// Appends a value if there is room. Safe to call from any thread.
+	/// </summary>
+	/// <param name="value">Value to enqueue.</param>
+	/// <returns>False if the ring is full.</returns>
+	bool tryPush(T value)
+	{
+		size_t position = pushPos_.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell& cell = cells_[position & mask_];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t turn = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			// Cell free for this position, claim it
+			if (turn == 0)
+			{
+				if (pushPos_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					cell.value = std::move(value);
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			// Cell still holds the value from one lap ago
+			else if (turn < 0)
+				return false;
+			// Another producer claimed this position first
+			else
+				position = pushPos_.load(std::memory_order_relaxed);
+		}
+	};
+
+	/// <summary>
+	/// Removes the oldest value. Must only be called from the consumer thread.
+	/// </summary>
+	/// <param name="value">Receives the dequeued value.</param>
+	/// <returns>False if the ring is empty (or a push is still being written).</returns>
+	bool pop(T& value)
+	{
+		Cell& cell = cells_[popPos_ & mask_];
+		if (cell.sequence.load(std::memory_order_acquire) != popPos_ + 1)
+			return false;
+		value = std::move(cell.value);
+		// Hand the cell to the producer one lap ahead
+		cell.sequence.store(popPos_ + mask_ + 1, std::memory_order_release);
+		popPos_++;
+		return true;
+	};
+
+	/// <summary>
+	/// Returns number of values the ring holds when full.
+	/// </summary>
+	/// <returns>Capacity.</returns>
+	size_t capacity() const
+	{
+		return mask_ + 1;
+	};
+
+private:
+	// Value slot and the position it is ready for
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	// Power of two cell storage
+	std::unique_ptr<Cell[]> cells_;
+	// Capacity minus one, positions are masked into cell indexes
+	size_t mask_;
+	// Next position to push (producers), kept off the consumer's cache line
+	alignas(64) std::atomic<size_t> pushPos_;
+	// Next position to pop (consumer)
+	alignas(64) size_t popPos_;
+};
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+// Smallest block handed out, blocks are powers of two from here up
+#define SLAB_MIN_BLOCK 64
+// Number of block size classes, so the largest block is SLAB_MIN_BLOCK << (SLAB_CLASSES - 1) bytes
+#define SLAB_CLASSES 11
+// Largest block handed out, larger requests go straight to the heap
+#define SLAB_MAX_BLOCK (SLAB_MIN_BLOCK << (SLAB_CLASSES - 1))
+// Bytes obtained from the system at a time, the size of an x86-64 huge page
+#define SLAB_SIZE (2 * 1024 * 1024)
+// Blocks moved between a thread's free list and the shared free list at a time
+#define SLAB_BATCH 32
+
+/// <summary>
+/// Memory held by the slab pool, shared by every thread.
+/// </summary>
+struct SlabStats
+{
+	// Slabs obtained from the system and their total bytes
+	uint64_t slabs;
+	uint64_t slabBytes;
+	// Slabs backed by huge pages
+	uint64_t hugeSlabs;
+	// Blocks carved from slabs, each reused for good once freed
+	uint64_t blocksCarved;
+	// Freed blocks parked on the shared free lists, waiting for any thread to reuse them
+	uint64_t blocksShared;
+	// Requests larger than SLAB_MAX_BLOCK passed to the heap
+	uint64_t oversized;
+};
+
+/// <summary>
+/// Process-wide size-class allocator for the broker's per-message and
+/// per-connection objects. Blocks are carved from SLAB_SIZE slabs, optionally
+/// backed by huge pages, and never returned to the system; a freed block goes
+/// onto its size class's free list for the calling thread, so each reactor
+/// thread allocates and frees without locks once warm. A thread's free list
+/// spills SLAB_BATCH blocks at a time to a shared list when it grows long and
+/// refills from it when empty, so blocks freed by another reactor still find
+/// their way back.
+/// </summary>
+class SlabPool
+{
+public:
+	// Pool is process-wide, see shared()
+	SlabPool(const SlabPool&) = delete;
+	SlabPool& operator=(const SlabPool&) = delete;
+
+	/// <summary>
+	/// Returns the pool shared by the process. It is never destroyed, so blocks
+	/// may be freed during static destruction.
+	/// </summary>
+	/// <returns>Process-wide pool.</returns>
+	static SlabPool& shared()
+	{
+		static SlabPool* pool = new SlabPool();
+		return *pool;
+	};
+
+	/// <summary>
+	/// Returns a block of at least size bytes, aligned at least as the heap aligns.
+	/// </summary>
+	/// <param name="size">Bytes needed.</param>
+	/// <returns>Block, freed with deallocate() and the same size.</returns>
+	void* allocate(size_t size)
+	{
+		if (size > SLAB_MAX_BLOCK)
+		{
+			oversized_.fetch_add(1, std::memory_order_relaxed);
+			return ::operator new(size);
+		}
+		size_t sizeClass = classOf(size);
+		ThreadCache* cache = threadCache();
+		if (!cache)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			FreeList list = {};
+			refill(sizeClass, list);
+			return pop(list);
+		}
+		FreeList& list = cache->lists[sizeClass];
+		if (!list.head)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			refill(sizeClass, list);
+		}
+		return pop(list);
+	};
+
+	/// <summary>
+	/// Returns a block to the calling thread's free list.
+	/// </summary>
+	/// <param name="block">Block from allocate().</param>
+	/// <param name="size">Size the block was allocated with.</param>
+	void deallocate(void* block, size_t size)
+	{
+		if (size > SLAB_MAX_BLOCK)
+		{
+			::operator delete(block);
+			return;
+		}
+		size_t sizeClass = classOf(size);
+		ThreadCache* cache = threadCache();
+		if (!cache)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			push(shared_[sizeClass], block);
+			return;
+		}
+		FreeList& list = cache->lists[sizeClass];
+		push(list, block);
+		if (list.count > 2 * SLAB_BATCH)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t moved = 0; moved < SLAB_BATCH; moved++)
+				push(shared_[sizeClass], pop(list));
+		}
+	};
+
+	/// <summary>
+	/// Backs slabs obtained from now on with huge pages, falling back to
+	/// transparent huge pages and then to normal pages. Only functional on Linux.
+	/// </summary>
+	/// <param name="enabled">Whether to ask for huge pages.</param>
+	void setHugePages(bool enabled)
+	{
+		hugePages_.store(enabled, std::memory_order_relaxed);
+	};
+
+	/// <summary>
+	/// Returns memory held by the pool.
+	/// </summary>
+	/// <returns>Pool statistics.</returns>
+	SlabStats stats()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		SlabStats stats = stats_;
+		for (const FreeList& list : shared_)
+			stats.blocksShared += list.count;
+		stats.oversized = oversized_.load(std::memory_order_relaxed);
+		return stats;
+	};
+
+private:
+	// Intrusive singly linked list of free blocks, each block's first bytes point to the next
+	struct FreeList
+	{
+		void* head;
+		size_t count;
+	};
+
+	// Free lists of one thread, handed to the shared lists when the thread exits
+	struct ThreadCache
+	{
+		FreeList lists[SLAB_CLASSES] = {};
+
+		~ThreadCache()
+		{
+			SlabPool& pool = SlabPool::shared();
+			std::lock_guard<std::mutex> lock(pool.mutex_);
+			for (size_t sizeClass = 0; sizeClass < SLAB_CLASSES; sizeClass++)
+			{
+				while (lists[sizeClass].head)
+					push(pool.shared_[sizeClass], pop(lists[sizeClass]));
+			}
+			cacheClosed_ = true;
+		}
+	};
+
+	SlabPool() : stats_({}), hugePages_(false), slab_(nullptr), slabLeft_(0), oversized_(0)
+	{
+		for (FreeList& list : shared_)
+			list = {};
+	};
+
+	/// <summary>
+	/// Returns the calling thread's free lists, null once they were torn down at thread exit.
+	/// </summary>
+	/// <returns>Thread's free lists or null.</returns>
+	static ThreadCache* threadCache()
+	{
+		if (cacheClosed_)
+			return nullptr;
+		static thread_local ThreadCache cache;
+		return &cache;
+	};
+
+	/// <summary>
+	/// Returns the size class serving a request.
+	/// </summary>
+	/// <param name="size">Bytes needed, at most SLAB_MAX_BLOCK.</param>
+	/// <returns>Index of the smallest class holding size bytes.</returns>
+	static size_t classOf(size_t size)
+	{
+		size_t sizeClass = 0;
+		while ((static_cast<size_t>(SLAB_MIN_BLOCK) << sizeClass) < size)
+			sizeClass++;
+		return sizeClass;
+	};
+
+	// Puts a block at the head of a list
+	static void push(FreeList& list, void* block)
+	{
+		*static_cast<void**>(block) = list.head;
+		list.head = block;
+		list.count++;
+	};
+
+	// Takes the block at the head of a non-empty list
+	static void* pop(FreeList& list)
+	{
+		void* block = list.head;
+		list.head = *static_cast<void**>(block);
+		list.count--;
+		return block;
+	};
+
+	/// <summary>
+	/// Moves a batch of free blocks of a class onto a list, taking them from the
+	/// shared list or carving them from the current slab. Called with mutex_ held.
+	/// </summary>
+	/// <param name="sizeClass">Size class to refill.</param>
+	/// <param name="list">Empty list receiving the blocks.</param>
+	void refill(size_t sizeClass, FreeList& list)
+	{
+		FreeList& shared = shared_[sizeClass];
+		while (shared.head && list.count < SLAB_BATCH)
+			push(list, pop(shared));
+		if (list.head)
+			return;
+
+		// Carve up to 64 KiB of blocks at once, but at least one
+		size_t blockSize = static_cast<size_t>(SLAB_MIN_BLOCK) << sizeClass;
+		size_t blocks = std::max<size_t>(1, std::min<size_t>(SLAB_BATCH, SLAB_MAX_BLOCK / blockSize));
+		if (slabLeft_ < blockSize * blocks)
+			newSlab();
+		blocks = std::min(blocks, slabLeft_ / blockSize);
+		for (size_t block = 0; block < blocks; block++)
+		{
+			push(list, slab_);
+			slab_ += blockSize;
+			slabLeft_ -= blockSize;
+		}
+		stats_.blocksCarved += blocks;
+	};
+
+	/// <summary>
+	/// Replaces the current slab with a fresh one, abandoning what is left of the old.
+	/// Called with mutex_ held. Throws std::bad_alloc if the system is out of memory.
+	/// </summary>
+	void newSlab()
+	{
+		void* slab = nullptr;
+		bool huge = false;
+#ifdef __linux__
+		bool hugePages = hugePages_.load(std::memory_order_relaxed);
+		if (hugePages)
+		{
+			slab = mmap(nullptr, SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			huge = slab != MAP_FAILED;
+		}
+		if (!huge)
+		{
+			// Map twice the size and trim to a SLAB_SIZE boundary, so the slab can become one transparent huge page
+			char* mapped = static_cast<char*>(mmap(nullptr, 2 * SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+			if (mapped == MAP_FAILED)
+				throw std::bad_alloc();
+			char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(mapped) + SLAB_SIZE - 1) & ~static_cast<uintptr_t>(SLAB_SIZE - 1));
+			if (aligned != mapped)
+				munmap(mapped, aligned - mapped);
+			munmap(aligned + SLAB_SIZE, mapped + SLAB_SIZE - aligned);
+			if (hugePages)
+				madvise(aligned, SLAB_SIZE, MADV_HUGEPAGE);
+			slab = aligned;
+		}
+#else
+		slab = std::malloc(SLAB_SIZE);
+		if (!slab)
+			throw std::bad_alloc();
+#endif
+		slab_ = static_cast<char*>(slab);
+		slabLeft_ = SLAB_SIZE;
+		stats_.slabs++;
+		stats_.slabBytes += SLAB_SIZE;
+		if (huge)
+			stats_.hugeSlabs++;
+	};
+
+	// Set once the calling thread's free lists are torn down, so later frees go to the shared lists
+	static inline thread_local bool cacheClosed_ = false;
+
+	// Guards the shared free lists, the current slab and stats_
+	std::mutex mutex_;
+	// Blocks spilled by threads or left behind by exited threads, per size class
+	FreeList shared_[SLAB_CLASSES];
+	// Slab and block counters
+	SlabStats stats_;
+	// Whether new slabs ask for huge pages
+	std::atomic<bool> hugePages_;
+	// Uncarved remainder of the current slab
+	char* slab_;
+	size_t slabLeft_;
+	// Requests passed to the heap, counted without the lock
+	std::atomic<uint64_t> oversized_;
+};
+
+/// <summary>
+/// Standard allocator drawing from the process-wide SlabPool, for containers
+/// and shared objects on the routing path.
+/// </summary>
+template <typename T>
+struct PoolAllocator
+{
+	using value_type = T;
+
+	PoolAllocator() = default;
+
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U>&) {};
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(SlabPool::shared().allocate(count * sizeof(T)));
+	};
+
+	void deallocate(T* memory, size_t count)
+	{
+		SlabPool::shared().deallocate(memory, count * sizeof(T));
+	};
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{
+	return false;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+Copyright 2020 Itreau Bigsby
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+@author   Itreau Bigsby    mailto:ibigsby@asu.edu
+ */
+
+/// <summary>
+/// Stable reference to a SlotMap element. A handle outlives its element
+/// safely: once the element is erased the slot's generation moves on, and
+/// lookups with the old handle fail instead of reaching a newer element.
+/// </summary>
+struct SlotHandle
+{
+	// Slot index, stable for the element's lifetime
+	uint32_t slot;
+	// Generation of the slot when the element was inserted
+	uint32_t generation;
+
+	bool operator==(const SlotHandle& other) const { return slot == other.slot && generation == other.generation; };
+	bool operator!=(const SlotHandle& other) const { return !(*this == other); };
+};
+
+// Handle that never refers to an element
+#define INVALID_SLOT_HANDLE SlotHandle{ UINT32_MAX, 0 }
+
+/// <summary>
+/// Container with O(1) insert, erase and lookup through generational handles,
+/// and dense storage for iteration. Erasing moves the last element into the
+/// hole, so positions change but handles never do.
+/// </summary>
+template <typename T>
+class SlotMap
+{
+public:
+	SlotMap() : freeHead_(UINT32_MAX) {};
+
+	/// <summary>
+	/// Stores a value, reusing a free slot when there is one.
+	/// </summary>
+	/// <param name="value">Value to store.</param>
+	/// <returns>Handle to the stored value.</returns>
+	SlotHandle insert(T value)
+	{
+		uint32_t slot;
+		if (freeHead_ != UINT32_MAX)
+		{
+			slot = freeHead_;
+			freeHead_ = slots_[slot].position;
+		}
+		else
+		{
+			slot = static_cast<uint32_t>(slots_.size());
+			slots_.push_back({ 0, 0 });
+		}
+		slots_[slot].position = static_cast<uint32_t>(values_.size());
+		values_.push_back(std::move(value));
+		owners_.push_back(slot);
+		return { slot, slots_[slot].generation };
+	};
+
+	/// <summary>
+	/// Removes the value a handle refers to.
+	/// </summary>
+	/// <param name="handle">Handle returned by insert.</param>
+	/// <returns>False if the handle is stale.</returns>
+	bool erase(SlotHandle handle)
+	{
+		if (!contains(handle))
+			return false;
+		uint32_t position = slots_[handle.slot].position;
+
+		// Move last value into the hole
+		uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+		if (position != last)
+		{
+			values_[position] = std::move(values_[last]);
+			owners_[position] = owners_[last];
+			slots_[owners_[position]].position = position;
+		}
+		values_.pop_back();
+		owners_.pop_back();
+
+		// Invalidate outstanding handles and chain slot onto free list
+		slots_[handle.slot].generation++;
+		slots_[handle.slot].position = freeHead_;
+		freeHead_ = handle.slot;
+		return true;
+	};
+
+	/// <summary>
+	/// Determines whether a handle still refers to a stored value.
+	/// </summary>
+	/// <param name="handle">Handle to check.</param>
+	/// <returns>True if live.</returns>
+	bool contains(SlotHandle handle) const
+	{
+		return handle.slot < slots_.size() && slots_[handle.slot].generation == handle.generation &&
+			slots_[handle.slot].position < owners_.size() && owners_[slots_[handle.slot].position] == handle.slot;
+	};
+
+	/// <summary>
+	/// Looks up the value a handle refers to.
+	/// </summary>
+	/// <param name="handle">Handle returned by insert.</param>
+	/// <returns>Pointer to value, or null if the handle is stale.</returns>
+	T* get(SlotHandle handle)
+	{
+		return contains(handle) ? &values_[slots_[handle.slot].position] : nullptr;
+	};
+
+	/// <summary>
+	/// Returns the value at a dense position.
+	/// </summary>
+	/// <param name="position">Position below size().</param>
+	/// <returns>Reference to value.</returns>
+	T& at(size_t position)
+	{
+		return values_[position];
+	};
+
+	/// <summary>
+	/// Returns the handle of the value at a dense position.
+	/// </summary>
+	/// <param name="position">Position below size().</param>
+	/// <returns>Handle of value.</returns>
+	SlotHandle handleAt(size_t position) const
+	{
+		uint32_t slot = owners_[position];
+		return { slot, slots_[slot].generation };
+	};
+
+	/// <summary>
+	/// Returns number of stored values.
+	/// </summary>
+	/// <returns>Value count.</returns>
+	size_t size() const
+	{
+		return values_.size();
+	};
+
+	// Dense iteration over stored values
+	typename std::vector<T>::iterator begin() { return values_.begin(); };
+	typename std::vector<T>::iterator end() { return values_.end(); };
+
+private:
+	/// <summary>
+	/// Indirection from handle to dense position.
+	/// </summary>
+	struct Slot
+	{
+		// Dense position while occupied, next free slot while free
+		uint32_t position;
+		// Incremented each time the slot is freed
+		uint32_t generation;
+	};
+
+	// Slots indexed by handle
+	std::vector<Slot> slots_;
+	// Values in dense order
+	std::vector<T> values_;
+	// Slot owning each dense position
+	std::vector<uint32_t> owners_;
+	// First free slot, UINT32_MAX if none
+	uint32_t freeHead_;
+};
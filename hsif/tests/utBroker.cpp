@@ -0,0 +1,186 @@
+#include "Broker.hpp"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+
+#ifdef __linux__
+
+// Testing function for a message from one endpoint to another
+std::string testMessage(const std::string& from, const std::string& to, int value)
+{
+	json msg = { { "type", "message" }, { "from", from }, { "to", to }, { "data", { { "value", value } } } };
+	return msg.dump();
+}
+
+// Testing function for a broker listening on the given port
+BrokerConfig testBrokerConfig(unsigned int port)
+{
+	BrokerConfig config = DEFAULT_BROKER_CONFIG;
+	config.ip = "127.0.0.1";
+	config.port = port;
+	return config;
+}
+
+// Test start returns while the broker polls in the background, and stop ends it
+TEST(TestBroker, TestStartStop)
+{
+	Broker broker(testBrokerConfig(7790));
+	ASSERT_FALSE(broker.running());
+	ASSERT_TRUE(broker.connect("early") == nullptr);
+	ASSERT_TRUE(broker.start());
+	ASSERT_TRUE(broker.running());
+
+	auto client = broker.connect("client");
+	ASSERT_TRUE(client != nullptr);
+	broker.stop();
+	ASSERT_FALSE(broker.running());
+	// Stopping closes in-process clients, so a receive returns at once
+	Payload msg;
+	ASSERT_TRUE(client->closed());
+	ASSERT_FALSE(client->receive(msg, -1));
+	ASSERT_FALSE(client->send(testMessage("client", "client", 1)));
+	ASSERT_TRUE(broker.connect("late") == nullptr);
+	// A stopped broker is replaced rather than restarted
+	ASSERT_FALSE(broker.start());
+}
+
+// Test in-process clients exchange messages, including one sent before the receiver registered
+TEST(TestBroker, TestLocalMessage)
+{
+	Broker broker(testBrokerConfig(7796));
+	ASSERT_TRUE(broker.start());
+	auto sender = broker.connect("sender");
+	ASSERT_TRUE(sender->send(testMessage("sender", "receiver", 1)));
+	auto receiver = broker.connect("receiver");
+	ASSERT_TRUE(receiver->send(testMessage("receiver", "sender", 2)));
+
+	Payload msg;
+	ASSERT_TRUE(receiver->receive(msg, 5000));
+	ASSERT_EQ(json::parse(*msg)["data"]["value"], 1);
+	ASSERT_TRUE(sender->receive(msg, 5000));
+	ASSERT_EQ(json::parse(*msg)["from"], "receiver");
+	ASSERT_FALSE(sender->tryReceive(msg));
+
+	// A closed client's identifier is free again
+	receiver->close();
+	receiver.reset();
+	auto replacement = broker.connect("receiver");
+	ASSERT_TRUE(sender->send(testMessage("sender", "receiver", 3)));
+	ASSERT_TRUE(replacement->receive(msg, 5000));
+	ASSERT_EQ(json::parse(*msg)["data"]["value"], 3);
+	broker.stop();
+}
+
+// Test routing on headers hands the sender's payload to the receiver without copying it
+TEST(TestBroker, TestZeroCopy)
+{
+	Broker broker(testBrokerConfig(7797));
+	ASSERT_TRUE(broker.start());
+	auto sender = broker.connect("sender");
+	auto receiver = broker.connect("receiver");
+	// Wait for the receiver to register, so the message is not parked
+	ASSERT_TRUE(receiver->send(testMessage("receiver", "sender", 0)));
+	Payload msg;
+	ASSERT_TRUE(sender->receive(msg, 5000));
+
+	for (int index = 0; index < 3 * LOCAL_RING_CAPACITY; index++)
+	{
+		Payload sent = framing::makePayload(testMessage("sender", "receiver", index));
+		ASSERT_TRUE(sender->send(sent, WireFormat::Text));
+		ASSERT_TRUE(receiver->receive(msg, 5000));
+		ASSERT_EQ(msg.get(), sent.get());
+	}
+	broker.stop();
+}
+
+// Test in-process and socket clients reach each other through the same routing
+TEST(TestBroker, TestLocalAndSocket)
+{
+	Broker broker(testBrokerConfig(7791));
+	ASSERT_TRUE(broker.start());
+	auto local = broker.connect("local");
+
+	sock::startup();
+	SOCKET remote = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in serverAddr = {};
+	serverAddr.sin_family = AF_INET;
+	serverAddr.sin_port = htons(7791);
+	serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	ASSERT_EQ(connect(remote, (sockaddr*)&serverAddr, sizeof(serverAddr)), 0);
+	std::string registration = "{\"type\":\"registration\",\"value\":\"remote\"}";
+	std::string msg = testMessage("remote", "local", 1);
+	std::string frames = std::to_string(registration.length()) + '\r' + registration + std::to_string(msg.length()) + '\r' + msg;
+	ASSERT_EQ(send(remote, frames.c_str(), frames.length(), 0), static_cast<int>(frames.length()));
+
+	Payload received;
+	ASSERT_TRUE(local->receive(received, 5000));
+	ASSERT_EQ(*received, msg);
+
+	// Replies are framed for the socket client like any other message
+	std::string reply = testMessage("local", "remote", 2);
+	ASSERT_TRUE(local->send(reply));
+	std::string expected = std::to_string(reply.length()) + '\r' + reply;
+	std::string bytes;
+	char buffer[1024];
+	while (bytes.size() < expected.size())
+	{
+		int count = recv(remote, buffer, sizeof(buffer), 0);
+		ASSERT_GT(count, 0);
+		bytes.append(buffer, count);
+	}
+	ASSERT_EQ(bytes, expected);
+	sock::close(remote);
+	broker.stop();
+}
+
+// Test in-process subscribers receive publications, translated to the format they registered
+TEST(TestBroker, TestPublish)
+{
+	Broker broker(testBrokerConfig(7792));
+	ASSERT_TRUE(broker.start());
+	auto text = broker.connect("text");
+	auto packed = broker.connect("packed", WireFormat::MsgPack);
+	ASSERT_TRUE(text->subscribe("readings"));
+	ASSERT_TRUE(packed->subscribe("readings"));
+	// Channels are serviced in the order they became pending, so the subscriptions are seen first
+	auto publisher = broker.connect("publisher");
+	json publication = { { "type", "publish" }, { "from", "publisher" }, { "to", "readings" }, { "data", { { "value", 7 } } } };
+	ASSERT_TRUE(publisher->send(publication.dump()));
+
+	Payload msg;
+	ASSERT_TRUE(text->receive(msg, 5000));
+	ASSERT_EQ(json::parse(*msg)["data"]["value"], 7);
+	ASSERT_TRUE(packed->receive(msg, 5000));
+	ASSERT_EQ(json::from_msgpack(*msg)["data"]["value"], 7);
+	ASSERT_FALSE(publisher->tryReceive(msg));
+
+	ASSERT_TRUE(text->unsubscribe("readings"));
+	ASSERT_TRUE(publisher->send(publication.dump()));
+	ASSERT_TRUE(packed->receive(msg, 5000));
+	ASSERT_FALSE(text->receive(msg, 100));
+	broker.stop();
+}
+
+// Test in-process clients spread over shards reach each other
+TEST(TestBroker, TestSharded)
+{
+	BrokerConfig config = testBrokerConfig(7793);
+	config.shards = 2;
+	Broker broker(config);
+	ASSERT_TRUE(broker.start());
+	ASSERT_EQ(broker.metrics().size(), 2);
+	auto first = broker.connect("first");
+	auto second = broker.connect("second");
+	ASSERT_TRUE(first->send(testMessage("first", "second", 1)));
+	ASSERT_TRUE(second->send(testMessage("second", "first", 2)));
+
+	Payload msg;
+	ASSERT_TRUE(second->receive(msg, 5000));
+	ASSERT_EQ(json::parse(*msg)["data"]["value"], 1);
+	ASSERT_TRUE(first->receive(msg, 5000));
+	ASSERT_EQ(json::parse(*msg)["data"]["value"], 2);
+	broker.stop();
+	ASSERT_TRUE(first->closed());
+}
+
+#endif
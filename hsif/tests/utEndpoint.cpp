@@ -16,9 +16,12 @@ TEST(TestEndpoint, TestRecvMsg)
 	auto endpoint = Endpoint(INVALID_SOCKET);
 	std::string finalMsg = std::to_string(testMsg.length()) + '\r' + testMsg;
 	endpoint.receiveMsg(testMsg);
-	ASSERT_TRUE(endpoint.inbox == "");
-	ASSERT_TRUE(endpoint.contentSize == finalMsg.length());
-	ASSERT_TRUE(strncmp(endpoint.sendBuffer, finalMsg.c_str(), finalMsg.length()) == 0);
+	ASSERT_TRUE(endpoint.outbound.numFrames() == 1);
+	ASSERT_TRUE(endpoint.outbound.bytesQueued() == finalMsg.length());
+	size_t count = endpoint.outbound.gather(endpoint.sendVecs, SEND_IOVECS);
+	ASSERT_TRUE(count == 2);
+	std::string gathered = std::string(sock::ioVecView(endpoint.sendVecs[0])) + std::string(sock::ioVecView(endpoint.sendVecs[1]));
+	ASSERT_TRUE(gathered == finalMsg);
 }
 
 // Test clear buffer
@@ -29,10 +32,10 @@ TEST(TestEndpoint, TestClearBuffer)
 	auto endpoint = Endpoint(INVALID_SOCKET);
 	endpoint.receiveMsg(testMsg);
 	// Clear buffer 
-	endpoint.bufferReady();
-	ASSERT_TRUE(endpoint.inbox == "");
-	ASSERT_TRUE(endpoint.contentSize == 0);
-	ASSERT_TRUE(endpoint.sendBuffer[0] == 0);
+	endpoint.outbound.consume(endpoint.outbound.bytesQueued());
+	ASSERT_TRUE(endpoint.outbound.empty());
+	ASSERT_TRUE(endpoint.outbound.bytesQueued() == 0);
+	ASSERT_TRUE(endpoint.outbound.gather(endpoint.sendVecs, SEND_IOVECS) == 0);
 }
 
 // Test endpoint's ability to parse messages
@@ -45,7 +48,31 @@ TEST(TestEndpoint, TestMessageRecv)
 	endpoint.bytesRecv = finalMsg.length();
 	endpoint.processRecv();
 
-	ASSERT_TRUE(endpoint.outbox.front() == testMsg);
+	ASSERT_TRUE(endpoint.outbox.front().payload == testMsg);
+	ASSERT_TRUE(endpoint.outbox.front().format == WireFormat::Text);
+}
+
+// Test frames split across packets and several frames per packet
+TEST(TestEndpoint, TestSplitMessageRecv)
+{
+	std::string testMsg = "{ \"TestData\" : \"TestValue\" }";
+	std::string finalMsg = std::to_string(testMsg.length()) + '\r' + testMsg;
+	std::string stream = finalMsg + finalMsg + finalMsg;
+	auto endpoint = Endpoint(INVALID_SOCKET);
+	std::vector<std::string> received;
+	for (size_t offset = 0; offset < stream.length(); offset += 7)
+	{
+		size_t length = stream.copy(endpoint.recvBuffer, 7, offset);
+		endpoint.bytesRecv = length;
+		ASSERT_TRUE(endpoint.processRecv());
+		for (const RecvFrame& frame : endpoint.outbox)
+			received.emplace_back(frame.payload);
+		endpoint.releaseFrames();
+	}
+
+	ASSERT_EQ(received.size(), 3);
+	for (const std::string& msg : received)
+		ASSERT_TRUE(msg == testMsg);
 }
 
 // Test endpoint cleanup
@@ -0,0 +1,89 @@
+#include "EpollReactor.hpp"
+#include "gtest/gtest.h"
+
+#ifdef __linux__
+
+// Test reactor initialization
+TEST(TestEpollReactor, TestInit)
+{
+	EpollReactor reactor;
+	ASSERT_TRUE(reactor.init());
+}
+
+// Test that only sockets with pending data are reported
+TEST(TestEpollReactor, TestReadReady)
+{
+	int pair[2];
+	int idle[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, idle), 0);
+
+	EpollReactor reactor;
+	std::vector<ReactorEvent> ready;
+	reactor.init();
+	reactor.add(pair[0], false);
+	reactor.add(idle[0], false);
+	ASSERT_EQ(reactor.wait(ready, 0), 0);
+
+	sock::send(pair[1], "data", 4);
+	ASSERT_EQ(reactor.wait(ready, 100), 1);
+	ASSERT_EQ(ready[0].socket, pair[0]);
+	ASSERT_TRUE(ready[0].readable);
+	ASSERT_FALSE(ready[0].writable);
+
+	// Edge triggered, no new event until more data arrives
+	ASSERT_EQ(reactor.wait(ready, 0), 0);
+
+	for (int fd : { pair[0], pair[1], idle[0], idle[1] })
+		sock::close(fd);
+}
+
+// Test write interest toggling
+TEST(TestEpollReactor, TestWriteInterest)
+{
+	int pair[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+
+	EpollReactor reactor;
+	std::vector<ReactorEvent> ready;
+	reactor.init();
+	reactor.add(pair[0], false);
+	ASSERT_EQ(reactor.wait(ready, 0), 0);
+
+	// Enabling write interest reports the already writable socket
+	ASSERT_TRUE(reactor.setWriteInterest(pair[0], true));
+	ASSERT_EQ(reactor.wait(ready, 100), 1);
+	ASSERT_TRUE(ready[0].writable);
+
+	// Disabling write interest silences it
+	ASSERT_TRUE(reactor.setWriteInterest(pair[0], false));
+	ASSERT_EQ(reactor.wait(ready, 0), 0);
+
+	sock::close(pair[0]);
+	sock::close(pair[1]);
+}
+
+// Test read interest can be paused and resumed without losing pending data
+TEST(TestEpollReactor, TestReadInterest)
+{
+	int pair[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+
+	EpollReactor reactor;
+	std::vector<ReactorEvent> ready;
+	reactor.init();
+	reactor.add(pair[0], false);
+	ASSERT_TRUE(reactor.setInterest(pair[0], false, false));
+	sock::send(pair[1], "data", 4);
+	ASSERT_EQ(reactor.wait(ready, 0), 0);
+
+	// Resuming reports data that arrived while paused
+	ASSERT_TRUE(reactor.setInterest(pair[0], true, false));
+	ASSERT_EQ(reactor.wait(ready, 100), 1);
+	ASSERT_TRUE(ready[0].readable);
+
+	sock::close(pair[0]);
+	sock::close(pair[1]);
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "FrameBuffer.hpp"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <string>
+
+// Copies data into the buffer's free space and commits it
+static void receive(FrameBuffer& buffer, const std::string& data)
+{
+	std::memcpy(buffer.writePointer(), data.data(), data.size());
+	buffer.commit(data.size());
+}
+
+// Test several frames delivered in one read
+TEST(TestFrameBuffer, TestMultipleFrames)
+{
+	FrameBuffer buffer(64);
+	std::string_view frame;
+	receive(buffer, "3\rabc5\rhello1\rx");
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Ready);
+	ASSERT_EQ(frame, "abc");
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Ready);
+	ASSERT_EQ(frame, "hello");
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Ready);
+	ASSERT_EQ(frame, "x");
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Incomplete);
+	ASSERT_EQ(buffer.pending(), 0);
+}
+
+// Test a frame split at every possible position, including inside the header
+TEST(TestFrameBuffer, TestSplitFrames)
+{
+	const std::string stream = "11\rhello world2\rok";
+	for (size_t split = 1; split < stream.size(); split++)
+	{
+		FrameBuffer buffer(64);
+		std::string_view frame;
+		std::vector<std::string> frames;
+		receive(buffer, stream.substr(0, split));
+		while (buffer.nextFrame(frame) == FrameStatus::Ready)
+			frames.emplace_back(frame);
+		buffer.release();
+		receive(buffer, stream.substr(split));
+		while (buffer.nextFrame(frame) == FrameStatus::Ready)
+			frames.emplace_back(frame);
+		ASSERT_EQ(frames.size(), 2);
+		ASSERT_EQ(frames[0], "hello world");
+		ASSERT_EQ(frames[1], "ok");
+	}
+}
+
+// Test binary frames mixed with text frames, split at every position
+TEST(TestFrameBuffer, TestBinaryFrames)
+{
+	char header[BINARY_HEADER_SIZE];
+	framing::writeBinaryHeader(header, WireFormat::MsgPack, 0, 3);
+	const std::string stream = "2\rok" + std::string(header, BINARY_HEADER_SIZE) + std::string("\x81\xA0\x00", 3) + "1\rx";
+	for (size_t split = 1; split < stream.size(); split++)
+	{
+		FrameBuffer buffer(64);
+		RecvFrame frame;
+		std::vector<RecvFrame> frames;
+		std::vector<std::string> payloads;
+		receive(buffer, stream.substr(0, split));
+		while (buffer.nextFrame(frame) == FrameStatus::Ready)
+			frames.push_back(frame), payloads.emplace_back(frame.payload);
+		buffer.release();
+		receive(buffer, stream.substr(split));
+		while (buffer.nextFrame(frame) == FrameStatus::Ready)
+			frames.push_back(frame), payloads.emplace_back(frame.payload);
+		ASSERT_EQ(frames.size(), 3);
+		ASSERT_EQ(payloads[0], "ok");
+		ASSERT_TRUE(frames[0].format == WireFormat::Text);
+		ASSERT_EQ(payloads[1], std::string("\x81\xA0\x00", 3));
+		ASSERT_TRUE(frames[1].format == WireFormat::MsgPack);
+		ASSERT_EQ(payloads[2], "x");
+	}
+
+	// Unknown formats are rejected
+	FrameBuffer buffer(64);
+	RecvFrame frame;
+	framing::writeBinaryHeader(header, WireFormat::MsgPack, 0, 3);
+	header[1] = 9;
+	receive(buffer, std::string(header, BINARY_HEADER_SIZE) + "abc");
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Malformed);
+}
+
+// Test payloads containing NUL bytes are kept intact
+TEST(TestFrameBuffer, TestEmbeddedNul)
+{
+	FrameBuffer buffer(64);
+	std::string_view frame;
+	receive(buffer, std::string("3\ra\0b", 5));
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Ready);
+	ASSERT_EQ(frame, std::string_view("a\0b", 3));
+}
+
+// Test invalid length prefixes
+TEST(TestFrameBuffer, TestMalformed)
+{
+	std::string_view frame;
+	for (std::string data : { "x3\rabc", "\rabc", "0\r", "12345678901234567890123" })
+	{
+		FrameBuffer buffer(64);
+		receive(buffer, data);
+		ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Malformed);
+	}
+}
+
+// Test length prefixes over the size limit are rejected before any payload is buffered
+TEST(TestFrameBuffer, TestMaxFrameSize)
+{
+	RecvFrame frame;
+	FrameBuffer text(64, 16);
+	receive(text, "16\r0123456789abcdef17\r");
+	ASSERT_EQ(text.nextFrame(frame), FrameStatus::Ready);
+	ASSERT_EQ(text.nextFrame(frame), FrameStatus::Malformed);
+
+	FrameBuffer defaults(64);
+	receive(defaults, std::to_string(FRAME_SIZE_MAX + 1) + "\r");
+	ASSERT_EQ(defaults.nextFrame(frame), FrameStatus::Malformed);
+
+	// Binary headers name up to 4 GiB, the limit applies to them too
+	char header[BINARY_HEADER_SIZE];
+	FrameBuffer binary(64);
+	binary.setMaxFrameSize(16);
+	framing::writeBinaryHeader(header, WireFormat::MsgPack, 0, 16);
+	receive(binary, std::string(header, BINARY_HEADER_SIZE) + std::string(16, '\0'));
+	ASSERT_EQ(binary.nextFrame(frame), FrameStatus::Ready);
+	framing::writeBinaryHeader(header, WireFormat::MsgPack, 0, UINT32_MAX);
+	receive(binary, std::string(header, BINARY_HEADER_SIZE));
+	ASSERT_EQ(binary.nextFrame(frame), FrameStatus::Malformed);
+}
+
+// Test frames larger than the buffer and views surviving growth
+TEST(TestFrameBuffer, TestGrowth)
+{
+	FrameBuffer buffer(16);
+	std::string_view first;
+	std::string_view second;
+	std::string payload(100, 'p');
+	receive(buffer, "2\rhi3\r");
+	ASSERT_EQ(buffer.nextFrame(first), FrameStatus::Ready);
+	ASSERT_EQ(buffer.nextFrame(second), FrameStatus::Incomplete);
+
+	// Frame spans several minimum-space writes while the first view is outstanding
+	std::string stream = "abc100\r" + payload;
+	for (size_t offset = 0; offset < stream.size(); offset += 16)
+	{
+		receive(buffer, stream.substr(offset, 16));
+		ASSERT_EQ(first, "hi");
+	}
+	ASSERT_EQ(buffer.nextFrame(second), FrameStatus::Ready);
+	ASSERT_EQ(second, "abc");
+	ASSERT_EQ(buffer.nextFrame(second), FrameStatus::Ready);
+	ASSERT_EQ(second, payload);
+	buffer.release();
+	ASSERT_EQ(buffer.pending(), 0);
+}
+
+// Test unparsed bytes, including a header already parsed, complete their frame in another buffer
+TEST(TestFrameBuffer, TestUnparsed)
+{
+	FrameBuffer buffer(16);
+	std::string_view frame;
+	receive(buffer, "2\rhi5\rhel");
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Ready);
+	ASSERT_EQ(buffer.nextFrame(frame), FrameStatus::Incomplete);
+	buffer.release();
+	ASSERT_EQ(buffer.unparsed(), "5\rhel");
+
+	FrameBuffer successor(16);
+	successor.append(buffer.unparsed());
+	receive(successor, "lo");
+	ASSERT_EQ(successor.nextFrame(frame), FrameStatus::Ready);
+	ASSERT_EQ(frame, "hello");
+	ASSERT_EQ(successor.nextFrame(frame), FrameStatus::Incomplete);
+}
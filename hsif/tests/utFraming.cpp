@@ -0,0 +1,79 @@
+#include "Framing.hpp"
+#include "gtest/gtest.h"
+#include <string>
+
+// Test binary header fields survive a round trip
+TEST(TestFraming, TestBinaryHeader)
+{
+	char header[BINARY_HEADER_SIZE];
+	WireFormat format;
+	uint32_t length;
+	framing::writeBinaryHeader(header, WireFormat::Cbor, 0, 0x01020304);
+	ASSERT_EQ(static_cast<unsigned char>(header[0]), BINARY_FRAME_MAGIC);
+	ASSERT_EQ(header[4], 0x04);
+	ASSERT_TRUE(framing::readBinaryHeader(header, format, length));
+	ASSERT_TRUE(format == WireFormat::Cbor);
+	ASSERT_EQ(length, 0x01020304);
+}
+
+// Test datagram headers round trip and malformed headers are rejected
+TEST(TestFraming, TestDatagramHeader)
+{
+	char header[DATAGRAM_HEADER_MAX];
+	size_t length = framing::writeDatagramHeader(header, UINT64_MAX);
+	ASSERT_EQ(length, DATAGRAM_HEADER_MAX);
+	std::string datagram = std::string(header, length) + "{\"a\":1}";
+	uint64_t sequence;
+	std::string_view payload;
+	ASSERT_TRUE(framing::readDatagram(datagram, sequence, payload));
+	ASSERT_EQ(sequence, UINT64_MAX);
+	ASSERT_EQ(payload, "{\"a\":1}");
+	ASSERT_FALSE(framing::readDatagram("{\"a\":1}", sequence, payload));
+	ASSERT_FALSE(framing::readDatagram("\r{}", sequence, payload));
+	ASSERT_FALSE(framing::readDatagram("1x\r{}", sequence, payload));
+}
+
+// Test registration framing names
+TEST(TestFraming, TestParseFormat)
+{
+	WireFormat format;
+	ASSERT_TRUE(framing::parseFormat("msgpack", format));
+	ASSERT_TRUE(format == WireFormat::MsgPack);
+	ASSERT_TRUE(framing::parseFormat("cbor", format));
+	ASSERT_TRUE(format == WireFormat::Cbor);
+	ASSERT_FALSE(framing::parseFormat("xml", format));
+}
+
+// Test each encoding is produced once and shared
+TEST(TestFraming, TestWireMessage)
+{
+	std::string text = "{\"type\":\"message\",\"from\":\"a\",\"to\":\"b\",\"data\":{\"value\":21.5}}";
+	WireMessage msg(std::make_shared<const std::string>(text));
+	ASSERT_EQ(*msg.payload(WireFormat::Text), text);
+	const Payload& packed = msg.payload(WireFormat::MsgPack);
+	ASSERT_TRUE(packed.get() == msg.payload(WireFormat::MsgPack).get());
+	ASSERT_TRUE(framing::decode(*packed, WireFormat::MsgPack) == json::parse(text));
+	ASSERT_TRUE(framing::decode(*msg.payload(WireFormat::Cbor), WireFormat::Cbor) == json::parse(text));
+}
+
+// Test payload buffers are recycled by size class once their last reference drops
+TEST(TestFraming, TestPayloadRecycling)
+{
+	Payload first = framing::makePayload(std::string(100, 'a'));
+	const char* buffer = first->data();
+	Payload shared = first;
+	first.reset();
+	ASSERT_EQ(*shared, std::string(100, 'a'));
+	shared.reset();
+
+	uint64_t allocated = framing::payloadBuffers();
+	Payload second = framing::makePayload(std::string_view("short enough for the same class"));
+	ASSERT_EQ(second->data(), buffer);
+	ASSERT_EQ(*second, "short enough for the same class");
+	ASSERT_EQ(framing::payloadBuffers(), allocated);
+
+	// A larger payload needs a larger class
+	Payload large = framing::makePayload(std::string_view(std::string(1000, 'b')));
+	ASSERT_NE(large->data(), buffer);
+	ASSERT_EQ(large->size(), 1000);
+}
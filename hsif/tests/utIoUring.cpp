@@ -0,0 +1,78 @@
+#include "IoUring.hpp"
+#include "gtest/gtest.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+
+// Test ring initialization and provided buffer registration
+TEST(TestIoUring, TestInit)
+{
+	IoUring ring;
+	ASSERT_TRUE(ring.init(8));
+	ASSERT_TRUE(ring.setupBufferRing(0, 4, 64));
+}
+
+// Test multishot receive into provided buffers
+TEST(TestIoUring, TestMultishotRecv)
+{
+	int pair[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+
+	IoUring ring;
+	std::vector<UringCompletion> completions;
+	ASSERT_TRUE(ring.init(8));
+	ASSERT_TRUE(ring.setupBufferRing(0, 4, 64));
+	ring.prepMultishotRecv(pair[0], 0, 42);
+
+	// One request keeps completing as data arrives
+	for (std::string data : { "first", "second" })
+	{
+		sock::send(pair[1], data.c_str(), data.size());
+		ASSERT_EQ(ring.submitAndWait(completions, 1), 1);
+		ASSERT_EQ(completions[0].userData, 42);
+		ASSERT_EQ(completions[0].result, static_cast<int32_t>(data.size()));
+		ASSERT_TRUE(completions[0].flags & IORING_CQE_F_BUFFER);
+		ASSERT_TRUE(completions[0].flags & IORING_CQE_F_MORE);
+		uint16_t bid = IoUring::bufferId(completions[0].flags);
+		ASSERT_EQ(std::string(ring.buffer(bid), completions[0].result), data);
+		ring.recycleBuffer(bid);
+	}
+	ASSERT_EQ(ring.numEnters(), 2);
+
+	sock::close(pair[0]);
+	sock::close(pair[1]);
+}
+
+// Test send completion
+TEST(TestIoUring, TestSend)
+{
+	int pair[2];
+	char buffer[16];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+
+	IoUring ring;
+	std::vector<UringCompletion> completions;
+	ASSERT_TRUE(ring.init(8));
+	ring.prepSend(pair[0], "data", 4, 7);
+	ASSERT_EQ(ring.submitAndWait(completions, 1), 1);
+	ASSERT_EQ(completions[0].userData, 7);
+	ASSERT_EQ(completions[0].result, 4);
+	ASSERT_EQ(sock::recv(pair[1], buffer, sizeof(buffer)), 4);
+
+	sock::close(pair[0]);
+	sock::close(pair[1]);
+}
+
+// Test a timeout ends a wait nothing else would end
+TEST(TestIoUring, TestTimeout)
+{
+	IoUring ring;
+	std::vector<UringCompletion> completions;
+	ASSERT_TRUE(ring.init(8));
+	ring.prepTimeout(1000000, 9);
+	ASSERT_EQ(ring.submitAndWait(completions, 1), 1);
+	ASSERT_EQ(completions[0].userData, 9);
+	ASSERT_EQ(completions[0].result, -ETIME);
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "Journal.hpp"
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+
+// Temporary journal directory removed when the test ends
+struct TestDirectory
+{
+	TestDirectory()
+	{
+		char name[] = "/tmp/hsif-journal-XXXXXX";
+		path = mkdtemp(name);
+	}
+	~TestDirectory()
+	{
+		std::filesystem::remove_all(path);
+	}
+	std::string path;
+};
+
+// Testing function for a message numbered by its journal offset
+std::string journalMsg(uint64_t number)
+{
+	return "{\"type\":\"message\",\"to\":\"unity\",\"data\":" + std::to_string(number) + "}";
+}
+
+// Test records read back in order with their offsets, timestamps and destinations
+TEST(TestJournal, TestAppendRead)
+{
+	TestDirectory directory;
+	Journal journal;
+	ASSERT_TRUE(journal.open(directory.path, DEFAULT_JOURNAL_POLICY));
+	ASSERT_FALSE(journal.dirty());
+	ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(0), 100));
+	ASSERT_TRUE(journal.append(JournalKind::Publish, "temps", journalMsg(1), 200));
+	ASSERT_TRUE(journal.dirty());
+	ASSERT_TRUE(journal.sync());
+	ASSERT_FALSE(journal.dirty());
+	ASSERT_EQ(journal.endOffset(), 2);
+
+	JournalCursor cursor = journal.seek(0);
+	JournalRecord record;
+	ASSERT_TRUE(journal.next(cursor, record));
+	ASSERT_EQ(record.offset, 0);
+	ASSERT_EQ(record.timestamp, 100);
+	ASSERT_TRUE(record.kind == JournalKind::Message);
+	ASSERT_EQ(record.destination, "unity");
+	ASSERT_EQ(record.payload, journalMsg(0));
+	ASSERT_TRUE(journal.next(cursor, record));
+	ASSERT_TRUE(record.kind == JournalKind::Publish);
+	ASSERT_EQ(record.destination, "temps");
+	ASSERT_FALSE(journal.next(cursor, record));
+
+	// A cursor at the end picks up later appends
+	ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(2), 300));
+	ASSERT_TRUE(journal.next(cursor, record));
+	ASSERT_EQ(record.offset, 2);
+}
+
+// Test records spill into new segments and are found through the sparse index
+TEST(TestJournal, TestSegments)
+{
+	TestDirectory directory;
+	Journal journal;
+	ASSERT_TRUE(journal.open(directory.path, { 1024, 128, std::chrono::milliseconds(0), 0 }));
+	for (uint64_t number = 0; number < 100; number++)
+		ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(number), number));
+	// A record larger than a segment gets a segment of its own
+	ASSERT_TRUE(journal.append(JournalKind::Message, "unity", std::string(4000, 'x'), 100));
+	ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(101), 101));
+	ASSERT_GT(std::distance(std::filesystem::directory_iterator(directory.path), std::filesystem::directory_iterator()), 4);
+
+	JournalRecord record;
+	for (uint64_t offset : { 0, 37, 63, 99, 101 })
+	{
+		JournalCursor cursor = journal.seek(offset);
+		ASSERT_TRUE(journal.next(cursor, record));
+		ASSERT_EQ(record.offset, offset);
+		ASSERT_EQ(record.payload, journalMsg(offset));
+	}
+	JournalCursor cursor = journal.seek(0);
+	uint64_t count = 0;
+	while (journal.next(cursor, record))
+		ASSERT_EQ(record.offset, count++);
+	ASSERT_EQ(count, 102);
+}
+
+// Test a reopened journal continues numbering and cuts off a damaged tail
+TEST(TestJournal, TestRecovery)
+{
+	TestDirectory directory;
+	JournalPolicy policy = { 65536, 4096, std::chrono::milliseconds(0), 0 };
+	{
+		Journal journal;
+		ASSERT_TRUE(journal.open(directory.path, policy));
+		for (uint64_t number = 0; number < 5; number++)
+			ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(number), number));
+	}
+	{
+		Journal journal;
+		ASSERT_TRUE(journal.open(directory.path, policy));
+		ASSERT_EQ(journal.endOffset(), 5);
+		ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(5), 5));
+	}
+
+	// Damage the payload of record 3 as a crash writing it back partly would
+	std::string segment = directory.path + "/00000000000000000000.log";
+	std::string contents;
+	{
+		std::ifstream file(segment, std::ios::binary);
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	size_t position = contents.find(journalMsg(3));
+	ASSERT_NE(position, std::string::npos);
+	{
+		std::fstream file(segment, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(position);
+		file.put('?');
+	}
+
+	Journal journal;
+	ASSERT_TRUE(journal.open(directory.path, policy));
+	ASSERT_EQ(journal.endOffset(), 3);
+	ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(3), 3));
+	JournalCursor cursor = journal.seek(0);
+	JournalRecord record;
+	uint64_t count = 0;
+	while (journal.next(cursor, record))
+		ASSERT_EQ(record.payload, journalMsg(count++));
+	ASSERT_EQ(count, 4);
+}
+
+// Test retention deletes the oldest segments and stale cursors resume at the oldest record
+TEST(TestJournal, TestRetention)
+{
+	TestDirectory directory;
+	Journal journal;
+	ASSERT_TRUE(journal.open(directory.path, { 1024, 256, std::chrono::milliseconds(0), 2 }));
+	JournalCursor stale = journal.seek(0);
+	for (uint64_t number = 0; number < 200; number++)
+		ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(number), number));
+	ASSERT_GT(journal.startOffset(), 0);
+	ASSERT_EQ(std::distance(std::filesystem::directory_iterator(directory.path), std::filesystem::directory_iterator()), 4);
+
+	JournalRecord record;
+	ASSERT_TRUE(journal.next(stale, record));
+	ASSERT_EQ(record.offset, journal.startOffset());
+	ASSERT_EQ(record.payload, journalMsg(record.offset));
+}
+
+// Test seeking by time lands on the first record at or after it
+TEST(TestJournal, TestSeekTime)
+{
+	TestDirectory directory;
+	Journal journal;
+	ASSERT_TRUE(journal.open(directory.path, { 1024, 128, std::chrono::milliseconds(0), 0 }));
+	for (uint64_t number = 0; number < 100; number++)
+		ASSERT_TRUE(journal.append(JournalKind::Message, "unity", journalMsg(number), 1000 + number * 10));
+
+	JournalRecord record;
+	JournalCursor cursor = journal.seekTime(1555);
+	ASSERT_TRUE(journal.next(cursor, record));
+	ASSERT_EQ(record.offset, 56);
+	cursor = journal.seekTime(0);
+	ASSERT_TRUE(journal.next(cursor, record));
+	ASSERT_EQ(record.offset, 0);
+	cursor = journal.seekTime(5000);
+	ASSERT_FALSE(journal.next(cursor, record));
+	ASSERT_EQ(cursor.offset, 100);
+}
+#endif
@@ -0,0 +1,80 @@
+#include "LoadGenerator.hpp"
+#include "Server.hpp"
+#include "gtest/gtest.h"
+#include <future>
+#include <thread>
+
+// Test pattern names
+TEST(TestLoadGenerator, TestParsePattern)
+{
+	LoadPattern pattern;
+	ASSERT_TRUE(LoadGenerator::parsePattern("pairwise", pattern));
+	ASSERT_TRUE(pattern == LoadPattern::Pairwise);
+	ASSERT_TRUE(LoadGenerator::parsePattern("many-to-one", pattern));
+	ASSERT_TRUE(pattern == LoadPattern::ManyToOne);
+	ASSERT_TRUE(LoadGenerator::parsePattern("fan-out", pattern));
+	ASSERT_TRUE(pattern == LoadPattern::FanOut);
+	ASSERT_FALSE(LoadGenerator::parsePattern("broadcast", pattern));
+}
+
+#ifdef __linux__
+
+// Runs a generator against an epoll server until it finishes
+static LoadReport runAgainstServer(LoadConfig config, RoutingMode mode)
+{
+	auto logger = std::make_shared<Logger>();
+	logger->setLevel(LogLevel::Warning);
+	auto server = Server("127.0.0.1", config.port, logger, false, PollBackend::Epoll);
+	server.setRoutingMode(mode);
+	bool success = server.connect();
+	EXPECT_TRUE(success);
+
+	std::promise<LoadReport> p;
+	auto f = p.get_future();
+	std::thread client([&]()
+	{
+		LoadGenerator generator(config);
+		LoadReport report;
+		generator.run(report);
+		p.set_value(report);
+
+		// Server may have handled the generator's hangups already, a last connection wakes it to see the result
+		SOCKET wake = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockaddr_in serverAddr = {};
+		serverAddr.sin_family = AF_INET;
+		serverAddr.sin_port = htons(config.port);
+		serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+		connect(wake, (sockaddr*)&serverAddr, sizeof(serverAddr));
+		sock::close(wake);
+	});
+	while (success && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		success = server.poll();
+	client.join();
+	server.cleanup();
+	return f.get();
+}
+
+// Test pairwise traffic is delivered and measured
+TEST(TestLoadGenerator, TestPairwise)
+{
+	LoadConfig config = { "127.0.0.1", 7782, 16, LoadPattern::Pairwise, 2000, 32, 100, 300, 2, 5000 };
+	LoadReport report = runAgainstServer(config, RoutingMode::Parse);
+	ASSERT_EQ(report.connected, 16);
+	ASSERT_EQ(report.errors, 0);
+	ASSERT_GT(report.sent, 0);
+	ASSERT_EQ(report.received, report.sent);
+	ASSERT_EQ(report.latency.count, report.received);
+	ASSERT_GT(report.latency.percentile(0.99), 0);
+}
+
+// Test every subscriber receives each publish
+TEST(TestLoadGenerator, TestFanOut)
+{
+	LoadConfig config = { "127.0.0.1", 7783, 8, LoadPattern::FanOut, 500, 32, 100, 300, 1, 5000 };
+	LoadReport report = runAgainstServer(config, RoutingMode::Header);
+	ASSERT_EQ(report.connected, 8);
+	ASSERT_EQ(report.errors, 0);
+	ASSERT_GT(report.sent, 0);
+	ASSERT_EQ(report.received, report.sent * 7);
+}
+#endif
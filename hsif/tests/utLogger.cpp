@@ -1,6 +1,7 @@
 #include "Logger.hpp"
 #include "gtest/gtest.h"
 #include <filesystem>
+#include <memory>
 
 // Test logger default initialization
 TEST(LoggerTest, TestInit)
@@ -46,4 +47,26 @@ TEST(LoggerTest, TestLogFile)
 	// Delete logger so file closes
 	delete logger;
 	ASSERT_FALSE(std::filesystem::is_empty(logPath));
-}
\ No newline at end of file
+}
+// Test messages below the runtime level are neither formatted nor written
+TEST(LoggerTest, TestLevels)
+{
+	auto logger = std::make_unique<Logger>("test_level_log.txt");
+	const std::filesystem::path logPath = std::filesystem::current_path() / "test_level_log.txt";
+	int formatted = 0;
+	auto format = [&formatted]() { formatted++; return std::string("formatted"); };
+
+	LOG_DEBUG(logger, true, format());
+	ASSERT_EQ(formatted, 0);
+	logger->flush();
+	ASSERT_TRUE(std::filesystem::is_empty(logPath));
+
+	// Enabled levels are written by the background thread
+	logger->setLevel(LogLevel::Debug);
+	LOG_DEBUG(logger, true, format());
+	LOG_ERROR(logger, true, format());
+	ASSERT_EQ(formatted, HSIF_LOG_LEVEL == 0 ? 2 : 1);
+	logger->flush();
+	ASSERT_FALSE(std::filesystem::is_empty(logPath));
+	ASSERT_EQ(logger->dropped(), 0);
+}
@@ -0,0 +1,144 @@
+#include "Metrics.hpp"
+#include "MetricsExporter.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+// Test small values map to exact buckets and larger values stay within the bucket error
+TEST(TestMetrics, TestBuckets)
+{
+	for (uint64_t value = 0; value < LATENCY_SUB_BUCKETS; value++)
+		ASSERT_EQ(LatencyHistogram::bucketIndex(value), value);
+	ASSERT_EQ(LatencyHistogram::bucketIndex(16), 16);
+	ASSERT_EQ(LatencyHistogram::bucketIndex(32), 32);
+
+	size_t previous = 0;
+	for (uint64_t value = 1; value < (uint64_t(1) << 30); value = value * 3 / 2 + 1)
+	{
+		size_t bucket = LatencyHistogram::bucketIndex(value);
+		uint64_t upper = LatencyHistogram::bucketUpperBound(bucket);
+		ASSERT_GE(bucket, previous);
+		ASSERT_GE(upper, value);
+		ASSERT_LE(upper - value, value / LATENCY_SUB_BUCKETS);
+		previous = bucket;
+	}
+	// Values past the largest exponent share the last bucket
+	ASSERT_EQ(LatencyHistogram::bucketIndex(UINT64_MAX), LATENCY_BUCKETS - 1);
+}
+
+// Test percentiles of a uniform distribution
+TEST(TestMetrics, TestPercentiles)
+{
+	LatencyHistogram histogram;
+	for (uint64_t micros = 1; micros <= 1000; micros++)
+		histogram.record(micros * 1000);
+	HistogramSnapshot snapshot;
+	histogram.snapshot(snapshot);
+	ASSERT_EQ(snapshot.count, 1000);
+	ASSERT_EQ(snapshot.max, 1000000);
+	ASSERT_EQ(snapshot.sum, 500500000);
+	ASSERT_NEAR(snapshot.percentile(0.5), 500000, 500000 / LATENCY_SUB_BUCKETS);
+	ASSERT_NEAR(snapshot.percentile(0.99), 990000, 990000 / LATENCY_SUB_BUCKETS);
+	ASSERT_EQ(snapshot.percentile(1.0), 1000000);
+
+	// Merging doubles counts without moving percentiles
+	HistogramSnapshot merged = snapshot;
+	merged.merge(snapshot);
+	ASSERT_EQ(merged.count, 2000);
+	ASSERT_EQ(merged.percentile(0.5), snapshot.percentile(0.5));
+}
+
+// Test endpoint traffic survives removal in the totals and only named endpoints are listed
+TEST(TestMetrics, TestRegistry)
+{
+	MetricsRegistry registry;
+	Counter* polls = registry.counter("hsif_polls_total", "Polls.");
+	Gauge* parked = registry.gauge("hsif_parked_messages", "Parked.");
+	polls->add(3);
+	parked->set(7);
+
+	auto first = registry.addEndpoint();
+	auto second = registry.addEndpoint();
+	registry.nameEndpoint(first, "sensor");
+	first->bytesIn.add(100);
+	second->bytesIn.add(50);
+
+	MetricsSnapshot snapshot = registry.snapshot();
+	ASSERT_EQ(snapshot.counters[0].value, 3);
+	ASSERT_EQ(snapshot.gauges[0].value, 7);
+	ASSERT_EQ(snapshot.endpoints.size(), 1);
+	ASSERT_EQ(snapshot.endpoints[0].id, "sensor");
+	auto total = [](const MetricsSnapshot& snapshot, const std::string& name) {
+		for (const MetricSample& sample : snapshot.counters)
+		{
+			if (sample.name == name)
+				return sample.value;
+		}
+		return uint64_t(0);
+	};
+	ASSERT_EQ(total(snapshot, "hsif_bytes_received_total"), 150);
+
+	registry.removeEndpoint(first);
+	registry.removeEndpoint(first);
+	snapshot = registry.snapshot();
+	ASSERT_TRUE(snapshot.endpoints.empty());
+	ASSERT_EQ(total(snapshot, "hsif_bytes_received_total"), 150);
+}
+
+// Test exposition text carries families once and a shard label per value
+TEST(TestMetrics, TestPrometheus)
+{
+	MetricsRegistry shard0, shard1;
+	shard0.setShard("0");
+	shard1.setShard("1");
+	shard0.counter("hsif_polls_total", "Polls.")->add(2);
+	shard1.counter("hsif_polls_total", "Polls.")->add(5);
+	shard0.histogram("hsif_delivery_latency_seconds", "Latency.")->record(2000);
+	shard1.histogram("hsif_delivery_latency_seconds", "Latency.");
+	auto endpoint = shard0.addEndpoint();
+	shard0.nameEndpoint(endpoint, "quote\"d");
+
+	std::string text = MetricsRegistry::toPrometheus({ shard0.snapshot(), shard1.snapshot() });
+	ASSERT_NE(text.find("# TYPE hsif_polls_total counter\n"), std::string::npos);
+	ASSERT_EQ(text.find("# TYPE hsif_polls_total counter\n"), text.rfind("# TYPE hsif_polls_total counter\n"));
+	ASSERT_NE(text.find("hsif_polls_total{shard=\"0\"} 2\n"), std::string::npos);
+	ASSERT_NE(text.find("hsif_polls_total{shard=\"1\"} 5\n"), std::string::npos);
+	ASSERT_NE(text.find("# TYPE hsif_delivery_latency_seconds summary\n"), std::string::npos);
+	ASSERT_NE(text.find("hsif_delivery_latency_seconds_count{shard=\"0\"} 1\n"), std::string::npos);
+	ASSERT_NE(text.find("hsif_endpoint_bytes_received_total{shard=\"0\",endpoint=\"quote\\\"d\"} 0\n"), std::string::npos);
+
+	MetricsSnapshot merged = MetricsRegistry::merge({ shard0.snapshot(), shard1.snapshot() });
+	ASSERT_EQ(merged.counters[0].value, 7);
+	ASSERT_EQ(merged.histograms[0].count, 1);
+	ASSERT_EQ(merged.endpoints.size(), 1);
+}
+
+// Test the exporter answers a scrape over loopback
+TEST(TestMetrics, TestExporter)
+{
+	auto registry = std::make_shared<MetricsRegistry>();
+	registry->counter("hsif_polls_total", "Polls.")->add(42);
+	MetricsExporter exporter({ registry }, std::make_shared<Logger>(), false);
+	ASSERT_TRUE(exporter.start(0));
+	ASSERT_NE(exporter.port(), 0);
+
+	SOCKET client = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(exporter.port());
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(connect(client, (sockaddr*)&address, sizeof(address)), 0);
+	std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+	sock::send(client, request.data(), request.size());
+
+	std::string response;
+	char buffer[1024];
+	int received;
+	while ((received = sock::recv(client, buffer, sizeof(buffer))) > 0)
+		response.append(buffer, received);
+	sock::close(client);
+	exporter.stop();
+
+	ASSERT_EQ(response.find("HTTP/1.0 200 OK\r\n"), 0);
+	ASSERT_NE(response.find("hsif_polls_total 42\n"), std::string::npos);
+}
@@ -0,0 +1,58 @@
+#include "MpscQueue.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+// Test queue preserves order for a single producer
+TEST(TestMpscQueue, TestOrder)
+{
+	MpscQueue<std::string> queue;
+	std::string value;
+	ASSERT_TRUE(queue.empty());
+	ASSERT_FALSE(queue.pop(value));
+	queue.push("first");
+	queue.push("second");
+	ASSERT_FALSE(queue.empty());
+	ASSERT_TRUE(queue.pop(value));
+	ASSERT_EQ(value, "first");
+	ASSERT_TRUE(queue.pop(value));
+	ASSERT_EQ(value, "second");
+	ASSERT_TRUE(queue.empty());
+}
+
+// Test every value from concurrent producers arrives exactly once
+TEST(TestMpscQueue, TestMultipleProducers)
+{
+	const int producers = 4;
+	const int perProducer = 10000;
+	MpscQueue<int> queue;
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; p++)
+	{
+		threads.emplace_back([&queue, p, perProducer]()
+		{
+			for (int i = 0; i < perProducer; i++)
+				queue.push(p * perProducer + i);
+		});
+	}
+
+	// Consume while producers are still running
+	std::vector<int> lastSeen(producers, -1);
+	int received = 0;
+	int value;
+	while (received < producers * perProducer)
+	{
+		if (queue.pop(value))
+		{
+			// Values from one producer stay in order
+			int producer = value / perProducer;
+			ASSERT_GT(value, lastSeen[producer]);
+			lastSeen[producer] = value;
+			received++;
+		}
+	}
+	for (auto& thread : threads)
+		thread.join();
+	ASSERT_TRUE(queue.empty());
+}
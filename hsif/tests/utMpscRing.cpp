@@ -0,0 +1,65 @@
+#include "MpscRing.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+// Test ring preserves order and refuses values once full
+TEST(TestMpscRing, TestFull)
+{
+	MpscRing<std::string> ring(3);
+	std::string value;
+	ASSERT_EQ(ring.capacity(), 4);
+	ASSERT_FALSE(ring.pop(value));
+	for (const char* item : { "a", "b", "c", "d" })
+		ASSERT_TRUE(ring.tryPush(item));
+	ASSERT_FALSE(ring.tryPush("e"));
+
+	// Popping frees a cell for the next lap
+	ASSERT_TRUE(ring.pop(value));
+	ASSERT_EQ(value, "a");
+	ASSERT_TRUE(ring.tryPush("e"));
+	for (const char* item : { "b", "c", "d", "e" })
+	{
+		ASSERT_TRUE(ring.pop(value));
+		ASSERT_EQ(value, item);
+	}
+	ASSERT_FALSE(ring.pop(value));
+}
+
+// Test every accepted value from concurrent producers arrives exactly once
+TEST(TestMpscRing, TestMultipleProducers)
+{
+	const int producers = 4;
+	const int perProducer = 10000;
+	MpscRing<int> ring(1024);
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; p++)
+	{
+		threads.emplace_back([&ring, p, perProducer]()
+		{
+			// Retry refused values so the total is known
+			for (int i = 0; i < perProducer; i++)
+				while (!ring.tryPush(p * perProducer + i))
+					std::this_thread::yield();
+		});
+	}
+
+	std::vector<int> lastSeen(producers, -1);
+	int received = 0;
+	int value;
+	while (received < producers * perProducer)
+	{
+		if (ring.pop(value))
+		{
+			// Values from one producer stay in order
+			int producer = value / perProducer;
+			ASSERT_GT(value, lastSeen[producer]);
+			lastSeen[producer] = value;
+			received++;
+		}
+	}
+	for (auto& thread : threads)
+		thread.join();
+	ASSERT_FALSE(ring.pop(value));
+}
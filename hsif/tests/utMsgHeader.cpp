@@ -0,0 +1,71 @@
+#include "MsgHeader.hpp"
+#include "gtest/gtest.h"
+#include <string>
+
+// Test routing fields of a message
+TEST(TestMsgHeader, TestMessage)
+{
+	MsgHeader header;
+	ASSERT_TRUE(header.scan("{ \"type\" : \"message\", \"from\" : \"a\", \"to\" : \"b\", \"data\" : { \"x\" : 1 } }"));
+	ASSERT_EQ(header.type, "message");
+	ASSERT_EQ(header.from, "a");
+	ASSERT_EQ(header.to, "b");
+}
+
+// Test registration fields
+TEST(TestMsgHeader, TestRegistration)
+{
+	MsgHeader header;
+	ASSERT_TRUE(header.scan("{\"type\":\"registration\",\"value\":\"id\"}"));
+	ASSERT_EQ(header.type, "registration");
+	ASSERT_EQ(header.value, "id");
+}
+
+// Test publish and subscription fields
+TEST(TestMsgHeader, TestTopics)
+{
+	MsgHeader header;
+	ASSERT_TRUE(header.scan("{\"type\":\"publish\",\"from\":\"a\",\"to\":\"temperature\",\"data\":1}"));
+	ASSERT_EQ(header.type, "publish");
+	ASSERT_EQ(header.to, "temperature");
+	ASSERT_TRUE(header.scan("{\"type\":\"subscribe\",\"value\":\"temperature\"}"));
+	ASSERT_EQ(header.type, "subscribe");
+	ASSERT_EQ(header.value, "temperature");
+}
+
+// Test nested values before routing fields are skipped, including look-alike keys
+TEST(TestMsgHeader, TestSkipNested)
+{
+	MsgHeader header;
+	std::string msg = "{\"data\":{\"to\":\"wrong\",\"s\":\"}]\\\"{\",\"r\":[1,[2,{\"type\":\"x\"}],true,null,-1.5e3]},\"n\":12,"
+	                  "\"type\":\"message\",\"to\":\"b\",\"from\":\"a\"}";
+	ASSERT_TRUE(header.scan(msg));
+	ASSERT_EQ(header.type, "message");
+	ASSERT_EQ(header.to, "b");
+	ASSERT_EQ(header.from, "a");
+}
+
+// Test messages the scanner leaves to the full parser
+TEST(TestMsgHeader, TestFallback)
+{
+	MsgHeader header;
+	ASSERT_FALSE(header.scan("[1, 2]"));
+	ASSERT_FALSE(header.scan("{\"type\":\"message\",\"to\":\"b\\u0041\",\"from\":\"a\"}"));
+	ASSERT_FALSE(header.scan("{\"type\":\"message\",\"to\":5,\"from\":\"a\"}"));
+	ASSERT_FALSE(header.scan("{\"type\":\"message\",\"from\":\"a\"}"));
+	ASSERT_FALSE(header.scan("{\"type\":\"subscribe\"}"));
+	ASSERT_FALSE(header.scan("{\"type\":\"message\",\"to\":\"b"));
+	ASSERT_FALSE(header.scan("{\"data\":[1,2"));
+}
+
+// Test the conflation key is found wherever it sits in the top level
+TEST(TestMsgHeader, TestScanKey)
+{
+	MsgHeader header;
+	ASSERT_TRUE(header.scanKey("{\"type\":\"message\",\"from\":\"rpi\",\"data\":{\"key\":\"wrong\"},\"key\":\"temp\"}"));
+	ASSERT_EQ(header.from, "rpi");
+	ASSERT_EQ(header.key, "temp");
+	ASSERT_TRUE(header.scanKey("{\"from\":\"rpi\"}"));
+	ASSERT_TRUE(header.key.empty());
+	ASSERT_FALSE(header.scanKey("{\"from\":\"rpi\",\"key\":3}"));
+}
@@ -0,0 +1,242 @@
+#include "MsgSchema.hpp"
+#include "MsgData.hpp"
+#include "gtest/gtest.h"
+#include <random>
+#include <string>
+
+// Testing structs covering every supported member type
+struct TestPoint
+{
+	int32_t x;
+	int32_t y;
+};
+
+template <>
+struct MsgSchema<TestPoint>
+{
+	static constexpr auto fields = std::make_tuple(
+		schema::field("x", &TestPoint::x),
+		schema::field("y", &TestPoint::y));
+};
+
+struct TestReading
+{
+	std::string sensor;
+	double celsius;
+	float humidity;
+	uint64_t sequence;
+	int8_t offset;
+	bool ok;
+	std::vector<double> samples;
+	std::vector<TestPoint> path;
+	std::optional<std::string> note;
+	std::optional<TestPoint> origin;
+};
+
+template <>
+struct MsgSchema<TestReading>
+{
+	static constexpr auto fields = std::make_tuple(
+		schema::field("sensor", &TestReading::sensor),
+		schema::field("celsius", &TestReading::celsius),
+		schema::field("humidity", &TestReading::humidity),
+		schema::field("sequence", &TestReading::sequence),
+		schema::field("offset", &TestReading::offset),
+		schema::field("ok", &TestReading::ok),
+		schema::field("samples", &TestReading::samples),
+		schema::field("path", &TestReading::path),
+		schema::field("note", &TestReading::note),
+		schema::field("origin", &TestReading::origin));
+};
+
+// Schema properties are known at compile time
+static_assert(schema::fieldCount<TestReading>() == 10);
+static_assert(schema::requiredMask<TestReading>() == 0xff);
+static_assert(schema::supported<std::vector<std::optional<int>>>());
+static_assert(!schema::supported<std::optional<std::optional<int>>>());
+static_assert(!schema::supported<long double>());
+static_assert(!schema::supported<MsgData>());
+
+// Testing function for a reading with every field set
+TestReading testReading()
+{
+	return { "t\"1\\\n", 21.5, 40.25f, 18446744073709551615ull, -100, true, { 1.5, -2.0, 1e-300 },
+	         { { 1, 2 }, { -3, 4 } }, "caf\xc3\xa9", TestPoint{ 7, 8 } };
+}
+
+// Testing function comparing two readings
+void expectEqual(const TestReading& actual, const TestReading& expected)
+{
+	ASSERT_EQ(actual.sensor, expected.sensor);
+	ASSERT_EQ(actual.celsius, expected.celsius);
+	ASSERT_EQ(actual.humidity, expected.humidity);
+	ASSERT_EQ(actual.sequence, expected.sequence);
+	ASSERT_EQ(actual.offset, expected.offset);
+	ASSERT_EQ(actual.ok, expected.ok);
+	ASSERT_EQ(actual.samples, expected.samples);
+	ASSERT_EQ(actual.path.size(), expected.path.size());
+	for (size_t index = 0; index < actual.path.size(); index++)
+	{
+		ASSERT_EQ(actual.path[index].x, expected.path[index].x);
+		ASSERT_EQ(actual.path[index].y, expected.path[index].y);
+	}
+	ASSERT_EQ(actual.note, expected.note);
+	ASSERT_EQ(actual.origin.has_value(), expected.origin.has_value());
+	if (actual.origin)
+	{
+		ASSERT_EQ(actual.origin->x, expected.origin->x);
+	}
+}
+
+// Test JSON text round trips and matches what nlohmann::json reads
+TEST(TestMsgSchema, TestJsonRoundTrip)
+{
+	TestReading reading = testReading();
+	std::string text;
+	schema::writeJson(reading, text);
+	TestReading parsed = {};
+	ASSERT_TRUE(schema::readJson(text, parsed));
+	expectEqual(parsed, reading);
+
+	json document = json::parse(text);
+	ASSERT_EQ(document["sensor"], reading.sensor);
+	ASSERT_EQ(document["celsius"], 21.5);
+	ASSERT_EQ(document["sequence"].get<uint64_t>(), reading.sequence);
+	ASSERT_EQ(document["path"][1]["x"], -3);
+	ASSERT_EQ(document["note"], "caf\xc3\xa9");
+
+	// Absent optionals are left out
+	reading.note.reset();
+	reading.origin.reset();
+	text.clear();
+	schema::writeJson(reading, text);
+	ASSERT_FALSE(json::parse(text).contains("note"));
+	ASSERT_TRUE(schema::readJson(text, parsed));
+	ASSERT_FALSE(parsed.note);
+	ASSERT_FALSE(parsed.origin);
+}
+
+// Test doubles written with few decimals or in shortest form read back exactly
+TEST(TestMsgSchema, TestJsonNumbers)
+{
+	std::mt19937_64 random(7);
+	std::vector<double> values = { 0.1, -0.0005, 20.125, 123456789.5, 1e-7, 1e300, -2.5e-300, 0.30000000000000004, 4e15, 9007199254740993.0 };
+	for (int index = 0; index < 1000; index++)
+	{
+		values.push_back(std::uniform_real_distribution<double>(-1000, 1000)(random));
+		values.push_back(static_cast<double>(static_cast<int64_t>(random() % 2000000) - 1000000) / 1000);
+	}
+	for (double value : values)
+	{
+		std::string text;
+		schema::writeJsonValue(text, value);
+		double parsed;
+		schema::JsonReader reader(text);
+		ASSERT_TRUE(reader.readNumber(parsed)) << text;
+		ASSERT_EQ(parsed, value) << text;
+		ASSERT_EQ(json::parse(text).get<double>(), value) << text;
+	}
+	std::string text;
+	schema::writeJsonValue(text, 20.5);
+	ASSERT_EQ(text, "20.5");
+}
+
+// Test JSON written by nlohmann::json parses, with escapes, whitespace, nulls and unknown fields
+TEST(TestMsgSchema, TestJsonParse)
+{
+	std::string text = "{ \"unknown\" : { \"a\" : [1, \"]}\", {}] },\n\"ok\":false, \"sensor\":\"\\u00e9\\ud83d\\ude00\\/\","
+	                   "\"celsius\":-1.25e2,\"humidity\":0,\"sequence\":5,\"offset\":-128,\"samples\":[],\"path\":[{\"y\":2,\"x\":1}],"
+	                   "\"note\":null,\"s\\u0065quence\":6 }";
+	TestReading parsed = testReading();
+	ASSERT_TRUE(schema::readJson(text, parsed));
+	ASSERT_EQ(parsed.sensor, "\xc3\xa9\xf0\x9f\x98\x80/");
+	ASSERT_EQ(parsed.celsius, -125.0);
+	ASSERT_EQ(parsed.sequence, 6);
+	ASSERT_EQ(parsed.offset, -128);
+	ASSERT_FALSE(parsed.ok);
+	ASSERT_TRUE(parsed.samples.empty());
+	ASSERT_EQ(parsed.path[0].y, 2);
+	ASSERT_FALSE(parsed.note);
+	// A reused value keeps nothing from before
+	ASSERT_FALSE(parsed.origin);
+
+	TestReading reading = testReading();
+	std::string dumped = json::parse([&] { std::string out; schema::writeJson(reading, out); return out; }()).dump(4);
+	ASSERT_TRUE(schema::readJson(dumped, parsed));
+	expectEqual(parsed, reading);
+}
+
+// Test malformed text, wrong types, out of range numbers and missing required fields are rejected
+TEST(TestMsgSchema, TestJsonReject)
+{
+	TestPoint point;
+	ASSERT_TRUE(schema::readJson("{\"x\":1,\"y\":2}", point));
+	ASSERT_FALSE(schema::readJson("{\"x\":1}", point));
+	ASSERT_FALSE(schema::readJson("{\"x\":1,\"y\":\"2\"}", point));
+	ASSERT_FALSE(schema::readJson("{\"x\":1.5,\"y\":2}", point));
+	ASSERT_FALSE(schema::readJson("{\"x\":3000000000,\"y\":2}", point));
+	ASSERT_FALSE(schema::readJson("{\"x\":1,\"y\":2", point));
+	ASSERT_FALSE(schema::readJson("{\"x\":1,\"y\":2} x", point));
+	ASSERT_FALSE(schema::readJson("{\"x\":1 \"y\":2}", point));
+	ASSERT_FALSE(schema::readJson("[1,2]", point));
+	ASSERT_FALSE(schema::readJson("", point));
+
+	TestReading reading;
+	ASSERT_FALSE(schema::readJson("{\"sensor\":\"\\ud83d\"}", reading));
+	ASSERT_FALSE(schema::readJson("{\"sensor\":\"abc", reading));
+}
+
+// Test MessagePack round trips and interoperates with nlohmann::json
+TEST(TestMsgSchema, TestMsgPack)
+{
+	TestReading reading = testReading();
+	reading.sensor = std::string(300, 's');
+	reading.samples.assign(20, 0.5);
+	std::string bytes;
+	schema::writeMsgPack(reading, bytes);
+	TestReading parsed = {};
+	ASSERT_TRUE(schema::readMsgPack(bytes, parsed));
+	expectEqual(parsed, reading);
+
+	json document = json::from_msgpack(bytes);
+	ASSERT_EQ(document["sensor"], reading.sensor);
+	ASSERT_EQ(document["offset"], -100);
+	ASSERT_EQ(document["sequence"].get<uint64_t>(), reading.sequence);
+	ASSERT_EQ(document["humidity"], 40.25);
+	ASSERT_EQ(document["samples"].size(), 20);
+
+	// Maps encoded by nlohmann::json parse, with integer widths and field order of its choosing
+	document["celsius"] = 3;
+	document["offset"] = -1;
+	document["extra"] = { { "nested", { 1, "two", nullptr, true, 1.5 } } };
+	std::vector<uint8_t> encoded = json::to_msgpack(document);
+	ASSERT_TRUE(schema::readMsgPack(std::string_view(reinterpret_cast<const char*>(encoded.data()), encoded.size()), parsed));
+	ASSERT_EQ(parsed.celsius, 3.0);
+	ASSERT_EQ(parsed.offset, -1);
+	ASSERT_EQ(parsed.sensor, reading.sensor);
+
+	// Truncated input and values that do not fit are rejected
+	ASSERT_FALSE(schema::readMsgPack(std::string_view(bytes).substr(0, bytes.size() - 1), parsed));
+	document["offset"] = 200;
+	encoded = json::to_msgpack(document);
+	ASSERT_FALSE(schema::readMsgPack(std::string_view(reinterpret_cast<const char*>(encoded.data()), encoded.size()), parsed));
+}
+
+// Test typed messages carry routing fields the broker reads and MsgData parses
+TEST(TestMsgSchema, TestTypedMsg)
+{
+	TypedMsg<TestPoint> msg = { "message", "unity", "rpi", { 3, 4 } };
+	std::string text;
+	schema::writeJson(msg, text);
+	ASSERT_EQ(text, "{\"type\":\"message\",\"to\":\"unity\",\"from\":\"rpi\",\"data\":{\"x\":3,\"y\":4}}");
+
+	MsgData data(json::parse(text));
+	ASSERT_TRUE(data.isValid());
+	ASSERT_EQ(json::parse(data.getJson())["data"]["y"], 4);
+
+	TypedMsg<TestPoint> parsed;
+	ASSERT_TRUE(schema::readJson(MsgData("rpi", "unity", { { "x", 5 }, { "y", 6 } }).getJson(), parsed));
+	ASSERT_EQ(parsed.type, "message");
+	ASSERT_EQ(parsed.to, "rpi");
+	ASSERT_EQ(parsed.data.y, 6);
+}
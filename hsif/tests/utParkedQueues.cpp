@@ -0,0 +1,93 @@
+#include "ParkedQueues.hpp"
+#include "gtest/gtest.h"
+#include <string>
+
+// Testing function for a payload holding a number
+Payload parkedMsg(int number)
+{
+	return std::make_shared<const std::string>(std::to_string(number));
+}
+
+// Test messages are released per destination in arrival order
+TEST(TestParkedQueues, TestRelease)
+{
+	ParkedQueues parked;
+	auto now = ParkClock::now();
+	ASSERT_TRUE(parked.park("unity", parkedMsg(1), now));
+	ASSERT_TRUE(parked.park("rpi", parkedMsg(2), now));
+	ASSERT_TRUE(parked.park("unity", parkedMsg(3), now));
+	ASSERT_EQ(parked.size(), 3);
+	ASSERT_EQ(parked.size("unity"), 2);
+
+	std::vector<Payload> released = parked.release("unity", now);
+	ASSERT_EQ(released.size(), 2);
+	ASSERT_EQ(*released[0], "1");
+	ASSERT_EQ(*released[1], "3");
+	ASSERT_EQ(parked.size(), 1);
+	ASSERT_TRUE(parked.release("unity", now).empty());
+	ASSERT_EQ(parked.stats().parked, 3);
+}
+
+// Test a full destination queue drops its oldest or newest message as configured
+TEST(TestParkedQueues, TestDropPolicy)
+{
+	auto now = ParkClock::now();
+	ParkedQueues oldest({ std::chrono::seconds(30), 2, 100, DropPolicy::DropOldest });
+	ParkedQueues newest({ std::chrono::seconds(30), 2, 100, DropPolicy::DropNewest });
+	for (int number = 1; number <= 3; number++)
+	{
+		oldest.park("unity", parkedMsg(number), now);
+		newest.park("unity", parkedMsg(number), now);
+	}
+	std::vector<Payload> kept = oldest.release("unity", now);
+	ASSERT_EQ(*kept[0], "2");
+	ASSERT_EQ(*kept[1], "3");
+	kept = newest.release("unity", now);
+	ASSERT_EQ(*kept[0], "1");
+	ASSERT_EQ(*kept[1], "2");
+	ASSERT_EQ(oldest.stats().dropped, 1);
+	ASSERT_EQ(newest.stats().dropped, 1);
+
+	// Total limit refuses new messages whatever the policy
+	ParkedQueues total({ std::chrono::seconds(30), 10, 2, DropPolicy::DropOldest });
+	ASSERT_TRUE(total.park("unity", parkedMsg(1), now));
+	ASSERT_TRUE(total.park("rpi", parkedMsg(2), now));
+	ASSERT_FALSE(total.park("sensor", parkedMsg(3), now));
+	ASSERT_EQ(total.size("sensor"), 0);
+}
+
+// Test messages outliving the TTL are expired and never released
+TEST(TestParkedQueues, TestExpiry)
+{
+	ParkedQueues parked({ std::chrono::milliseconds(100), 10, 100, DropPolicy::DropOldest });
+	auto now = ParkClock::now();
+	parked.park("unity", parkedMsg(1), now);
+	parked.park("unity", parkedMsg(2), now + std::chrono::milliseconds(50));
+	parked.park("rpi", parkedMsg(3), now);
+
+	ASSERT_EQ(parked.expire(now + std::chrono::milliseconds(99)), 0);
+	ASSERT_EQ(parked.expire(now + std::chrono::milliseconds(100)), 2);
+	ASSERT_EQ(parked.size("rpi"), 0);
+	ASSERT_EQ(parked.size("unity"), 1);
+
+	std::vector<Payload> released = parked.release("unity", now + std::chrono::milliseconds(150));
+	ASSERT_TRUE(released.empty());
+	ASSERT_TRUE(parked.empty());
+	ASSERT_EQ(parked.stats().expired, 3);
+}
+
+// Test peeking leaves messages parked and skips expired ones
+TEST(TestParkedQueues, TestPeek)
+{
+	ParkedQueues parked({ std::chrono::milliseconds(100), 10, 100, DropPolicy::DropOldest });
+	auto now = ParkClock::now();
+	parked.park("unity", parkedMsg(1), now);
+	parked.park("unity", parkedMsg(2), now + std::chrono::milliseconds(50));
+
+	std::vector<Payload> peeked = parked.peek("unity", now + std::chrono::milliseconds(100));
+	ASSERT_EQ(peeked.size(), 1);
+	ASSERT_EQ(*peeked[0], "2");
+	ASSERT_TRUE(parked.peek("rpi", now).empty());
+	ASSERT_EQ(parked.size("unity"), 2);
+	ASSERT_EQ(parked.release("unity", now).size(), 2);
+}
@@ -0,0 +1,238 @@
+#include "SendQueue.hpp"
+#include "gtest/gtest.h"
+#include <string>
+
+// Concatenates gathered elements
+static std::string gathered(IoVec* vecs, size_t count)
+{
+	std::string bytes;
+	for (size_t index = 0; index < count; index++)
+		bytes += sock::ioVecView(vecs[index]);
+	return bytes;
+}
+
+// Test frames are gathered as header and payload elements in order
+TEST(TestSendQueue, TestGather)
+{
+	SendQueue queue;
+	IoVec vecs[8];
+	queue.push(std::make_shared<const std::string>("abc"));
+	queue.push(std::make_shared<const std::string>("hello"));
+	ASSERT_EQ(queue.numFrames(), 2);
+	ASSERT_EQ(queue.bytesQueued(), 12);
+	size_t count = queue.gather(vecs, 8);
+	ASSERT_EQ(count, 4);
+	ASSERT_EQ(gathered(vecs, count), "3\rabc5\rhello");
+
+	// Limited capacity stops mid frame
+	ASSERT_EQ(queue.gather(vecs, 3), 3);
+	ASSERT_EQ(gathered(vecs, 3), "3\rabc5\r");
+}
+
+// Test partial sends resume at the right offset
+TEST(TestSendQueue, TestPartialConsume)
+{
+	SendQueue queue;
+	IoVec vecs[8];
+	queue.push(std::make_shared<const std::string>("abc"));
+	queue.push(std::make_shared<const std::string>("hello"));
+	std::string expected = "3\rabc5\rhello";
+	for (size_t sent = 0; sent < expected.size(); sent++)
+	{
+		ASSERT_EQ(gathered(vecs, queue.gather(vecs, 8)), expected.substr(sent));
+		queue.consume(1);
+	}
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(queue.bytesQueued(), 0);
+}
+
+// Test one payload shared between queues is never copied
+TEST(TestSendQueue, TestSharedPayload)
+{
+	SendQueue first;
+	SendQueue second;
+	IoVec vecs[2];
+	auto payload = std::make_shared<const std::string>(100000, 'x');
+	first.push(payload);
+	second.push(payload);
+	ASSERT_EQ(payload.use_count(), 3);
+	second.gather(vecs, 2);
+	ASSERT_EQ(sock::ioVecView(vecs[1]).data(), payload->data());
+	second.consume(second.bytesQueued());
+	ASSERT_EQ(payload.use_count(), 2);
+}
+
+// Test the oldest unsent frames are discarded first, never a partially sent or kept frame
+TEST(TestSendQueue, TestDropOldest)
+{
+	SendQueue queue;
+	IoVec vecs[8];
+	for (const char* payload : { "aaa", "bbb", "ccc", "ddd" })
+		queue.push(std::make_shared<const std::string>(payload));
+	queue.consume(1);
+
+	// Partially sent front frame stays, the next oldest go until 10 bytes remain
+	ASSERT_EQ(queue.dropOldest(10, 0), 2);
+	ASSERT_EQ(queue.numFrames(), 2);
+	ASSERT_EQ(queue.bytesQueued(), 9);
+	ASSERT_EQ(gathered(vecs, queue.gather(vecs, 8)), "\raaa3\rddd");
+
+	// Discarded frames are skipped once the front frame is sent
+	queue.consume(4);
+	ASSERT_EQ(gathered(vecs, queue.gather(vecs, 8)), "3\rddd");
+
+	// Kept frames are never discarded
+	ASSERT_EQ(queue.dropOldest(0, 1), 0);
+	ASSERT_EQ(queue.dropOldest(0, 0), 1);
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(queue.bytesQueued(), 0);
+}
+
+// Test whole frames are taken from the front, skipping discarded ones
+TEST(TestSendQueue, TestFront)
+{
+	SendQueue queue;
+	ASSERT_EQ(queue.frontBytes(), 0);
+	Payload first = std::make_shared<const std::string>("aaa");
+	queue.push(first);
+	for (const char* payload : { "bbb", "cccc" })
+		queue.push(std::make_shared<const std::string>(payload));
+	ASSERT_EQ(queue.front(), first);
+	ASSERT_EQ(queue.frontBytes(), 5);
+	queue.consume(queue.frontBytes());
+	ASSERT_EQ(*queue.front(), "bbb");
+
+	// A discarded frame is never the front one
+	ASSERT_EQ(queue.dropOldest(6, 0), 1);
+	ASSERT_EQ(*queue.front(), "cccc");
+	ASSERT_EQ(queue.frontBytes(), 6);
+	queue.consume(queue.frontBytes());
+	ASSERT_TRUE(queue.empty());
+}
+
+// Test receive-to-send latency is recorded once per frame, when its last byte is sent
+TEST(TestSendQueue, TestLatency)
+{
+	SendQueue queue;
+	LatencyHistogram latency;
+	uint64_t receivedAt = MetricsRegistry::now();
+	queue.push(std::make_shared<const std::string>("abc"), WireFormat::Text, receivedAt);
+	queue.push(std::make_shared<const std::string>("hello"), WireFormat::Text, 0);
+	ASSERT_EQ(queue.consume(3, &latency), 0);
+	ASSERT_EQ(latency.count(), 0);
+	ASSERT_EQ(queue.consume(4, &latency), 1);
+	ASSERT_EQ(latency.count(), 1);
+	// Unstamped frame is counted as sent but not timed
+	ASSERT_EQ(queue.consume(5, &latency), 1);
+	ASSERT_EQ(latency.count(), 1);
+	ASSERT_TRUE(queue.empty());
+}
+
+// Test a keyed message replaces the unsent one in place, never a partially sent or kept frame
+TEST(TestSendQueue, TestPushLatest)
+{
+	SendQueue queue;
+	IoVec vecs[8];
+	auto payload = [](const char* text) { return std::make_shared<const std::string>(text); };
+	ASSERT_FALSE(queue.pushLatest("a", payload("a1"), WireFormat::Text, 0, 0));
+	ASSERT_FALSE(queue.pushLatest("b", payload("b1"), WireFormat::Text, 0, 0));
+	ASSERT_TRUE(queue.pushLatest("a", payload("a22"), WireFormat::Text, 0, 0));
+	ASSERT_EQ(queue.numFrames(), 2);
+	ASSERT_EQ(queue.bytesQueued(), 9);
+	ASSERT_EQ(gathered(vecs, queue.gather(vecs, 8)), "3\ra222\rb1");
+
+	// Partially sent front frame is queued behind, the newest copy is replaced afterwards
+	queue.consume(1);
+	ASSERT_FALSE(queue.pushLatest("a", payload("a3"), WireFormat::Text, 0, 0));
+	ASSERT_TRUE(queue.pushLatest("a", payload("a4"), WireFormat::Text, 0, 0));
+	ASSERT_EQ(gathered(vecs, queue.gather(vecs, 8)), "\ra222\rb12\ra4");
+
+	// Kept frames are never replaced
+	ASSERT_FALSE(queue.pushLatest("b", payload("b2"), WireFormat::Text, 0, 2));
+	ASSERT_EQ(queue.numFrames(), 4);
+
+	// Dropping a keyed frame, or sending it, forgets its key
+	queue.dropOldest(0, 3);
+	ASSERT_FALSE(queue.pushLatest("b", payload("b3"), WireFormat::Text, 0, 0));
+	queue.consume(queue.bytesQueued());
+	ASSERT_FALSE(queue.pushLatest("a", payload("a5"), WireFormat::Text, 0, 0));
+	ASSERT_EQ(gathered(vecs, queue.gather(vecs, 8)), "2\ra5");
+}
+
+// Test frames move to another queue without copying, restarting a partially sent frame
+TEST(TestSendQueue, TestMoveTo)
+{
+	SendQueue queue;
+	SendQueue other;
+	IoVec vecs[8];
+	auto payload = std::make_shared<const std::string>("abc");
+	queue.push(payload);
+	queue.pushLatest("k", std::make_shared<const std::string>("k1"), WireFormat::Text, 0, 0);
+	queue.push(std::make_shared<const std::string>("hello"));
+	queue.consume(2);
+	other.push(std::make_shared<const std::string>("first"));
+
+	queue.moveTo(other, 0);
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(queue.bytesQueued(), 0);
+	ASSERT_EQ(payload.use_count(), 2);
+	ASSERT_EQ(other.numFrames(), 4);
+	ASSERT_EQ(other.bytesQueued(), 23);
+	ASSERT_EQ(gathered(vecs, other.gather(vecs, 8)), "5\rfirst3\rabc2\rk15\rhello");
+
+	// Conflation keys follow their frames
+	ASSERT_TRUE(other.pushLatest("k", std::make_shared<const std::string>("k2"), WireFormat::Text, 0, 0));
+	ASSERT_EQ(gathered(vecs, other.gather(vecs, 8)), "5\rfirst3\rabc2\rk25\rhello");
+
+	// A key the other queue already holds supersedes the moved frame
+	SendQueue newest;
+	newest.pushLatest("k", std::make_shared<const std::string>("k3"), WireFormat::Text, 0, 0);
+	other.moveTo(newest, 0);
+	ASSERT_EQ(newest.numFrames(), 4);
+	ASSERT_EQ(gathered(vecs, newest.gather(vecs, 8)), "2\rk35\rfirst3\rabc5\rhello");
+}
+
+// Test kept frames stay in place, shared with the queue they moved to
+TEST(TestSendQueue, TestMoveToKeep)
+{
+	SendQueue queue;
+	SendQueue other;
+	IoVec vecs[8];
+	queue.push(std::make_shared<const std::string>("abc"));
+	queue.push(std::make_shared<const std::string>("hello"));
+	queue.gather(vecs, 8);
+	const char* inFlight = sock::ioVecView(vecs[0]).data();
+
+	queue.moveTo(other, 1);
+	ASSERT_EQ(queue.numFrames(), 1);
+	ASSERT_EQ(queue.bytesQueued(), 5);
+	ASSERT_EQ(queue.gather(vecs, 8), 2);
+	ASSERT_EQ(sock::ioVecView(vecs[0]).data(), inFlight);
+	ASSERT_EQ(gathered(vecs, other.gather(vecs, 8)), "3\rabc5\rhello");
+}
+
+// Test unsent bytes are copied with their headers and continue where the copy left off
+TEST(TestSendQueue, TestCopyUnsent)
+{
+	SendQueue queue;
+	IoVec vecs[8];
+	queue.push(std::make_shared<const std::string>("abc"));
+	queue.push(std::make_shared<const std::string>("hello"));
+	queue.consume(3);
+
+	std::vector<std::string> frames;
+	queue.copyUnsent(frames);
+	ASSERT_EQ(frames.size(), 2);
+	ASSERT_EQ(frames[0], "bc");
+	ASSERT_EQ(frames[1], "5\rhello");
+	ASSERT_EQ(queue.numFrames(), 2);
+
+	// Framed bytes go out as they are, without a second header
+	SendQueue successor;
+	for (const std::string& frame : frames)
+		successor.pushFramed(std::make_shared<const std::string>(frame));
+	ASSERT_EQ(successor.bytesQueued(), 9);
+	ASSERT_EQ(gathered(vecs, successor.gather(vecs, 8)), "bc5\rhello");
+	successor.consume(9);
+	ASSERT_TRUE(successor.empty());
+}
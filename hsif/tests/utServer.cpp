@@ -1,8 +1,12 @@
 #include "Server.hpp"
-#include <Windows.h>
+#include "SharedClient.hpp"
 #include "gtest/gtest.h"
 #include <thread>
 #include <future>
+#include <filesystem>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
 
 #define TEST_BUFLEN 1024
 
@@ -10,12 +14,11 @@
 void createTestEndpoint(std::string ip, unsigned int port, std::string id, std::string msg, std::promise<std::string> && p)
 {
     // Socket variables
-    WSADATA wsaData;
     char recvbuf[TEST_BUFLEN];
     int iResult;
     int recvBufLen = TEST_BUFLEN;
     SOCKET testSocket;
-    SOCKADDR_IN serverAddr, senderInfo;
+    sockaddr_in serverAddr = {};
     int retCode;
     int bytesSent, bytesRecv, nlen;
     // Message variables
@@ -23,8 +26,8 @@ void createTestEndpoint(std::string ip, unsigned int port, std::string id, std::
     std::string registrationMsg = std::to_string(registration.length()) + '\r' + registration;
     std::string jsonMsg = std::to_string(msg.length()) + '\r' + msg;
 
-    // Initialize Winsock
-    WSAStartup(MAKEWORD(2, 2), &wsaData);
+    // Initialize socket library
+    sock::startup();
 
     // Bind socket
     testSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -35,7 +38,7 @@ void createTestEndpoint(std::string ip, unsigned int port, std::string id, std::
     serverAddr.sin_addr.s_addr = inet_addr(ip.c_str());
 
     // Make a connection to the HSIF server
-    connect(testSocket, (SOCKADDR*)&serverAddr, sizeof(serverAddr));
+    connect(testSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
     // Send registration and test message
     send(testSocket, registrationMsg.c_str(), registrationMsg.length(), 0);
     bytesSent = send(testSocket, jsonMsg.c_str(), jsonMsg.length(), 0);
@@ -48,6 +51,7 @@ void createTestEndpoint(std::string ip, unsigned int port, std::string id, std::
         recvbuf[bytesRecv] = '\0';
     // Set return value to message received
     p.set_value(std::string(recvbuf));
+    sock::close(testSocket);
 }
 
 // Test endpoint initialization
@@ -63,6 +67,7 @@ TEST(ServerTest, TestConnect)
     auto logger = std::make_shared<Logger>();
     auto server = Server("", 7777, logger, false);
     bool connectSuccess = server.connect();
+    server.cleanup();
     ASSERT_TRUE(connectSuccess);
 }
 
@@ -82,9 +87,13 @@ TEST(ServerTest, TestDeleteEndpoint)
     SOCKET testSock = INVALID_SOCKET;
     auto logger = std::make_shared<Logger>();
     auto server = Server("", 7777, logger, false);
-    server.createEndpoint(testSock);
-    server.deleteEndpoint(0);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    ASSERT_TRUE(server.deleteEndpoint(handle));
     ASSERT_TRUE(server.numEndpoints() == 0);
+    // Removed endpoints can not be deleted or looked up again
+    ASSERT_FALSE(server.deleteEndpoint(handle));
+    ASSERT_TRUE(server.getEndpoint(handle) == nullptr);
 }
 
 // Test register endpoint
@@ -93,8 +102,9 @@ TEST(ServerTest, TestRegisterEndpoint)
     SOCKET testSock = INVALID_SOCKET;
     auto logger = std::make_shared<Logger>();
     auto server = Server("", 7777, logger, false);
-    server.createEndpoint(testSock);
-    bool success = server.registerEndpoint("testId", 0);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    bool success = server.registerEndpoint("testId", handle);
     ASSERT_TRUE(success);
 }
 
@@ -104,8 +114,9 @@ TEST(ServerTest, TestGetEndpoint)
     SOCKET testSock = INVALID_SOCKET;
     auto logger = std::make_shared<Logger>();
     auto server = Server("", 7777, logger, false);
-    server.createEndpoint(testSock);
-    server.registerEndpoint("testId", 0);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    server.registerEndpoint("testId", handle);
     auto returnedEndpoint = server.getEndpoint("testId");
     ASSERT_TRUE(returnedEndpoint->socket == testSock);
     ASSERT_TRUE(returnedEndpoint->id == "testId");
@@ -121,12 +132,621 @@ TEST(ServerTest, TestRouting)
 
     auto logger = std::make_shared<Logger>();
     auto server = Server("", 7777, logger, false);
-    server.createEndpoint(testSock);
-    server.routeMessage(regMsg, 0);
-    server.routeMessage(msg, 0);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    server.routeMessage(regMsg, handle);
+    server.routeMessage(msg, handle);
+    std::shared_ptr<Endpoint> endpoint = server.getEndpoint("testId");
+    ASSERT_TRUE(endpoint != nullptr);
+    ASSERT_TRUE(finalMsg.size() == endpoint->outbound.bytesQueued());
+}
+
+// Test header routing forwards the sender's bytes unchanged
+TEST(ServerTest, TestHeaderRouting)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string regMsg = "{ \"type\" : \"registration\", \"value\" : \"testId\" }";
+    std::string msg = "{ \"type\" : \"message\", \"from\" : \"testId\", \"to\" : \"testId\", \"data\" : { \"data\" : \"testData\" } }";
+    std::string finalMsg = std::to_string(msg.length()) + '\r' + msg;
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setRoutingMode(RoutingMode::Header);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    server.routeMessage(regMsg, handle);
+    server.routeMessage(msg, handle);
     std::shared_ptr<Endpoint> endpoint = server.getEndpoint("testId");
     ASSERT_TRUE(endpoint != nullptr);
-    ASSERT_TRUE(finalMsg.size() == endpoint->contentSize);
+    ASSERT_TRUE(finalMsg.size() == endpoint->outbound.bytesQueued());
+    size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+    ASSERT_TRUE(count == 2);
+    ASSERT_TRUE(sock::ioVecView(endpoint->sendVecs[1]) == msg);
+}
+
+// Test batches are split and each message routed in order, in both routing modes
+TEST(ServerTest, TestBatchRouting)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string regMsg = "{\"type\":\"registration\",\"value\":\"testId\"}";
+    std::string batch = "{ \"type\" : \"batch\", \"messages\" : [ "
+        "{ \"type\" : \"message\", \"from\" : \"testId\", \"to\" : \"testId\", \"data\" : { \"seq\" : 1 } }, "
+        "{ \"type\" : \"batch\", \"messages\" : [] }, "
+        "{ \"type\" : \"subscribe\", \"value\" : \"news\" }, "
+        "{ \"type\" : \"message\", \"from\" : \"testId\", \"to\" : \"testId\", \"data\" : { \"seq\" : 2 } } ] }";
+
+    for (RoutingMode mode : { RoutingMode::Parse, RoutingMode::Header })
+    {
+        auto logger = std::make_shared<Logger>();
+        auto server = Server("", 7777, logger, false);
+        server.setRoutingMode(mode);
+        EndpointHandle handle;
+        server.createEndpoint(testSock, handle);
+        server.routeMessage(regMsg, handle);
+        server.routeMessage(batch, handle);
+
+        std::shared_ptr<Endpoint> endpoint = server.getEndpoint("testId");
+        ASSERT_EQ(endpoint->outbound.numFrames(), 2);
+        ASSERT_EQ(server.numSubscribers("news"), 1);
+        ASSERT_EQ(server.stats().batchesRouted, 1);
+        size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+        ASSERT_EQ(count, 4);
+        ASSERT_EQ(json::parse(sock::ioVecView(endpoint->sendVecs[1]))["data"]["seq"], 1);
+        ASSERT_EQ(json::parse(sock::ioVecView(endpoint->sendVecs[3]))["data"]["seq"], 2);
+    }
+}
+
+// Test stats requests are answered in place with counters of the whole server
+TEST(ServerTest, TestStatsRequest)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string regMsg = "{\"type\":\"registration\",\"value\":\"monitor\"}";
+    std::string statsMsg = "{ \"type\" : \"stats\" }";
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setRoutingMode(RoutingMode::Header);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    server.routeMessage(regMsg, handle);
+    server.routeMessage(statsMsg, handle);
+
+    std::shared_ptr<Endpoint> endpoint = server.getEndpoint("monitor");
+    ASSERT_EQ(endpoint->outbound.numFrames(), 1);
+    size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+    ASSERT_EQ(count, 2);
+    json reply = json::parse(sock::ioVecView(endpoint->sendVecs[1]));
+    ASSERT_EQ(reply["type"], "stats");
+    ASSERT_EQ(reply["to"], "monitor");
+    ASSERT_EQ(reply["value"]["counters"]["hsif_stats_requests_total"], 1);
+    ASSERT_EQ(reply["value"]["gauges"]["hsif_registered_endpoints"], 1);
+    ASSERT_EQ(reply["value"]["endpoints"][0]["id"], "monitor");
+    ASSERT_TRUE(reply["value"]["latency"].contains("hsif_delivery_latency_seconds"));
+
+    // Sending the reply counts its bytes against the endpoint
+    endpoint->processSent(endpoint->outbound.bytesQueued(), nullptr);
+    MetricsSnapshot snapshot = server.metrics()->snapshot();
+    ASSERT_EQ(snapshot.endpoints[0].messagesOut, 1);
+    ASSERT_EQ(snapshot.endpoints[0].queuedBytes, 0);
+}
+
+// Test messages for an unregistered destination wait until it registers, in its negotiated framing
+TEST(ServerTest, TestParkedDelivery)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string msg = "{\"type\":\"message\",\"from\":\"sensor\",\"to\":\"unity\",\"data\":{\"temp\":21.5}}";
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setParkingPolicy({ std::chrono::seconds(30), 2, 100, DropPolicy::DropOldest });
+    EndpointHandle sensor, unity;
+    server.createEndpoint(testSock, sensor);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"sensor\"}", sensor);
+    for (int count = 0; count < 3; count++)
+        server.routeMessage(msg, sensor);
+    ASSERT_EQ(server.numParked("unity"), 2);
+    ASSERT_EQ(server.stats().messagesParked, 3);
+    ASSERT_EQ(server.stats().messagesDropped, 1);
+
+    // Parked messages outlive their sender and are released by the registration alone
+    server.deleteEndpoint(sensor);
+    server.createEndpoint(testSock, unity);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"unity\",\"framing\":\"cbor\"}", unity);
+    ASSERT_EQ(server.numParked("unity"), 0);
+    std::shared_ptr<Endpoint> endpoint = server.getEndpoint("unity");
+    ASSERT_EQ(endpoint->outbound.numFrames(), 2);
+    ASSERT_EQ(endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS), 4);
+    ASSERT_TRUE(framing::decode(sock::ioVecView(endpoint->sendVecs[1]), WireFormat::Cbor) == json::parse(msg));
+    ASSERT_EQ(server.stats().messagesRouted, 2);
+}
+
+// Test a conflating receiver keeps only the newest undelivered message per sender and key, in both routing modes
+TEST(ServerTest, TestConflation)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string regMsg = "{\"type\":\"registration\",\"value\":\"unity\",\"conflate\":true}";
+    auto reading = [](const char* key, int seq)
+    {
+        return "{\"type\":\"message\",\"from\":\"sensor\",\"to\":\"unity\",\"data\":{\"seq\":" + std::to_string(seq) + "},\"key\":\"" + key + "\"}";
+    };
+
+    for (RoutingMode mode : { RoutingMode::Parse, RoutingMode::Header })
+    {
+        auto logger = std::make_shared<Logger>();
+        auto server = Server("", 7777, logger, false);
+        server.setRoutingMode(mode);
+        EndpointHandle sensor, unity;
+        server.createEndpoint(testSock, sensor);
+        server.createEndpoint(testSock, unity);
+        server.registerEndpoint("sensor", sensor);
+        server.routeMessage(regMsg, unity);
+        std::shared_ptr<Endpoint> receiver = server.getEndpoint("unity");
+        ASSERT_TRUE(receiver->conflate);
+
+        for (int seq = 0; seq < 100; seq++)
+        {
+            server.routeMessage(reading("temp", seq), sensor);
+            server.routeMessage(reading("humidity", seq), sensor);
+        }
+        ASSERT_EQ(receiver->outbound.numFrames(), 2);
+        ASSERT_EQ(server.stats().messagesRouted, 200);
+        ASSERT_EQ(server.stats().messagesConflated, 198);
+        ASSERT_EQ(receiver->outbound.gather(receiver->sendVecs, SEND_IOVECS), 4);
+        ASSERT_EQ(json::parse(sock::ioVecView(receiver->sendVecs[1]))["key"], "temp");
+        ASSERT_EQ(json::parse(sock::ioVecView(receiver->sendVecs[1]))["data"]["seq"], 99);
+        ASSERT_EQ(json::parse(sock::ioVecView(receiver->sendVecs[3]))["data"]["seq"], 99);
+    }
+}
+
+// Test a conflated topic conflates at subscribers that did not ask for it
+TEST(ServerTest, TestTopicConflation)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string subMsg = "{\"type\":\"subscribe\",\"value\":\"temperature\"}";
+    std::string msg = "{\"type\":\"publish\",\"from\":\"sensor\",\"to\":\"temperature\",\"data\":{\"value\":21.5}}";
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    EndpointHandle sensor, display;
+    server.createEndpoint(testSock, sensor);
+    server.createEndpoint(testSock, display);
+    server.registerEndpoint("display", display);
+    server.routeMessage(subMsg, display);
+    std::shared_ptr<Endpoint> subscriber = server.getEndpoint(display);
+
+    server.routeMessage(msg, sensor);
+    server.routeMessage(msg, sensor);
+    ASSERT_EQ(subscriber->outbound.numFrames(), 2);
+    server.setTopicConflation("temperature", true);
+    server.routeMessage(msg, sensor);
+    server.routeMessage(msg, sensor);
+    ASSERT_EQ(subscriber->outbound.numFrames(), 3);
+    ASSERT_EQ(server.stats().messagesConflated, 1);
+}
+
+// Test a receiver past its high watermark blocks its sender until it drains to its low watermark
+TEST(ServerTest, TestBackpressureBlock)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string msg = "{\"type\":\"message\",\"from\":\"sensor\",\"to\":\"unity\",\"data\":{\"temp\":21.5}}";
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setBackpressurePolicy({ 200, 100, OverflowPolicy::Block });
+    EndpointHandle sensor, unity;
+    server.createEndpoint(testSock, sensor);
+    server.createEndpoint(testSock, unity);
+    server.registerEndpoint("sensor", sensor);
+    server.registerEndpoint("unity", unity);
+    std::shared_ptr<Endpoint> sender = server.getEndpoint(sensor);
+    std::shared_ptr<Endpoint> receiver = server.getEndpoint(unity);
+
+    while (receiver->outbound.bytesQueued() <= 200)
+    {
+        ASSERT_EQ(sender->blockedOn, 0);
+        server.routeMessage(msg, sensor);
+    }
+    ASSERT_EQ(sender->blockedOn, 1);
+    ASSERT_TRUE(receiver->pressured);
+    ASSERT_EQ(server.stats().pausedSenders, 1);
+    ASSERT_EQ(server.stats().pressuredEndpoints, 1);
+
+    // Draining above the low watermark keeps the sender paused
+    receiver->outbound.consume(receiver->outbound.bytesQueued() - 150);
+    server.relievePressure(receiver);
+    ASSERT_EQ(sender->blockedOn, 1);
+    receiver->outbound.consume(receiver->outbound.bytesQueued());
+    server.relievePressure(receiver);
+    ASSERT_EQ(sender->blockedOn, 0);
+    ASSERT_FALSE(receiver->pressured);
+    ASSERT_EQ(server.stats().pausedSenders, 0);
+    ASSERT_EQ(server.stats().senderPauses, 1);
+}
+
+// Test frames for an idle receiver are held until its byte budget fills
+TEST(ServerTest, TestCoalescingHold)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string msg = "{\"type\":\"message\",\"from\":\"sensor\",\"to\":\"unity\",\"data\":{\"temp\":21.5}}";
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setCoalescingPolicy({ 1000000, 200, false, false });
+    EndpointHandle sensor, unity;
+    server.createEndpoint(testSock, sensor);
+    server.createEndpoint(testSock, unity);
+    server.registerEndpoint("sensor", sensor);
+    server.registerEndpoint("unity", unity);
+    std::shared_ptr<Endpoint> receiver = server.getEndpoint(unity);
+
+    server.routeMessage(msg, sensor);
+    ASSERT_NE(receiver->flushDeadline, 0);
+    while (receiver->outbound.bytesQueued() < 200)
+    {
+        ASSERT_NE(receiver->flushDeadline, 0);
+        server.routeMessage(msg, sensor);
+    }
+    ASSERT_EQ(receiver->flushDeadline, 0);
+    ASSERT_EQ(server.stats().coalescedWrites, 1);
+
+    // Removing a receiver discards its window
+    server.routeMessage(msg, sensor);
+    receiver->outbound.consume(receiver->outbound.bytesQueued());
+    server.routeMessage(msg, sensor);
+    ASSERT_NE(receiver->flushDeadline, 0);
+    server.deleteEndpoint(unity);
+    ASSERT_EQ(receiver->flushDeadline, 0);
+}
+
+// Test drop-oldest and disconnect overflow policies bound a slow receiver
+TEST(ServerTest, TestBackpressureOverflow)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string msg = "{\"type\":\"message\",\"from\":\"sensor\",\"to\":\"unity\",\"data\":{\"temp\":21.5}}";
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    EndpointHandle sensor, unity;
+    server.createEndpoint(testSock, sensor);
+    server.createEndpoint(testSock, unity);
+    server.registerEndpoint("sensor", sensor);
+    server.registerEndpoint("unity", unity);
+    std::shared_ptr<Endpoint> receiver = server.getEndpoint(unity);
+
+    server.setBackpressurePolicy(unity, { 200, 100, OverflowPolicy::DropOldest });
+    for (int count = 0; count < 10; count++)
+        server.routeMessage(msg, sensor);
+    ASSERT_LE(receiver->outbound.bytesQueued(), 200);
+    ASSERT_EQ(server.stats().overflowDrops, 10 - receiver->outbound.numFrames());
+    ASSERT_EQ(server.getEndpoint(sensor)->blockedOn, 0);
+
+    // Slow consumer is removed at the end of the poll, the sender is untouched
+    server.setBackpressurePolicy(unity, { 200, 100, OverflowPolicy::Disconnect });
+    server.routeMessage(msg, sensor);
+    server.routeMessage(msg, sensor);
+    ASSERT_TRUE(server.getEndpoint(unity) != nullptr);
+    server.serviceOverflow();
+    ASSERT_TRUE(server.getEndpoint(unity) == nullptr);
+    ASSERT_TRUE(server.getEndpoint(sensor) != nullptr);
+    ASSERT_EQ(server.stats().overflowDisconnects, 1);
+}
+
+// Test text and binary peers are translated between in both directions
+TEST(ServerTest, TestBinaryTranslation)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string textMsg = "{\"type\":\"message\",\"from\":\"unity\",\"to\":\"rpi\",\"data\":{\"led\":true}}";
+    json binaryMsg = { { "type", "message" }, { "from", "rpi" }, { "to", "unity" }, { "data", { { "temp", 21.5 } } } };
+    std::string packed = framing::encode(binaryMsg, WireFormat::MsgPack);
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setRoutingMode(RoutingMode::Header);
+    EndpointHandle unityHandle, rpiHandle, otherHandle;
+    server.createEndpoint(testSock, unityHandle);
+    server.createEndpoint(testSock, rpiHandle);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"unity\"}", unityHandle);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"rpi\",\"framing\":\"msgpack\"}", rpiHandle);
+    std::shared_ptr<Endpoint> unity = server.getEndpoint("unity");
+    std::shared_ptr<Endpoint> rpi = server.getEndpoint("rpi");
+    ASSERT_TRUE(unity->format == WireFormat::Text);
+    ASSERT_TRUE(rpi->format == WireFormat::MsgPack);
+
+    // Text sender, binary receiver
+    server.routeMessage(textMsg, unityHandle);
+    ASSERT_EQ(rpi->outbound.gather(rpi->sendVecs, SEND_IOVECS), 2);
+    std::string_view header = sock::ioVecView(rpi->sendVecs[0]);
+    std::string_view payload = sock::ioVecView(rpi->sendVecs[1]);
+    WireFormat format;
+    uint32_t length;
+    ASSERT_EQ(header.size(), BINARY_HEADER_SIZE);
+    ASSERT_TRUE(framing::readBinaryHeader(header.data(), format, length));
+    ASSERT_TRUE(format == WireFormat::MsgPack);
+    ASSERT_EQ(length, payload.size());
+    ASSERT_TRUE(framing::decode(payload, WireFormat::MsgPack) == json::parse(textMsg));
+
+    // Binary sender, text receiver
+    server.routeMessage(RecvFrame{ packed, WireFormat::MsgPack }, rpiHandle);
+    ASSERT_EQ(unity->outbound.gather(unity->sendVecs, SEND_IOVECS), 2);
+    ASSERT_TRUE(json::parse(sock::ioVecView(unity->sendVecs[1])) == binaryMsg);
+
+    // Unknown framing is refused
+    server.createEndpoint(testSock, otherHandle);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"other\",\"framing\":\"xml\"}", otherHandle);
+    ASSERT_TRUE(server.getEndpoint("other") == nullptr);
+}
+
+// Test a publish is framed once and queued by reference on every subscriber
+TEST(ServerTest, TestPublish)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string subMsg = "{\"type\":\"subscribe\",\"value\":\"temperature\"}";
+    std::string msg = "{\"type\":\"publish\",\"from\":\"sensor\",\"to\":\"temperature\",\"data\":{\"value\":21.5}}";
+
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setRoutingMode(RoutingMode::Header);
+    EndpointHandle handles[4];
+    server.createEndpoint(testSock, handles[0]);
+    for (size_t index = 1; index < 4; index++)
+    {
+        server.createEndpoint(testSock, handles[index]);
+        server.registerEndpoint("display" + std::to_string(index), handles[index]);
+        server.routeMessage(subMsg, handles[index]);
+    }
+    // Repeated subscription is ignored
+    server.routeMessage(subMsg, handles[1]);
+    ASSERT_EQ(server.numSubscribers("temperature"), 3);
+
+    server.routeMessage(msg, handles[0]);
+    const char* shared = nullptr;
+    for (size_t index = 1; index < 4; index++)
+    {
+        std::shared_ptr<Endpoint> endpoint = server.getEndpoint("display" + std::to_string(index));
+        ASSERT_EQ(endpoint->outbound.numFrames(), 1);
+        ASSERT_EQ(endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS), 2);
+        ASSERT_TRUE(sock::ioVecView(endpoint->sendVecs[1]) == msg);
+        // Every subscriber sends from the same buffer
+        const char* data = sock::ioVecView(endpoint->sendVecs[1]).data();
+        ASSERT_TRUE(shared == nullptr || shared == data);
+        shared = data;
+    }
+    ASSERT_EQ(server.stats().messagesPublished, 1);
+    ASSERT_EQ(server.stats().messagesRouted, 3);
+
+    // Unsubscribed endpoints no longer receive publishes
+    server.routeMessage("{\"type\":\"unsubscribe\",\"value\":\"temperature\"}", handles[1]);
+    server.deleteEndpoint(handles[2]);
+    ASSERT_EQ(server.numSubscribers("temperature"), 1);
+}
+
+// Test frames that do not decode or lack a required field are dropped and counted
+TEST(ServerTest, TestMalformedMessages)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    server.registerEndpoint("testId", handle);
+
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"message\",\"to\":", handle));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"message\",\"from\":\"testId\",\"to\":5}", handle));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"subscribe\",\"value\":[\"temperature\"]}", handle));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"registration\",\"value\":\"otherTestId\",\"framing\":1}", handle));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"batch\",\"messages\":[{\"type\":\"publish\"}]}", handle));
+    ASSERT_FALSE(server.routeMessage("[]", handle));
+    ASSERT_EQ(server.stats().messagesMalformed, 6);
+    ASSERT_EQ(server.numSubscribers("temperature"), 0);
+
+    // Well-formed messages still route
+    ASSERT_TRUE(server.routeMessage("{\"type\":\"message\",\"from\":\"testId\",\"to\":\"testId\",\"data\":{}}", handle));
+    ASSERT_EQ(server.stats().messagesRouted, 1);
+    ASSERT_EQ(server.stats().messagesMalformed, 6);
+}
+
+// Test malformed frames the header scan hands to the full parser are dropped too
+TEST(ServerTest, TestMalformedMessagesHeader)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setRoutingMode(RoutingMode::Header);
+    EndpointHandle handle;
+    server.createEndpoint(testSock, handle);
+    server.registerEndpoint("testId", handle);
+
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"message\",\"to\":\"testId", handle));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"message\",\"from\":\"testId\",\"to\":5}", handle));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"publish\",\"from\":\"testId\"}", handle));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"channel\",\"value\":{}}", handle));
+    ASSERT_EQ(server.stats().messagesMalformed, 4);
+    ASSERT_EQ(server.stats().messagesParked, 0);
+
+    ASSERT_TRUE(server.routeMessage("{\"type\":\"message\",\"from\":\"testId\",\"to\":\"testId\",\"data\":{}}", handle));
+    ASSERT_EQ(server.stats().messagesRouted, 1);
+}
+
+// Test header-routed bodies that are not JSON are dropped where a receiver needs them parsed
+TEST(ServerTest, TestMalformedBodyHeader)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setRoutingMode(RoutingMode::Header);
+    EndpointHandle sender, binary, latest, parked;
+    server.createEndpoint(testSock, sender);
+    server.createEndpoint(testSock, binary);
+    server.createEndpoint(testSock, latest);
+    server.createEndpoint(testSock, parked);
+    server.registerEndpoint("sensor", sender);
+    ASSERT_TRUE(server.routeMessage("{\"type\":\"registration\",\"value\":\"unity\",\"framing\":\"msgpack\"}", binary));
+    ASSERT_TRUE(server.routeMessage("{\"type\":\"registration\",\"value\":\"latest\",\"conflate\":true}", latest));
+
+    // A receiver taking another encoding, and one needing a conflation key
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"message\",\"to\":\"unity\",\"from\":\"sensor\",\"data\": nope}", sender));
+    ASSERT_FALSE(server.routeMessage("{\"type\":\"message\",\"to\":\"latest\",\"from\":\"sensor\",\"data\": {", sender));
+    ASSERT_EQ(server.stats().messagesMalformed, 2);
+    ASSERT_TRUE(server.getEndpoint("unity")->outbound.empty());
+    ASSERT_TRUE(server.getEndpoint("latest")->outbound.empty());
+
+    // Parked bytes are only checked once their receiver registers
+    ASSERT_TRUE(server.routeMessage("{\"type\":\"message\",\"to\":\"later\",\"from\":\"sensor\",\"data\": nope}", sender));
+    ASSERT_TRUE(server.routeMessage("{\"type\":\"registration\",\"value\":\"later\",\"framing\":\"cbor\"}", parked));
+    ASSERT_EQ(server.stats().messagesMalformed, 3);
+    ASSERT_TRUE(server.getEndpoint("later")->outbound.empty());
+
+    ASSERT_TRUE(server.routeMessage("{\"type\":\"message\",\"to\":\"unity\",\"from\":\"sensor\",\"data\":1}", sender));
+    ASSERT_EQ(server.getEndpoint("unity")->outbound.numFrames(), 1);
+}
+
+// Test removing endpoints keeps every other handle and registration pointing at the right endpoint
+TEST(ServerTest, TestHandleChurn)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    std::vector<EndpointHandle> handles(8);
+    for (size_t index = 0; index < handles.size(); index++)
+    {
+        server.createEndpoint(INVALID_SOCKET, handles[index]);
+        server.registerEndpoint("id" + std::to_string(index), handles[index]);
+    }
+
+    // Removing from the front moves the last endpoint into the freed position
+    server.deleteEndpoint(handles[0]);
+    server.deleteEndpoint(handles[3]);
+    ASSERT_EQ(server.numEndpoints(), 6);
+    ASSERT_EQ(server.numRegisteredEndpoints(), 6);
+    for (size_t index = 0; index < handles.size(); index++)
+    {
+        std::shared_ptr<Endpoint> endpoint = server.getEndpoint("id" + std::to_string(index));
+        if (index == 0 || index == 3)
+        {
+            ASSERT_TRUE(endpoint == nullptr);
+            continue;
+        }
+        ASSERT_TRUE(endpoint == server.getEndpoint(handles[index]));
+        ASSERT_EQ(endpoint->id, "id" + std::to_string(index));
+    }
+
+    // A reused slot never answers to the handle of its previous occupant
+    EndpointHandle reused;
+    server.createEndpoint(INVALID_SOCKET, reused);
+    ASSERT_TRUE(reused.slot == handles[3].slot);
+    ASSERT_TRUE(server.getEndpoint(handles[3]) == nullptr);
+    ASSERT_FALSE(server.registerEndpoint("stale", handles[3]));
+}
+
+// Test a session is taken over with its unsent frames and subscriptions, and keeps queueing while disconnected
+TEST(ServerTest, TestSessionResume)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    std::string regMsg = "{\"type\":\"registration\",\"value\":\"rpi\",\"session\":\"s3cret\"}";
+    auto message = [](int seq)
+    {
+        return "{\"type\":\"message\",\"from\":\"unity\",\"to\":\"rpi\",\"data\":{\"seq\":" + std::to_string(seq) + "}}";
+    };
+    // Parses the frame at an index of an endpoint's queue
+    auto queued = [](const std::shared_ptr<Endpoint>& endpoint, size_t index)
+    {
+        endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+        return json::parse(sock::ioVecView(endpoint->sendVecs[index * 2 + 1]));
+    };
+
+    for (RoutingMode mode : { RoutingMode::Parse, RoutingMode::Header })
+    {
+        auto logger = std::make_shared<Logger>();
+        auto server = Server("", 7777, logger, false);
+        server.setRoutingMode(mode);
+        EndpointHandle sender, first, intruder, second, third;
+        server.createEndpoint(testSock, sender);
+        server.createEndpoint(testSock, first);
+        server.routeMessage("{\"type\":\"registration\",\"value\":\"unity\"}", sender);
+        server.routeMessage(regMsg, first);
+        server.routeMessage("{\"type\":\"subscribe\",\"value\":\"temps\"}", first);
+        std::shared_ptr<Endpoint> endpoint = server.getEndpoint("rpi");
+        ASSERT_EQ(endpoint->outbound.numFrames(), 1);
+        ASSERT_EQ(queued(endpoint, 0)["type"], "session");
+        ASSERT_EQ(queued(endpoint, 0)["resume"], 0);
+        ASSERT_EQ(queued(endpoint, 0)["resumed"], false);
+
+        // The session message and one message are sent, the next is cut off mid-frame
+        server.routeMessage(message(0), sender);
+        size_t sent = endpoint->outbound.bytesQueued();
+        server.routeMessage(message(1), sender);
+        endpoint->processSent(sent + 3, nullptr);
+        ASSERT_EQ(endpoint->framesSent, 2);
+
+        // Without the token, or with another, the identifier stays taken
+        server.createEndpoint(testSock, intruder);
+        server.routeMessage("{\"type\":\"registration\",\"value\":\"rpi\"}", intruder);
+        server.routeMessage("{\"type\":\"registration\",\"value\":\"rpi\",\"session\":\"guess\"}", intruder);
+        ASSERT_TRUE(server.getEndpoint("rpi") == endpoint);
+
+        // The client reconnects before its old connection is reaped
+        server.createEndpoint(testSock, second);
+        server.routeMessage(regMsg, second);
+        std::shared_ptr<Endpoint> resumed = server.getEndpoint("rpi");
+        ASSERT_TRUE(resumed == server.getEndpoint(second));
+        ASSERT_TRUE(server.getEndpoint(first) == nullptr);
+        ASSERT_EQ(resumed->outbound.numFrames(), 2);
+        ASSERT_EQ(queued(resumed, 0)["resume"], 2);
+        ASSERT_EQ(queued(resumed, 0)["resumed"], true);
+        ASSERT_EQ(queued(resumed, 1)["data"]["seq"], 1);
+        ASSERT_EQ(server.numSubscribers("temps"), 1);
+
+        // Disconnected, the session keeps queueing messages and publishes
+        server.deleteEndpoint(second);
+        ASSERT_EQ(server.numDetachedSessions(), 1);
+        server.routeMessage(message(2), sender);
+        server.routeMessage("{\"type\":\"publish\",\"from\":\"unity\",\"to\":\"temps\",\"data\":{\"seq\":3}}", sender);
+        server.routeMessage("{\"type\":\"registration\",\"value\":\"rpi\"}", intruder);
+        ASSERT_EQ(server.numParked("rpi"), 0);
+
+        // The unsent session message of the connection that dropped is replaced, not repeated
+        server.createEndpoint(testSock, third);
+        server.routeMessage(regMsg, third);
+        std::shared_ptr<Endpoint> last = server.getEndpoint("rpi");
+        ASSERT_TRUE(last == server.getEndpoint(third));
+        ASSERT_EQ(server.numDetachedSessions(), 0);
+        ASSERT_EQ(last->outbound.numFrames(), 4);
+        ASSERT_EQ(queued(last, 0)["resume"], 2);
+        for (int seq = 1; seq <= 3; seq++)
+            ASSERT_EQ(queued(last, seq)["data"]["seq"], seq);
+        ASSERT_EQ(server.numSubscribers("temps"), 1);
+        ASSERT_EQ(server.stats().sessionsResumed, 2);
+    }
+}
+
+// Test senders a disconnected session blocked stay blocked until the resumed connection drains
+TEST(ServerTest, TestSessionBackpressure)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7777, logger, false);
+    server.setBackpressurePolicy({ 200, 0, OverflowPolicy::Block });
+    EndpointHandle sender, first, second;
+    server.createEndpoint(testSock, sender);
+    server.createEndpoint(testSock, first);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"unity\"}", sender);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"rpi\",\"session\":\"s3cret\"}", first);
+    server.deleteEndpoint(first);
+    for (int seq = 0; seq < 4; seq++)
+        server.routeMessage("{\"type\":\"message\",\"from\":\"unity\",\"to\":\"rpi\",\"data\":{\"seq\":" + std::to_string(seq) + "}}", sender);
+    ASSERT_EQ(server.stats().pressuredEndpoints, 1);
+    ASSERT_EQ(server.stats().pausedSenders, 1);
+
+    server.createEndpoint(testSock, second);
+    server.routeMessage("{\"type\":\"registration\",\"value\":\"rpi\",\"session\":\"s3cret\"}", second);
+    std::shared_ptr<Endpoint> endpoint = server.getEndpoint(second);
+    ASSERT_EQ(server.stats().pressuredEndpoints, 1);
+    ASSERT_EQ(server.stats().pausedSenders, 1);
+    ASSERT_EQ(server.getEndpoint(sender)->blockedOn, 1);
+    endpoint->processSent(endpoint->outbound.bytesQueued(), nullptr);
+    server.relievePressure(endpoint);
+    ASSERT_EQ(server.stats().pressuredEndpoints, 0);
+    ASSERT_EQ(server.stats().pausedSenders, 0);
+    ASSERT_EQ(endpoint->framesSent, 5);
 }
 
 // Test endpoint polling from two separate 
@@ -143,17 +763,694 @@ TEST(ServerTest, TestEndpointPoll)
 
     std::thread ep1(&createTestEndpoint, "127.0.0.1", 7777, "testId", "{ \"type\" : \"message\", \"from\" : \"testId\", \"to\" : \"otherTestId\", \"data\": { \"data\" :\"testData\" } }", std::move(p));
     std::thread ep2(&createTestEndpoint, "127.0.0.1", 7777, "otherTestId", "{ \"type\" : \"message\", \"from\" : \"otherTestId\", \"to\" : \"testId\", \"data\": { \"data\" :\"otherTestData\" } }", std::move(p2));
-    // Poll a few times. Polling executes small steps to be more performant. Poll multiple times to get to point where both endpoints have received messages.
-    success = server.poll();
-    success = server.poll();
-    success = server.poll();
-    success = server.poll();
-    success = server.poll();
+    // Poll until both endpoints have received messages. Polling executes small steps to be more performant, and each
+    // endpoint closes after receiving, so every poll until both are done has an event to wake on.
+    while (success && (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready ||
+                       f2.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+        success = server.poll();
     ep2.join();
     ep1.join();
+    server.cleanup();
     auto data1 = f.get();
     auto data2 = f2.get();
     ASSERT_TRUE(success);
     ASSERT_TRUE(data1 == "85\r{\"data\":{\"data\":\"otherTestData\"},\"from\":\"otherTestId\",\"to\":\"testId\",\"type\":\"message\"}");
     ASSERT_TRUE(data2 == "80\r{\"data\":{\"data\":\"testData\"},\"from\":\"testId\",\"to\":\"otherTestId\",\"type\":\"message\"}");
 }
+
+#ifdef __linux__
+// Test epoll backend selection
+TEST(ServerTest, TestEpollConnect)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("", 7778, logger, false, PollBackend::Epoll);
+    bool connectSuccess = server.connect();
+    server.cleanup();
+    ASSERT_TRUE(connectSuccess);
+    ASSERT_TRUE(server.backend() == PollBackend::Epoll);
+}
+
+// Test running out of descriptors while accepting keeps the server polling
+TEST(ServerTest, TestAcceptExhaustedEpoll)
+{
+    auto logger = std::make_shared<Logger>();
+    Server server("127.0.0.1", 7799, logger, false, PollBackend::Epoll);
+    ASSERT_TRUE(server.connect());
+    SOCKET client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in serverAddr = {};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(7799);
+    inet_pton(AF_INET, "127.0.0.1", &serverAddr.sin_addr);
+
+    // Cap descriptors at the lowest free one, so the accepted connection has none left
+    rlimit previous;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &previous), 0);
+    int lowest = dup(client);
+    ::close(lowest);
+    rlimit capped = { static_cast<rlim_t>(lowest), previous.rlim_max };
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &capped), 0);
+    bool connected = connect(client, (sockaddr*)&serverAddr, sizeof(serverAddr)) == 0;
+    bool polled = server.poll();
+    setrlimit(RLIMIT_NOFILE, &previous);
+
+    ASSERT_TRUE(connected);
+    ASSERT_TRUE(polled);
+    ASSERT_EQ(server.numEndpoints(), 0);
+    sock::close(client);
+    server.cleanup();
+}
+
+// Test io_uring backs off when accept runs out of descriptors and accepts again once they free up
+TEST(ServerTest, TestAcceptExhaustedUring)
+{
+    auto logger = std::make_shared<Logger>();
+    Server server("127.0.0.1", 7800, logger, false, PollBackend::Uring);
+    ASSERT_TRUE(server.connect());
+    SOCKET client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in serverAddr = {};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(7800);
+    inet_pton(AF_INET, "127.0.0.1", &serverAddr.sin_addr);
+
+    // Cap descriptors at the lowest free one, so the kernel has none to accept into
+    rlimit previous;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &previous), 0);
+    int lowest = dup(client);
+    ::close(lowest);
+    rlimit capped = { static_cast<rlim_t>(lowest), previous.rlim_max };
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &capped), 0);
+    bool connected = connect(client, (sockaddr*)&serverAddr, sizeof(serverAddr)) == 0;
+    bool polled = server.poll();
+    size_t exhausted = server.numEndpoints();
+    setrlimit(RLIMIT_NOFILE, &previous);
+
+    ASSERT_TRUE(connected);
+    ASSERT_TRUE(polled);
+    ASSERT_EQ(exhausted, 0);
+    // The back-off re-arms the accept, and the waiting connection is taken
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (server.numEndpoints() == 0 && std::chrono::steady_clock::now() < deadline)
+        ASSERT_TRUE(server.poll());
+    ASSERT_EQ(server.numEndpoints(), 1);
+    sock::close(client);
+    server.cleanup();
+}
+
+// Test endpoint polling from two separate endpoints using the epoll reactor
+TEST(ServerTest, TestEndpointPollEpoll)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("127.0.0.1", 7778, logger, false, PollBackend::Epoll);
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    std::promise<std::string> p;
+    auto f = p.get_future();
+    std::promise<std::string> p2;
+    auto f2 = p2.get_future();
+
+    std::thread ep1(&createTestEndpoint, "127.0.0.1", 7778, "testId", "{ \"type\" : \"message\", \"from\" : \"testId\", \"to\" : \"otherTestId\", \"data\": { \"data\" :\"testData\" } }", std::move(p));
+    std::thread ep2(&createTestEndpoint, "127.0.0.1", 7778, "otherTestId", "{ \"type\" : \"message\", \"from\" : \"otherTestId\", \"to\" : \"testId\", \"data\": { \"data\" :\"otherTestData\" } }", std::move(p2));
+    // Each endpoint closes after receiving, so every poll until both are done has an event to wake on
+    while (success && (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready ||
+                       f2.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+        success = server.poll();
+    ep2.join();
+    ep1.join();
+    server.cleanup();
+    ASSERT_TRUE(success);
+    ASSERT_TRUE(f.get() == "85\r{\"data\":{\"data\":\"otherTestData\"},\"from\":\"otherTestId\",\"to\":\"testId\",\"type\":\"message\"}");
+    ASSERT_TRUE(f2.get() == "80\r{\"data\":{\"data\":\"testData\"},\"from\":\"testId\",\"to\":\"otherTestId\",\"type\":\"message\"}");
+}
+
+// Test endpoint polling from two separate endpoints using io_uring
+TEST(ServerTest, TestEndpointPollUring)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("127.0.0.1", 7780, logger, false, PollBackend::Uring);
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    std::promise<std::string> p;
+    auto f = p.get_future();
+    std::promise<std::string> p2;
+    auto f2 = p2.get_future();
+
+    std::thread ep1(&createTestEndpoint, "127.0.0.1", 7780, "testId", "{ \"type\" : \"message\", \"from\" : \"testId\", \"to\" : \"otherTestId\", \"data\": { \"data\" :\"testData\" } }", std::move(p));
+    std::thread ep2(&createTestEndpoint, "127.0.0.1", 7780, "otherTestId", "{ \"type\" : \"message\", \"from\" : \"otherTestId\", \"to\" : \"testId\", \"data\": { \"data\" :\"otherTestData\" } }", std::move(p2));
+    while (success && (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready ||
+                       f2.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+        success = server.poll();
+    ep2.join();
+    ep1.join();
+    ServerStats stats = server.stats();
+    server.cleanup();
+    ASSERT_TRUE(success);
+    ASSERT_TRUE(f.get() == "85\r{\"data\":{\"data\":\"otherTestData\"},\"from\":\"otherTestId\",\"to\":\"testId\",\"type\":\"message\"}");
+    ASSERT_TRUE(f2.get() == "80\r{\"data\":{\"data\":\"testData\"},\"from\":\"testId\",\"to\":\"otherTestId\",\"type\":\"message\"}");
+    ASSERT_EQ(stats.messagesRouted, 2);
+    ASSERT_GT(stats.syscalls, 0);
+}
+
+// Test a message far larger than a packet is delivered intact through partial writes
+TEST(ServerTest, TestBulkTransferEpoll)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("127.0.0.1", 7781, logger, false, PollBackend::Epoll);
+    server.setRoutingMode(RoutingMode::Header);
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    std::string registration = "{\"type\":\"registration\",\"value\":\"bulk\"}";
+    std::string msg = "{\"type\":\"message\",\"from\":\"bulk\",\"to\":\"bulk\",\"data\":\"" + std::string(1 << 20, 'x') + "\"}";
+    std::string expected = std::to_string(msg.length()) + '\r' + msg;
+    std::promise<std::string> p;
+    auto f = p.get_future();
+    std::thread client([&]()
+    {
+        SOCKET testSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in serverAddr = {};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(7781);
+        serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        connect(testSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        std::string frames = std::to_string(registration.length()) + '\r' + registration + expected;
+        for (size_t sent = 0; sent < frames.length();)
+            sent += sock::send(testSocket, frames.c_str() + sent, frames.length() - sent);
+
+        // Read until the whole frame came back
+        std::string received;
+        char buffer[65536];
+        int bytes;
+        while (received.length() < expected.length() && (bytes = sock::recv(testSocket, buffer, sizeof(buffer))) > 0)
+            received.append(buffer, bytes);
+        p.set_value(received);
+        sock::close(testSocket);
+    });
+    while (success && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        success = server.poll();
+    client.join();
+    server.cleanup();
+    ASSERT_TRUE(success);
+    ASSERT_TRUE(f.get() == expected);
+}
+
+// Test a batch is delivered through the coalescing window as whole frames
+TEST(ServerTest, TestCoalescingEpoll)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("127.0.0.1", 7784, logger, false, PollBackend::Epoll);
+    server.setCoalescingPolicy({ 2000, 64 * 1024, true, true });
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    std::string registration = "{\"type\":\"registration\",\"value\":\"coalesce\"}";
+    json batch = { { "type", "batch" }, { "messages", json::array() } };
+    for (int seq = 0; seq < 10; seq++)
+        batch["messages"].push_back({ { "type", "message" }, { "from", "coalesce" }, { "to", "coalesce" }, { "data", { { "seq", seq } } } });
+    std::string batchMsg = batch.dump();
+    std::string expected;
+    for (const json& msg : batch["messages"])
+        expected += std::to_string(msg.dump().length()) + '\r' + msg.dump();
+
+    std::promise<std::string> p;
+    auto f = p.get_future();
+    std::thread client([&]()
+    {
+        SOCKET testSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in serverAddr = {};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(7784);
+        serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        connect(testSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        std::string frames = std::to_string(registration.length()) + '\r' + registration +
+            std::to_string(batchMsg.length()) + '\r' + batchMsg;
+        for (size_t sent = 0; sent < frames.length();)
+            sent += sock::send(testSocket, frames.c_str() + sent, frames.length() - sent);
+
+        std::string received;
+        char buffer[4096];
+        int bytes;
+        while (received.length() < expected.length() && (bytes = sock::recv(testSocket, buffer, sizeof(buffer))) > 0)
+            received.append(buffer, bytes);
+        p.set_value(received);
+        sock::close(testSocket);
+    });
+    while (success && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        success = server.poll();
+    client.join();
+    ASSERT_TRUE(success);
+    ASSERT_TRUE(f.get() == expected);
+    ASSERT_EQ(server.stats().batchesRouted, 1);
+    ASSERT_EQ(server.stats().coalescedWrites, 1);
+    server.cleanup();
+}
+
+// Test datagrams from a linked channel route over UDP, dropping stale ones, and fall back to TCP
+TEST(ServerTest, TestDatagramChannelEpoll)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("127.0.0.1", 7785, logger, false, PollBackend::Epoll);
+    server.setRoutingMode(RoutingMode::Header);
+    server.setDatagramPort(7785);
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    std::string registration = "{\"type\":\"registration\",\"value\":\"tele\"}";
+    std::string channel = "{\"type\":\"channel\",\"value\":\"tele-token\"}";
+    auto reading = [](int seq, size_t padding)
+    {
+        return "{\"type\":\"message\",\"from\":\"tele\",\"to\":\"tele\",\"data\":{\"seq\":" + std::to_string(seq) + ",\"pad\":\"" + std::string(padding, 'x') + "\"}}";
+    };
+    std::promise<std::vector<std::string>> p;
+    auto f = p.get_future();
+    std::thread client([&]()
+    {
+        sockaddr_in serverAddr = {};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(7785);
+        serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        timeval timeout = { 0, 50000 };
+        SOCKET tcpSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        SOCKET udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        setsockopt(udpSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        connect(tcpSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        connect(udpSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        std::string frames = std::to_string(registration.length()) + '\r' + registration +
+            std::to_string(channel.length()) + '\r' + channel;
+        sock::send(tcpSocket, frames.c_str(), frames.length());
+
+        // Say hello until acknowledged, the token may not be open yet
+        std::vector<std::string> received;
+        char buffer[2048];
+        int bytes = 0;
+        for (int attempt = 0; attempt < 40 && bytes <= 0; attempt++)
+        {
+            std::string hello = "0\r" + channel;
+            sock::send(udpSocket, hello.c_str(), hello.length());
+            bytes = sock::recv(udpSocket, buffer, sizeof(buffer));
+        }
+        received.push_back(bytes > 0 ? std::string(buffer, bytes) : "");
+
+        // Fresh, stale and fresh again, malformed, then one too large for a datagram
+        for (std::string datagram : { "5\r" + reading(5, 0), "3\r" + reading(3, 0), "6\r" + reading(6, 0), std::string("7\r{\"type\":\"message\",\"to\":"), "8\r" + reading(7, 2000) })
+            sock::send(udpSocket, datagram.c_str(), datagram.length());
+        while (received.size() < 3 && (bytes = sock::recv(udpSocket, buffer, sizeof(buffer))) > 0)
+        {
+            // Repeated hellos may have been acknowledged more than once
+            if (std::string(buffer, bytes).find("channel") == std::string::npos)
+                received.push_back(std::string(buffer, bytes));
+        }
+
+        std::string expected = reading(7, 2000);
+        expected = std::to_string(expected.length()) + '\r' + expected;
+        std::string stream;
+        while (stream.length() < expected.length() && (bytes = sock::recv(tcpSocket, buffer, sizeof(buffer))) > 0)
+            stream.append(buffer, bytes);
+        received.push_back(stream);
+        p.set_value(received);
+        sock::close(udpSocket);
+        sock::close(tcpSocket);
+    });
+    while (success && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        success = server.poll();
+    client.join();
+    ASSERT_TRUE(success);
+    std::vector<std::string> received = f.get();
+    ASSERT_EQ(received.size(), 4);
+    ASSERT_EQ(json::parse(received[0].substr(received[0].find('\r') + 1))["value"], "tele-token");
+    ASSERT_EQ(received[1].substr(received[1].find('\r') + 1), reading(5, 0));
+    ASSERT_EQ(received[2].substr(received[2].find('\r') + 1), reading(6, 0));
+    ASSERT_LT(std::stoull(received[1]), std::stoull(received[2]));
+    ASSERT_EQ(received[3], std::to_string(reading(7, 2000).length()) + '\r' + reading(7, 2000));
+    ServerStats stats = server.stats();
+    ASSERT_EQ(stats.datagramsIn, 4);
+    ASSERT_GE(stats.datagramsDropped, 2);
+    // A malformed datagram leaves its channel's stream connection up
+    ASSERT_EQ(stats.messagesMalformed, 1);
+    ASSERT_EQ(stats.messagesRouted, 3);
+    server.cleanup();
+}
+
+// Test routed messages are journaled and replayed to their receiver from an offset or a time
+TEST(ServerTest, TestJournalReplay)
+{
+    SOCKET testSock = INVALID_SOCKET;
+    for (RoutingMode mode : { RoutingMode::Parse, RoutingMode::Header })
+    {
+        char name[] = "/tmp/hsif-ut-journal-XXXXXX";
+        std::string directory = mkdtemp(name);
+        auto logger = std::make_shared<Logger>();
+        {
+            auto server = Server("", 7777, logger, false);
+            server.setRoutingMode(mode);
+            ASSERT_TRUE(server.openJournal(directory, DEFAULT_JOURNAL_POLICY));
+            EndpointHandle sender, receiver;
+            server.createEndpoint(testSock, sender);
+            server.createEndpoint(testSock, receiver);
+            server.routeMessage("{\"type\":\"registration\",\"value\":\"rpi\"}", sender);
+            server.routeMessage("{\"type\":\"registration\",\"value\":\"unity\"}", receiver);
+            server.routeMessage("{\"type\":\"subscribe\",\"value\":\"temps\"}", receiver);
+            for (int seq = 0; seq < 6; seq++)
+            {
+                // Messages and publishes for the receiver, interleaved with traffic it never sees
+                const char* to = seq % 3 == 0 ? "unity" : seq % 3 == 1 ? "other" : "temps";
+                const char* type = seq % 3 == 2 ? "publish" : "message";
+                server.routeMessage(std::string("{\"type\":\"") + type + "\",\"from\":\"rpi\",\"to\":\"" + to + "\",\"data\":{\"seq\":" + std::to_string(seq) + "}}", sender);
+            }
+            ASSERT_EQ(server.stats().messagesJournaled, 6);
+            ASSERT_EQ(server.journal()->endOffset(), 6);
+            ASSERT_TRUE(server.journal()->dirty());
+
+            std::shared_ptr<Endpoint> endpoint = server.getEndpoint("unity");
+            endpoint->outbound.consume(endpoint->outbound.bytesQueued());
+            server.routeMessage("{\"type\":\"replay\",\"offset\":2}", receiver);
+            ASSERT_EQ(endpoint->outbound.numFrames(), 4);
+            size_t count = endpoint->outbound.gather(endpoint->sendVecs, SEND_IOVECS);
+            ASSERT_EQ(count, 8);
+            ASSERT_EQ(json::parse(sock::ioVecView(endpoint->sendVecs[1]))["data"]["seq"], 2);
+            ASSERT_EQ(json::parse(sock::ioVecView(endpoint->sendVecs[3]))["data"]["seq"], 3);
+            ASSERT_EQ(json::parse(sock::ioVecView(endpoint->sendVecs[5]))["data"]["seq"], 5);
+            json done = json::parse(sock::ioVecView(endpoint->sendVecs[7]));
+            ASSERT_EQ(done["type"], "replay");
+            ASSERT_EQ(done["offset"], 6);
+            ASSERT_EQ(server.stats().messagesReplayed, 3);
+
+            // Nothing was routed after a time in the future
+            endpoint->outbound.consume(endpoint->outbound.bytesQueued());
+            server.routeMessage("{\"type\":\"replay\",\"since\":" + std::to_string(Journal::now() + 60000) + "}", receiver);
+            ASSERT_EQ(endpoint->outbound.numFrames(), 1);
+            server.cleanup();
+        }
+
+        // The journal outlives the server
+        auto server = Server("", 7777, logger, false);
+        ASSERT_TRUE(server.openJournal(directory, DEFAULT_JOURNAL_POLICY));
+        ASSERT_EQ(server.journal()->endOffset(), 6);
+        server.cleanup();
+        std::filesystem::remove_all(directory);
+    }
+}
+
+// Test a reconnecting client resumes its session over TCP and a session left disconnected expires
+TEST(ServerTest, TestSessionExpiryEpoll)
+{
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("127.0.0.1", 7789, logger, false, PollBackend::Epoll);
+    server.setSessionPolicy({ std::chrono::milliseconds(100), 16 });
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    std::string registration = "{\"type\":\"registration\",\"value\":\"rpi\",\"session\":\"s3cret\"}";
+    std::promise<std::vector<json>> p;
+    auto f = p.get_future();
+    std::thread client([&]()
+    {
+        sockaddr_in serverAddr = {};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(7789);
+        serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        std::string frames = std::to_string(registration.length()) + '\r' + registration;
+        std::vector<json> received;
+        for (int connection = 0; connection < 2; connection++)
+        {
+            SOCKET testSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            connect(testSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+            sock::send(testSocket, frames.c_str(), frames.length());
+            // One session message, however the bytes are split
+            std::string stream;
+            char buffer[1024];
+            int bytes;
+            while ((stream.find('\r') == std::string::npos || stream.length() < stream.find('\r') + 1 + std::stoull(stream)) &&
+                   (bytes = sock::recv(testSocket, buffer, sizeof(buffer))) > 0)
+                stream.append(buffer, bytes);
+            received.push_back(stream.empty() ? json() : json::parse(stream.substr(stream.find('\r') + 1)));
+            sock::close(testSocket);
+        }
+        p.set_value(received);
+    });
+    while (success && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        success = server.poll();
+    client.join();
+    std::vector<json> received = f.get();
+    ASSERT_EQ(received.size(), 2);
+    ASSERT_EQ(received[0]["resumed"], false);
+    ASSERT_EQ(received[1]["resumed"], true);
+    ASSERT_EQ(received[1]["resume"], 1);
+
+    // The poll wakes on its own once the grace period passes
+    for (int attempt = 0; attempt < 50 && success && server.stats().sessionsExpired == 0; attempt++)
+        success = server.poll();
+    ASSERT_TRUE(success);
+    ASSERT_EQ(server.numDetachedSessions(), 0);
+    ASSERT_TRUE(server.getEndpoint("rpi") == nullptr);
+    ASSERT_EQ(server.stats().sessionsResumed, 1);
+    ASSERT_EQ(server.stats().sessionsExpired, 1);
+    server.cleanup();
+}
+
+// Runs a shared-memory client and a TCP client exchanging messages through one server
+static void runSharedExchange(PollBackend backend, unsigned int port)
+{
+    auto logger = std::make_shared<Logger>();
+    std::string path = "/tmp/hsif-ut-shared-" + std::to_string(port) + ".sock";
+    auto server = Server("127.0.0.1", port, logger, false, backend);
+    server.setSharedPath(path);
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    std::string toTcp = "{\"type\":\"message\",\"from\":\"shm\",\"to\":\"tcp\",\"data\":\"from shared memory\"}";
+    std::string toShm = "{\"type\":\"message\",\"from\":\"tcp\",\"to\":\"shm\",\"data\":\"from tcp\"}";
+    // Larger than the ring in both directions, so both sides wait for space
+    std::string bulk = "{\"type\":\"message\",\"from\":\"shm\",\"to\":\"shm\",\"data\":\"" + std::string(SHARED_RING_CAPACITY * 5 / 2, 'x') + "\"}";
+    std::promise<std::vector<std::string>> p;
+    auto f = p.get_future();
+    std::thread client([&]()
+    {
+        std::vector<std::string> received;
+        SharedClient shared;
+        RecvFrame frame;
+        if (!shared.connect(path))
+        {
+            p.set_value(received);
+            return;
+        }
+        shared.send("{\"type\":\"registration\",\"value\":\"shm\"}");
+
+        SOCKET tcpSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in serverAddr = {};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(port);
+        serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        connect(tcpSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        std::string registration = "{\"type\":\"registration\",\"value\":\"tcp\"}";
+        std::string frames = std::to_string(registration.length()) + '\r' + registration;
+        sock::send(tcpSocket, frames.c_str(), frames.length());
+
+        // Messages sent before a registration is routed are parked, so order does not matter
+        shared.send(toTcp);
+        frames = std::to_string(toShm.length()) + '\r' + toShm;
+        sock::send(tcpSocket, frames.c_str(), frames.length());
+
+        std::string expected = std::to_string(toTcp.length()) + '\r' + toTcp;
+        std::string stream;
+        char buffer[1024];
+        int bytes;
+        while (stream.length() < expected.length() && (bytes = sock::recv(tcpSocket, buffer, sizeof(buffer))) > 0)
+            stream.append(buffer, bytes);
+        received.push_back(stream);
+        received.push_back(shared.receive(frame, 5000) ? std::string(frame.payload) : "");
+
+        shared.send(bulk);
+        received.push_back(shared.receive(frame, 5000) ? std::string(frame.payload) : "");
+        p.set_value(received);
+        shared.close();
+        sock::close(tcpSocket);
+    });
+    while (success && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        success = server.poll();
+    client.join();
+    ASSERT_TRUE(success);
+    std::vector<std::string> received = f.get();
+    ASSERT_EQ(received.size(), 3);
+    ASSERT_EQ(received[0], std::to_string(toTcp.length()) + '\r' + json::parse(toTcp).dump());
+    ASSERT_EQ(json::parse(received[1]), json::parse(toShm));
+    ASSERT_EQ(received[2].length(), json::parse(bulk).dump().length());
+
+    // Closing both clients removes their endpoints
+    for (int attempt = 0; attempt < 10 && server.numEndpoints() > 0; attempt++)
+        success = success && server.poll();
+    ASSERT_EQ(server.numEndpoints(), 0);
+    ASSERT_EQ(server.stats().messagesRouted, 3);
+    server.cleanup();
+}
+
+// Test shared-memory and socket endpoints route to each other with epoll
+TEST(ServerTest, TestSharedEndpointEpoll)
+{
+    runSharedExchange(PollBackend::Epoll, 7786);
+}
+
+// Test shared-memory and socket endpoints route to each other with select
+TEST(ServerTest, TestSharedEndpointSelect)
+{
+    runSharedExchange(PollBackend::Select, 7787);
+}
+
+// Test shared-memory and socket endpoints route to each other with io_uring
+TEST(ServerTest, TestSharedEndpointUring)
+{
+    runSharedExchange(PollBackend::Uring, 7788);
+}
+
+// Connects a blocking test client to the loopback server on a port
+static SOCKET connectTestClient(unsigned int port)
+{
+    SOCKET testSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in serverAddr = {};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    connect(testSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+    return testSocket;
+}
+
+// Receives exactly length bytes from a blocking test client
+static std::string recvTestBytes(SOCKET testSocket, size_t length)
+{
+    std::string received;
+    char buffer[1024];
+    int bytes;
+    while (received.length() < length && (bytes = sock::recv(testSocket, buffer, std::min(sizeof(buffer), length - received.length()))) > 0)
+        received.append(buffer, bytes);
+    return received;
+}
+
+// Test a successor takes over the listener and connections, with held frames, partial input and parked messages
+TEST(ServerTest, TestHandoffEpoll)
+{
+    std::string path = "/tmp/hsif_upgrade_test.sock";
+    auto logger = std::make_shared<Logger>();
+    auto server = Server("127.0.0.1", 7794, logger, false, PollBackend::Epoll);
+    server.setRoutingMode(RoutingMode::Header);
+    server.setUpgradePath(path);
+    // Frames to the receiver are held past the hand-off
+    server.setCoalescingPolicy({ 10000000, 0, false, false });
+    bool success = server.connect();
+    ASSERT_TRUE(success);
+
+    auto frame = [](const std::string& msg) { return std::to_string(msg.length()) + '\r' + msg; };
+    std::string held = "{\"type\":\"message\",\"from\":\"sender\",\"to\":\"receiver\",\"data\":1}";
+    std::string split = "{\"type\":\"message\",\"from\":\"sender\",\"to\":\"receiver\",\"data\":2}";
+    std::string parked = "{\"type\":\"message\",\"from\":\"sender\",\"to\":\"late\",\"data\":3}";
+    SOCKET sender = connectTestClient(7794);
+    SOCKET receiver = connectTestClient(7794);
+    std::string frames = frame("{\"type\":\"registration\",\"value\":\"sender\"}") + frame(held) + frame(parked);
+    std::string registration = frame("{\"type\":\"registration\",\"value\":\"receiver\"}");
+    sock::send(receiver, registration.c_str(), registration.length());
+    while (success && server.numRegisteredEndpoints() < 1)
+        success = server.poll();
+    // Half of a frame arrives before the hand-off, the rest after it
+    std::string splitFrame = frame(split);
+    frames += splitFrame.substr(0, splitFrame.length() / 2);
+    sock::send(sender, frames.c_str(), frames.length());
+    while (success && server.numParked("late") == 0)
+        success = server.poll();
+    ASSERT_TRUE(success);
+
+    // The old server polls until its successor acknowledges
+    Server successor("127.0.0.1", 7794, logger, false, PollBackend::Epoll);
+    successor.setRoutingMode(RoutingMode::Header);
+    std::future<bool> tookOver = std::async(std::launch::async, [&]() { return successor.takeOver(path); });
+    for (int attempt = 0; attempt < 100 && server.poll(); attempt++)
+        ;
+    ASSERT_TRUE(tookOver.get());
+    ASSERT_TRUE(server.handedOff());
+    ASSERT_FALSE(server.poll());
+    server.cleanup();
+    ASSERT_EQ(successor.numRegisteredEndpoints(), 2);
+    ASSERT_EQ(successor.numParked("late"), 1);
+
+    // Nothing reconnects: the held frame and the completed split frame reach the receiver, a new client is accepted
+    std::promise<std::vector<std::string>> p;
+    auto f = p.get_future();
+    std::thread client([&]()
+    {
+        std::vector<std::string> received;
+        std::string rest = splitFrame.substr(splitFrame.length() / 2);
+        sock::send(sender, rest.c_str(), rest.length());
+        received.push_back(recvTestBytes(receiver, frame(held).length() + splitFrame.length()));
+        SOCKET late = connectTestClient(7794);
+        std::string lateRegistration = frame("{\"type\":\"registration\",\"value\":\"late\"}");
+        sock::send(late, lateRegistration.c_str(), lateRegistration.length());
+        received.push_back(recvTestBytes(late, frame(parked).length()));
+        p.set_value(received);
+        sock::close(late);
+    });
+    success = true;
+    while (success && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        success = successor.poll();
+    client.join();
+    ASSERT_TRUE(success);
+    std::vector<std::string> received = f.get();
+    ASSERT_EQ(received[0], frame(held) + splitFrame);
+    ASSERT_EQ(received[1], frame(parked));
+    sock::close(sender);
+    sock::close(receiver);
+    successor.cleanup();
+    ASSERT_FALSE(std::filesystem::exists(path));
+}
+
+// Test taking over fails without a server accepting successors
+TEST(ServerTest, TestHandoffMissing)
+{
+    auto logger = std::make_shared<Logger>();
+    Server server("127.0.0.1", 7795, logger, false, PollBackend::Epoll);
+    ASSERT_FALSE(server.takeOver("/tmp/hsif_upgrade_missing.sock"));
+    ASSERT_FALSE(server.handedOff());
+    server.cleanup();
+}
+
+// Test the select backend refuses sockets its fd_sets cannot hold
+TEST(ServerTest, TestSelectDescriptorLimit)
+{
+    auto logger = std::make_shared<Logger>();
+    Server server("127.0.0.1", 7798, logger, false);
+    SOCKET low = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_TRUE(sock::fitsSelect(low));
+    // Only checked where the descriptor limit reaches past FD_SETSIZE
+    SOCKET high = dup2(low, FD_SETSIZE);
+    if (high != INVALID_SOCKET)
+    {
+        EndpointHandle handle;
+        ASSERT_FALSE(sock::fitsSelect(high));
+        ASSERT_FALSE(server.createEndpoint(high, handle));
+        ASSERT_EQ(server.numEndpoints(), 0);
+        sock::close(high);
+    }
+    sock::close(low);
+}
+
+// Wakes a server blocked in poll on another thread and checks no endpoint was created to do it
+static void runWake(PollBackend backend, unsigned int port)
+{
+    auto logger = std::make_shared<Logger>();
+    Server server("127.0.0.1", port, logger, false, backend);
+    ASSERT_TRUE(server.connect());
+    auto polled = std::async(std::launch::async, [&]() { return server.poll(); });
+    ASSERT_EQ(polled.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+    ASSERT_TRUE(server.wake());
+    ASSERT_EQ(polled.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    ASSERT_TRUE(polled.get());
+    ASSERT_EQ(server.numEndpoints(), 0);
+    server.cleanup();
+}
+
+// Test wake() returns a blocked poll with each backend
+TEST(ServerTest, TestWake)
+{
+    runWake(PollBackend::Select, 7801);
+    runWake(PollBackend::Epoll, 7802);
+    runWake(PollBackend::Uring, 7803);
+}
+#endif
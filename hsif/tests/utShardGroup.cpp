@@ -0,0 +1,157 @@
+#include "ShardGroup.hpp"
+#include "gtest/gtest.h"
+#include <future>
+
+#ifdef __linux__
+
+// Test directory registration and lookup
+TEST(TestShardGroup, TestDirectory)
+{
+	auto logger = std::make_shared<Logger>();
+	ShardGroup group("", 7779, logger, false, 2);
+	EndpointLocation location;
+	ASSERT_EQ(group.numShards(), 2);
+	ASSERT_TRUE(group.registerEndpoint("testId", { 1, SlotHandle{ 42, 1 } }));
+	ASSERT_FALSE(group.registerEndpoint("testId", { 0, SlotHandle{ 43, 1 } }));
+	ASSERT_TRUE(group.locate("testId", location));
+	ASSERT_EQ(location.shard, 1);
+	ASSERT_EQ(location.handle, (SlotHandle{ 42, 1 }));
+	// Only the owning shard may release an identifier
+	group.unregisterEndpoint("testId", 0);
+	ASSERT_TRUE(group.locate("testId", location));
+	group.unregisterEndpoint("testId", 1);
+	ASSERT_FALSE(group.locate("testId", location));
+}
+
+// Test identifiers are unique across shards
+TEST(TestShardGroup, TestRegisterAcrossShards)
+{
+	auto logger = std::make_shared<Logger>();
+	ShardGroup group("", 7779, logger, false, 2);
+	EndpointHandle first, second;
+	group.server(0).createEndpoint(INVALID_SOCKET, first);
+	group.server(1).createEndpoint(INVALID_SOCKET, second);
+	ASSERT_TRUE(group.server(0).registerEndpoint("testId", first));
+	ASSERT_FALSE(group.server(1).registerEndpoint("testId", second));
+	ASSERT_TRUE(group.server(0).numRegisteredEndpoints() == 1);
+	ASSERT_TRUE(group.server(1).numRegisteredEndpoints() == 0);
+}
+
+// Test message for an endpoint on another shard is handed to that shard
+TEST(TestShardGroup, TestCrossShardRouting)
+{
+	std::string msg = "{\"type\":\"message\",\"from\":\"sender\",\"to\":\"receiver\",\"data\":{\"data\":\"testData\"}}";
+	auto logger = std::make_shared<Logger>();
+	ShardGroup group("", 7779, logger, false, 2);
+	EndpointHandle sender, receiver;
+	group.server(0).createEndpoint(INVALID_SOCKET, sender);
+	group.server(1).createEndpoint(INVALID_SOCKET, receiver);
+	group.server(0).routeMessage("{\"type\":\"registration\",\"value\":\"sender\"}", sender);
+	group.server(1).routeMessage("{\"type\":\"registration\",\"value\":\"receiver\"}", receiver);
+
+	group.server(0).routeMessage(msg, sender);
+	ShardMessage forwarded;
+	ASSERT_FALSE(group.nextMessage(0, forwarded));
+	ASSERT_TRUE(group.nextMessage(1, forwarded));
+	ASSERT_EQ(forwarded.to, "receiver");
+	ASSERT_TRUE(json::parse(*forwarded.payload) == json::parse(msg));
+}
+
+// Test a publish reaches each subscribing shard once, sharing one payload
+TEST(TestShardGroup, TestCrossShardPublish)
+{
+	std::string msg = "{\"type\":\"publish\",\"from\":\"sensor\",\"to\":\"temperature\",\"data\":{\"value\":21.5}}";
+	auto logger = std::make_shared<Logger>();
+	ShardGroup group("", 7779, logger, false, 3);
+	EndpointHandle publisher, first, second;
+	group.server(0).createEndpoint(INVALID_SOCKET, publisher);
+	group.server(1).createEndpoint(INVALID_SOCKET, first);
+	group.server(1).createEndpoint(INVALID_SOCKET, second);
+	group.server(1).routeMessage("{\"type\":\"subscribe\",\"value\":\"temperature\"}", first);
+	group.server(1).routeMessage("{\"type\":\"subscribe\",\"value\":\"temperature\"}", second);
+
+	group.server(0).routeMessage(msg, publisher);
+	ShardMessage forwarded;
+	ASSERT_FALSE(group.nextMessage(2, forwarded));
+	ASSERT_TRUE(group.nextMessage(1, forwarded));
+	ASSERT_FALSE(group.nextMessage(1, forwarded));
+	ASSERT_TRUE(forwarded.publish);
+	ASSERT_EQ(forwarded.to, "temperature");
+	ASSERT_TRUE(json::parse(*forwarded.payload) == json::parse(msg));
+
+	// Last subscriber leaving removes the shard from the topic
+	group.server(1).deleteEndpoint(second);
+	group.server(1).routeMessage("{\"type\":\"unsubscribe\",\"value\":\"temperature\"}", first);
+	group.server(0).routeMessage(msg, publisher);
+	ASSERT_FALSE(group.nextMessage(1, forwarded));
+}
+
+// Test a blocking receiver fed from another shard stays at its high watermark
+TEST(TestShardGroup, TestCrossShardBackpressure)
+{
+	std::string msg = "{\"type\":\"message\",\"from\":\"sensor\",\"to\":\"unity\",\"data\":{\"temp\":21.5}}";
+	auto logger = std::make_shared<Logger>();
+	ShardGroup group("", 7779, logger, false, 2);
+	group.setBackpressurePolicy({ 200, 100, OverflowPolicy::Block });
+	EndpointHandle sensor, unity;
+	group.server(0).createEndpoint(INVALID_SOCKET, sensor);
+	group.server(1).createEndpoint(INVALID_SOCKET, unity);
+	group.server(0).routeMessage("{\"type\":\"registration\",\"value\":\"sensor\"}", sensor);
+	group.server(1).routeMessage("{\"type\":\"registration\",\"value\":\"unity\"}", unity);
+	std::shared_ptr<Endpoint> receiver = group.server(1).getEndpoint(unity);
+
+	// The sender's shard cannot be paused, the receiver sheds its oldest frames instead
+	for (int count = 0; count < 50; count++)
+	{
+		group.server(0).routeMessage(msg, sensor);
+		group.server(1).drainShardInbox();
+		ASSERT_LE(receiver->outbound.bytesQueued(), 200);
+	}
+	ASSERT_EQ(group.server(1).stats().overflowDrops, 50 - receiver->outbound.numFrames());
+	ASSERT_EQ(group.server(0).getEndpoint(sensor)->blockedOn, 0);
+}
+
+// Testing function for a blocking endpoint that registers, sends one message and waits for one reply
+void shardTestEndpoint(unsigned int port, std::string id, std::string to, std::promise<std::string>&& p)
+{
+	const std::string registration = "{\"type\":\"registration\",\"value\":\"" + id + "\"}";
+	const std::string msg = "{\"type\":\"message\",\"from\":\"" + id + "\",\"to\":\"" + to + "\",\"data\":{}}";
+	std::string outgoing = std::to_string(registration.length()) + '\r' + registration +
+		std::to_string(msg.length()) + '\r' + msg;
+
+	SOCKET testSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in serverAddr = {};
+	serverAddr.sin_family = AF_INET;
+	serverAddr.sin_port = htons(port);
+	serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	connect(testSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
+	sock::send(testSocket, outgoing.c_str(), outgoing.length());
+
+	char recvbuf[1024];
+	int bytesRecv = sock::recv(testSocket, recvbuf, sizeof(recvbuf));
+	p.set_value(std::string(recvbuf, bytesRecv > 0 ? bytesRecv : 0));
+	sock::close(testSocket);
+}
+
+// Test shards started on their own threads deliver messages between endpoints
+TEST(TestShardGroup, TestShardedPoll)
+{
+	auto logger = std::make_shared<Logger>();
+	ShardGroup group("", 7779, logger, false, 4);
+	ASSERT_TRUE(group.start());
+
+	std::promise<std::string> p;
+	auto f = p.get_future();
+	std::promise<std::string> p2;
+	auto f2 = p2.get_future();
+	std::thread ep1(&shardTestEndpoint, 7779, "testId", "otherTestId", std::move(p));
+	std::thread ep2(&shardTestEndpoint, 7779, "otherTestId", "testId", std::move(p2));
+	ep1.join();
+	ep2.join();
+	group.stop();
+
+	ASSERT_TRUE(f.get() == "63\r{\"data\":{},\"from\":\"otherTestId\",\"to\":\"testId\",\"type\":\"message\"}");
+	ASSERT_TRUE(f2.get() == "63\r{\"data\":{},\"from\":\"testId\",\"to\":\"otherTestId\",\"type\":\"message\"}");
+}
+
+#endif
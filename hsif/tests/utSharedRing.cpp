@@ -0,0 +1,148 @@
+#include "SharedRing.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+// Ring over private memory, as both sides of a channel see it
+struct TestRing
+{
+	SharedRingHeader header{};
+	char data[16];
+	SharedRing ring{ &header, data, sizeof(data) };
+};
+
+// Writes one buffer
+static size_t writeText(SharedRing& ring, const std::string& text)
+{
+	IoVec vec;
+	sock::setIoVec(vec, text.data(), text.size());
+	return ring.write(&vec, 1);
+}
+
+// Reads up to length bytes
+static std::string readText(SharedRing& ring, size_t length)
+{
+	std::string text(length, '\0');
+	text.resize(ring.read(&text[0], length));
+	return text;
+}
+
+// Test bytes come out in order across the end of the data area
+TEST(TestSharedRing, TestWrap)
+{
+	TestRing test;
+	IoVec vecs[2];
+	std::string header = "5\r";
+	std::string payload = "hello";
+	sock::setIoVec(vecs[0], header.data(), header.size());
+	sock::setIoVec(vecs[1], payload.data(), payload.size());
+	ASSERT_EQ(test.ring.write(vecs, 2), 7);
+	ASSERT_EQ(readText(test.ring, 4), "5\rhe");
+	ASSERT_EQ(writeText(test.ring, "abcdefghij"), 10);
+	ASSERT_EQ(test.ring.readable(), 13);
+	ASSERT_EQ(readText(test.ring, 64), "lloabcdefghij");
+	ASSERT_EQ(test.ring.readable(), 0);
+}
+
+// Test positions more than the capacity apart are refused rather than followed
+TEST(TestSharedRing, TestCorruptPositions)
+{
+	TestRing test;
+	char buffer[16];
+	test.header.tail = 17;
+	ASSERT_EQ(test.ring.read(buffer, sizeof(buffer)), SHARED_RING_ERROR);
+	ASSERT_EQ(writeText(test.ring, "x"), SHARED_RING_ERROR);
+	// A head ahead of the tail wraps to a huge distance too
+	test.header.tail = 0;
+	test.header.head = 1;
+	ASSERT_EQ(test.ring.read(buffer, sizeof(buffer)), SHARED_RING_ERROR);
+	ASSERT_EQ(writeText(test.ring, "x"), SHARED_RING_ERROR);
+}
+
+// Test a full ring takes part of a write and wakes a waiting producer once
+TEST(TestSharedRing, TestFull)
+{
+	TestRing test;
+	ASSERT_EQ(writeText(test.ring, std::string(20, 'x')), 16);
+	ASSERT_EQ(writeText(test.ring, "y"), 0);
+	ASSERT_FALSE(test.ring.wakeProducer());
+	ASSERT_TRUE(test.ring.prepareWait());
+	ASSERT_EQ(readText(test.ring, 4), "xxxx");
+	ASSERT_TRUE(test.ring.wakeProducer());
+	ASSERT_FALSE(test.ring.wakeProducer());
+
+	// Space freed before the wait is noticed without a wakeup
+	ASSERT_FALSE(test.ring.prepareWait());
+	ASSERT_FALSE(test.ring.wakeProducer());
+}
+
+// Test a sleeping consumer is woken by the first write only
+TEST(TestSharedRing, TestSleep)
+{
+	TestRing test;
+	ASSERT_FALSE(test.ring.wakeConsumer());
+	ASSERT_TRUE(test.ring.prepareSleep());
+	ASSERT_EQ(writeText(test.ring, "abc"), 3);
+	ASSERT_TRUE(test.ring.wakeConsumer());
+	ASSERT_EQ(writeText(test.ring, "def"), 3);
+	ASSERT_FALSE(test.ring.wakeConsumer());
+
+	// Bytes written before the sleep keep the consumer awake
+	ASSERT_FALSE(test.ring.prepareSleep());
+	ASSERT_FALSE(test.ring.wakeConsumer());
+	ASSERT_EQ(readText(test.ring, 16), "abcdef");
+}
+
+#ifdef __linux__
+
+// Returns whether a doorbell has been rung
+static bool rung(SOCKET bell)
+{
+	pollfd handle = { bell, POLLIN, 0 };
+	return ::poll(&handle, 1, 0) == 1;
+}
+
+// Test a channel passed over a local socket joins both sides' rings and doorbells
+TEST(TestSharedRing, TestChannelHandoff)
+{
+	int pair[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+	SharedChannel server;
+	SharedChannel client;
+	ASSERT_TRUE(server.create(1000));
+	ASSERT_TRUE(server.sendHandles(pair[0]));
+	ASSERT_TRUE(client.receiveHandles(pair[1]));
+
+	ASSERT_EQ(writeText(client.sending(), "ping"), 4);
+	ASSERT_EQ(readText(server.receiving(), 16), "ping");
+	ASSERT_EQ(writeText(server.sending(), std::string(2000, 'x')), 1024);
+	ASSERT_EQ(client.receiving().readable(), 1024);
+
+	ASSERT_FALSE(rung(server.bell()));
+	client.ringPeer();
+	ASSERT_TRUE(rung(server.bell()));
+	server.clearBell();
+	ASSERT_FALSE(rung(server.bell()));
+	ASSERT_FALSE(rung(client.bell()));
+	server.ringPeer();
+	ASSERT_TRUE(rung(client.bell()));
+
+	sock::close(pair[0]);
+	sock::close(pair[1]);
+}
+
+// Test a client refuses handles that do not describe a channel
+TEST(TestSharedRing, TestChannelRejected)
+{
+	int pair[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+	int handles[3] = { pair[0], pair[0], pair[0] };
+	ASSERT_TRUE(sock::sendHandles(pair[0], handles, 3));
+	SharedChannel client;
+	ASSERT_FALSE(client.receiveHandles(pair[1]));
+	sock::close(pair[0]);
+	sock::close(pair[1]);
+}
+#endif
@@ -0,0 +1,93 @@
+#include "SlabPool.hpp"
+#include "gtest/gtest.h"
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Test a freed block is handed out again by the next request of its size class
+TEST(TestSlabPool, TestReuse)
+{
+	SlabPool& pool = SlabPool::shared();
+	void* block = pool.allocate(100);
+	pool.deallocate(block, 100);
+	void* again = pool.allocate(128);
+	ASSERT_EQ(again, block);
+	pool.deallocate(again, 128);
+
+	// Another size class does not take it
+	void* small = pool.allocate(64);
+	ASSERT_NE(small, block);
+	pool.deallocate(small, 64);
+}
+
+// Test requests past the largest class go to the heap and are counted
+TEST(TestSlabPool, TestOversized)
+{
+	SlabPool& pool = SlabPool::shared();
+	uint64_t before = pool.stats().oversized;
+	void* block = pool.allocate(SLAB_MAX_BLOCK + 1);
+	ASSERT_EQ(pool.stats().oversized, before + 1);
+	pool.deallocate(block, SLAB_MAX_BLOCK + 1);
+}
+
+// Test a warm pool serves repeated allocations without carving more blocks
+TEST(TestSlabPool, TestSteadyState)
+{
+	SlabPool& pool = SlabPool::shared();
+	std::vector<void*> blocks;
+	for (int round = 0; round < 3; round++)
+	{
+		uint64_t carved = pool.stats().blocksCarved;
+		for (int index = 0; index < 1000; index++)
+			blocks.push_back(pool.allocate(256));
+		for (void* block : blocks)
+			pool.deallocate(block, 256);
+		blocks.clear();
+		if (round > 0)
+		{
+			ASSERT_EQ(pool.stats().blocksCarved, carved);
+		}
+	}
+	ASSERT_GT(pool.stats().slabBytes, 0);
+}
+
+// Test blocks freed on another thread find their way back through the shared lists
+TEST(TestSlabPool, TestCrossThread)
+{
+	SlabPool& pool = SlabPool::shared();
+	std::vector<void*> blocks;
+	for (int index = 0; index < 4 * SLAB_BATCH; index++)
+		blocks.push_back(pool.allocate(2048));
+	uint64_t shared = pool.stats().blocksShared;
+	std::thread other([&]()
+	{
+		for (void* block : blocks)
+			pool.deallocate(block, 2048);
+	});
+	other.join();
+	// The exited thread's free list is handed over in full
+	ASSERT_GE(pool.stats().blocksShared, shared + blocks.size());
+
+	uint64_t carved = pool.stats().blocksCarved;
+	for (void*& block : blocks)
+		block = pool.allocate(2048);
+	ASSERT_EQ(pool.stats().blocksCarved, carved);
+	for (void* block : blocks)
+		pool.deallocate(block, 2048);
+}
+
+// Test containers and shared objects drawing from the pool
+TEST(TestSlabPool, TestAllocator)
+{
+	std::deque<int, PoolAllocator<int>> values;
+	for (int value = 0; value < 10000; value++)
+		values.push_back(value);
+	for (int value = 0; value < 10000; value++)
+	{
+		ASSERT_EQ(values.front(), value);
+		values.pop_front();
+	}
+	std::shared_ptr<std::string> text = std::allocate_shared<std::string>(PoolAllocator<std::string>(), "pooled");
+	ASSERT_EQ(*text, "pooled");
+}
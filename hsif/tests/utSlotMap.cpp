@@ -0,0 +1,50 @@
+#include "SlotMap.hpp"
+#include "gtest/gtest.h"
+#include <string>
+
+// Test values are reachable through their handles
+TEST(TestSlotMap, TestInsertGet)
+{
+	SlotMap<std::string> map;
+	SlotHandle first = map.insert("first");
+	SlotHandle second = map.insert("second");
+	ASSERT_EQ(map.size(), 2);
+	ASSERT_EQ(*map.get(first), "first");
+	ASSERT_EQ(*map.get(second), "second");
+	ASSERT_TRUE(map.get(INVALID_SLOT_HANDLE) == nullptr);
+}
+
+// Test erased handles go stale and stay stale after their slot is reused
+TEST(TestSlotMap, TestStaleHandle)
+{
+	SlotMap<std::string> map;
+	SlotHandle first = map.insert("first");
+	ASSERT_TRUE(map.erase(first));
+	ASSERT_FALSE(map.contains(first));
+	ASSERT_FALSE(map.erase(first));
+
+	SlotHandle reused = map.insert("reused");
+	ASSERT_EQ(reused.slot, first.slot);
+	ASSERT_TRUE(reused != first);
+	ASSERT_TRUE(map.get(first) == nullptr);
+	ASSERT_EQ(*map.get(reused), "reused");
+}
+
+// Test erasing keeps storage dense and every other handle valid
+TEST(TestSlotMap, TestDenseErase)
+{
+	SlotMap<int> map;
+	SlotHandle handles[4];
+	for (int value = 0; value < 4; value++)
+		handles[value] = map.insert(value);
+	map.erase(handles[1]);
+	ASSERT_EQ(map.size(), 3);
+
+	int sum = 0;
+	for (int value : map)
+		sum += value;
+	ASSERT_EQ(sum, 0 + 2 + 3);
+	for (size_t position = 0; position < map.size(); position++)
+		ASSERT_EQ(*map.get(map.handleAt(position)), map.at(position));
+	ASSERT_EQ(*map.get(handles[3]), 3);
+}
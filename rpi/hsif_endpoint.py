@@ -1,12 +1,43 @@
 import random
 import json
 import threading
+import secrets
 import select
 import socket
 import sys
 import time
 import queue
 
+# Binary framing: magic, format, flags, reserved, little-endian uint32 payload length
+BINARY_FRAME_MAGIC = 0xB5
+BINARY_HEADER_SIZE = 8
+FRAMING_FORMATS = { "text" : 0, "msgpack" : 1, "cbor" : 2 }
+
+def encode_payload(obj, framing):
+    '''
+        Encodes a dict in the given binary framing. The msgpack and cbor2
+        modules are only needed by endpoints that negotiate those framings.
+    '''
+    if framing == "msgpack":
+        import msgpack
+        return msgpack.packb(obj)
+    if framing == "cbor":
+        import cbor2
+        return cbor2.dumps(obj)
+    return json.dumps(obj).encode('utf-8')
+
+def decode_payload(payload, format_id):
+    '''
+        Decodes a binary frame payload given the format byte of its header.
+    '''
+    if format_id == FRAMING_FORMATS["msgpack"]:
+        import msgpack
+        return msgpack.unpackb(payload)
+    if format_id == FRAMING_FORMATS["cbor"]:
+        import cbor2
+        return cbor2.loads(payload)
+    return json.loads(payload.decode('utf-8'))
+
 class HSIFMsg():
     '''
     -------------- HSIF Message Base Class --------------
@@ -50,20 +81,40 @@ class HSIFMsg():
         json_msg = str(len(json_msg.encode('utf-8'))) + '\r' + json_msg
         return json_msg
 
+    def get_frame(self, framing="text"):
+        '''
+            Creates and returns the framed bytes of the current HSIFMsg instance
+            in the given framing ("text", "msgpack" or "cbor").
+        '''
+        if framing == "text":
+            return self.get_json().encode('utf-8')
+        payload = encode_payload(self.dict, framing)
+        header = bytes([BINARY_FRAME_MAGIC, FRAMING_FORMATS[framing], 0, 0]) + len(payload).to_bytes(4, 'little')
+        return header + payload
+
 class HSIFEndpoint():
     '''
     -------------- HSIF Endpoint Base Class --------------
         Base class used to encapsulate JSON messaging
         facilities for Endpoint. 
     '''
-    def __init__(self, sock=None):
+    def __init__(self, sock=None, framing="text"):
         # Initialize class variables
         self.packet_size=1024
+        # Framing negotiated at registration, messages received use it once registered
+        self.framing = framing
+        self.recv_buffer = bytearray()
         self.valid = False
         self.msg_inbox = queue.Queue()
         self.msg_outbox = queue.Queue()
         self.message = ""
         self.msg_thread = None
+        # Datagram channel for loss-tolerant messages, opened by open_channel
+        self.udp_sock = None
+        self.channel_token = None
+        self.channel_linked = False
+        self.datagram_seq_out = 0
+        self.datagram_seq_in = 0
         # If socket provided, set
         if sock is None:
             self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
@@ -80,6 +131,7 @@ class HSIFEndpoint():
             # Begin by generating registration message for endpoint.
             self.register(id)
             self.sock.connect((host, port))
+            self.server_addr = (host, port)
             self.valid = True
             # Create and start IO management thread.
             self.msg_thread = threading.Thread(target=self.poll, args=())
@@ -94,15 +146,94 @@ class HSIFEndpoint():
             and sends to outgoing message structure. Endpoint must be registered to 
             receive messages.
         '''
-        json_data = "{ \"type\" : \"registration\", \"value\" : \"" + id + "\" }"
+        json_data = "{ \"type\" : \"registration\", \"value\" : \"" + id + "\", \"framing\" : \"" + self.framing + "\" }"
         json_data = str(len(json_data.encode('utf-8'))) + '\r' + json_data
         self.msg_outbox.put(json_data)
 
+    def subscribe(self, topic):
+        '''
+            Creates a subscription message for the given topic and sends to
+            outgoing message structure. Every message published to the topic
+            is delivered to this endpoint.
+        '''
+        json_data = "{ \"type\" : \"subscribe\", \"value\" : \"" + topic + "\" }"
+        json_data = str(len(json_data.encode('utf-8'))) + '\r' + json_data
+        self.msg_outbox.put(json_data)
+
+    def publish(self, from_id, topic, data):
+        '''
+            Sends data once to the HSIF server, which delivers it to every
+            subscriber of the topic.
+        '''
+        msg = HSIFMsg(from_id, topic, data)
+        msg.dict["type"] = "publish"
+        self.msg_outbox.put(msg.get_frame(self.framing))
+
+    def send_batch(self, msgs):
+        '''
+            Sends several HSIFMsg instances in one frame. The HSIF server
+            splits the batch and routes each message in order, as if each
+            had been sent on its own.
+        '''
+        batch = HSIFMsg(None, None, None)
+        batch.dict = { "type" : "batch", "messages" : [ msg.dict for msg in msgs ] }
+        self.msg_outbox.put(batch.get_frame(self.framing))
+
+    def open_channel(self):
+        '''
+            Opens a UDP datagram channel linked to this endpoint's TCP session.
+            The token is sent over TCP, then repeated in hellos over UDP until
+            the server acknowledges it. Must be called after connect.
+        '''
+        self.channel_token = secrets.token_hex(16)
+        json_data = "{ \"type\" : \"channel\", \"value\" : \"" + self.channel_token + "\" }"
+        self.msg_outbox.put(str(len(json_data.encode('utf-8'))) + '\r' + json_data)
+        self.udp_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.udp_sock.connect(self.server_addr)
+        self.send_hello()
+
+    def send_hello(self):
+        '''
+            Sends a channel hello. Hellos always carry sequence 0.
+        '''
+        hello = "0\r{ \"type\" : \"channel\", \"value\" : \"" + self.channel_token + "\" }"
+        self.udp_sock.send(hello.encode('utf-8'))
+
+    def send_datagram(self, msg):
+        '''
+            Sends a loss-tolerant HSIFMsg as one datagram, numbered so the server
+            and receivers drop any that arrive after a newer one. Goes over TCP
+            until the channel is linked.
+        '''
+        if not self.channel_linked:
+            self.msg_outbox.put(msg.get_frame(self.framing))
+            return
+        self.datagram_seq_out += 1
+        self.udp_sock.send(str(self.datagram_seq_out).encode('utf-8') + b'\r' + encode_payload(msg.dict, self.framing))
+
+    def process_datagram(self, datagram):
+        '''
+            Handles one received datagram: acknowledges the channel hello, drops
+            stale datagrams and queues the data of fresh ones.
+        '''
+        header, _, payload = datagram.partition(b'\r')
+        seq = int(header.decode('utf-8'))
+        msg = decode_payload(payload, FRAMING_FORMATS[self.framing])
+        if msg.get("type") == "channel":
+            self.channel_linked = True
+            return
+        if seq <= self.datagram_seq_in:
+            return
+        self.datagram_seq_in = seq
+        self.msg_inbox.put(msg["data"])
+
     def disconnect(self):
         '''
             Closes socket connection and invalidates endpoint.
         '''
         self.sock.close()
+        if self.udp_sock is not None:
+            self.udp_sock.close()
         self.valid = False
     
     def poll(self):
@@ -126,8 +257,15 @@ class HSIFEndpoint():
                 outputs = [self.sock]
             else:
                 outputs = []
+            # Watch the datagram channel once opened, repeating the hello until acknowledged
+            if self.udp_sock is not None and self.udp_sock not in inputs:
+                inputs.append(self.udp_sock)
+            if self.udp_sock is not None and not self.channel_linked:
+                self.send_hello()
             # Retrieve lists of readable, writable, and exceptional sockets. Block if nothing has changed.
-            readable, writable, exceptional = select.select(inputs, outputs, [], 3)
+            readable, writable, exceptional = select.select(inputs, outputs, [], 3 if self.channel_linked or self.udp_sock is None else 0.5)
+            if self.udp_sock in readable:
+                self.process_datagram(self.udp_sock.recv(65536))
             # If writable, send message
             if self.sock in writable:
                 self.send_msg(self.msg_outbox.get())
@@ -137,6 +275,10 @@ class HSIFEndpoint():
                 # If empty, disconnect
                 if chunk == b'':
                     raise RuntimeError("socket connection broken")
+                # Binary framing has fixed size headers and is parsed separately
+                if self.framing != "text":
+                    self.process_binary(chunk)
+                    chunk = b''
                 # First message or new message. Look for size header first.
                 while chunk != b'':
                     if msg_len == 0:
@@ -175,6 +317,23 @@ class HSIFEndpoint():
         # IO loop exited successfully
         print("Endpoint closed")
 
+    def process_binary(self, chunk):
+        '''
+            Appends received bytes and extracts every complete binary frame,
+            keeping partial frames buffered for the next packet.
+        '''
+        self.recv_buffer += chunk
+        while len(self.recv_buffer) >= BINARY_HEADER_SIZE:
+            if self.recv_buffer[0] != BINARY_FRAME_MAGIC:
+                raise RuntimeError("error trying to process message")
+            msg_len = int.from_bytes(self.recv_buffer[4:BINARY_HEADER_SIZE], 'little')
+            if len(self.recv_buffer) < BINARY_HEADER_SIZE + msg_len:
+                break
+            payload = bytes(self.recv_buffer[BINARY_HEADER_SIZE:BINARY_HEADER_SIZE + msg_len])
+            msg = decode_payload(payload, self.recv_buffer[1])
+            del self.recv_buffer[:BINARY_HEADER_SIZE + msg_len]
+            self.msg_inbox.put(msg["data"])
+
     def send_msg(self, msg):
         '''
             Sends HSIFMsg message provided. Loops over 
@@ -182,7 +341,8 @@ class HSIFEndpoint():
             transferred.
         '''
         totalsent = 0
-        msg_bytes = msg.encode('utf-8')
+        # Binary frames are queued as bytes, text frames as str
+        msg_bytes = msg if isinstance(msg, bytes) else msg.encode('utf-8')
         msg_len = len(msg_bytes)
         while totalsent < msg_len:
             sent = self.sock.send(msg_bytes[totalsent:])
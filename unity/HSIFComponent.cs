@@ -25,6 +25,9 @@ public abstract class HSIFComponent : MonoBehaviour
     public string host = "localhost";
     public int port = 8888;
     public string endpointId = "";
+    // Keep only the newest undelivered message per sender and key,
+    // so a slow display never renders stale readings.
+    public bool conflate = false;
 
     // Socket communication resources.
     protected TcpClient hsifSocket;
@@ -68,7 +71,7 @@ public abstract class HSIFComponent : MonoBehaviour
     void RegisterEndpoint()
     {
         // Create registration message
-        string message = "{ \"type\": \"registration\", \"value\" : \"" + endpointId + "\" }";
+        string message = "{ \"type\": \"registration\", \"value\" : \"" + endpointId + "\", \"conflate\" : " + (conflate ? "true" : "false") + " }";
         // Add to outbox
         msgOutbox.Enqueue(message);
     }